@@ -129,6 +129,11 @@
 
 #define LCD_2LINE_5x7           0x38    // 8-bit, 2 lines, 5x7 font (for reference)
 
+// Display geometry
+#define LCD_ROWS                2
+#define LCD_COLS                16
+#define LCD_CGRAM_SLOTS         8
+
 /* ================== PUBLIC API: CORE FUNCTIONS ==================
  * These are the main functions used by the application.
  * The rest of the project should only use these and not
@@ -138,6 +143,18 @@
 // Initialize LCD in 4-bit mode and configure basic settings
 void LCD_Init(void);
 
+// Re-synchronise an LCD that stayed powered over an MCU reset;
+// skips the power-up delays of LCD_Init(), contents are kept
+void LCD_Resume(void);
+
+// Drive EN, RS and D4-D7 low so the controller latches nothing more;
+// no waiting (supply failure, power.h). LCD_Resume() takes it back
+void LCD_SafeState(void);
+
+// Time spent in the driver's fixed delays since start-up, in us (wraps).
+// It does not shrink with a faster clock (governor.h).
+uint32_t LCD_WaitedUs(void);
+
 // Clear entire display and return cursor home
 void LCD_Clear(void);
 
@@ -181,7 +198,7 @@ void LCD_WriteString(char *str);
 // Set position and then write string
 void LCD_WriteStringXY(uint8_t row, uint8_t col, char *str);
 
-// printf-style formatted print to LCD
+// printf-style formatted print to LCD (%c %s %d %u %x with width, see fmt.h)
 void LCD_Print(char *format, ...);
 
 /* ================== CUSTOM CHARACTER FUNCTIONS ==================
@@ -191,7 +208,14 @@ void LCD_Print(char *format, ...);
  * ================================================================ */
 
 // Define a custom character pattern at CGRAM location (0..7)
-void LCD_CreateChar(uint8_t location, uint8_t charmap[]);
+void LCD_CreateChar(uint8_t location, const uint8_t charmap[]);
+
+// Put a 5x8 glyph in CGRAM and return its character code (0..7).
+// A glyph that is already loaded is not uploaded again; otherwise a
+// free slot is used, then the oldest upload is replaced (a character
+// still on screen changes with it). The LCD address is left in CGRAM,
+// so set the cursor before writing text.
+uint8_t LCD_LoadGlyph(const uint8_t glyph[8]);
 
 // Write pre-defined custom char at current cursor
 void LCD_WriteCustomChar(uint8_t location);
@@ -0,0 +1,46 @@
+#ifndef ANIM_H
+#define ANIM_H
+
+#include <stdint.h>
+
+/**
+ * @file    anim.h
+ * @brief   Player for LCD animations stored in flash
+ *
+ * An animation is const data produced by Tools/anim_pack.py from an
+ * ASCII-art or PNG source in Assets/ (see the tool for the format).
+ * Glyph bitmaps and frames are run-length coded and decoded while
+ * playing; the only RAM used is the player's copy of the screen.
+ *
+ * Glyphs go through the LCD driver's CGRAM cache (LCD_LoadGlyph()),
+ * so a bitmap already in the display is not uploaded again. Only
+ * cells that differ from the previous frame are written.
+ *
+ * Playback does not block: ANIM_Start() draws the first frame and
+ * ANIM_Poll() the later ones when their time has come, so other work
+ * can run between frames. Frames that are overdue when polled are
+ * skipped. Nothing else may write to the LCD while an animation runs.
+ */
+
+typedef struct {
+    const char *name;
+    const uint8_t *glyphs;      // RLE glyph rows
+    const uint8_t *timeline;    // Frames: duration, then RLE cells
+    uint8_t glyphCount;         // At most LCD_CGRAM_SLOTS
+    uint16_t frameCount;
+} Anim_t;
+
+// Upload the glyphs, clear the LCD and draw the first frame
+void ANIM_Start(const Anim_t *anim);
+
+// Draw the frame that is due, if any. Returns 1 while the animation
+// runs, i.e. until the last frame has been shown for its duration.
+// Call it from the main loop, not from an interrupt: it drives the LCD.
+uint8_t ANIM_Poll(void);
+
+uint8_t ANIM_Running(void);
+
+// End now; the current frame stays on the LCD
+void ANIM_Stop(void);
+
+#endif
@@ -0,0 +1,10 @@
+/* Generated by Tools/anim_pack.py from rocket.anim; do not edit. */
+
+#ifndef ANIM_ASSETS_H
+#define ANIM_ASSETS_H
+
+#include "anim.h"
+
+extern const Anim_t animRocket;
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef APP_CONFIG_H
+#define APP_CONFIG_H
+
+/**
+ * @file    app_config.h
+ * @brief   Build-time feature switches for the application
+ *
+ * Every switch has a default here and can be overridden from the
+ * build, e.g. -DCONFIG_MODE_STOPWATCH=0 in
+ * Project > Properties > C/C++ Build > Settings > Preprocessor.
+ *
+ * A mode that is switched off is not compiled at all, so it takes
+ * no flash, no RAM and never appears in the mode registry.
+ */
+
+/* ================== APPLICATION MODES ================== */
+
+#ifndef CONFIG_MODE_CLOCK
+#define CONFIG_MODE_CLOCK        1
+#endif
+
+#ifndef CONFIG_MODE_STOPWATCH
+#define CONFIG_MODE_STOPWATCH    1
+#endif
+
+// Lap times kept by the stopwatch (4 bytes each)
+#ifndef CONFIG_STOPWATCH_LAPS
+#define CONFIG_STOPWATCH_LAPS    16
+#endif
+
+// Mirror the stopwatch into the backup SRAM and resume it after a
+// reset (stopwatch.h)
+#ifndef CONFIG_STOPWATCH_BACKUP
+#define CONFIG_STOPWATCH_BACKUP  1
+#endif
+
+#ifndef CONFIG_MODE_SETTINGS
+#define CONFIG_MODE_SETTINGS     1
+#endif
+
+// Debug view with stack / heap high-water marks (needs CONFIG_MEMSTAT)
+#ifndef CONFIG_MODE_MEMINFO
+#define CONFIG_MODE_MEMINFO      0
+#endif
+
+// Debug view with the boot-time profile (boot.h)
+#ifndef CONFIG_MODE_BOOTINFO
+#define CONFIG_MODE_BOOTINFO     0
+#endif
+
+/* ================== STORAGE ================== */
+
+// Settings in flash sectors 1 and 2 (kvstore.h); the linker script
+// keeps the program out of them
+#ifndef CONFIG_KV_STORE
+#define CONFIG_KV_STORE          1
+#endif
+
+// Event log in flash sectors 6 and 7 (eventlog.h): resets, time
+// corrections, stopwatch sessions; the linker script keeps the
+// program out of them
+#ifndef CONFIG_EVENT_LOG
+#define CONFIG_EVENT_LOG         1
+#endif
+
+/* ================== POWER ================== */
+
+// Save the state to backup SRAM when the supply fails (power.h)
+#ifndef CONFIG_POWER_FAIL
+#define CONFIG_POWER_FAIL        1
+#endif
+
+// PVD level, PLS: 0 = 2.0 V .. 7 = 2.9 V. Above 2.7 V, where flash
+// programming ends, so no write starts once the warning is given
+#ifndef CONFIG_PVD_LEVEL
+#define CONFIG_PVD_LEVEL         7
+#endif
+
+// Pick the clock profile from the main loop's load (governor.h)
+#ifndef CONFIG_GOVERNOR
+#define CONFIG_GOVERNOR          1
+#endif
+
+// Load is judged per window
+#ifndef CONFIG_GOVERNOR_WINDOW_MS
+#define CONFIG_GOVERNOR_WINDOW_MS  250
+#endif
+
+// Longest CPU part of a main loop pass: two 10 ms button poll
+// periods (a press lasts 50 ms or more)
+#ifndef CONFIG_GOVERNOR_PASS_US
+#define CONFIG_GOVERNOR_PASS_US  20000
+#endif
+
+// Busy share of a window above which the clock goes up, and below
+// which a lower profile has to stay before it goes down
+#ifndef CONFIG_GOVERNOR_UP_PCT
+#define CONFIG_GOVERNOR_UP_PCT   50
+#endif
+
+#ifndef CONFIG_GOVERNOR_DOWN_PCT
+#define CONFIG_GOVERNOR_DOWN_PCT 20
+#endif
+
+// Windows in a row a lower profile must do before it is taken
+#ifndef CONFIG_GOVERNOR_HOLD
+#define CONFIG_GOVERNOR_HOLD     4
+#endif
+
+// Trim the HSI against the LSE crystal, correct the stopwatch for
+// the rest (hsitrim.h)
+#ifndef CONFIG_HSITRIM
+#define CONFIG_HSITRIM           1
+#endif
+
+// LSE periods per measurement, a multiple of 8: 8192 is 250 ms, to
+// 0.03 ppm at 16 MHz
+#ifndef CONFIG_HSITRIM_PERIODS
+#define CONFIG_HSITRIM_PERIODS   8192
+#endif
+
+// Between measurements once settled
+#ifndef CONFIG_HSITRIM_INTERVAL_S
+#define CONFIG_HSITRIM_INTERVAL_S  60
+#endif
+
+// LSE start-up allowed before calibration is given up (HAL: 5000)
+#ifndef CONFIG_HSITRIM_LSE_MS
+#define CONFIG_HSITRIM_LSE_MS    5000
+#endif
+
+/* ================== CONSOLE ================== */
+
+// Command console on USART2 (console.h); stdout shares the line
+#ifndef CONFIG_CONSOLE
+#define CONFIG_CONSOLE           1
+#endif
+
+#ifndef CONFIG_CONSOLE_BAUD
+#define CONFIG_CONSOLE_BAUD      115200
+#endif
+
+// DMA ring sizes; the RX ring must hold what arrives during one main
+// loop pass (256 bytes: 22 ms at 115200, two passes). Power of two.
+#ifndef CONFIG_CONSOLE_RX_BYTES
+#define CONFIG_CONSOLE_RX_BYTES  256
+#endif
+
+#ifndef CONFIG_CONSOLE_TX_BYTES
+#define CONFIG_CONSOLE_TX_BYTES  512
+#endif
+
+// Longest command line; longer lines are rejected
+#ifndef CONFIG_CONSOLE_LINE
+#define CONFIG_CONSOLE_LINE      48
+#endif
+
+/* ================== TELEMETRY ================== */
+
+// Binary record stream on USART1 TX, PA9 (telemetry.h); off by default
+#ifndef CONFIG_TELEMETRY
+#define CONFIG_TELEMETRY         0
+#endif
+
+#ifndef CONFIG_TELEMETRY_BAUD
+#define CONFIG_TELEMETRY_BAUD    921600
+#endif
+
+// Each of the two DMA buffers; about 5 ms of line time at 921600 baud
+#ifndef CONFIG_TELEMETRY_BUF_BYTES
+#define CONFIG_TELEMETRY_BUF_BYTES 512
+#endif
+
+/* ================== DIAGNOSTICS ================== */
+
+// Run the DWT micro-benchmarks (bench.c) once after start-up and
+// print the results on stdout (USART2, 115200 8N1 on the ST-LINK VCP)
+#ifndef CONFIG_BENCHMARK
+#define CONFIG_BENCHMARK         0
+#endif
+
+// Record LCD transfers, FSM transitions, RTC reads and interrupts
+// in the trace ring (trace.h). Records are 8 bytes each.
+#ifndef CONFIG_TRACE
+#define CONFIG_TRACE             0
+#endif
+
+#ifndef CONFIG_TRACE_RECORDS
+#define CONFIG_TRACE_RECORDS     512
+#endif
+
+// Paint the stack at start-up and track stack / heap high-water marks
+#ifndef CONFIG_MEMSTAT
+#define CONFIG_MEMSTAT           1
+#endif
+
+#ifndef CONFIG_MEMSTAT_SCAN_MS
+#define CONFIG_MEMSTAT_SCAN_MS   1000
+#endif
+
+// Record button events, console stopwatch actions and RTC corrections
+// for replay (input_log.h)
+#ifndef CONFIG_INPUT_LOG
+#define CONFIG_INPUT_LOG         1
+#endif
+
+// A press takes 2 bytes, an RTC correction 5
+#ifndef CONFIG_INPUT_LOG_BYTES
+#define CONFIG_INPUT_LOG_BYTES   512
+#endif
+
+#if CONFIG_MODE_MEMINFO && !CONFIG_MEMSTAT
+#error "CONFIG_MODE_MEMINFO requires CONFIG_MEMSTAT"
+#endif
+
+#endif
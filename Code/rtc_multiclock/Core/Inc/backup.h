@@ -0,0 +1,60 @@
+#ifndef BACKUP_H
+#define BACKUP_H
+
+#include "app_config.h"
+#include "main.h"
+#include "stopwatch.h"
+#include "crash.h"
+#include "power.h"
+#include "eventlog.h"
+
+/**
+ * @file    backup.h
+ * @brief   Layout of the 4 KB backup SRAM: state that survives a reset
+ *
+ * The backup SRAM sits in the backup domain with the RTC. It keeps
+ * its contents through every reset, and with the backup regulator on
+ * also on VBAT while VDD is off. A write is a plain store of a few
+ * cycles, with no wear: state can be mirrored on every change.
+ *
+ * After a power-on without a battery the contents are random, and a
+ * reset can cut a multi-word update short, so each user checks its
+ * own data (CRC16) before it trusts it.
+ *
+ * BACKUP_Init() opens the domain for writing (DBP) and starts the
+ * backup regulator; call it after MX_RTC_Init() and before the users
+ * read their state (MODE_InitAll()). BACKUP_Access() only opens it,
+ * without waiting for anything, for the fault handlers.
+ */
+
+// Time being edited in SETTINGS when the supply failed (mode_settings.c)
+typedef struct {
+    uint32_t magic;          // SETTINGS_BACKUP_MAGIC while an edit is pending
+    uint8_t  hours;
+    uint8_t  minutes;
+    uint8_t  state;          // SET_HOURS, SET_MINUTES or SET_SAVE
+    uint8_t  reserved;
+    uint16_t crc;            // CRC16 of the rest
+} SettingsBackup_t;
+
+#define SETTINGS_BACKUP_MAGIC  0x54455345U   // "ESET"
+
+typedef struct {
+    StopwatchBackup_t stopwatch[2];   // Two copies, see mode_stopwatch.c
+    CrashDump_t       crash;          // Last fault or Error_Handler() (crash.h)
+    PowerBackup_t     power;          // PVD events and save times (power.h)
+    SettingsBackup_t  settings;
+    EvlogTail_t       evlog;          // Records not yet in flash (eventlog.h)
+} BackupSram_t;
+
+#define BACKUP_SRAM_BYTES  4096U
+#define BACKUP_SRAM        ((BackupSram_t *)BKPSRAM_BASE)
+
+_Static_assert(sizeof(BackupSram_t) <= BACKUP_SRAM_BYTES, "backup SRAM is 4 KB");
+
+void BACKUP_Init(void);
+
+// Clocks and write access only: safe with interrupts off
+void BACKUP_Access(void);
+
+#endif
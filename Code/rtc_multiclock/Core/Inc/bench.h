@@ -0,0 +1,38 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "app_config.h"
+#include <stdint.h>
+
+/**
+ * @file    bench.h
+ * @brief   On-target micro-benchmarks timed with the DWT cycle counter
+ *
+ * Built only with CONFIG_BENCHMARK=1. BENCH_Run() times each case
+ * and prints one machine-readable record per case on stdout (USART2
+ * on the board, see retarget.c; the terminal on the host build):
+ *
+ *   BENCH,<target>,<cpu_hz>,<name>,<iterations>,<min>,<mean>,<max>
+ *   BENCH_ROM,<target>,<table>,<bytes>
+ *   BENCH_DONE,<target>,<count>
+ *
+ * Cycle counts have the cost of the measurement itself removed.
+ * Tools/bench_compare.py diffs two such logs.
+ */
+
+// Name reported in every record; the host build overrides it
+#ifndef BENCH_TARGET
+#define BENCH_TARGET  "stm32f446"
+#endif
+
+// 1 where the cycle counter only counts simulated HAL time (delays and
+// busy-waits, the host sim): a case that took none prints n/a for
+// min, mean and max rather than a real-looking 0
+#ifndef BENCH_HAL_CYCLES_ONLY
+#define BENCH_HAL_CYCLES_ONLY  0
+#endif
+
+// Run every benchmark once and print the records
+void BENCH_Run(void);
+
+#endif
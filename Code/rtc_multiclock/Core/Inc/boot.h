@@ -0,0 +1,90 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include "app_config.h"
+#include "main.h"
+
+/**
+ * @file    boot.h
+ * @brief   Boot-time profile and the fast-boot decision
+ *
+ * SystemInit() starts the DWT cycle counter from zero, so CYCCNT
+ * counts from the reset vector. BOOT_Mark() converts the cycles since
+ * the previous mark with the clock that was running then (HSI 16 MHz
+ * until SystemClock_Config(), the PLL after it) and stores the time
+ * since reset at the end of each phase in 'bootProfile'. Phases a
+ * boot does not go through are left out of 'marked'.
+ *
+ * The profile can be read in three ways:
+ *  - RAM dump of 'bootProfile' (e.g. GDB: print bootProfile)
+ *  - BOOT_Dump() prints it as text on stdout (USART2):
+ *
+ *      BOOT,<fast>,<reset flags (RCC_CSR)>
+ *      B,<phase>,<us since reset>          (phases that have ended)
+ *      ...
+ *      BOOT_END
+ *
+ *  - the BOOTINFO view (CONFIG_MODE_BOOTINFO), and the host build
+ *    prints it after the run
+ *
+ * Fast boot: after a reset without power loss (NRST, watchdog,
+ * software reset) with the RTC already set and an LCD that was
+ * initialised since power-up, the splash and the LCD power-up
+ * sequence are skipped and the RTC keeps its time. The first clock
+ * frame then follows the reset by a few ms instead of seconds.
+ */
+
+// RTC backup register holding BOOT_RTC_MAGIC once the time has been set
+#define BOOT_RTC_BKP_REG   RTC_BKP_DR0
+#define BOOT_RTC_MAGIC     0x32F2U
+
+#define BOOT_LCD_MAGIC     0x1CD0BEEFU
+
+typedef enum {
+    BOOT_PHASE_PREMAIN = 0,   // Reset vector to main(): .data/.bss, constructors
+    BOOT_PHASE_STACK_PAINT,   // MEMSTAT_PaintStack()
+    BOOT_PHASE_HAL,           // HAL_Init()
+    BOOT_PHASE_CLOCK,         // SystemClock_Config(): oscillators, PLL lock
+    BOOT_PHASE_GPIO,          // MX_GPIO_Init()
+    BOOT_PHASE_LCD,           // INPUTLOG_Init(), LCD_Init() or LCD_Resume(), first splash frame
+    BOOT_PHASE_RTC,           // MX_RTC_Init()
+    BOOT_PHASE_MODES,         // BACKUP_Init() .. MODE_InitAll(), under the splash
+    BOOT_PHASE_SPLASH,        // Rest of the splash (until it ends or a press)
+    BOOT_PHASE_FIRST_FRAME,   // MODE_Start(), first frame drawn by a mode
+    BOOT_PHASE_COUNT
+} BootPhase_t;
+
+typedef struct {
+    uint32_t resetFlags;            // RCC_CSR reset flags of this boot
+    uint16_t marked;                // Bit per phase that has ended
+    uint8_t  fast;                  // 1 if the fast-boot path was taken
+    uint32_t us[BOOT_PHASE_COUNT];  // Time since reset at the end of each phase
+} BootProfile_t;
+
+extern BootProfile_t bootProfile;
+
+// BOOT_LCD_MAGIC once the LCD has been through its power-up init;
+// in .noinit, so it survives a reset but not a power cycle
+extern uint32_t bootLcdMagic;
+
+// Call first thing in main(): latches and clears the reset flags
+void BOOT_Start(void);
+
+// End of 'phase'; later calls for the same phase are ignored
+void BOOT_Mark(BootPhase_t phase);
+
+// Decide on the fast-boot path; call after INPUTLOG_Init()
+uint8_t BOOT_CanFastBoot(void);
+
+// Note that the LCD now holds a valid configuration
+void BOOT_LcdReady(void);
+
+// Duration of one phase in us (0 if it has not ended or was skipped)
+uint32_t BOOT_PhaseUs(BootPhase_t phase);
+
+const char *BOOT_PhaseName(BootPhase_t phase);
+
+// Print the profile as text records on stdout
+void BOOT_Dump(void);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef CALENDAR_H
+#define CALENDAR_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file    calendar.h
+ * @brief   Calendar lookups for the RTC's years 2000..2099
+ *
+ * C interface to the tables in calendar_tables.hpp, which the C++
+ * compiler generates and checks (static_assert) at build time. The
+ * tables are const data in flash: nothing is computed or copied to
+ * RAM at start-up.
+ *
+ * Years are RTC years 0..99 (2000 + year), months 1..12, days 1..31.
+ * Weekdays use the RTC numbering: RTC_WEEKDAY_MONDAY (1) to
+ * RTC_WEEKDAY_SUNDAY (7). Out-of-range arguments return 0.
+ */
+
+#define CAL_BCD_INVALID  0xFFU
+
+uint8_t  CAL_IsLeap(uint8_t year);
+uint8_t  CAL_DaysInMonth(uint8_t year, uint8_t month);
+
+// 1..366
+uint16_t CAL_DayOfYear(uint8_t year, uint8_t month, uint8_t day);
+
+// Days since 2000-01-01 (0..36524) and back; CAL_FromDays() clamps
+// to 2099-12-31
+uint16_t CAL_DaysSince2000(uint8_t year, uint8_t month, uint8_t day);
+void     CAL_FromDays(uint16_t days, uint8_t *year, uint8_t *month, uint8_t *day);
+
+// 1 = Monday .. 7 = Sunday
+uint8_t  CAL_DayOfWeek(uint8_t year, uint8_t month, uint8_t day);
+
+// 0..99 <-> packed BCD; CAL_BCD_INVALID for a nibble above 9
+uint8_t  CAL_ToBcd(uint8_t value);
+uint8_t  CAL_FromBcd(uint8_t bcd);
+
+// ms within the second from RTC_SSR ('subSeconds') and PREDIV_S
+// ('secondFraction'). A SUBFS shift adds to SSR without a borrow, so
+// for up to a second after it SSR is above PREDIV_S and TR / DR read
+// ahead (RM0390, RTC_SSR). The result is the ms within the true
+// second, and *aheadSeconds what to take off TR / DR.
+uint16_t CAL_SubSecondMs(uint32_t subSeconds, uint32_t secondFraction, uint32_t *aheadSeconds);
+
+// Flash taken by the lookup tables, for the benchmark report
+uint32_t CAL_TableBytes(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef CALENDAR_TABLES_HPP
+#define CALENDAR_TABLES_HPP
+
+/**
+ * @file    calendar_tables.hpp
+ * @brief   Compile-time calendar and BCD tables (C++14)
+ *
+ * Every table is built by a constexpr function and stored as a
+ * constexpr object, so it is constant-initialised into .rodata. The
+ * static_asserts at the end check the tables against an independent
+ * weekday formula for every day from 2000-01-01 to 2099-12-31. If a
+ * table is wrong, the build fails.
+ *
+ * Only calendar.cpp includes this file; C code uses calendar.h.
+ */
+
+#include <stdint.h>
+
+namespace cal {
+
+constexpr unsigned kFirstYear = 2000;
+constexpr unsigned kYears = 100;
+
+/* ================== GENERATORS ================== */
+
+// Full Gregorian rule, although 2000..2099 only needs year % 4
+constexpr bool isLeap(unsigned year) {
+    return (year % 4U == 0U && year % 100U != 0U) || year % 400U == 0U;
+}
+
+constexpr uint8_t daysInMonthOf(bool leap, unsigned month) {
+    return (month == 2U) ? (leap ? 29U : 28U)
+         : (month == 4U || month == 6U || month == 9U || month == 11U) ? 30U : 31U;
+}
+
+// Sakamoto's method, 1 = Monday .. 7 = Sunday. Used only to check the tables.
+constexpr unsigned referenceWeekday(unsigned year, unsigned month, unsigned day) {
+    constexpr uint8_t t[12] = { 0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4 };
+    unsigned y = year - (month < 3U ? 1U : 0U);
+    unsigned w = (y + y / 4U - y / 100U + y / 400U + t[month - 1U] + day) % 7U;   // 0 = Sunday
+    return (w == 0U) ? 7U : w;
+}
+
+// Per year: bit 7 = leap year, bits 0..2 = weekday of 1 January
+struct YearTable {
+    uint8_t info[kYears];
+};
+
+constexpr YearTable makeYearTable() {
+    YearTable t{};
+    unsigned weekday = 6;   // 2000-01-01 was a Saturday
+    for(unsigned i = 0; i < kYears; i++) {
+        bool leap = isLeap(kFirstYear + i);
+        t.info[i] = static_cast<uint8_t>((leap ? 0x80U : 0U) | weekday);
+        weekday = (weekday - 1U + (leap ? 366U : 365U)) % 7U + 1U;
+    }
+    return t;
+}
+
+struct MonthTable {
+    uint8_t  days[2][12];         // [leap][month - 1]
+    uint16_t before[2][13];       // Days in the year before the 1st of the month; [12] = year length
+    uint8_t  weekdayShift[2][12]; // before[][] % 7, so the weekday needs one small modulo
+};
+
+constexpr MonthTable makeMonthTable() {
+    MonthTable t{};
+    for(unsigned leap = 0; leap < 2U; leap++) {
+        unsigned sum = 0;
+        for(unsigned m = 0; m < 12U; m++) {
+            t.days[leap][m] = daysInMonthOf(leap != 0U, m + 1U);
+            t.before[leap][m] = static_cast<uint16_t>(sum);
+            t.weekdayShift[leap][m] = static_cast<uint8_t>(sum % 7U);
+            sum += t.days[leap][m];
+        }
+        t.before[leap][12] = static_cast<uint16_t>(sum);
+    }
+    return t;
+}
+
+struct BcdTable {
+    uint8_t toBcd[100];
+    uint8_t fromBcd[256];
+};
+
+constexpr BcdTable makeBcdTable() {
+    BcdTable t{};
+    for(unsigned v = 0; v < 100U; v++) {
+        t.toBcd[v] = static_cast<uint8_t>(((v / 10U) << 4) | (v % 10U));
+    }
+    for(unsigned b = 0; b < 256U; b++) {
+        bool valid = (b >> 4) <= 9U && (b & 0x0FU) <= 9U;
+        t.fromBcd[b] = valid ? static_cast<uint8_t>((b >> 4) * 10U + (b & 0x0FU)) : 0xFFU;
+    }
+    return t;
+}
+
+/* ================== TABLES ================== */
+
+constexpr YearTable  kYearTable  = makeYearTable();
+constexpr MonthTable kMonthTable = makeMonthTable();
+constexpr BcdTable   kBcdTable   = makeBcdTable();
+
+constexpr uint32_t kTableBytes = sizeof(kYearTable) + sizeof(kMonthTable) + sizeof(kBcdTable);
+
+/* ================== LOOKUPS ==================
+ * Shared by the C wrappers and the checks below, so the code that
+ * runs is the code that was verified. Arguments must be in range.
+ * ============================================= */
+
+constexpr unsigned leapIndex(unsigned year) {
+    return kYearTable.info[year] >> 7;
+}
+
+constexpr unsigned dayOfYear(unsigned year, unsigned month, unsigned day) {
+    return kMonthTable.before[leapIndex(year)][month - 1U] + day;
+}
+
+// 0 = 2000-01-01; every year before 'year' has a leap day if year % 4 == 0
+constexpr unsigned daysSince2000(unsigned year, unsigned month, unsigned day) {
+    return year * 365U + (year + 3U) / 4U + dayOfYear(year, month, day) - 1U;
+}
+
+constexpr unsigned dayOfWeek(unsigned year, unsigned month, unsigned day) {
+    unsigned jan1 = kYearTable.info[year] & 0x07U;
+    return (jan1 - 1U + kMonthTable.weekdayShift[leapIndex(year)][month - 1U] + day - 1U) % 7U + 1U;
+}
+
+/* ================== BUILD-TIME CHECKS ================== */
+
+constexpr bool everyDayMatchesReference() {
+    for(unsigned y = 0; y < kYears; y++) {
+        for(unsigned m = 1; m <= 12U; m++) {
+            unsigned days = kMonthTable.days[leapIndex(y)][m - 1U];
+            for(unsigned d = 1; d <= days; d++) {
+                if(dayOfWeek(y, m, d) != referenceWeekday(kFirstYear + y, m, d)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+constexpr bool bcdRoundTrips() {
+    unsigned invalid = 0;
+    for(unsigned v = 0; v < 100U; v++) {
+        if(kBcdTable.fromBcd[kBcdTable.toBcd[v]] != v) {
+            return false;
+        }
+    }
+    for(unsigned b = 0; b < 256U; b++) {
+        invalid += (kBcdTable.fromBcd[b] == 0xFFU) ? 1U : 0U;
+    }
+    return invalid == 256U - 100U;
+}
+
+static_assert(kMonthTable.before[0][12] == 365U && kMonthTable.before[1][12] == 366U,
+              "month lengths must add up to the year length");
+static_assert(leapIndex(0) == 1U && leapIndex(24) == 1U && leapIndex(99) == 0U,
+              "2000 and 2024 are leap years, 2099 is not");
+static_assert(dayOfWeek(0, 1, 1) == 6U, "2000-01-01 was a Saturday");
+static_assert(dayOfWeek(24, 2, 29) == 4U, "2024-02-29 was a Thursday");
+static_assert(dayOfWeek(99, 12, 31) == 4U, "2099-12-31 is a Thursday");
+static_assert(dayOfYear(24, 12, 31) == 366U && dayOfYear(23, 3, 1) == 60U, "day of year");
+static_assert(daysSince2000(0, 1, 1) == 0U && daysSince2000(1, 1, 1) == 366U &&
+              daysSince2000(99, 12, 31) == 36524U, "days since 2000");
+static_assert(everyDayMatchesReference(), "weekday tables disagree with Sakamoto's method");
+static_assert(bcdRoundTrips(), "BCD tables are not inverse");
+
+} // namespace cal
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include "app_config.h"
+#include "main.h"
+
+/**
+ * @file    console.h
+ * @brief   Command console on USART2 (ST-LINK virtual COM port)
+ *
+ * Both directions run on DMA, so the CPU never handles single bytes:
+ *  - RX: DMA1 stream 5 writes every received byte into a circular
+ *    ring. The idle-line interrupt (end of a burst) and the half /
+ *    full transfer interrupts (bursts longer than half the ring) only
+ *    note how far the DMA has got. CONSOLE_Poll() in the main loop
+ *    splits the new bytes into lines and runs the commands.
+ *  - TX: replies and stdout are queued in a ring. Stream 6 sends the
+ *    oldest contiguous chunk and its transfer-complete interrupt
+ *    starts the next. Replies never wait: what does not fit is
+ *    dropped and counted. A longer reply (log) goes out over several
+ *    polls, as the ring empties; lines received meanwhile wait.
+ *
+ * 115200 8N1 by default (CONFIG_CONSOLE_BAUD). A line ends with CR or
+ * LF; there is no echo. Each command answers with its lines, then
+ * "OK" or "ERR <reason>":
+ *
+ *   help                      list the commands
+ *   date                      DATE 2026-10-19 MON
+ *   date YYYY-MM-DD           set the date (the weekday follows)
+ *   time                      TIME 12:34:56.789
+ *   time hh:mm:ss[.mmm]       set the time, to the millisecond
+ *   sw                        SW RUNNING 00:01:02.345 LAPS 3
+ *   sw start|stop|reset|lap   same as the STOPWATCH buttons
+ *   laps                      LAP <n> <split> <lap time>, stored laps
+ *   kv                        KV <key> <hex> per setting, store state
+ *   kv <key> <hex>|-          store or delete a setting (kvstore.h)
+ *   log [from [to]]           EV <date> <time> <event> ... with from <=
+ *                             time < to (YYYY-MM-DD[Thh:mm[:ss]]), then
+ *                             LOG <n> EVENTS (eventlog.h)
+ *   input                     the input log, INPUTLOG,<length>,<dropped>
+ *                             to INPUTLOG_END (input_log.h); the capture
+ *                             replays with the host build's -r
+ *   crash                     the dump of the last fault, CRASH ... to
+ *                             CRASH_END, or CRASH NONE (crash.h)
+ *   crash clear|test          forget it / Error_Handler() now
+ *   clock                     CLOCK <profile> <MHz> MHZ, GOV AUTO|PINNED
+ *                             LOAD <%> % UP <n> DOWN <n> SWITCHING <us> US
+ *                             (governor.h), then per profile PROFILE
+ *                             <name> <MHz> MHZ <mA> MA SW <n> FAIL <n>
+ *                             LAST <us> MAX <us> US (sysclk.h), RESIDENCY
+ *                             <name> <ms> MS
+ *   clock low|nominal|over    switch the system clock profile and keep it
+ *   clock auto                let the governor choose again
+ *   hsi                       HSI <state> TRIM <n> FACTORY <n>, HSI <ppm>
+ *                             PPM CORRECTION <ppm> PPM, STOPWATCH BEFORE
+ *                             <ppm> AFTER <ppm> PPM, MEASURED <n>
+ *                             DISCARDED <n> (hsitrim.h)
+ *   stats                     uptime, boot, mode switches, console,
+ *                             supply failures and save cycles, STACK
+ *                             <peak>/<reserved> B FREE <bytes>, HEAP
+ *                             <peak>/<reserved> B FAIL <n> LAST <bytes>
+ *                             (memstat.h)
+ *
+ * Setting the date or time and the sw actions are recorded in the
+ * input log (input_log.h); while a log is replayed they, and changes
+ * to the settings, answer "ERR replay".
+ */
+
+#if CONFIG_CONSOLE
+
+// Longest wait of CONSOLE_PutChar() for the DMA to free a byte
+#define CONSOLE_PUTCHAR_TIMEOUT_MS  20U
+
+typedef struct {
+    uint32_t rxBytes;       // Bytes received
+    uint32_t rxOverruns;    // Times the DMA overwrote unread bytes
+    uint32_t txBytes;       // Bytes queued for sending
+    uint32_t txDropped;     // Bytes that did not fit in the TX ring
+    uint32_t commands;      // Lines executed
+} ConsoleStats_t;
+
+// Pins, USART2 and both DMA streams; starts receiving
+void CONSOLE_Init(void);
+
+// Run the commands that have arrived; 1 if one changed the time, the
+// stopwatch or a setting (redraw the display)
+uint8_t CONSOLE_Poll(void);
+
+// Queue bytes for sending without waiting; returns the bytes queued
+uint16_t CONSOLE_Write(const char *data, uint16_t length);
+
+// stdout (retarget.c): LF becomes CRLF, waits up to
+// CONSOLE_PUTCHAR_TIMEOUT_MS for room in the TX ring
+int CONSOLE_PutChar(int ch);
+
+const ConsoleStats_t *CONSOLE_GetStats(void);
+
+// Around a system clock switch (sysclk.h): hold the TX stream and let
+// the last character out / set the baud rate for the new PCLK1 and go on
+void CONSOLE_ClockChanging(void);
+void CONSOLE_ClockChanged(void);
+
+#endif /* CONFIG_CONSOLE */
+
+#endif
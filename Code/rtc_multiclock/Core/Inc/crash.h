@@ -0,0 +1,104 @@
+#ifndef CRASH_H
+#define CRASH_H
+
+#include "app_config.h"
+#include "main.h"
+#include "trace.h"
+#include <stddef.h>
+
+/**
+ * @file    crash.h
+ * @brief   Post-mortem dump of faults and Error_Handler() in backup SRAM
+ *
+ * HardFault, MemManage, BusFault and UsageFault enter crash.c (the
+ * .ioc no longer generates them in stm32f4xx_it.c), Error_Handler()
+ * calls CRASH_Error(). Both store a dump in the backup SRAM (backup.h)
+ * and reset the MCU (NVIC_SystemReset()):
+ *  - the exception frame the core stacked (R0-R3, R12, LR, PC, xPSR),
+ *    the SP before it and EXC_RETURN
+ *  - CFSR, HFSR, MMFAR and BFAR
+ *  - a backtrace: the first CRASH_BACKTRACE words on the stack that
+ *    point just behind a BL / BLX in the program (return addresses)
+ *  - the last CRASH_TRACE_RECORDS trace events (trace.h)
+ *  - the RTC time (TR / DR)
+ * then a CRC16. The dump is written in place with plain stores: no
+ * HAL call, no interrupt, no stack beyond one frame. A stack pointer
+ * outside RAM is not followed.
+ *
+ * CRASH_Init() at the next boot prints a dump it has not reported
+ * yet on stdout and notes it in the event log (EVLOG_CRASH). It stays
+ * until the next crash or CRASH_Clear(); the console shows it with
+ * 'crash'. Text form, one record per line:
+ *
+ *   CRASH,<cause>,<count>,<YYYY-MM-DD>T<hh:mm:ss>
+ *   CRASH_R,<r0>,<r1>,<r2>,<r3>,<r12>
+ *   CRASH_PC,<pc>,<lr>,<xpsr>,<sp>,<exc_return>
+ *   CRASH_FSR,<cfsr>,<hfsr>,<mmfar>,<bfar>
+ *   CRASH_BT,<return address>                 (innermost first)
+ *   TRACE,<cpu_hz>,<n>,<n>  T,<cycles>,<id>,<arg> ...  TRACE_END
+ *   CRASH_END
+ *
+ * Registers are hex; 'count' counts the dumps since the backup SRAM
+ * was last lost. Tools/crash_decode.py turns it into source lines
+ * with the ELF of the build that crashed.
+ */
+
+#define CRASH_BACKTRACE      8U
+#define CRASH_TRACE_RECORDS  16U
+#define CRASH_SCAN_WORDS     512U    // Stack words searched for return addresses
+
+// Longest line of the text form, with its NUL
+#define CRASH_LINE_MAX       64U
+
+typedef enum {
+    CRASH_NONE = 0,
+    CRASH_HARDFAULT,
+    CRASH_MEMMANAGE,
+    CRASH_BUSFAULT,
+    CRASH_USAGEFAULT,
+    CRASH_ERROR,              // Error_Handler()
+    CRASH_CAUSE_COUNT
+} CrashCause_t;
+
+typedef struct {
+    uint32_t magic;           // CRASH_MAGIC once a dump has been stored
+    uint16_t count;           // Dumps since the backup SRAM was lost
+    uint8_t  cause;           // CrashCause_t
+    uint8_t  reported;        // Printed at a boot since
+    uint32_t r0, r1, r2, r3, r12, lr, pc, xpsr;   // As stacked by the core
+    uint32_t sp;              // Before the exception
+    uint32_t excReturn;       // LR on entry; 0 for Error_Handler()
+    uint32_t cfsr, hfsr, mmfar, bfar;
+    uint32_t rtcTime, rtcDate;    // RTC TR / DR (BCD)
+    uint32_t cpuHz;               // Clock of the first trace record
+    uint32_t backtrace[CRASH_BACKTRACE];
+    TraceRecord_t trace[CRASH_TRACE_RECORDS];   // Oldest first
+    uint8_t  depth;           // Entries in backtrace
+    uint8_t  traceCount;      // Entries in trace
+    uint16_t crc;             // CRC16 of everything before
+} CrashDump_t;
+
+#define CRASH_MAGIC  0x48535243U   // "CRSH"
+
+// Catch MemManage, BusFault and UsageFault on their own vectors, and
+// report and log a dump left by the previous run. After BACKUP_Init().
+void CRASH_Init(void);
+
+// Store a dump for Error_Handler() called from 'caller', then reset
+void CRASH_Error(uint32_t caller) __attribute__((noreturn));
+
+// Fault vectors (crash.c): 'frame' is the stacked R0..xPSR
+void CRASH_Fault(const uint32_t *frame, uint32_t excReturn, CrashCause_t cause)
+    __attribute__((noreturn));
+
+// The stored dump, or NULL if there is none (or it is damaged)
+const CrashDump_t *CRASH_Get(void);
+
+void CRASH_Clear(void);
+
+const char *CRASH_CauseName(CrashCause_t cause);
+
+// Line 'index' of the text form (no line end); 0 past the last line
+uint8_t CRASH_Line(uint16_t index, char *out, size_t size);
+
+#endif
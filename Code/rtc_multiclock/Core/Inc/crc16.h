@@ -0,0 +1,21 @@
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stdint.h>
+
+/**
+ * @file    crc16.h
+ * @brief   CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF, no reflection)
+ *
+ * A nibble at a time from a 16-entry table: 32 bytes of flash and
+ * about 10 cycles per byte on the M4. Data can be fed in pieces by
+ * passing the previous result back in as 'crc'.
+ *
+ * Check value: CRC16_Update(CRC16_INIT, "123456789", 9) == 0x29B1
+ */
+
+#define CRC16_INIT  0xFFFFU
+
+uint16_t CRC16_Update(uint16_t crc, const void *data, uint32_t length);
+
+#endif
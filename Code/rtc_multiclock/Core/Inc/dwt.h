@@ -0,0 +1,27 @@
+#ifndef DWT_H
+#define DWT_H
+
+#include "main.h"
+
+/**
+ * @file    dwt.h
+ * @brief   Cortex-M4 DWT cycle counter helpers
+ *
+ * CYCCNT counts CPU clock cycles and wraps every
+ * 2^32 / SystemCoreClock seconds (~51 s at 84 MHz), so
+ * differences computed with unsigned subtraction are
+ * valid for anything shorter than that.
+ */
+
+// Enable the cycle counter (safe to call more than once)
+static inline void DWT_CycleCounterInit(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+// Current cycle count
+static inline uint32_t DWT_Cycles(void) {
+    return DWT->CYCCNT;
+}
+
+#endif
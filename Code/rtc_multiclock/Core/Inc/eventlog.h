@@ -0,0 +1,135 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include "app_config.h"
+#include "main.h"
+
+/**
+ * @file    eventlog.h
+ * @brief   Audit trail in flash: resets, time corrections, stopwatch
+ *          sessions and alarms, with a time index
+ *
+ * Flash sectors 6 and 7 (128 KB each, kept out of the program by the
+ * linker script) form a ring of EVLOG_BLOCKS blocks of EVLOG_BLOCK_BYTES.
+ * Block n of the log (n counts up from 0 for the life of the log) sits
+ * at n % EVLOG_BLOCKS. Records are appended to the newest block and
+ * never changed in place:
+ *
+ *   block    magic | n | start time | ~(n ^ start), then records
+ *   record   type:6 | words:2 | pending:1 | delta:23, then 0..3 data words
+ *
+ * Times are RTC seconds since 2000-01-01 00:00:00. The first record of
+ * a block is at the block's start time, each further one 'delta'
+ * seconds after the one before. A record that does not fit, or comes
+ * more than EVLOG_MAX_DELTA after the previous one, opens the next
+ * block. Entering a sector erases it, which drops the oldest half of
+ * the log (16 K records of one data word).
+ *
+ * Stamps never go backwards: after the clock is set back, events are
+ * stamped with the time of the correction until the RTC catches up.
+ * The correction itself (EVLOG_TIME_SET) is stamped with the old time
+ * and holds the new one, so an export shows the step.
+ *
+ * EVLOG_Init() reads the block headers once and keeps each block's
+ * start time in RAM (EVLOG_BLOCKS words). A query for a time range is
+ * a binary search over them and a scan of one block; after that the
+ * events come out in order, one record each.
+ *
+ * Power loss: a record is written with its pending bit set, which is
+ * cleared once its data is complete. EVLOG_Init() stops at a pending
+ * or damaged record and starts the next block, so nothing is ever
+ * appended after a torn write; a block whose header is torn is skipped.
+ *
+ * Supply failure (power.h): EVLOG_PowerFail() stages the record being
+ * written, if any, and a POWER_FAIL record in backup SRAM. EVLOG_Init()
+ * appends those of them that are not in flash yet and drops the stage.
+ *
+ * Writing stalls the CPU for about 16 us per word (a record takes 2 to
+ * 5 programming operations); erasing a sector takes about 1 s. Record
+ * events on their occasion, not periodically.
+ */
+
+#define EVLOG_BLOCK_BYTES  4096U
+#define EVLOG_BLOCKS       64U        // Two 128 KB sectors
+#define EVLOG_MAX_WORDS    3U
+#define EVLOG_MAX_DELTA    0x7FFFFFUL // Seconds (97 days)
+
+// Record types are tags in flash: append new ones, never renumber
+typedef enum {
+    EVLOG_RESET = 1,         // data: RCC_CSR reset flags (boot.h)
+    EVLOG_TIME_SET,          // data: new RTC time (seconds since 2000)
+    EVLOG_STOPWATCH_START,   // data: elapsed ms it resumes from
+    EVLOG_STOPWATCH_STOP,    // data: elapsed ms, laps
+    EVLOG_ALARM,             // data: alarm number
+    EVLOG_CRASH,             // data: CrashCause_t, PC, CFSR (crash.h)
+    EVLOG_POWER_FAIL,        // VDD fell below the PVD level (power.h)
+    EVLOG_TYPE_COUNT
+} EvlogType_t;
+
+typedef struct {
+    uint32_t    time;                   // Seconds since 2000-01-01
+    EvlogType_t type;
+    uint8_t     words;
+    uint32_t    data[EVLOG_MAX_WORDS];
+} EvlogEvent_t;
+
+// Records staged in backup SRAM by EVLOG_PowerFail()
+typedef struct {
+    uint32_t     magic;                 // EVLOG_TAIL_MAGIC while staged
+    uint32_t     count;
+    EvlogEvent_t event[2];
+    uint16_t     crc;                   // CRC16 from 'count' on
+} EvlogTail_t;
+
+// Position in the log for EVLOG_Next()
+typedef struct {
+    uint32_t block;      // Block number (not the slot)
+    uint32_t offset;     // Next record in that block
+    uint32_t time;       // Of the record before 'offset'
+    uint32_t from;       // Earlier events are skipped
+} EvlogCursor_t;
+
+typedef struct {
+    uint32_t oldest;     // Block numbers in the log
+    uint32_t newest;
+    uint32_t records;    // Appended since EVLOG_Init()
+    uint32_t last;       // Later events are stamped no earlier
+    uint16_t used;       // Bytes of the newest block in use
+    uint8_t  recovered;  // EVLOG_Init() found a write cut short by a reset
+} EvlogStats_t;
+
+#if CONFIG_EVENT_LOG
+
+// Index the log; creates it on first use
+void EVLOG_Init(void);
+
+// Append an event stamped with the current RTC time
+HAL_StatusTypeDef EVLOG_Record(EvlogType_t type, const uint32_t *data, uint8_t words);
+
+// Append an event stamped 'time' (clamped to the newest stamp)
+HAL_StatusTypeDef EVLOG_RecordAt(uint32_t time, EvlogType_t type,
+                                 const uint32_t *data, uint8_t words);
+
+// The RTC was set; 'before' is EVLOG_Now() from just before the write
+HAL_StatusTypeDef EVLOG_TimeChanged(uint32_t before);
+
+// Current RTC time in seconds since 2000-01-01
+uint32_t EVLOG_Now(void);
+
+// Start reading at the first event at or after 'from' (0: the oldest)
+void EVLOG_Seek(EvlogCursor_t *cursor, uint32_t from);
+
+// Next event in time order; 0 at the end of the log
+uint8_t EVLOG_Next(EvlogCursor_t *cursor, EvlogEvent_t *event);
+
+// Supply failing: stage the record in progress and POWER_FAIL in
+// backup SRAM. Interrupt context, no flash access
+void EVLOG_PowerFail(void);
+
+const char *EVLOG_TypeName(EvlogType_t type);
+
+void EVLOG_GetStats(EvlogStats_t *stats);
+
+#endif /* CONFIG_EVENT_LOG */
+
+#endif
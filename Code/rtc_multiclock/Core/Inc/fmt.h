@@ -0,0 +1,53 @@
+#ifndef FMT_H
+#define FMT_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file    fmt.h
+ * @brief   Fixed-width number formatting without newlib's printf
+ *
+ * The field writers store digits at 'out' and return the position
+ * after the last one; they do not add a terminating NUL. Two digits
+ * at a time come from the fmtDigits2 table, so there is one divide
+ * per pair of digits and none at all for BCD input.
+ *
+ * FMT_Format() understands the subset of printf used for the LCD:
+ *
+ *   %%  %c  %s  %[0][width][l]{d,u,x,X}
+ *
+ * Anything else is printed as '?'. Output is truncated to 'size'
+ * and NUL-terminated unless 'size' is 0.
+ */
+
+// "00" .. "99"
+extern const char fmtDigits2[100][2];
+
+// Zero-padded fields; larger values keep only the low digits
+char *FMT_Dec2(char *out, uint32_t value);
+char *FMT_Dec3(char *out, uint32_t value);
+char *FMT_Dec4(char *out, uint32_t value);
+
+// Packed BCD byte as read with RTC_FORMAT_BCD, e.g. 0x59 -> "59"
+char *FMT_Bcd2(char *out, uint8_t bcd);
+
+// "HH:MM:SS" (8 characters) from the RTC_TR layout 0x00HHMMSS, i.e.
+// (Hours << 16) | (Minutes << 8) | Seconds read with RTC_FORMAT_BCD.
+// All six digits are converted at once with the M4's SIMD instructions
+// where available. A nibble above 9 prints as '?'.
+char *FMT_BcdTime(char *out, uint32_t bcd);
+
+// At least 'width' characters, padded with 'pad'; never truncates
+char *FMT_Uint(char *out, uint32_t value, uint8_t width, char pad);
+
+// Copy a string without its NUL
+char *FMT_Str(char *out, const char *s);
+
+// Returns the length the whole output needs, without the NUL, like
+// snprintf: the output was truncated if that is 'size' or more
+int FMT_Format(char *out, size_t size, const char *format, ...);
+int FMT_VFormat(char *out, size_t size, const char *format, va_list args);
+
+#endif
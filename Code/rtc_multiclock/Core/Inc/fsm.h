@@ -0,0 +1,100 @@
+#ifndef FSM_H
+#define FSM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file    fsm.h
+ * @brief   Generic table-driven finite state machine engine
+ *
+ * A state machine is described entirely by constant data:
+ *  - One descriptor per state (enter / exit / render hooks)
+ *  - A dense [state][event] transition table
+ *
+ * Both tables are declared const so the linker places them in
+ * flash (.rodata). Dispatching an event is a single indexed
+ * lookup, independent of the number of states or events.
+ *
+ * The application tables for this project live in ui_fsm.h.
+ */
+
+/* ================== BASIC TYPES ================== */
+
+typedef uint8_t FsmState_t;
+typedef uint8_t FsmEvent_t;
+
+// Guard: return non-zero to allow the transition
+typedef uint8_t (*FsmGuard_t)(void);
+
+// Action / hook: side-effect executed by the engine
+typedef void (*FsmAction_t)(void);
+
+/**
+ * @brief One cell of the transition table
+ *
+ * Cells that are not listed in the table are zero-filled by the
+ * compiler; 'used' tells the engine to ignore them.
+ */
+typedef struct {
+    FsmGuard_t  guard;   // NULL = always allowed
+    FsmAction_t action;  // NULL = no side-effect
+    FsmState_t  next;    // Target state (may equal the current state)
+    uint8_t     used;    // 0 = event ignored in this state
+} FsmTransition_t;
+
+/**
+ * @brief Per-state hooks
+ *
+ * enter  : called once when the state becomes active
+ * exit   : called once when the state is left
+ * render : called by FSM_Render() to draw the state's view
+ */
+typedef struct {
+    const char *name;
+    FsmAction_t enter;
+    FsmAction_t exit;
+    FsmAction_t render;
+} FsmStateDesc_t;
+
+/**
+ * @brief Complete (flash-resident) description of a machine
+ */
+typedef struct {
+    const FsmStateDesc_t  *states;   // numStates entries
+    const FsmTransition_t *table;    // numStates * numEvents entries, row-major
+    uint8_t numStates;
+    uint8_t numEvents;
+} FsmDef_t;
+
+/**
+ * @brief Runtime instance (RAM): only the current state
+ */
+typedef struct {
+    const FsmDef_t *def;
+    FsmState_t state;
+} Fsm_t;
+
+/* ================== TABLE HELPERS ==================
+ * Used with the X-macro tables in ui_fsm.h to build the
+ * flash-resident arrays with designated initializers.
+ * =================================================== */
+
+#define FSM_STATE_DESC(id, enter, exit, render) \
+    [id] = { #id, enter, exit, render },
+
+#define FSM_CELL(numEvents, state, event, guard, action, next) \
+    [(state) * (numEvents) + (event)] = { guard, action, next, 1 },
+
+/* ================== PUBLIC API ================== */
+
+// Bind an instance to its table and enter the initial state
+void FSM_Init(Fsm_t *fsm, const FsmDef_t *def, FsmState_t initial);
+
+// Feed one event into the machine (O(1) table lookup)
+void FSM_Dispatch(Fsm_t *fsm, FsmEvent_t event);
+
+// Invoke the render hook of the current state
+void FSM_Render(const Fsm_t *fsm);
+
+#endif
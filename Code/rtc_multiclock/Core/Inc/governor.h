@@ -0,0 +1,65 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include "app_config.h"
+#include "sysclk.h"
+
+/**
+ * @file    governor.h
+ * @brief   Clock profile governor driven by the main loop's load
+ *
+ * The main loop does its work, then waits in HAL_Delay() until the
+ * next button sample. GOV_Poll(), called just before that wait, adds
+ * the pass's busy time (DWT, thread mode) to the current window of
+ * CONFIG_GOVERNOR_WINDOW_MS. The LCD driver's fixed delays
+ * (LCD_WaitedUs()) are taken out of it: they last as long at any
+ * clock. The rest is CPU time, and scaled by the ratio of the clocks
+ * it says what the pass would have taken at each other profile.
+ *
+ * The deadlines: the CPU part of a pass must stay within
+ * CONFIG_GOVERNOR_PASS_US, so the next button sample is on time, and
+ * the window's CPU time within CONFIG_GOVERNOR_UP_PCT of the time
+ * outside the LCD delays (the load). The governor picks the lowest
+ * profile that meets both:
+ *  - up at once: at the end of a window over the limits, or right
+ *    after a single pass over CONFIG_GOVERNOR_PASS_US
+ *  - down only after CONFIG_GOVERNOR_HOLD windows in a row in which a
+ *    lower profile would have stayed under CONFIG_GOVERNOR_DOWN_PCT
+ *    and half the pass limit
+ * The gap between the two thresholds keeps it from going back and
+ * forth. SYSCLK_Set() does the switch (sysclk.h) and re-derives what
+ * depends on the clock; its cost per profile is in SYSCLK_Stats().
+ *
+ * GOV_Pin() fixes a profile (console 'clock low|nominal|over') until
+ * GOV_Release() ('clock auto'). The time spent in each profile is
+ * counted either way.
+ */
+
+typedef struct {
+    uint32_t residencyMs[SYSCLK_PROFILE_COUNT];  // Time spent in each
+    uint32_t ups;             // Switches to a faster profile
+    uint32_t downs;
+    uint32_t switchUs;        // Time all switches took
+    uint32_t windows;         // Windows evaluated
+    uint8_t  loadPct;         // Load of the last window
+    uint8_t  pinned;          // GOV_Pin() in effect
+} GovStats_t;
+
+#if CONFIG_GOVERNOR
+
+// Once the main loop is about to start (the profile is SYSCLK_Get())
+void GOV_Init(void);
+
+// End of a main loop pass that began at 'startCycles' (DWT)
+void GOV_Poll(uint32_t startCycles);
+
+// Switch to 'profile' and keep it / let the governor choose again
+HAL_StatusTypeDef GOV_Pin(SysclkProfile_t profile);
+void GOV_Release(void);
+
+// Residency up to now, switches, last load
+const GovStats_t *GOV_GetStats(void);
+
+#endif /* CONFIG_GOVERNOR */
+
+#endif
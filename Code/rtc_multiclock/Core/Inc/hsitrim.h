@@ -0,0 +1,83 @@
+#ifndef HSITRIM_H
+#define HSITRIM_H
+
+#include "app_config.h"
+#include "main.h"
+
+/**
+ * @file    hsitrim.h
+ * @brief   HSI trimmed against the LSE crystal, for an accurate SysTick
+ *
+ * Every clock profile runs from the HSI (sysclk.h), and so does
+ * SysTick. The HSI is only good to about 1 % as it comes from the
+ * factory, so the stopwatch can be 36 s an hour off. The 32.768 kHz
+ * LSE crystal (X2 on the Nucleo) is good to some 20 ppm.
+ *
+ * Measurement: TIM5 runs free at the APB1 timer clock, and channel 4
+ * captures it on every 8th LSE edge (TIM5_OR remaps TI4 to the LSE).
+ * TIM5_IRQHandler() takes the first and the last capture of
+ * CONFIG_HSITRIM_PERIODS LSE periods. The counts between them, against
+ * what the nominal clock would give, are the HSI error in ppm. A
+ * measurement during which the clock profile changed, or a capture
+ * was missed, is thrown away.
+ *
+ * Closed loop: HSITRIM in RCC_CR moves the HSI by about 0.5 % a step.
+ * After each measurement the trim goes the number of steps the error
+ * calls for, and is measured again. It stops where a step would not
+ * help, or once the error changes sign; then the better of the last
+ * two is kept. The PLL follows the small step while it runs.
+ *
+ * Correction: what is left of the error (at most half a step) is taken
+ * out in software. HSITRIM_Ms() is HAL_GetTick() scaled by it, and the
+ * stopwatch counts in it. Once settled, the error is measured again at
+ * once, then every CONFIG_HSITRIM_INTERVAL_S, which follows temperature
+ * drift.
+ *
+ * Report (console 'hsi'): the stopwatch error before, that is the HSI
+ * at the factory trim, and after, that is the error of the corrected
+ * stopwatch over the last measurement.
+ *
+ * The LSE takes about 2 s to start; SystemClock_Config() asks for it
+ * but leaves RCC_OSCILLATORTYPE_LSE out, so HSITRIM_Init() turns it
+ * on. Without a crystal the trim stays as it is and HSITRIM_Ms() is
+ * HAL_GetTick().
+ */
+
+typedef enum {
+    HSITRIM_LSE_WAIT = 0,     // LSE starting
+    HSITRIM_NO_LSE,           // Not ready within CONFIG_HSITRIM_LSE_MS
+    HSITRIM_TRIMMING,
+    HSITRIM_SETTLED
+} HsitrimState_t;
+
+typedef struct {
+    uint8_t  state;           // HsitrimState_t
+    uint8_t  factoryTrim;     // HSITRIM at start-up
+    uint8_t  trim;            // HSITRIM now
+    int32_t  factoryPpm;      // HSI at factoryTrim: the stopwatch error before
+    int32_t  hsiPpm;          // HSI at trim, last measurement
+    int32_t  correctionPpm;   // Taken out by HSITRIM_Ms()
+    int32_t  residualPpm;     // Corrected stopwatch, last measurement: the error after
+    uint32_t measurements;
+    uint32_t discarded;       // Clock switch or missed capture
+} HsitrimStats_t;
+
+#if CONFIG_HSITRIM
+
+// After SYSCLK_Init(): start the LSE and TIM5
+void HSITRIM_Init(void);
+
+// From the main loop: starts and evaluates the measurements
+void HSITRIM_Poll(void);
+
+// Milliseconds since start-up, as HAL_GetTick() would count them with
+// the HSI at 16 MHz; continuous when the correction changes
+uint32_t HSITRIM_Ms(void);
+
+const HsitrimStats_t *HSITRIM_GetStats(void);
+
+const char *HSITRIM_StateName(HsitrimState_t state);
+
+#endif /* CONFIG_HSITRIM */
+
+#endif
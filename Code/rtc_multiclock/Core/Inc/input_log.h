@@ -0,0 +1,117 @@
+#ifndef INPUT_LOG_H
+#define INPUT_LOG_H
+
+#include "app_config.h"
+#include "main.h"
+#include "ui_fsm.h"
+
+/**
+ * @file    input_log.h
+ * @brief   Record and replay of debounced button events, console
+ *          stopwatch actions and RTC corrections
+ *
+ * Every event that handleButtons() dispatches, every stopwatch action
+ * and every date or time written to the RTC is appended to 'inputLog'
+ * with its HAL_GetTick() timestamp. Records are delta-encoded, so a
+ * press costs two bytes:
+ *
+ *   byte 0   kind:3 | more:1 | delta[3:0]
+ *   byte 1.. delta >> 4 as a little-endian base-128 varint (if 'more')
+ *   SW       one more byte: the UiEvent_t
+ *   DATE     three more bytes: year (from 2000), month, day
+ *   RTC      three more bytes: hours, minutes, seconds
+ *
+ * kind is the UiEvent_t of a button, INPUTLOG_KIND_SW for a stopwatch
+ * action from outside the mode (console.h) recorded as the event that
+ * does the same, INPUTLOG_KIND_DATE for a date set, INPUTLOG_KIND_RTC_UI
+ * for a time saved from the SETTINGS mode or INPUTLOG_KIND_RTC for any
+ * other correction. Timestamps are ms since reset; the first delta is
+ * from 0.
+ *
+ * Replay: an InputLog_t image placed in 'inputLogReplay' (.noinit,
+ * not cleared by the start-up code) before reset is picked up by
+ * INPUTLOG_Init(). handleButtons() then ignores the pins and
+ * dispatches the recorded events on the same ticks. Stopwatch
+ * actions, dates and INPUTLOG_KIND_RTC corrections are applied;
+ * INPUTLOG_KIND_RTC_UI ones are not, the replayed button events write
+ * them again. Nothing is recorded while replaying, and the console
+ * refuses the commands that would be (console.h).
+ * The image is consumed, so the following reset runs normally.
+ *
+ * Export: a RAM dump of 'inputLog', or the text of INPUTLOG_Dump()
+ * and of the console's input command:
+ *
+ *   INPUTLOG,<length>,<dropped>
+ *   I,<up to INPUTLOG_DUMP_ROW data bytes in hex>
+ *   ...
+ *   INPUTLOG_END
+ */
+
+#define INPUTLOG_MAGIC        0x474C4E49U   // "INLG"
+#define INPUTLOG_KIND_SW      3U
+#define INPUTLOG_KIND_DATE    4U
+#define INPUTLOG_KIND_RTC_UI  6U
+#define INPUTLOG_KIND_RTC     7U
+#define INPUTLOG_FNV_BASIS    0x811C9DC5U
+
+#define INPUTLOG_DUMP_ROW     32U
+// Longest line of the text form, with its NUL
+#define INPUTLOG_LINE_MAX     (2U + 2U * INPUTLOG_DUMP_ROW + 1U)
+
+typedef struct {
+    uint32_t magic;       // INPUTLOG_MAGIC when the image is valid
+    uint16_t length;      // Bytes used in data[]
+    uint16_t dropped;     // Records that did not fit (saturates)
+    uint32_t lastMs;      // Timestamp of the last record, the next delta base
+    uint32_t checksum;    // FNV-1a over data[0..length)
+    uint8_t  data[CONFIG_INPUT_LOG_BYTES];
+} InputLog_t;
+
+#if CONFIG_INPUT_LOG
+
+extern InputLog_t inputLog;
+extern InputLog_t inputLogReplay;
+
+// Start recording; replays 'inputLogReplay' first if it holds a valid image
+void INPUTLOG_Init(void);
+
+// Record a debounced button event (ignored while replaying)
+void INPUTLOG_RecordEvent(UiEvent_t event);
+
+// Record a stopwatch action taken outside the mode as the event that
+// does it in the current state: SELECT starts or stops, INC resets or
+// takes a lap (ignored while replaying)
+void INPUTLOG_RecordStopwatch(UiEvent_t event);
+
+// Record a date written to the RTC (ignored while replaying)
+void INPUTLOG_RecordDate(const RTC_DateTypeDef *date);
+
+// Record a time written to the RTC (ignored while replaying);
+// kind is INPUTLOG_KIND_RTC_UI or INPUTLOG_KIND_RTC
+void INPUTLOG_RecordRtc(const RTC_TimeTypeDef *time, uint8_t kind);
+
+// 1 until every record of the replay image has been played
+uint8_t INPUTLOG_Replaying(void);
+
+// Next recorded event due at HAL_GetTick(); stopwatch, date and RTC
+// records on the way are applied. Returns 0 when nothing is due.
+uint8_t INPUTLOG_NextReplayed(UiEvent_t *event);
+
+// 1 once after INPUTLOG_NextReplayed() applied a record itself, as the
+// console command did (redraw the display)
+uint8_t INPUTLOG_ReplayApplied(void);
+
+// Line 'index' of the text form above (no line end); 0 past the last
+// line. Line 0 fixes the length the others cover, so records added
+// while the lines are fetched one by one do not tear the dump.
+uint8_t INPUTLOG_Line(uint16_t index, char *out, size_t size);
+
+// Print 'inputLog' on stdout in the text format above
+void INPUTLOG_Dump(void);
+
+// FNV-1a, continued from 'hash' (start with INPUTLOG_FNV_BASIS)
+uint32_t INPUTLOG_Checksum(uint32_t hash, const uint8_t *data, uint32_t length);
+
+#endif /* CONFIG_INPUT_LOG */
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef KVSTORE_H
+#define KVSTORE_H
+
+#include "app_config.h"
+#include "main.h"
+
+/**
+ * @file    kvstore.h
+ * @brief   Settings that survive power loss: a log-structured store in flash
+ *
+ * Two 16 KB flash sectors (1 and 2, kept out of the program by the
+ * linker script) take turns. The active one holds a header and then
+ * records, appended one after the other and never changed in place:
+ *
+ *   header   magic | generation | ~generation | active (0 once complete)
+ *   record   key:8 | length:7 | pending:1 | CRC-16:16, then the value
+ *            padded to words
+ *
+ * A later record for the same key replaces the earlier one; length 0
+ * deletes the key. When the active sector is full, the latest value of
+ * every key is copied into the other sector (erased first), which gets
+ * the next generation and becomes active once the copy is complete.
+ * Every erase thus moves at least a sector's worth of writes forward,
+ * and both sectors wear at the same rate.
+ *
+ * KV_Init() reads the active sector once from start to end and keeps
+ * the offset of each key's latest record in RAM, so KV_Get() is a
+ * table lookup and a copy out of flash.
+ *
+ * Power loss at any point leaves either the old or the new value:
+ *  - a record is written with its pending bit set, which is cleared
+ *    (the header word programmed again) once the value is complete.
+ *    The scan stops at a pending or damaged record, or at programmed
+ *    bits after the last one, and the next write compacts into the
+ *    other sector instead of appending after them
+ *  - a half-copied sector has no active mark and is ignored; the
+ *    previous one is still intact because it is only erased when it
+ *    becomes the target of the next compaction
+ *  - the header is checked against its complement, so a sector whose
+ *    erase was cut short is not taken for a newer one
+ *
+ * Writing stalls the CPU: code runs from the same flash bank. A record
+ * takes about 16 us per word, a compaction also erases a sector, which
+ * takes 250 ms (typical). Write settings on a user action, not in
+ * a loop.
+ */
+
+#define KV_MAX_VALUE  32U     // At most 127 (7-bit length)
+
+// Keys are record tags in flash: append new ones, never renumber
+#define KV_KEYS(X)                                                        \
+    X(HOUR_FORMAT,     "hour_format")  /* 12 or 24, 1 byte (CLOCK) */     \
+    X(RTC_CALIBRATION, "rtc_calib")    /* Smooth calibration in ppm,  */  \
+                                       /* int16 LE, applied at boot   */
+
+#define KV_KEY_ENUM(name, text)  KV_KEY_##name,
+
+typedef enum {
+    KV_KEYS(KV_KEY_ENUM)
+    KV_KEY_COUNT
+} KvKey_t;
+
+typedef struct {
+    uint32_t generation;   // Compactions since the store was created + 1
+    uint16_t used;         // Bytes of the active sector in use
+    uint16_t size;         // Bytes of a sector
+    uint16_t records;      // Records in the active sector, superseded ones too
+    uint8_t  recovered;    // KV_Init() found a write cut short by a reset
+} KvStats_t;
+
+#if CONFIG_KV_STORE
+
+// Find the active sector and index it; creates the store on first use
+void KV_Init(void);
+
+// Copy a value to 'value' (up to 'size' bytes). Returns its length,
+// 0 if the key has no value.
+uint8_t KV_Get(KvKey_t key, void *value, uint8_t size);
+
+// Store a value (at most KV_MAX_VALUE bytes, 0 deletes the key).
+// Writing the value already stored costs nothing.
+HAL_StatusTypeDef KV_Set(KvKey_t key, const void *value, uint8_t length);
+
+// Key by name (KV_KEYS); KV_KEY_COUNT if unknown
+KvKey_t KV_Find(const char *name);
+const char *KV_Name(KvKey_t key);
+
+void KV_GetStats(KvStats_t *stats);
+
+#endif /* CONFIG_KV_STORE */
+
+#endif
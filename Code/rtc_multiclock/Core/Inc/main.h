@@ -53,8 +53,8 @@ extern "C" {
 /* USER CODE BEGIN ET */
 /*
  * Exported application-level types (if any) can be placed here.
- * Currently, mode/state enums are defined directly in main.c
- * for closer coupling with application logic.
+ * Mode/state enums are generated from the tables in ui_fsm.h,
+ * and each application mode registers itself through mode.h.
  */
 /* USER CODE END ET */
 
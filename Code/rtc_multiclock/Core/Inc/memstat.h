@@ -0,0 +1,49 @@
+#ifndef MEMSTAT_H
+#define MEMSTAT_H
+
+#include "app_config.h"
+#include <stdint.h>
+
+/**
+ * @file    memstat.h
+ * @brief   Stack and heap high-water marks
+ *
+ * At start-up all RAM between the heap start ('_end') and the
+ * current stack pointer is painted with MEMSTAT_PAINT. The stack
+ * high-water mark is found by scanning up from the heap break for
+ * the first word that was overwritten. _sbrk() in sysmem.c records
+ * the peak heap break and refused allocations.
+ *
+ * Reported through the MEMINFO view (CONFIG_MODE_MEMINFO), the
+ * console's stats command and MEMSTAT_Get() for other front ends.
+ */
+
+#define MEMSTAT_PAINT  0xC5C5C5C5U
+
+typedef struct {
+    uint32_t stackReserved;   // _Min_Stack_Size
+    uint32_t stackPeak;       // Deepest stack use seen, bytes below _estack
+    uint32_t heapReserved;    // _Min_Heap_Size
+    uint32_t heapPeak;        // Highest _sbrk break, bytes above _end
+    uint32_t heapFailures;    // _sbrk requests refused
+    uint32_t heapFailLast;    // Size of the last refused request
+    uint32_t freeGap;         // Never-touched RAM between heap and stack
+} MemStats_t;
+
+#if CONFIG_MEMSTAT
+
+// Paint the unused RAM; call first thing in main()
+void MEMSTAT_PaintStack(void);
+
+// Update the stack high-water mark (scans the painted area)
+void MEMSTAT_Scan(void);
+
+// Rate-limited MEMSTAT_Scan() for the main loop
+void MEMSTAT_Poll(void);
+
+// Latest figures (does not rescan)
+void MEMSTAT_Get(MemStats_t *stats);
+
+#endif /* CONFIG_MEMSTAT */
+
+#endif
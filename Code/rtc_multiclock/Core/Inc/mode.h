@@ -0,0 +1,100 @@
+#ifndef MODE_H
+#define MODE_H
+
+#include <stdint.h>
+#include "ui_fsm.h"
+
+/**
+ * @file    mode.h
+ * @brief   Pluggable application mode interface and link-time registry
+ *
+ * Each application (clock, stopwatch, settings, ...) lives in its
+ * own mode_*.c file and registers itself with MODE_REGISTER().
+ * The linker collects all registered descriptors into the
+ * 'mode_registry' section (see STM32F446RETX_FLASH.ld), so main.c
+ * never needs to know which modes exist.
+ *
+ * The MODE button cycles through the registered modes in ascending
+ * 'order'; modes with the same order follow their place in the
+ * registry (link order). All other UI events go to the active mode's
+ * on_event.
+ *
+ * save runs in the PVD interrupt (power.h) with interrupts off, active
+ * or not: plain stores to backup SRAM, no waiting. A mode that left
+ * something there can pick it up in init and claim the display at
+ * boot through resume.
+ */
+
+/* ================== MODE INTERFACE ================== */
+
+typedef struct {
+    const char *name;                    // Short name for debug / reports
+    void     (*init)(void);              // Once at boot (may be NULL)
+    void     (*enter)(void);             // Mode becomes active (may be NULL)
+    void     (*exit)(void);              // Mode is left (may be NULL)
+    void     (*on_event)(UiEvent_t ev);  // SELECT / INC button events (may be NULL)
+    void     (*render)(void);            // Draw the mode's view
+    void     (*tick)(void);              // Every main loop pass while active (may be NULL)
+    uint32_t (*deadline)(void);          // ms until next redraw is due (NULL = 1000)
+    void     (*save)(void);              // Supply failing: state to backup SRAM (may be NULL)
+    uint8_t  (*resume)(void);            // After init: nonzero to start in this mode (may be NULL)
+    uint8_t  order;                      // Position in the MODE button cycle
+} Mode_t;
+
+/**
+ * @brief Place a const Mode_t into the registry section
+ *
+ * Usage:  MODE_REGISTER(modeClock) = { .name = "CLOCK", ... };
+ *
+ * 'used' keeps the otherwise unreferenced object alive, and the
+ * explicit alignment keeps descriptors packed back-to-back so the
+ * section can be walked as an array.
+ */
+#define MODE_REGISTER(sym) \
+    __attribute__((used, section("mode_registry"), aligned(sizeof(void *)))) \
+    const Mode_t sym
+
+/**
+ * @brief Mode switch timing, in CPU cycles (exit + enter hooks)
+ */
+typedef struct {
+    uint32_t last;
+    uint32_t max;
+    uint32_t count;
+} ModeSwitchStats_t;
+
+/* ================== PUBLIC API ================== */
+
+// Call init() of every registered mode; nothing is drawn yet
+void MODE_InitAll(void);
+
+// After MODE_InitAll(): enter the first mode (or the first whose
+// resume() asks for it)
+void MODE_Start(void);
+
+// Call save() of every registered mode (supply failure)
+void MODE_SaveAll(void);
+
+// Route a UI event: MODE switches mode, the rest goes to the active mode
+void MODE_Dispatch(UiEvent_t event);
+
+// Return to the first mode in the cycle (e.g. after saving settings)
+void MODE_Home(void);
+
+// Periodic work and drawing for the active mode
+void MODE_Tick(void);
+void MODE_Render(void);
+
+// Milliseconds until the active mode needs to be redrawn
+uint32_t MODE_NextDeadline(void);
+
+// Active mode descriptor (NULL if no mode is compiled in)
+const Mode_t *MODE_Active(void);
+
+// Number of registered modes
+uint8_t MODE_Count(void);
+
+// Timing of the most recent and slowest mode switch
+const ModeSwitchStats_t *MODE_GetSwitchStats(void);
+
+#endif
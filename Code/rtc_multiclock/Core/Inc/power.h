@@ -0,0 +1,70 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include "app_config.h"
+#include "main.h"
+
+/**
+ * @file    power.h
+ * @brief   Supply failure warning: the PVD saves the state to backup SRAM
+ *
+ * The programmable voltage detector compares VDD with the level of
+ * CONFIG_PVD_LEVEL (2.9 V by default) and raises PVD_IRQn (EXTI line
+ * 16) when VDD falls below it. From there the bulk capacitance has to
+ * carry the MCU to the power-down reset (about 1.7 V). On this board
+ * (100 uF, about 30 mA) that is some 4 ms; the save path is meant to
+ * take a small, fixed part of it, POWER_SAVE_BUDGET_US.
+ *
+ * PVD_IRQHandler() (priority 0, as SysTick) runs POWER_Save():
+ *  - the RTC leaves init mode if the interrupt cut a calendar write
+ *    short, so it keeps counting on VBAT (TR / DR hold the old or the
+ *    new value: each is written in one access)
+ *  - each mode's save hook (mode.h): the stopwatch writes a backup
+ *    copy, SETTINGS the time being edited
+ *  - the event log tail: the record being written, if any, and a
+ *    POWER_FAIL record, both replayed by EVLOG_Init() at the next boot
+ *  - LCD_SafeState(): EN, RS and D4-D7 low, so nothing is latched while
+ *    the levels sag
+ * All of it is plain stores and register accesses: no loop depends on
+ * the state, no HAL call waits. The cycles it took (DWT) are kept in
+ * backup SRAM with the largest so far; the console's 'stats' shows
+ * them, and the power_save benchmark times the worst case.
+ *
+ * The handler then waits with interrupts off and never returns to the
+ * code it interrupted, so no flash operation starts below the level
+ * at which flash may be programmed. Either the supply fails and the
+ * next power-up restores the state, or VDD rises above the level again
+ * and the MCU resets (NVIC_SystemReset()) to restore it at once.
+ *
+ * A PVD during a flash erase (about 1 s) is taken when the erase is
+ * over: every fetch from flash stalls until then.
+ */
+
+// Hold-up time left for POWER_Save() on this board
+#define POWER_SAVE_BUDGET_US  100U
+
+typedef struct {
+    uint32_t magic;           // POWER_MAGIC, else the counters start over
+    uint32_t saves;           // PVD events since the backup SRAM was lost
+    uint32_t lastCycles;      // POWER_Save() of the last one
+    uint32_t maxCycles;
+} PowerBackup_t;
+
+#define POWER_MAGIC  0x52574F50U   // "POWR"
+
+#if CONFIG_POWER_FAIL
+
+// PVD at CONFIG_PVD_LEVEL and its interrupt; after MODE_InitAll(),
+// since the save path calls the modes' save hooks
+void POWER_Init(void);
+
+// The save path of the PVD interrupt (without the wait and the reset),
+// for the benchmark; changes the backup SRAM
+void POWER_Save(void);
+
+// PVD events and save cycles (survive resets)
+const PowerBackup_t *POWER_GetStats(void);
+
+#endif /* CONFIG_POWER_FAIL */
+
+#endif
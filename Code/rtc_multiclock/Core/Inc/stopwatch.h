@@ -0,0 +1,73 @@
+#ifndef STOPWATCH_H
+#define STOPWATCH_H
+
+#include "app_config.h"
+#include "main.h"
+
+/**
+ * @file    stopwatch.h
+ * @brief   Stopwatch control from outside the STOPWATCH mode
+ *
+ * The calls feed the same STOPPED <-> RUNNING machine as the buttons
+ * (ui_fsm.h), so the console and the buttons can be mixed freely.
+ * The stopwatch keeps running while another mode is shown.
+ *
+ * Laps: INC while running (or STOPWATCH_Lap()) stores the elapsed
+ * time in a ring of CONFIG_STOPWATCH_LAPS entries; RESET clears it.
+ * Lap numbers count from 1 since the last reset; only the most recent
+ * CONFIG_STOPWATCH_LAPS stay readable.
+ *
+ * Backup (CONFIG_STOPWATCH_BACKUP): every start, stop, reset and lap
+ * mirrors the state into the backup SRAM (backup.h), alternating
+ * between two copies so that a reset during the write leaves the
+ * previous one intact. A running session is anchored to the RTC: the
+ * elapsed time at the last start, lap or clock change, and the RTC
+ * time (ms) it was taken at. After a reset the newest copy whose
+ * CRC16 checks out is restored; if it was running, the RTC time since
+ * the anchor is added and the stopwatch runs on. The outage is thus
+ * counted by the RTC (LSI), the rest by SysTick, corrected for the
+ * HSI error where CONFIG_HSITRIM measures it.
+ */
+
+typedef struct {
+    uint32_t sequence;       // The higher of the two copies is newer
+    uint32_t anchorSeconds;  // RTC seconds since 2000-01-01 at the anchor
+    uint32_t anchorElapsed;  // Elapsed ms at the anchor (the total if stopped)
+    uint16_t anchorMs;       // ms within the RTC second at the anchor
+    uint16_t lapCount;
+    uint8_t  running;
+    uint8_t  reserved;
+    uint16_t crc;            // CRC16 of the rest of the copy
+    uint32_t lapMs[CONFIG_STOPWATCH_LAPS];
+} StopwatchBackup_t;
+
+#if CONFIG_MODE_STOPWATCH
+
+// SELECT while stopped / running; 0 if it already was in that state
+uint8_t STOPWATCH_Start(void);
+uint8_t STOPWATCH_Stop(void);
+
+// INC while stopped; 0 while running
+uint8_t STOPWATCH_Reset(void);
+
+// INC while running; 0 while stopped
+uint8_t STOPWATCH_Lap(void);
+
+uint8_t  STOPWATCH_Running(void);
+uint32_t STOPWATCH_ElapsedMs(void);
+
+// Laps taken since the last reset (may exceed the ring)
+uint16_t STOPWATCH_LapCount(void);
+
+// Elapsed time at lap 'number' (1-based); 0 if it is no longer stored
+uint32_t STOPWATCH_LapMs(uint16_t number);
+
+// Mirror the state into the backup SRAM (the actions do this already)
+void STOPWATCH_Backup(void);
+
+// The RTC was set: re-anchor a running session to the new time
+void STOPWATCH_ClockChanged(void);
+
+#endif
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef SYSCLK_H
+#define SYSCLK_H
+
+#include "app_config.h"
+#include "main.h"
+
+/**
+ * @file    sysclk.h
+ * @brief   System clock profiles, switched at run time
+ *
+ *   profile    SYSCLK             regulator        flash  APB1  APB2
+ *   LOW        HSI      16 MHz    scale 3          0 WS   16    16
+ *   NOMINAL    PLL      84 MHz    scale 3          2 WS   42    84
+ *   OVERDRIVE  PLL     180 MHz    scale 1 + OD     5 WS   45    90
+ *
+ * NOMINAL is what SystemClock_Config() sets up at boot. LOW is enough
+ * for the clock display, which spends nearly all its time in
+ * HAL_Delay(); OVERDRIVE is the highest the F446 runs at.
+ *
+ * SYSCLK_Set() goes through HSI each time, as the PLL and the
+ * regulator may only change while nothing runs from them:
+ *  1. the UARTs stop taking bytes from their DMA streams (DMAT off)
+ *     and finish the character on the wire
+ *  2. SYSCLK to HSI, over-drive off, PLL off
+ *  3. regulator scale, PLL on with the new factors and locked,
+ *     over-drive on, SYSCLK to the PLL with the new wait states
+ *  4. each UART's baud rate from its new APB clock, DMAT back on
+ * HAL_RCC_ClockConfig() re-arms SysTick for 1 ms at the new HCLK;
+ * LCD_DelayUs() reads SystemCoreClock on each call. The RTC runs from
+ * LSE / LSI and is not affected, nor is anything timed by it (the
+ * stopwatch). DWT counts change pace: a trace gets a TRACE_CLOCK
+ * record with the new MHz.
+ *
+ * The time a switch took (DWT, each part at the clock it ran at) is
+ * kept per target profile; the console's 'clock' command shows it
+ * with the typical run current of each profile.
+ */
+
+typedef enum {
+    SYSCLK_LOW = 0,
+    SYSCLK_NOMINAL,
+    SYSCLK_OVERDRIVE,
+    SYSCLK_PROFILE_COUNT
+} SysclkProfile_t;
+
+typedef struct {
+    const char *name;
+    uint32_t    hz;           // HCLK
+    uint16_t    runMa10;      // Typical run current, 0.1 mA
+} SysclkInfo_t;
+
+typedef struct {
+    uint32_t switches;        // Completed switches to this profile
+    uint32_t failures;        // Switches to it that returned HAL_ERROR
+    uint32_t lastUs;          // Duration of the last completed one
+    uint32_t maxUs;
+} SysclkStats_t;
+
+// After SystemClock_Config(): the boot profile is NOMINAL
+void SYSCLK_Init(void);
+
+// Switch to 'profile'. On HAL_ERROR the MCU stays where the switch
+// stopped: on LOW past step 2, else on the old profile (SYSCLK_Get())
+HAL_StatusTypeDef SYSCLK_Set(SysclkProfile_t profile);
+
+SysclkProfile_t SYSCLK_Get(void);
+
+const SysclkInfo_t *SYSCLK_Info(SysclkProfile_t profile);
+const SysclkStats_t *SYSCLK_Stats(SysclkProfile_t profile);
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "app_config.h"
+#include "main.h"
+
+/**
+ * @file    telemetry.h
+ * @brief   Binary telemetry stream on USART1 TX (PA9), sent by DMA
+ *
+ * Every record is one frame on the wire:
+ *
+ *   COBS( type | seq | tick (4) | payload | CRC-16 (2) ) 0x00
+ *
+ * Multi-byte fields are little-endian. seq counts every frame that
+ * was built, so a gap in seq on the host is a dropped frame. The CRC
+ * is CRC-16/CCITT-FALSE over type .. payload. COBS removes every zero
+ * byte from the frame, so 0x00 only ever ends a frame and the host can
+ * resynchronise at the next one after line noise.
+ *
+ * Zero copy: producers call TELEM_Reserve(), write the payload straight
+ * into the buffer the DMA will send, and TELEM_Commit() adds the CRC and
+ * encodes the frame in place. There are two buffers: the DMA sends one
+ * while records are added to the other, and the transfer-complete
+ * interrupt hands over the next one at once, so a steady stream keeps
+ * the line busy. When both are full a reservation fails: the record is
+ * dropped and counted, the UI never waits for the line.
+ *
+ * Records (Tools/telem_decode.py turns them into CSV or Parquet):
+ *   TIME   once a second: RTC time and sub-seconds against the tick (drift)
+ *   LOOP   every main loop pass: busy and period cycles
+ *   INPUT  every input event: cycles from the button sample to the redrawn frame
+ *   STATS  once a second: frames, bytes, drops and cycles spent on telemetry
+ *
+ * Producers run in thread mode (the main loop), not in interrupts.
+ */
+
+#define TELEM_HEADER_BYTES   6U     // type, seq, tick
+#define TELEM_CRC_BYTES      2U
+#define TELEM_MAX_PAYLOAD    32U    // COBS needs no extra code byte below 254
+
+typedef enum {
+    TELEM_REC_TIME  = 1,
+    TELEM_REC_LOOP  = 2,
+    TELEM_REC_INPUT = 3,
+    TELEM_REC_STATS = 4,
+} TelemRecord_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  hours;
+    uint8_t  minutes;
+    uint8_t  seconds;
+    uint16_t subSeconds;      // RTC_SSR, counts down from secondFraction
+    uint16_t secondFraction;  // PREDIV_S
+} TelemTime_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t busyCycles;      // Loop start to the poll delay
+    uint32_t periodCycles;    // Loop start to loop start
+} TelemLoop_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t latencyCycles;   // Button sample to frame written to the LCD
+} TelemInput_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t frames;          // Frames committed
+    uint32_t bytes;           // Encoded bytes handed to the DMA
+    uint32_t dropped;         // Frames refused for lack of buffer space
+    uint32_t cycles;          // CPU cycles spent in this module
+} TelemStats_t;
+
+#if CONFIG_TELEMETRY
+
+// USART1 at CONFIG_TELEMETRY_BAUD and DMA2 stream 7
+void TELEM_Init(void);
+
+// Payload area of a new frame, or NULL (dropped) if there is no room.
+// Only one frame can be open at a time.
+void *TELEM_Reserve(TelemRecord_t type, uint8_t length);
+
+// Seal the reserved frame and queue it for sending
+void TELEM_Commit(void);
+
+// Producers used by the main loop
+void TELEM_Loop(uint32_t startCycles);
+void TELEM_Input(uint32_t startCycles);
+
+// Once-a-second TIME and STATS records; call every main loop pass
+void TELEM_Poll(void);
+
+// Running totals (the STATS record carries the same figures)
+const TelemStats_t *TELEM_GetStats(void);
+
+// Around a system clock switch (sysclk.h), as the console's: hold the
+// DMA stream / set the baud rate for the new PCLK2 and go on. At 16 MHz
+// 921600 baud comes out 2.1 % fast, within what a receiver takes.
+void TELEM_ClockChanging(void);
+void TELEM_ClockChanged(void);
+
+#endif /* CONFIG_TELEMETRY */
+
+#endif
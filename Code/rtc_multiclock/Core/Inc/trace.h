@@ -0,0 +1,71 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "app_config.h"
+#include "trace_events.h"
+#include "dwt.h"
+
+/**
+ * @file    trace.h
+ * @brief   Binary event trace: 8-byte records in a RAM ring
+ *
+ * TRACE(id, arg) stores { CYCCNT, id, arg } in the next slot of
+ * traceBuffer. Interrupts are masked only for the slot store, so
+ * thread code and ISRs may both trace. The cost is about 15 cycles
+ * in an optimised build; with CONFIG_TRACE=0 the macro is empty.
+ *
+ * The ring can be read in three ways:
+ *  - RAM dump of 'traceBuffer' (e.g. GDB: dump binary value trace.bin traceBuffer)
+ *  - TRACE_Dump() prints it as text on stdout (USART2)
+ *  - the host build writes it with 'rtc_multiclock_host -T trace.bin'
+ * Tools/trace_decode.c turns any of them into a Chrome / Perfetto
+ * JSON timeline.
+ */
+
+typedef struct {
+    uint32_t cycles;    // DWT->CYCCNT when the event happened
+    uint16_t id;        // TraceEventId_t
+    uint16_t arg;       // Event specific
+} TraceRecord_t;
+
+typedef struct {
+    uint32_t magic;     // TRACE_MAGIC once TRACE_Init() has run
+    uint32_t head;      // Records written so far (next slot = head % size)
+    uint32_t size;      // Records in the ring
+    uint32_t cpuHz;     // SystemCoreClock when tracing started
+    TraceRecord_t ring[CONFIG_TRACE_RECORDS];
+} TraceBuffer_t;
+
+#if CONFIG_TRACE
+
+#if (CONFIG_TRACE_RECORDS & (CONFIG_TRACE_RECORDS - 1)) != 0
+#error "CONFIG_TRACE_RECORDS must be a power of two"
+#endif
+
+extern TraceBuffer_t traceBuffer;
+
+// Start (or restart) tracing; call after the clock is configured
+void TRACE_Init(void);
+
+// Print the ring oldest-first as text records on stdout
+void TRACE_Dump(void);
+
+static inline void TRACE_Event(uint16_t id, uint16_t arg) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    TraceRecord_t *r = &traceBuffer.ring[traceBuffer.head++ & (CONFIG_TRACE_RECORDS - 1U)];
+    r->cycles = DWT->CYCCNT;
+    r->id = id;
+    r->arg = arg;
+    __set_PRIMASK(primask);
+}
+
+#define TRACE(id, arg)  TRACE_Event((uint16_t)(id), (uint16_t)(arg))
+
+#else
+
+#define TRACE(id, arg)  ((void)0)
+
+#endif /* CONFIG_TRACE */
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef TRACE_EVENTS_H
+#define TRACE_EVENTS_H
+
+/**
+ * @file    trace_events.h
+ * @brief   Event IDs of the trace ring (see trace.h)
+ *
+ * Kept free of any HAL include so that the host decoder
+ * (Tools/trace_decode.c) expands the same list.
+ *
+ * E(id, name, phase, track)
+ *   phase : 'B' begin / 'E' end of a duration, 'i' instant
+ *   track : 0 = thread mode, 1 = interrupts
+ */
+
+#define TRACE_EVENTS(E) \
+    E(TRACE_LCD_CMD_BEGIN,   "lcd_cmd",     'B', 0) /* arg: command byte     */ \
+    E(TRACE_LCD_CMD_END,     "lcd_cmd",     'E', 0)                             \
+    E(TRACE_LCD_DATA_BEGIN,  "lcd_data",    'B', 0) /* arg: character        */ \
+    E(TRACE_LCD_DATA_END,    "lcd_data",    'E', 0)                             \
+    E(TRACE_RTC_READ_BEGIN,  "rtc_read",    'B', 0)                             \
+    E(TRACE_RTC_READ_END,    "rtc_read",    'E', 0)                             \
+    E(TRACE_UI_EVENT,        "ui_event",    'i', 0) /* arg: UiEvent_t        */ \
+    E(TRACE_FSM_TRANSITION,  "fsm",         'i', 0) /* arg: from << 8 | to   */ \
+    E(TRACE_MODE_SWITCH,     "mode_switch", 'i', 0) /* arg: order of new mode */ \
+    E(TRACE_ISR_ENTER,       "isr",         'B', 1) /* arg: IRQ number       */ \
+    E(TRACE_ISR_EXIT,        "isr",         'E', 1)                             \
+    E(TRACE_MARK,            "mark",        'i', 0) /* free for debugging    */ \
+    E(TRACE_CLOCK,           "clock",       'i', 0) /* arg: new HCLK in MHz  */
+
+#define TRACE_AS_ENUM(id, name, phase, track)  id,
+
+typedef enum {
+    TRACE_EVENTS(TRACE_AS_ENUM)
+    TRACE_EVENT_COUNT
+} TraceEventId_t;
+
+// Image header magic: "TRC1" in little-endian memory order
+#define TRACE_MAGIC  0x31435254U
+
+#endif
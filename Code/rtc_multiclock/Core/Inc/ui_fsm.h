@@ -0,0 +1,102 @@
+#ifndef UI_FSM_H
+#define UI_FSM_H
+
+#include "fsm.h"
+
+/**
+ * @file    ui_fsm.h
+ * @brief   Declarative state tables for the clock user interface
+ *
+ * Switching between applications is handled by the mode registry
+ * (mode.h). Inside a mode, button handling is table-driven:
+ *  - Stopwatch machine : STOPPED <-> RUNNING
+ *  - Setting machine   : HOURS -> MINUTES -> SAVE
+ *
+ * Each machine is written as X-macro lists so that the very same
+ * rows generate the enums, the flash tables in the mode_*.c files
+ * and the graph exported by Tools/fsm_graph.c.
+ *
+ * To add a mode, create a mode_*.c file that registers itself with
+ * MODE_REGISTER() and, if it has sub-states, add its rows here.
+ *
+ * Row formats:
+ *  X(state, enter, exit, render)
+ *  T(state, event, guard, action, next)
+ * NULL may be used for any hook, guard or action.
+ */
+
+/* ================== EVENTS ==================
+ * Debounced button presses produced by
+ * handleButtons() in main.c.
+ * ============================================ */
+
+#define UI_EVENTS(E)      \
+    E(UI_EV_MODE)         /* MODE button (PB9)            */ \
+    E(UI_EV_SELECT)       /* START/STOP / select (PB8)    */ \
+    E(UI_EV_INC)          /* RESET / increment (PC0)      */
+
+/* ================== STOPWATCH MACHINE ================== */
+
+#define UI_STOPWATCH_STATES(X) \
+    X(SW_STOPPED, NULL, NULL, displayStopwatch) \
+    X(SW_RUNNING, NULL, NULL, displayStopwatch)
+
+#define UI_STOPWATCH_TRANSITIONS(T) \
+    T(SW_STOPPED, UI_EV_SELECT, NULL, stopwatchStart, SW_RUNNING) \
+    T(SW_RUNNING, UI_EV_SELECT, NULL, stopwatchStop,  SW_STOPPED) \
+    T(SW_STOPPED, UI_EV_INC,    NULL, stopwatchReset, SW_STOPPED) \
+    T(SW_RUNNING, UI_EV_INC,    NULL, stopwatchLap,   SW_RUNNING)
+
+#define UI_STOPWATCH_INITIAL  SW_STOPPED
+
+/* ================== SETTING MACHINE ================== */
+
+#define UI_SETTING_STATES(X) \
+    X(SET_HOURS,   NULL, NULL, displaySetHours)   \
+    X(SET_MINUTES, NULL, NULL, displaySetMinutes) \
+    X(SET_SAVE,    NULL, NULL, displaySetSave)
+
+#define UI_SETTING_TRANSITIONS(T) \
+    T(SET_HOURS,   UI_EV_SELECT, NULL, NULL,             SET_MINUTES) \
+    T(SET_MINUTES, UI_EV_SELECT, NULL, NULL,             SET_SAVE)    \
+    T(SET_SAVE,    UI_EV_SELECT, NULL, NULL,             SET_HOURS)   \
+    T(SET_HOURS,   UI_EV_INC,    NULL, incrementHours,   SET_HOURS)   \
+    T(SET_MINUTES, UI_EV_INC,    NULL, incrementMinutes, SET_MINUTES) \
+    T(SET_SAVE,    UI_EV_INC,    NULL, saveTime,         SET_SAVE)
+
+#define UI_SETTING_INITIAL  SET_HOURS
+
+/* ================== GENERATED ENUMS ================== */
+
+#define UI_AS_ENUM(id, ...)  id,
+#define UI_EVENT_ENUM(id)    id,
+
+typedef enum {
+    UI_EVENTS(UI_EVENT_ENUM)
+    UI_EV_COUNT
+} UiEvent_t;
+
+/**
+ * @brief Stopwatch states
+ *
+ * SW_STOPPED : Elapsed time frozen, RESET clears it
+ * SW_RUNNING : Elapsed time follows HAL_GetTick(), LAP stores it
+ */
+typedef enum {
+    UI_STOPWATCH_STATES(UI_AS_ENUM)
+    SW_COUNT
+} StopwatchState_t;
+
+/**
+ * @brief Time setting sub-modes
+ *
+ * SET_HOURS   : Adjust hours field
+ * SET_MINUTES : Adjust minutes field
+ * SET_SAVE    : Commit time to RTC and exit settings
+ */
+typedef enum {
+    UI_SETTING_STATES(UI_AS_ENUM)
+    SET_COUNT
+} SettingMode_t;
+
+#endif
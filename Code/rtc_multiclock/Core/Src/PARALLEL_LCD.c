@@ -14,17 +14,27 @@
  */
 
 #include "parallel_lcd.h"
+#include "trace.h"
+#include "fmt.h"
 #include <stdarg.h>
-#include <stdio.h>
 #include <string.h>
 
+// Shadow of CGRAM so that LCD_LoadGlyph() uploads each bitmap once
+static uint8_t lcdCgram[LCD_CGRAM_SLOTS][8];
+static uint8_t lcdCgramUsed;    // Bit per slot
+static uint8_t lcdCgramNext;    // Next slot to replace when all are used
+
 /* ================== LOCAL DELAY HELPERS ==================
  * These wrappers abstract delays so that the LCD timing
  * matches the original 8051-based implementation.
  * ========================================================= */
 
+// Sum of the delays below, for the clock governor
+static uint32_t lcdWaitedUs;
+
 // Millisecond delay using HAL (blocking delay)
 static void LCD_DelayMs(uint32_t ms) {
+    lcdWaitedUs += ms * 1000U;
     HAL_Delay(ms);
 }
 
@@ -32,6 +42,8 @@ static void LCD_DelayMs(uint32_t ms) {
 static void LCD_DelayUs(uint32_t us) {
     // Convert microseconds to loop iterations based on system clock
     uint32_t cycles = us * (SystemCoreClock / 1000000) / 10;
+
+    lcdWaitedUs += us;
     while(cycles--) {
         __NOP();
     }
@@ -65,6 +77,7 @@ static void LCD_PulseEnable(void) {
 
 // Send command to LCD (RS = 0)
 void LCD_Command(uint8_t cmd) {
+    TRACE(TRACE_LCD_CMD_BEGIN, cmd);
     HAL_GPIO_WritePin(LCD_RS_PORT, LCD_RS_PIN, GPIO_PIN_RESET); // Command mode (RS = 0)
 
     // Send high nibble
@@ -81,10 +94,12 @@ void LCD_Command(uint8_t cmd) {
     } else {
         LCD_DelayUs(100);  // Normal command delay
     }
+    TRACE(TRACE_LCD_CMD_END, cmd);
 }
 
 // Send a single character (data) to LCD (RS = 1)
 void LCD_WriteChar(char ch) {
+    TRACE(TRACE_LCD_DATA_BEGIN, (uint8_t)ch);
     HAL_GPIO_WritePin(LCD_RS_PORT, LCD_RS_PIN, GPIO_PIN_SET); // Data mode (RS = 1)
 
     // Send high nibble
@@ -96,6 +111,7 @@ void LCD_WriteChar(char ch) {
     LCD_PulseEnable();
 
     LCD_DelayUs(100); // Small delay after data write
+    TRACE(TRACE_LCD_DATA_END, (uint8_t)ch);
 }
 
 /* ================== LCD INITIALIZATION ==================
@@ -141,6 +157,10 @@ void LCD_Init(void) {
     LCD_Command(0x06);
     HAL_Delay(5);
 
+    // CGRAM content is undefined after power-up
+    lcdCgramUsed = 0;
+    lcdCgramNext = 0;
+
     // Clear display and go home
     LCD_Command(0x01);
     HAL_Delay(10);
@@ -149,8 +169,57 @@ void LCD_Init(void) {
     HAL_Delay(10);
 }
 
+/* ================== WARM RESTART ==================
+ * After an MCU reset the LCD is still powered and configured,
+ * but it may be halfway through a byte in 4-bit mode. Three
+ * 0x3 nibbles bring it back to 8-bit mode from any state,
+ * then the usual mode set-up follows without the power-up
+ * waits of LCD_Init().
+ * ================================================== */
+
+void LCD_Resume(void) {
+    HAL_GPIO_WritePin(LCD_RS_PORT, LCD_RS_PIN, GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(LCD_EN_PORT, LCD_EN_PIN, GPIO_PIN_RESET);
+
+    // The first nibble may complete a clear or home command (1.52 ms)
+    LCD_Write4Bits(0x03);
+    LCD_PulseEnable();
+    LCD_DelayUs(2000);
+
+    LCD_Write4Bits(0x03);
+    LCD_PulseEnable();
+
+    LCD_Write4Bits(0x03);
+    LCD_PulseEnable();
+
+    LCD_Write4Bits(0x02);
+    LCD_PulseEnable();
+
+    LCD_Command(0x28);  // 4-bit, 2 lines, 5x8 font
+    LCD_Command(0x0C);  // Display ON, cursor OFF, blink OFF
+    LCD_Command(0x06);  // Increment, no display shift
+
+    // CGRAM kept its glyphs, but the shadow of them is gone
+    lcdCgramUsed = 0;
+    lcdCgramNext = 0;
+}
+
+// EN first: with EN low, nothing on RS or the data lines is latched
+void LCD_SafeState(void) {
+    HAL_GPIO_WritePin(LCD_EN_PORT, LCD_EN_PIN, GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(LCD_RS_PORT, LCD_RS_PIN, GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(LCD_D4_PORT, LCD_D4_PIN, GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(LCD_D5_PORT, LCD_D5_PIN, GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(LCD_D6_PORT, LCD_D6_PIN, GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(LCD_D7_PORT, LCD_D7_PIN, GPIO_PIN_RESET);
+}
+
 /* ================== HIGH-LEVEL HELPERS ================== */
 
+uint32_t LCD_WaitedUs(void) {
+    return lcdWaitedUs;
+}
+
 // Clear LCD and wait for completion
 void LCD_Clear(void) {
     LCD_Command(0x01); // Clear command
@@ -189,13 +258,13 @@ void LCD_WriteStringXY(uint8_t row, uint8_t col, char *str) {
     LCD_WriteString(str);
 }
 
-// Print formatted text (like printf for LCD)
+// Print formatted text (printf subset, see fmt.h)
 void LCD_Print(char *format, ...) {
     char buffer[32];
     va_list args;
 
     va_start(args, format);
-    vsnprintf(buffer, sizeof(buffer), format, args);
+    FMT_VFormat(buffer, sizeof(buffer), format, args);
     va_end(args);
 
     LCD_WriteString(buffer);
@@ -206,11 +275,37 @@ void LCD_Print(char *format, ...) {
  * Used in this project for rocket and flame animation.
  * ============================================================= */
 
-void LCD_CreateChar(uint8_t location, uint8_t charmap[]) {
+void LCD_CreateChar(uint8_t location, const uint8_t charmap[]) {
     location &= 0x07; // Only locations 0–7 are valid
     LCD_Command(0x40 | (location << 3)); // Set CGRAM address
 
     for (int i = 0; i < 8; i++) {
         LCD_WriteChar(charmap[i]); // Write 8-byte pattern
     }
+
+    memcpy(lcdCgram[location], charmap, 8);
+    lcdCgramUsed |= (uint8_t)(1U << location);
+}
+
+uint8_t LCD_LoadGlyph(const uint8_t glyph[8]) {
+    uint8_t slot;
+
+    for(slot = 0; slot < LCD_CGRAM_SLOTS; slot++) {
+        if((lcdCgramUsed & (1U << slot)) && memcmp(lcdCgram[slot], glyph, 8) == 0) {
+            return slot;
+        }
+    }
+
+    for(slot = 0; slot < LCD_CGRAM_SLOTS; slot++) {
+        if(!(lcdCgramUsed & (1U << slot))) {
+            break;
+        }
+    }
+    if(slot == LCD_CGRAM_SLOTS) {
+        slot = lcdCgramNext;
+        lcdCgramNext = (uint8_t)((lcdCgramNext + 1U) % LCD_CGRAM_SLOTS);
+    }
+
+    LCD_CreateChar(slot, glyph);
+    return slot;
 }
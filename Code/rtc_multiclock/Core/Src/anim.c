@@ -0,0 +1,152 @@
+/**
+ * @file    anim.c
+ * @brief   Streams RLE animations from flash to the LCD
+ */
+
+#include "anim.h"
+#include "parallel_lcd.h"
+#include <string.h>
+
+// Cell values below this are glyph indices, the rest are characters
+#define ANIM_GLYPH_LIMIT  LCD_CGRAM_SLOTS
+
+// Run header bit: the next n bytes are cells, otherwise one byte n times
+#define ANIM_RUN_LITERAL  0x80U
+
+/* ================== DECODING ================== */
+
+// Upload the animation's glyphs and note the character code of each
+static void animLoadGlyphs(const Anim_t *anim, uint8_t codes[LCD_CGRAM_SLOTS]) {
+    const uint8_t *p = anim->glyphs;
+    uint8_t glyph[8];
+    uint8_t row = 0;
+    uint8_t run = 0;
+    uint8_t value = 0;
+
+    for(uint8_t g = 0; g < anim->glyphCount && g < LCD_CGRAM_SLOTS; g++) {
+        for(row = 0; row < 8; row++) {
+            if(run == 0) {
+                run = (uint8_t)((*p >> 5) + 1U);
+                value = *p++ & 0x1FU;
+            }
+            glyph[row] = value;
+            run--;
+        }
+        codes[g] = LCD_LoadGlyph(glyph);
+    }
+}
+
+// Draw one frame's cells, writing only those that changed
+static const uint8_t *animDrawFrame(const uint8_t *p, const uint8_t codes[LCD_CGRAM_SLOTS],
+                                    char screen[LCD_ROWS * LCD_COLS]) {
+    uint8_t cell = 0;
+    int16_t cursor = -1;    // Cell the LCD will write next, -1 = unknown
+
+    while(cell < LCD_ROWS * LCD_COLS) {
+        uint8_t count = *p++;
+        uint8_t literal = count & ANIM_RUN_LITERAL;
+
+        count &= (uint8_t)~ANIM_RUN_LITERAL;
+        for(; count > 0 && cell < LCD_ROWS * LCD_COLS; count--, cell++) {
+            // A repeat run reads the same value again, a literal run the next one
+            uint8_t value = literal ? *p++ : *p;
+            char ch = (char)((value < ANIM_GLYPH_LIMIT) ? codes[value] : value);
+
+            if(screen[cell] == ch) {
+                continue;
+            }
+            if(cursor != cell) {
+                LCD_SetCursor(cell / LCD_COLS, cell % LCD_COLS);
+            }
+            LCD_WriteChar(ch);
+            screen[cell] = ch;
+            // The address does not wrap from the end of line 1 to line 2
+            cursor = ((cell + 1) % LCD_COLS) ? (int16_t)(cell + 1) : -1;
+        }
+        if(!literal) {
+            p++;
+        }
+    }
+    return p;
+}
+
+// Step over one frame's cells without drawing them
+static const uint8_t *animSkipFrame(const uint8_t *p) {
+    uint8_t cell = 0;
+
+    while(cell < LCD_ROWS * LCD_COLS) {
+        uint8_t count = *p++;
+
+        if(count & ANIM_RUN_LITERAL) {
+            count &= (uint8_t)~ANIM_RUN_LITERAL;
+            p += count;
+        } else {
+            p++;
+        }
+        cell = (uint8_t)(cell + count);
+    }
+    return p;
+}
+
+/* ================== PLAYER ================== */
+
+typedef struct {
+    const Anim_t *anim;             // NULL when idle
+    const uint8_t *next;            // Next frame in the timeline
+    uint16_t framesLeft;
+    uint32_t dueMs;                 // Tick at which the next frame (or the end) is due
+    uint8_t codes[LCD_CGRAM_SLOTS]; // Character code of each glyph
+    char screen[LCD_ROWS * LCD_COLS];
+} AnimPlayer_t;
+
+static AnimPlayer_t player;
+
+void ANIM_Start(const Anim_t *anim) {
+    player.anim = anim;
+    player.next = anim->timeline;
+    player.framesLeft = anim->frameCount;
+    player.dueMs = HAL_GetTick();
+
+    animLoadGlyphs(anim, player.codes);
+    LCD_Clear();
+    memset(player.screen, ' ', sizeof(player.screen));
+
+    ANIM_Poll();
+}
+
+uint8_t ANIM_Poll(void) {
+    uint32_t now = HAL_GetTick();
+
+    if(player.anim == NULL) {
+        return 0;
+    }
+
+    while(player.framesLeft > 0U && (int32_t)(now - player.dueMs) >= 0) {
+        uint16_t ms = (uint16_t)(player.next[0] | (player.next[1] << 8));
+
+        player.next += 2;
+        player.framesLeft--;
+        player.dueMs += ms;
+
+        // Late (e.g. behind a long init step): only draw the frame that is current
+        if(player.framesLeft > 0U && (int32_t)(now - player.dueMs) >= 0) {
+            player.next = animSkipFrame(player.next);
+        } else {
+            player.next = animDrawFrame(player.next, player.codes, player.screen);
+        }
+    }
+
+    // The last frame stays up for its duration
+    if(player.framesLeft == 0U && (int32_t)(now - player.dueMs) >= 0) {
+        player.anim = NULL;
+    }
+    return ANIM_Running();
+}
+
+uint8_t ANIM_Running(void) {
+    return player.anim != NULL;
+}
+
+void ANIM_Stop(void) {
+    player.anim = NULL;
+}
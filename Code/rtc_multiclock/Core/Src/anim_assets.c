@@ -0,0 +1,40 @@
+/* Generated by Tools/anim_pack.py from rocket.anim; do not edit. */
+
+#include "anim_assets.h"
+
+/* ================== ROCKET ==================
+ * 4 glyphs (rocket_top, rocket_bottom, flame_1, flame_2): 32 -> 23 bytes
+ * 17 frames: 578 -> 182 bytes
+ * ========================================= */
+
+static const uint8_t animRocketGlyphs[] = {
+    0x04, 0xAE, 0x00, 0x2E, 0x5F, 0x35, 0x00, 0x04, 0x0E, 0x15, 0x0E, 0x1F,
+    0x0A, 0x15, 0x04, 0x0E, 0x1F, 0x0E, 0x1F, 0x15, 0x1F, 0x0E, 0x04,
+};
+
+static const uint8_t animRocketTimeline[] = {
+    0x50, 0x00, 0x17, 0x20, 0x81, 0x02, 0x08, 0x20, 0x50, 0x00, 0x17, 0x20,
+    0x81, 0x03, 0x08, 0x20, 0x50, 0x00, 0x17, 0x20, 0x81, 0x02, 0x08, 0x20,
+    0x50, 0x00, 0x17, 0x20, 0x81, 0x03, 0x08, 0x20, 0x50, 0x00, 0x17, 0x20,
+    0x81, 0x02, 0x08, 0x20, 0x50, 0x00, 0x17, 0x20, 0x81, 0x03, 0x08, 0x20,
+    0x50, 0x00, 0x17, 0x20, 0x81, 0x02, 0x08, 0x20, 0x50, 0x00, 0x17, 0x20,
+    0x81, 0x03, 0x08, 0x20, 0x50, 0x00, 0x17, 0x20, 0x81, 0x02, 0x08, 0x20,
+    0x50, 0x00, 0x17, 0x20, 0x81, 0x03, 0x08, 0x20, 0x50, 0x00, 0x17, 0x20,
+    0x81, 0x02, 0x08, 0x20, 0x50, 0x00, 0x17, 0x20, 0x81, 0x03, 0x08, 0x20,
+    0x96, 0x00, 0x07, 0x20, 0x81, 0x00, 0x0F, 0x20, 0x81, 0x01, 0x08, 0x20,
+    0x96, 0x00, 0x07, 0x20, 0x81, 0x00, 0x0F, 0x20, 0x81, 0x02, 0x08, 0x20,
+    0x96, 0x00, 0x07, 0x20, 0x81, 0x03, 0x18, 0x20, 0xD0, 0x07, 0x02, 0x20,
+    0x8E, 0x53, 0x59, 0x53, 0x54, 0x45, 0x4D, 0x20, 0x4F, 0x4E, 0x4C, 0x49,
+    0x4E, 0x45, 0x20, 0x10, 0x2D, 0xD0, 0x07, 0x8D, 0x4D, 0x75, 0x6C, 0x74,
+    0x69, 0x2D, 0x50, 0x75, 0x72, 0x70, 0x6F, 0x73, 0x65, 0x03, 0x20, 0x8C,
+    0x43, 0x6C, 0x6F, 0x63, 0x6B, 0x20, 0x52, 0x65, 0x61, 0x64, 0x79, 0x21,
+    0x04, 0x20,
+};
+
+const Anim_t animRocket = {
+    .name = "rocket",
+    .glyphs = animRocketGlyphs,
+    .timeline = animRocketTimeline,
+    .glyphCount = 4,
+    .frameCount = 17,
+};
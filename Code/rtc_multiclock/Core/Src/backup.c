@@ -0,0 +1,19 @@
+/**
+ * @file    backup.c
+ * @brief   Backup SRAM access (backup.h)
+ */
+
+#include "backup.h"
+
+void BACKUP_Access(void) {
+    __HAL_RCC_PWR_CLK_ENABLE();
+    HAL_PWR_EnableBkUpAccess();
+    __HAL_RCC_BKPSRAM_CLK_ENABLE();
+}
+
+void BACKUP_Init(void) {
+    BACKUP_Access();
+
+    // Keeps the SRAM on VBAT; waits for the regulator (a few us)
+    HAL_PWREx_EnableBkUpReg();
+}
@@ -0,0 +1,332 @@
+/**
+ * @file    bench.c
+ * @brief   DWT micro-benchmarks of the LCD driver, RTC, formatting and modes
+ *
+ * Each case may have a setup (run once, untimed), the timed body and
+ * an untimed 'after' step run after every iteration. SysTick keeps
+ * running, so 'min' is the number to compare across builds; 'max'
+ * shows interrupt and HAL_Delay jitter.
+ */
+
+#include "bench.h"
+
+#if CONFIG_BENCHMARK
+
+#include "mode.h"
+#include "dwt.h"
+#include "parallel_lcd.h"
+#include "trace.h"
+#include "fmt.h"
+#include "calendar.h"
+#include "telemetry.h"
+#include "stopwatch.h"
+#include "power.h"
+#include "backup.h"
+#include <stdio.h>
+#include <string.h>
+
+extern RTC_HandleTypeDef hrtc;
+
+typedef struct {
+    const char *name;
+    void (*setup)(void);   // Once before the first iteration (optional)
+    void (*body)(void);    // Timed
+    void (*after)(void);   // After every iteration, untimed (optional)
+    uint16_t iterations;
+} BenchCase_t;
+
+// Keeps results observable so the compiler cannot drop the work
+static volatile uint32_t benchSink;
+static char benchBuffer[17];
+static RTC_TimeTypeDef benchTime;
+static RTC_DateTypeDef benchDate;
+static uint8_t benchDay;
+
+/* ================== CASES ================== */
+
+static void benchEmpty(void) {
+}
+
+static void benchLcdHome(void) {
+    LCD_SetCursor(0, 0);
+}
+
+static void benchLcdWriteChar(void) {
+    LCD_WriteChar('8');
+}
+
+static void benchLcdSetCursor(void) {
+    LCD_SetCursor(1, 5);
+}
+
+static void benchLcdClear(void) {
+    LCD_Clear();
+}
+
+// Same call as displayClock() in mode_clock.c
+static void benchSnprintfClock(void) {
+    benchSink += (uint32_t)snprintf(benchBuffer, sizeof(benchBuffer), "T:%02d:%02d:%02d ",
+                                    benchTime.Hours, benchTime.Minutes, benchTime.Seconds);
+}
+
+// One BCD field at a time: BCD registers, no division
+static void benchFmtClock(void) {
+    char *p = FMT_Str(benchBuffer, "T:");
+
+    p = FMT_Bcd2(p, benchTime.Hours);
+    *p++ = ':';
+    p = FMT_Bcd2(p, benchTime.Minutes);
+    *p++ = ':';
+    p = FMT_Bcd2(p, benchTime.Seconds);
+    *p++ = ' ';
+    *p = '\0';
+    benchSink += (uint32_t)(p - benchBuffer);
+}
+
+// All six digits at once (SIMD kernel on the M4)
+static void benchFmtTimeSimd(void) {
+    char *p = FMT_Str(benchBuffer, "T:");
+
+    p = FMT_BcdTime(p, ((uint32_t)benchTime.Hours << 16) |
+                       ((uint32_t)benchTime.Minutes << 8) | benchTime.Seconds);
+    *p++ = ' ';
+    *p = '\0';
+    benchSink += (uint32_t)(p - benchBuffer);
+}
+
+// Same format as snprintf_clock through the LCD_Print parser
+static void benchFmtFormatClock(void) {
+    benchSink += (uint32_t)FMT_Format(benchBuffer, sizeof(benchBuffer), "T:%02d:%02d:%02d ",
+                                      benchTime.Hours, benchTime.Minutes, benchTime.Seconds);
+}
+
+// A different date on every call so nothing can be hoisted out
+static void benchNextDate(void) {
+    benchDay = (uint8_t)(benchDay % 28U + 1U);
+    benchDate.Date = benchDay;
+    benchDate.Month = (uint8_t)(benchDay % 12U + 1U);
+    benchDate.Year = (uint8_t)(benchDay * 3U);
+}
+
+static void benchCalDayOfWeek(void) {
+    benchSink += CAL_DayOfWeek(benchDate.Year, benchDate.Month, benchDate.Date);
+}
+
+// Sakamoto's method: what the table lookup replaces
+static void benchCalDayOfWeekFormula(void) {
+    static const uint8_t t[12] = { 0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4 };
+    uint32_t y = 2000U + benchDate.Year - (benchDate.Month < 3U ? 1U : 0U);
+    uint32_t w = (y + y / 4U - y / 100U + y / 400U + t[benchDate.Month - 1U] + benchDate.Date) % 7U;
+
+    benchSink += (w == 0U) ? 7U : w;
+}
+
+static void benchCalDaysInMonth(void) {
+    benchSink += CAL_DaysInMonth(benchDate.Year, benchDate.Month);
+}
+
+static void benchCalDayOfYear(void) {
+    benchSink += CAL_DayOfYear(benchDate.Year, benchDate.Month, benchDate.Date);
+}
+
+static void benchRtcGetTimeBcd(void) {
+    HAL_RTC_GetTime(&hrtc, &benchTime, RTC_FORMAT_BCD);
+    HAL_RTC_GetDate(&hrtc, &benchDate, RTC_FORMAT_BCD);
+}
+
+static void benchRtcGetTime(void) {
+    HAL_RTC_GetTime(&hrtc, &benchTime, RTC_FORMAT_BIN);
+}
+
+static void benchRtcGetDate(void) {
+    HAL_RTC_GetDate(&hrtc, &benchDate, RTC_FORMAT_BIN);
+}
+
+#if CONFIG_TRACE
+static void benchTraceEvent(void) {
+    TRACE(TRACE_MARK, 0);
+}
+#endif
+
+static void benchModeRender(void) {
+    MODE_Render();
+}
+
+static void benchModeEvent(void) {
+    MODE_Dispatch(UI_EV_MODE);
+}
+
+static void benchSelectEvent(void) {
+    MODE_Dispatch(UI_EV_SELECT);
+}
+
+// Step through the mode cycle until 'name' is active
+static void benchEnterMode(const char *name) {
+    MODE_Home();
+    for(uint8_t i = 0; i < MODE_Count(); i++) {
+        if(strcmp(MODE_Active()->name, name) == 0) {
+            return;
+        }
+        MODE_Dispatch(UI_EV_MODE);
+    }
+}
+
+static void benchEnterClock(void) {
+    benchEnterMode("CLOCK");
+}
+
+#if CONFIG_MODE_STOPWATCH
+static void benchEnterStopwatch(void) {
+    benchEnterMode("STOPWATCH");
+}
+#endif
+
+#if CONFIG_MODE_STOPWATCH && CONFIG_STOPWATCH_BACKUP
+// One mirror of the stopwatch into the backup SRAM, as after every
+// start, stop, reset and lap: about 90 bytes of stores and their CRC16
+static void benchStopwatchBackup(void) {
+    STOPWATCH_Backup();
+}
+#endif
+
+#if CONFIG_POWER_FAIL
+// The save path of the PVD interrupt with SETTINGS active, so every
+// save hook stores; a running stopwatch adds its re-anchor (an RTC
+// read and a backup, see stopwatch_backup). The backup SRAM is put
+// back after each run, so the next boot finds nothing staged.
+static BackupSram_t benchBackup;
+
+static void benchPowerSetup(void) {
+    memcpy(&benchBackup, BACKUP_SRAM, sizeof(benchBackup));
+    benchEnterMode("SETTINGS");
+}
+
+static void benchPowerSave(void) {
+    POWER_Save();
+}
+
+static void benchPowerRestore(void) {
+    memcpy(BACKUP_SRAM, &benchBackup, sizeof(benchBackup));
+}
+#endif
+
+#if CONFIG_TELEMETRY
+// One LOOP record: reserve, CRC, COBS and queue. The 24 frames fit in
+// the buffers, so none is dropped. At line rate (5120 such frames per
+// second at 921600 baud) the CPU share is min * 5120 / SystemCoreClock.
+static void benchTelemLoop(void) {
+    TELEM_Loop(DWT_Cycles());
+}
+#endif
+
+static const BenchCase_t benchCases[] = {
+    { "lcd_write_char",     benchLcdHome,        benchLcdWriteChar,  NULL,            16 },
+    { "lcd_set_cursor",     NULL,                benchLcdSetCursor,  NULL,            32 },
+    { "lcd_clear",          NULL,                benchLcdClear,      NULL,            8  },
+    { "snprintf_clock",     benchRtcGetTime,     benchSnprintfClock, NULL,            64 },
+    { "fmt_format_clock",   benchRtcGetTime,     benchFmtFormatClock, NULL,           64 },
+    { "fmt_clock_bcd",      benchRtcGetTimeBcd,  benchFmtClock,      NULL,            64 },
+    { "fmt_time_simd",      benchRtcGetTimeBcd,  benchFmtTimeSimd,   NULL,            64 },
+    { "cal_day_of_week",    benchNextDate,       benchCalDayOfWeek,  benchNextDate,   64 },
+    { "cal_weekday_formula", benchNextDate,      benchCalDayOfWeekFormula, benchNextDate, 64 },
+    { "cal_days_in_month",  benchNextDate,       benchCalDaysInMonth, benchNextDate,  64 },
+    { "cal_day_of_year",    benchNextDate,       benchCalDayOfYear,  benchNextDate,   64 },
+    { "rtc_get_time",       NULL,                benchRtcGetTime,    benchRtcGetDate, 64 },
+    { "rtc_get_date",       NULL,                benchRtcGetDate,    NULL,            64 },
+    { "render_clock",       benchEnterClock,     benchModeRender,    NULL,            8  },
+#if CONFIG_MODE_STOPWATCH
+    { "fsm_stopwatch_select", benchEnterStopwatch, benchSelectEvent, NULL,            32 },
+#endif
+#if CONFIG_MODE_STOPWATCH && CONFIG_STOPWATCH_BACKUP
+    { "stopwatch_backup",   NULL,                benchStopwatchBackup, NULL,          32 },
+#endif
+    { "mode_switch",        NULL,                benchModeEvent,     NULL,            12 },
+#if CONFIG_POWER_FAIL
+    { "power_save",         benchPowerSetup,     benchPowerSave,     benchPowerRestore, 16 },
+#endif
+#if CONFIG_TRACE
+    { "trace_event",        NULL,                benchTraceEvent,    NULL,            64 },
+#endif
+#if CONFIG_TELEMETRY
+    { "telem_loop_record",  NULL,                benchTelemLoop,     NULL,            24 },
+#endif
+};
+
+#define BENCH_CASE_COUNT  (sizeof(benchCases) / sizeof(benchCases[0]))
+
+/* ================== RUNNER ================== */
+
+// Cycles of one timed call of 'body', without measurement overhead
+static uint32_t benchTime1(void (*body)(void), uint32_t overhead) {
+    uint32_t start = DWT_Cycles();
+    body();
+    uint32_t cycles = DWT_Cycles() - start;
+
+    return (cycles > overhead) ? (cycles - overhead) : 0U;
+}
+
+static void benchRunCase(const BenchCase_t *bc, uint32_t overhead) {
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+    uint64_t sum = 0;
+
+    if(bc->setup != NULL) {
+        bc->setup();
+    }
+
+    for(uint16_t i = 0; i < bc->iterations; i++) {
+        uint32_t cycles = benchTime1(bc->body, overhead);
+
+        if(bc->after != NULL) {
+            bc->after();
+        }
+        if(cycles < min) {
+            min = cycles;
+        }
+        if(cycles > max) {
+            max = cycles;
+        }
+        sum += cycles;
+    }
+
+#if BENCH_HAL_CYCLES_ONLY
+    if(max == 0U) {
+        printf("BENCH,%s,%lu,%s,%u,n/a,n/a,n/a\n", BENCH_TARGET,
+               (unsigned long)SystemCoreClock, bc->name, (unsigned)bc->iterations);
+        return;
+    }
+#endif
+    printf("BENCH,%s,%lu,%s,%u,%lu,%lu,%lu\n", BENCH_TARGET,
+           (unsigned long)SystemCoreClock, bc->name, (unsigned)bc->iterations,
+           (unsigned long)min, (unsigned long)(sum / bc->iterations), (unsigned long)max);
+}
+
+void BENCH_Run(void) {
+    uint32_t overhead = UINT32_MAX;
+
+    DWT_CycleCounterInit();
+
+    // Cost of timing an empty call: the smallest of a few samples
+    for(uint8_t i = 0; i < 16; i++) {
+        uint32_t cycles = benchTime1(benchEmpty, 0);
+        if(cycles < overhead) {
+            overhead = cycles;
+        }
+    }
+
+    for(uint32_t i = 0; i < BENCH_CASE_COUNT; i++) {
+        benchRunCase(&benchCases[i], overhead);
+    }
+
+    // Flash footprint of the constexpr calendar tables (calendar_tables.hpp)
+    printf("BENCH_ROM,%s,calendar_tables,%lu\n", BENCH_TARGET, (unsigned long)CAL_TableBytes());
+
+    printf("BENCH_DONE,%s,%u\n", BENCH_TARGET, (unsigned)BENCH_CASE_COUNT);
+    fflush(stdout);
+
+    // Leave the UI as after boot
+    MODE_Home();
+    benchSink = 0;
+}
+
+#endif /* CONFIG_BENCHMARK */
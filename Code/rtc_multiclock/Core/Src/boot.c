@@ -0,0 +1,112 @@
+/**
+ * @file    boot.c
+ * @brief   Boot-time profile and fast-boot decision (see boot.h)
+ */
+
+#include "boot.h"
+#include "dwt.h"
+#include "input_log.h"
+#include <stdio.h>
+#include <string.h>
+
+// Reset cause flags of RCC_CSR; RMVF clears them
+#define BOOT_RESET_FLAGS  (RCC_CSR_LPWRRSTF | RCC_CSR_WWDGRSTF | RCC_CSR_IWDGRSTF | \
+                           RCC_CSR_SFTRSTF | RCC_CSR_PORRSTF | RCC_CSR_PINRSTF | \
+                           RCC_CSR_BORRSTF)
+
+BootProfile_t bootProfile;
+
+__attribute__((section(".noinit"))) uint32_t bootLcdMagic;
+
+static const char *const bootPhaseNames[BOOT_PHASE_COUNT] = {
+    "PREMAIN", "STACK", "HAL", "CLOCK", "GPIO", "LCD", "RTC", "MODES", "SPLASH", "FRAME",
+};
+
+static uint32_t lastCycles;     // CYCCNT at the previous mark
+static uint32_t lastMhz;        // Core clock in MHz since the previous mark
+static uint32_t cycleCarry;     // Cycles not yet counted as a whole us
+static uint32_t elapsedUs;
+
+void BOOT_Start(void) {
+    // SystemInit() has started it from 0; without that (host build) it starts here
+    DWT_CycleCounterInit();
+    memset(&bootProfile, 0, sizeof(bootProfile));
+    lastCycles = 0;
+    lastMhz = SystemCoreClock / 1000000U;
+    cycleCarry = 0;
+    elapsedUs = 0;
+
+    bootProfile.resetFlags = RCC->CSR & BOOT_RESET_FLAGS;
+    __HAL_RCC_CLEAR_RESET_FLAGS();
+
+    BOOT_Mark(BOOT_PHASE_PREMAIN);
+}
+
+void BOOT_Mark(BootPhase_t phase) {
+    uint32_t now = DWT_Cycles();
+
+    if(phase >= BOOT_PHASE_COUNT || (bootProfile.marked & (1U << phase))) {
+        return;
+    }
+
+    // Cycles since the last mark ran at the clock of that mark
+    cycleCarry += now - lastCycles;
+    elapsedUs += cycleCarry / lastMhz;
+    cycleCarry %= lastMhz;
+    lastCycles = now;
+    lastMhz = SystemCoreClock / 1000000U;
+
+    bootProfile.us[phase] = elapsedUs;
+    bootProfile.marked |= (uint16_t)(1U << phase);
+}
+
+uint8_t BOOT_CanFastBoot(void) {
+    // No power loss: the LCD and the backup domain kept their state
+    uint8_t warm = (bootProfile.resetFlags & (RCC_CSR_PORRSTF | RCC_CSR_BORRSTF)) == 0U;
+    // The backup domain keeps the RTC clocked, so this reads before MX_RTC_Init()
+    uint8_t rtcSet = (&RTC->BKP0R)[BOOT_RTC_BKP_REG] == BOOT_RTC_MAGIC;
+
+    bootProfile.fast = warm && rtcSet && bootLcdMagic == BOOT_LCD_MAGIC;
+#if CONFIG_INPUT_LOG
+    // A replay reproduces a recorded cold boot
+    if(INPUTLOG_Replaying()) {
+        bootProfile.fast = 0;
+    }
+#endif
+    return bootProfile.fast;
+}
+
+void BOOT_LcdReady(void) {
+    bootLcdMagic = BOOT_LCD_MAGIC;
+}
+
+uint32_t BOOT_PhaseUs(BootPhase_t phase) {
+    uint32_t start = 0;
+
+    if(phase >= BOOT_PHASE_COUNT || !(bootProfile.marked & (1U << phase))) {
+        return 0;
+    }
+    // From the end of the latest earlier phase this boot went through
+    for(int p = (int)phase - 1; p >= 0; p--) {
+        if(bootProfile.marked & (1U << p)) {
+            start = bootProfile.us[p];
+            break;
+        }
+    }
+    return bootProfile.us[phase] - start;
+}
+
+const char *BOOT_PhaseName(BootPhase_t phase) {
+    return (phase < BOOT_PHASE_COUNT) ? bootPhaseNames[phase] : "?";
+}
+
+void BOOT_Dump(void) {
+    printf("BOOT,%u,%08lX\n", (unsigned)bootProfile.fast, (unsigned long)bootProfile.resetFlags);
+    for(uint8_t p = 0; p < BOOT_PHASE_COUNT; p++) {
+        if(bootProfile.marked & (1U << p)) {
+            printf("B,%s,%lu\n", bootPhaseNames[p], (unsigned long)bootProfile.us[p]);
+        }
+    }
+    printf("BOOT_END\n");
+    fflush(stdout);
+}
@@ -0,0 +1,85 @@
+/**
+ * @file    calendar.cpp
+ * @brief   C wrappers around the compile-time tables in calendar_tables.hpp
+ *
+ * No constructors, exceptions or RTTI: the object file has only
+ * code and .rodata, so it links into the C firmware without the C++
+ * runtime.
+ */
+
+#include "calendar.h"
+#include "calendar_tables.hpp"
+
+static inline bool validDate(uint8_t year, uint8_t month, uint8_t day) {
+    return year < cal::kYears && month >= 1U && month <= 12U && day >= 1U &&
+           day <= cal::kMonthTable.days[cal::leapIndex(year)][month - 1U];
+}
+
+extern "C" {
+
+uint8_t CAL_IsLeap(uint8_t year) {
+    return (year < cal::kYears) ? static_cast<uint8_t>(cal::leapIndex(year)) : 0U;
+}
+
+uint8_t CAL_DaysInMonth(uint8_t year, uint8_t month) {
+    if(year >= cal::kYears || month < 1U || month > 12U) {
+        return 0;
+    }
+    return cal::kMonthTable.days[cal::leapIndex(year)][month - 1U];
+}
+
+uint16_t CAL_DayOfYear(uint8_t year, uint8_t month, uint8_t day) {
+    return validDate(year, month, day) ? static_cast<uint16_t>(cal::dayOfYear(year, month, day)) : 0U;
+}
+
+uint16_t CAL_DaysSince2000(uint8_t year, uint8_t month, uint8_t day) {
+    return validDate(year, month, day) ? static_cast<uint16_t>(cal::daysSince2000(year, month, day)) : 0U;
+}
+
+void CAL_FromDays(uint16_t days, uint8_t *year, uint8_t *month, uint8_t *day) {
+    unsigned y = 0;
+    unsigned m = 0;
+    unsigned left = days;
+
+    while(y < cal::kYears - 1U && left >= cal::kMonthTable.before[cal::leapIndex(y)][12]) {
+        left -= cal::kMonthTable.before[cal::leapIndex(y)][12];
+        y++;
+    }
+    while(m < 11U && left >= cal::kMonthTable.days[cal::leapIndex(y)][m]) {
+        left -= cal::kMonthTable.days[cal::leapIndex(y)][m];
+        m++;
+    }
+    if(left >= cal::kMonthTable.days[cal::leapIndex(y)][m]) {
+        left = cal::kMonthTable.days[cal::leapIndex(y)][m] - 1U;    // Past 2099
+    }
+    *year = static_cast<uint8_t>(y);
+    *month = static_cast<uint8_t>(m + 1U);
+    *day = static_cast<uint8_t>(left + 1U);
+}
+
+uint8_t CAL_DayOfWeek(uint8_t year, uint8_t month, uint8_t day) {
+    return validDate(year, month, day) ? static_cast<uint8_t>(cal::dayOfWeek(year, month, day)) : 0U;
+}
+
+uint8_t CAL_ToBcd(uint8_t value) {
+    return (value < 100U) ? cal::kBcdTable.toBcd[value] : CAL_BCD_INVALID;
+}
+
+uint8_t CAL_FromBcd(uint8_t bcd) {
+    return cal::kBcdTable.fromBcd[bcd];
+}
+
+uint16_t CAL_SubSecondMs(uint32_t subSeconds, uint32_t secondFraction, uint32_t *aheadSeconds) {
+    uint32_t steps = secondFraction + 1U;
+    uint32_t ahead = (subSeconds > secondFraction) ? (subSeconds - steps) / steps + 1U : 0U;
+
+    // SSR counts down from PREDIV_S within each second
+    *aheadSeconds = ahead;
+    return static_cast<uint16_t>((ahead * steps + secondFraction - subSeconds) * 1000U / steps);
+}
+
+uint32_t CAL_TableBytes(void) {
+    return cal::kTableBytes;
+}
+
+} // extern "C"
@@ -0,0 +1,1125 @@
+/**
+ * @file    console.c
+ * @brief   USART2 command console with DMA receive and send (see console.h)
+ *
+ * There is no UART or DMA HAL module in this project, so USART2 and
+ * DMA1 streams 5 / 6 (channel 4) are set up at register level, as
+ * retarget.c did for the polled stdout before.
+ */
+
+#include "app_config.h"
+
+#if CONFIG_CONSOLE
+
+#include "console.h"
+#include "stopwatch.h"
+#include "calendar.h"
+#include "mode.h"
+#include "boot.h"
+#include "input_log.h"
+#include "kvstore.h"
+#include "eventlog.h"
+#include "trace.h"
+#include "crash.h"
+#include "power.h"
+#include "sysclk.h"
+#include "governor.h"
+#include "hsitrim.h"
+#include "memstat.h"
+#include "fmt.h"
+#include <stdarg.h>
+#include <string.h>
+
+#define CONSOLE_DMA_CHANNEL  (4U << DMA_SxCR_CHSEL_Pos)   // USART2 on streams 5 and 6
+
+#define CONSOLE_REPLY_MAX    80U     // Longest reply line, CRLF included
+
+// Every flag of stream 5 / stream 6 in HIFCR
+#define CONSOLE_RX_FLAGS  (DMA_HIFCR_CFEIF5 | DMA_HIFCR_CDMEIF5 | DMA_HIFCR_CTEIF5 | \
+                           DMA_HIFCR_CHTIF5 | DMA_HIFCR_CTCIF5)
+#define CONSOLE_TX_FLAGS  (DMA_HIFCR_CFEIF6 | DMA_HIFCR_CDMEIF6 | DMA_HIFCR_CTEIF6 | \
+                           DMA_HIFCR_CHTIF6 | DMA_HIFCR_CTCIF6)
+
+// rxWritten wraps at 2^32 without losing its place in the ring
+#if (CONFIG_CONSOLE_RX_BYTES & (CONFIG_CONSOLE_RX_BYTES - 1)) != 0
+#error "CONFIG_CONSOLE_RX_BYTES must be a power of two"
+#endif
+
+extern RTC_HandleTypeDef hrtc;
+
+typedef struct {
+    const char *name;
+    const char *usage;
+    const char *(*run)(const char *args);   // NULL or the reason of the ERR
+} ConsoleCommand_t;
+
+static ConsoleStats_t consoleStats;
+static uint8_t consoleReady = 0;
+
+// RX: the DMA writes rxRing; the interrupts count the bytes in rxWritten
+static uint8_t rxRing[CONFIG_CONSOLE_RX_BYTES];
+static volatile uint32_t rxWritten;   // Bytes stored by the DMA since CONSOLE_Init()
+static uint16_t rxDmaPos;             // Ring index of the DMA at the last count
+static uint32_t rxRead;               // Bytes taken by CONSOLE_Poll()
+
+static char line[CONFIG_CONSOLE_LINE + 1];
+static uint8_t lineLength;
+static const char *lineError;         // Set when the line cannot be run
+
+// Reply longer than the TX ring: called from CONSOLE_Poll() until it
+// returns 0, then "OK"; later lines wait in the RX ring meanwhile
+static uint8_t (*consoleMore)(void);
+
+// TX: [txTail, txHead) is queued, the DMA owns txBusy bytes from txTail
+static uint8_t txRing[CONFIG_CONSOLE_TX_BYTES];
+static volatile uint16_t txHead;
+static volatile uint16_t txTail;
+static volatile uint16_t txBusy;
+
+static const char *const weekdayNames[7] = {
+    "MON", "TUE", "WED", "THU", "FRI", "SAT", "SUN",
+};
+
+/* ================= RX ================= */
+
+// Interrupt context: count what the DMA has stored since the last call.
+// With the half / full transfer interrupts the DMA is never more than
+// half the ring ahead, so the distance is unambiguous.
+static void consoleRxCount(void) {
+    uint16_t pos = (uint16_t)((CONFIG_CONSOLE_RX_BYTES - DMA1_Stream5->NDTR) % CONFIG_CONSOLE_RX_BYTES);
+
+    rxWritten += (uint16_t)(pos - rxDmaPos + CONFIG_CONSOLE_RX_BYTES) % CONFIG_CONSOLE_RX_BYTES;
+    rxDmaPos = pos;
+}
+
+// End of a burst: the line has been idle for one character
+void USART2_IRQHandler(void) {
+    TRACE(TRACE_ISR_ENTER, USART2_IRQn);
+    if(USART2->SR & USART_SR_IDLE) {
+        (void)USART2->DR;   // SR then DR clears IDLE
+        consoleRxCount();
+    }
+    TRACE(TRACE_ISR_EXIT, USART2_IRQn);
+}
+
+// Half / full ring during a long burst
+void DMA1_Stream5_IRQHandler(void) {
+    TRACE(TRACE_ISR_ENTER, DMA1_Stream5_IRQn);
+    DMA1->HIFCR = CONSOLE_RX_FLAGS;
+    consoleRxCount();
+    TRACE(TRACE_ISR_EXIT, DMA1_Stream5_IRQn);
+}
+
+/* ================= TX ================= */
+
+// Start the oldest contiguous chunk if the stream is idle.
+// Called with interrupts off or from the stream 6 interrupt.
+static void consoleTxKick(void) {
+    uint16_t length;
+
+    if(txBusy != 0U || txHead == txTail) {
+        return;
+    }
+    length = (txHead > txTail) ? (uint16_t)(txHead - txTail)
+                               : (uint16_t)(CONFIG_CONSOLE_TX_BYTES - txTail);
+
+    DMA1->HIFCR = CONSOLE_TX_FLAGS;
+    DMA1_Stream6->M0AR = (uintptr_t)&txRing[txTail];
+    DMA1_Stream6->NDTR = length;
+    txBusy = length;
+    DMA1_Stream6->CR |= DMA_SxCR_EN;
+}
+
+void DMA1_Stream6_IRQHandler(void) {
+    TRACE(TRACE_ISR_ENTER, DMA1_Stream6_IRQn);
+    if(DMA1->HISR & DMA_HISR_TCIF6) {
+        DMA1->HIFCR = DMA_HIFCR_CTCIF6;
+        txTail = (uint16_t)((txTail + txBusy) % CONFIG_CONSOLE_TX_BYTES);
+        txBusy = 0;
+        consoleTxKick();
+    }
+    TRACE(TRACE_ISR_EXIT, DMA1_Stream6_IRQn);
+}
+
+static uint16_t consoleTxFree(void) {
+    uint16_t used = (uint16_t)((txHead - txTail + CONFIG_CONSOLE_TX_BYTES) % CONFIG_CONSOLE_TX_BYTES);
+    return (uint16_t)(CONFIG_CONSOLE_TX_BYTES - 1U - used);
+}
+
+uint16_t CONSOLE_Write(const char *data, uint16_t length) {
+    uint32_t primask;
+    uint16_t queued;
+
+    if(!consoleReady) {
+        CONSOLE_Init();
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    queued = consoleTxFree();
+    if(queued > length) {
+        queued = length;
+    }
+    for(uint16_t i = 0; i < queued; i++) {
+        txRing[txHead] = (uint8_t)data[i];
+        txHead = (uint16_t)((txHead + 1U) % CONFIG_CONSOLE_TX_BYTES);
+    }
+    consoleStats.txBytes += queued;
+    consoleStats.txDropped += (uint32_t)(length - queued);
+    consoleTxKick();
+    __set_PRIMASK(primask);
+
+    return queued;
+}
+
+int CONSOLE_PutChar(int ch) {
+    char crlf[2] = { '\r', (char)ch };
+    uint16_t length = (ch == '\n') ? 2U : 1U;
+    const char *data = (length == 2U) ? crlf : &crlf[1];
+    uint32_t start = HAL_GetTick();
+
+    if(!consoleReady) {
+        CONSOLE_Init();
+    }
+    // Dumps are larger than the ring: wait for the DMA, unless it cannot run
+    while(consoleTxFree() < length && __get_PRIMASK() == 0U &&
+          HAL_GetTick() - start < CONSOLE_PUTCHAR_TIMEOUT_MS) {
+    }
+    CONSOLE_Write(data, length);
+    return ch;
+}
+
+const ConsoleStats_t *CONSOLE_GetStats(void) {
+    return &consoleStats;
+}
+
+/* ================= REPLIES ================= */
+
+static void consoleReply(const char *format, ...) {
+    char buffer[CONSOLE_REPLY_MAX];
+    va_list args;
+    int length;
+
+    va_start(args, format);
+    length = FMT_VFormat(buffer, sizeof(buffer) - 2U, format, args);
+    va_end(args);
+
+    if(length < 0) {
+        length = 0;
+    } else if(length > (int)sizeof(buffer) - 3) {
+        length = (int)sizeof(buffer) - 3;
+    }
+    buffer[length++] = '\r';
+    buffer[length++] = '\n';
+    CONSOLE_Write(buffer, (uint16_t)length);
+}
+
+// "hh:mm:ss.mmm"; hours widen past 99
+static char *formatMs(char *out, uint32_t ms) {
+    uint32_t seconds = ms / 1000U;
+
+    out = FMT_Uint(out, seconds / 3600U, 2, '0');
+    *out++ = ':';
+    out = FMT_Dec2(out, (seconds / 60U) % 60U);
+    *out++ = ':';
+    out = FMT_Dec2(out, seconds % 60U);
+    *out++ = '.';
+    out = FMT_Dec3(out, ms % 1000U);
+    *out = '\0';
+    return out;
+}
+
+/* ================= PARSING ================= */
+
+// Exactly 'digits' decimal digits at *p
+static uint8_t parseDigits(const char **p, uint8_t digits, uint32_t *value) {
+    *value = 0;
+    for(uint8_t i = 0; i < digits; i++) {
+        if((*p)[i] < '0' || (*p)[i] > '9') {
+            return 0;
+        }
+        *value = *value * 10U + (uint32_t)((*p)[i] - '0');
+    }
+    *p += digits;
+    return 1;
+}
+
+static uint8_t parseChar(const char **p, char c) {
+    if(**p != c) {
+        return 0;
+    }
+    (*p)++;
+    return 1;
+}
+
+// Start of the next word, or of the end of the line
+static const char *skipSpaces(const char *p) {
+    while(*p == ' ' || *p == '\t') {
+        p++;
+    }
+    return p;
+}
+
+#if CONFIG_INPUT_LOG
+// A replay owns the stopwatch and the RTC: a change from here would
+// not be in the recording it is checked against
+#define CONSOLE_REPLAYING()  INPUTLOG_Replaying()
+#else
+#define CONSOLE_REPLAYING()  0
+#endif
+
+// Set by a command that changed the time, the stopwatch or a setting.
+// Only those redraw: a redraw after a query would not be in a replay.
+static uint8_t consoleChanged;
+
+// 1 if 'args' is exactly 'word' (surrounding spaces aside)
+static uint8_t isWord(const char *args, const char *word) {
+    size_t length = strlen(word);
+
+    return strncmp(args, word, length) == 0 && *skipSpaces(args + length) == '\0';
+}
+
+/* ================= COMMANDS ================= */
+
+static const char *cmdHelp(const char *args);
+
+static const char *cmdDate(const char *args) {
+    RTC_TimeTypeDef time;
+    RTC_DateTypeDef date;
+    uint32_t year, month, day;
+#if CONFIG_EVENT_LOG
+    uint32_t before;
+#endif
+
+    if(*args == '\0') {
+        HAL_RTC_GetTime(&hrtc, &time, RTC_FORMAT_BIN);
+        HAL_RTC_GetDate(&hrtc, &date, RTC_FORMAT_BIN); // Unlocks the shadow registers
+        consoleReply("DATE 20%02u-%02u-%02u %s", date.Year, date.Month, date.Date,
+                     weekdayNames[(date.WeekDay - 1U) % 7U]);
+        return NULL;
+    }
+
+    if(!parseDigits(&args, 4, &year) || !parseChar(&args, '-') ||
+       !parseDigits(&args, 2, &month) || !parseChar(&args, '-') ||
+       !parseDigits(&args, 2, &day) || *skipSpaces(args) != '\0') {
+        return "usage";
+    }
+    if(year < 2000U || year > 2099U || month < 1U || month > 12U || day < 1U ||
+       day > CAL_DaysInMonth((uint8_t)(year - 2000U), (uint8_t)month)) {
+        return "range";
+    }
+    if(CONSOLE_REPLAYING()) {
+        return "replay";
+    }
+
+    date.Year = (uint8_t)(year - 2000U);
+    date.Month = (uint8_t)month;
+    date.Date = (uint8_t)day;
+    date.WeekDay = CAL_DayOfWeek(date.Year, date.Month, date.Date);
+#if CONFIG_EVENT_LOG
+    before = EVLOG_Now();
+#endif
+    if(HAL_RTC_SetDate(&hrtc, &date, RTC_FORMAT_BIN) != HAL_OK) {
+        return "rtc";
+    }
+    consoleChanged = 1;
+#if CONFIG_INPUT_LOG
+    INPUTLOG_RecordDate(&date);
+#endif
+#if CONFIG_EVENT_LOG
+    EVLOG_TimeChanged(before);
+#endif
+#if CONFIG_MODE_STOPWATCH
+    STOPWATCH_ClockChanged();
+#endif
+    return NULL;
+}
+
+static const char *cmdTime(const char *args) {
+    RTC_TimeTypeDef time = {0};
+    RTC_DateTypeDef date;
+    uint32_t hours, minutes, seconds, ms = 0;
+    char buffer[16];
+#if CONFIG_EVENT_LOG
+    uint32_t before;
+#endif
+
+    if(*args == '\0') {
+        uint32_t ahead;
+
+        HAL_RTC_GetTime(&hrtc, &time, RTC_FORMAT_BIN);
+        HAL_RTC_GetDate(&hrtc, &date, RTC_FORMAT_BIN); // Unlocks the shadow registers
+        // TR reads ahead for up to a second after a set with ms
+        ms = CAL_SubSecondMs(time.SubSeconds, time.SecondFraction, &ahead);
+        seconds = ((time.Hours * 60U + time.Minutes) * 60U + time.Seconds + 86400U - ahead) % 86400U;
+        formatMs(buffer, seconds * 1000U + ms);
+        consoleReply("TIME %s", buffer);
+        return NULL;
+    }
+
+    if(!parseDigits(&args, 2, &hours) || !parseChar(&args, ':') ||
+       !parseDigits(&args, 2, &minutes) || !parseChar(&args, ':') ||
+       !parseDigits(&args, 2, &seconds) ||
+       (parseChar(&args, '.') && !parseDigits(&args, 3, &ms)) ||
+       *skipSpaces(args) != '\0') {
+        return "usage";
+    }
+    if(hours > 23U || minutes > 59U || seconds > 59U) {
+        return "range";
+    }
+    if(CONSOLE_REPLAYING()) {
+        return "replay";
+    }
+
+    time.Hours = (uint8_t)hours;
+    time.Minutes = (uint8_t)minutes;
+    time.Seconds = (uint8_t)seconds;
+    time.TimeFormat = RTC_HOURFORMAT_24;
+    time.DayLightSaving = RTC_DAYLIGHTSAVING_NONE;
+    time.StoreOperation = RTC_STOREOPERATION_RESET;
+#if CONFIG_EVENT_LOG
+    before = EVLOG_Now();
+#endif
+    if(HAL_RTC_SetTime(&hrtc, &time, RTC_FORMAT_BIN) != HAL_OK) {
+        return "rtc";
+    }
+    consoleChanged = 1;
+    // The write restarts the second; move it on by 'ms': add one
+    // second and take back the rest of it in PREDIV_S + 1 steps
+    if(ms > 0U) {
+        uint32_t steps = hrtc.Init.SynchPrediv + 1U;
+        if(HAL_RTCEx_SetSynchroShift(&hrtc, RTC_SHIFTADD1S_SET,
+                                     steps - ms * steps / 1000U) != HAL_OK) {
+            return "rtc";
+        }
+    }
+#if CONFIG_INPUT_LOG
+    // Replays restore the whole seconds
+    INPUTLOG_RecordRtc(&time, INPUTLOG_KIND_RTC);
+#endif
+#if CONFIG_EVENT_LOG
+    EVLOG_TimeChanged(before);
+#endif
+#if CONFIG_MODE_STOPWATCH
+    STOPWATCH_ClockChanged();
+#endif
+    return NULL;
+}
+
+#if CONFIG_MODE_STOPWATCH
+
+static void replyStopwatch(void) {
+    char buffer[16];
+
+    formatMs(buffer, STOPWATCH_ElapsedMs());
+    consoleReply("SW %s %s LAPS %u", STOPWATCH_Running() ? "RUNNING" : "STOPPED",
+                 buffer, STOPWATCH_LapCount());
+}
+
+static const char *cmdStopwatch(const char *args) {
+    uint8_t done;
+    UiEvent_t event;
+
+    if(*args == '\0') {
+        replyStopwatch();
+        return NULL;
+    }
+
+    // Each action is the button event that does it in that state
+    if(isWord(args, "start") || isWord(args, "stop")) {
+        event = UI_EV_SELECT;
+    } else if(isWord(args, "reset") || isWord(args, "lap")) {
+        event = UI_EV_INC;
+    } else {
+        return "usage";
+    }
+    if(CONSOLE_REPLAYING()) {
+        return "replay";
+    }
+
+    if(isWord(args, "start")) {
+        done = STOPWATCH_Start();
+    } else if(isWord(args, "stop")) {
+        done = STOPWATCH_Stop();
+    } else if(isWord(args, "reset")) {
+        done = STOPWATCH_Reset();
+    } else {
+        done = STOPWATCH_Lap();
+    }
+    if(!done) {
+        return STOPWATCH_Running() ? "running" : "stopped";
+    }
+    consoleChanged = 1;
+#if CONFIG_INPUT_LOG
+    INPUTLOG_RecordStopwatch(event);
+#else
+    (void)event;
+#endif
+    replyStopwatch();
+    return NULL;
+}
+
+static const char *cmdLaps(const char *args) {
+    uint16_t count = STOPWATCH_LapCount();
+    uint16_t first = (count > CONFIG_STOPWATCH_LAPS) ? (uint16_t)(count - CONFIG_STOPWATCH_LAPS + 1U) : 1U;
+    char split[16];
+    char lap[16];
+
+    (void)args;
+    for(uint16_t n = first; n <= count; n++) {
+        uint32_t ms = STOPWATCH_LapMs(n);
+        uint32_t previous = (n > 1U) ? STOPWATCH_LapMs((uint16_t)(n - 1U)) : 0U;
+
+        formatMs(split, ms);
+        // The lap before the oldest stored one is gone; its time is unknown
+        if(n == first && n > 1U) {
+            consoleReply("LAP %u %s", n, split);
+        } else {
+            formatMs(lap, ms - previous);
+            consoleReply("LAP %u %s %s", n, split, lap);
+        }
+    }
+    return NULL;
+}
+
+#endif /* CONFIG_MODE_STOPWATCH */
+
+#if CONFIG_KV_STORE
+
+static uint8_t parseHexDigit(char c) {
+    if(c >= '0' && c <= '9') {
+        return (uint8_t)(c - '0');
+    }
+    if(c >= 'A' && c <= 'F') {
+        return (uint8_t)(c - 'A' + 10);
+    }
+    if(c >= 'a' && c <= 'f') {
+        return (uint8_t)(c - 'a' + 10);
+    }
+    return 0xFFU;
+}
+
+static void replyValue(KvKey_t key) {
+    static const char hexDigits[] = "0123456789ABCDEF";
+    uint8_t value[KV_MAX_VALUE];
+    char hex[2U * KV_MAX_VALUE + 1U];
+    uint8_t length = KV_Get(key, value, sizeof(value));
+
+    if(length == 0U) {
+        return;
+    }
+    for(uint8_t i = 0; i < length; i++) {
+        hex[2U * i] = hexDigits[value[i] >> 4];
+        hex[2U * i + 1U] = hexDigits[value[i] & 0x0FU];
+    }
+    hex[2U * length] = '\0';
+    consoleReply("KV %s %s", KV_Name(key), hex);
+}
+
+// kv                  every stored value in hex, then the store's state
+// kv <key> <hex>      store a value
+// kv <key> -          delete it
+static const char *cmdKv(const char *args) {
+    char name[16];
+    uint8_t value[KV_MAX_VALUE];
+    uint8_t length = 0;
+    uint8_t n = 0;
+    KvKey_t key;
+
+    if(*args == '\0') {
+        KvStats_t stats;
+
+        for(uint8_t k = 0; k < KV_KEY_COUNT; k++) {
+            replyValue((KvKey_t)k);
+        }
+        KV_GetStats(&stats);
+        consoleReply("KVSTORE GEN %lu USED %u/%u RECORDS %u%s", (unsigned long)stats.generation,
+                     stats.used, stats.size, stats.records, stats.recovered ? " RECOVERED" : "");
+        return NULL;
+    }
+
+    while(*args != ' ' && *args != '\t' && *args != '\0' && n < sizeof(name) - 1U) {
+        name[n++] = *args++;
+    }
+    name[n] = '\0';
+    key = KV_Find(name);
+    if(key == KV_KEY_COUNT) {
+        return "key";
+    }
+
+    args = skipSpaces(args);
+    if(*args == '\0') {
+        return "usage";
+    }
+    if(isWord(args, "-")) {
+        args = "";
+    }
+    for(; *args != '\0' && *args != ' ' && *args != '\t'; args += 2) {
+        uint8_t high = parseHexDigit(args[0]);
+        uint8_t low = (high != 0xFFU) ? parseHexDigit(args[1]) : 0xFFU;
+
+        if(low == 0xFFU || length == KV_MAX_VALUE) {
+            return "usage";
+        }
+        value[length++] = (uint8_t)((high << 4) | low);
+    }
+    if(*skipSpaces(args) != '\0') {
+        return "usage";
+    }
+    // hour_format changes the CLOCK view
+    if(CONSOLE_REPLAYING()) {
+        return "replay";
+    }
+
+    if(KV_Set(key, value, length) != HAL_OK) {
+        return "flash";
+    }
+    consoleChanged = 1;
+    replyValue(key);
+    return NULL;
+}
+
+#endif /* CONFIG_KV_STORE */
+
+#if CONFIG_EVENT_LOG
+
+static const struct {
+    uint32_t flag;
+    const char *name;
+} resetFlagNames[] = {
+    { RCC_CSR_PORRSTF,  "POR"  },
+    { RCC_CSR_BORRSTF,  "BOR"  },
+    { RCC_CSR_PINRSTF,  "PIN"  },
+    { RCC_CSR_SFTRSTF,  "SFT"  },
+    { RCC_CSR_IWDGRSTF, "IWDG" },
+    { RCC_CSR_WWDGRSTF, "WWDG" },
+    { RCC_CSR_LPWRRSTF, "LPWR" },
+};
+
+static EvlogCursor_t logCursor;
+static uint32_t logTo;
+static uint32_t logCount;
+
+// "YYYY-MM-DD hh:mm:ss"
+static char *formatStamp(char *out, uint32_t stamp) {
+    uint8_t year, month, day;
+
+    CAL_FromDays((uint16_t)(stamp / 86400U), &year, &month, &day);
+    out = FMT_Dec4(out, 2000U + year);
+    *out++ = '-';
+    out = FMT_Dec2(out, month);
+    *out++ = '-';
+    out = FMT_Dec2(out, day);
+    *out++ = ' ';
+    stamp %= 86400U;
+    out = FMT_Dec2(out, stamp / 3600U);
+    *out++ = ':';
+    out = FMT_Dec2(out, (stamp / 60U) % 60U);
+    *out++ = ':';
+    out = FMT_Dec2(out, stamp % 60U);
+    *out = '\0';
+    return out;
+}
+
+static void replyEvent(const EvlogEvent_t *event) {
+    char when[20];
+    char detail[40];
+    char *p = detail;
+
+    formatStamp(when, event->time);
+    detail[0] = '\0';
+    switch(event->type) {
+    case EVLOG_RESET:
+        for(uint8_t i = 0; i < sizeof(resetFlagNames) / sizeof(resetFlagNames[0]); i++) {
+            if(event->words > 0U && (event->data[0] & resetFlagNames[i].flag)) {
+                *p++ = ' ';
+                p = FMT_Str(p, resetFlagNames[i].name);
+            }
+        }
+        *p = '\0';
+        break;
+    case EVLOG_TIME_SET:
+        if(event->words > 0U) {
+            *p++ = ' ';
+            formatStamp(p, event->data[0]);
+        }
+        break;
+    case EVLOG_STOPWATCH_START:
+    case EVLOG_STOPWATCH_STOP:
+        if(event->words > 0U) {
+            *p++ = ' ';
+            p = formatMs(p, event->data[0]);
+        }
+        if(event->words > 1U) {
+            FMT_Format(p, sizeof(detail) - (size_t)(p - detail), " LAPS %lu",
+                       (unsigned long)event->data[1]);
+        }
+        break;
+    case EVLOG_CRASH:
+        if(event->words > 1U) {
+            FMT_Format(detail, sizeof(detail), " %s PC %08lX",
+                       CRASH_CauseName((CrashCause_t)event->data[0]),
+                       (unsigned long)event->data[1]);
+        }
+        break;
+    default:
+        for(uint8_t i = 0; i < event->words; i++) {
+            p += FMT_Format(p, 10, " %lX", (unsigned long)event->data[i]);
+        }
+        break;
+    }
+    consoleReply("EV %s %s%s", when, EVLOG_TypeName(event->type), detail);
+}
+
+// Events of the range while a line fits in the TX ring
+static uint8_t logMore(void) {
+    EvlogEvent_t event;
+
+    while(consoleTxFree() >= CONSOLE_REPLY_MAX) {
+        if(!EVLOG_Next(&logCursor, &event) || event.time >= logTo) {
+            consoleReply("LOG %lu EVENTS", (unsigned long)logCount);
+            return 0;
+        }
+        replyEvent(&event);
+        logCount++;
+    }
+    return 1;
+}
+
+// YYYY-MM-DD[Thh:mm[:ss]] as seconds since 2000
+static uint8_t parseStamp(const char **p, uint32_t *stamp) {
+    uint32_t year, month, day, hours = 0, minutes = 0, seconds = 0;
+
+    if(!parseDigits(p, 4, &year) || !parseChar(p, '-') ||
+       !parseDigits(p, 2, &month) || !parseChar(p, '-') || !parseDigits(p, 2, &day)) {
+        return 0;
+    }
+    if(parseChar(p, 'T') &&
+       (!parseDigits(p, 2, &hours) || !parseChar(p, ':') || !parseDigits(p, 2, &minutes) ||
+        (parseChar(p, ':') && !parseDigits(p, 2, &seconds)))) {
+        return 0;
+    }
+    if(year < 2000U || year > 2099U || month < 1U || month > 12U || day < 1U ||
+       day > CAL_DaysInMonth((uint8_t)(year - 2000U), (uint8_t)month) ||
+       hours > 23U || minutes > 59U || seconds > 59U) {
+        return 0;
+    }
+    *stamp = CAL_DaysSince2000((uint8_t)(year - 2000U), (uint8_t)month, (uint8_t)day) * 86400UL +
+             (hours * 60U + minutes) * 60U + seconds;
+    return 1;
+}
+
+// log [from [to]]     events with from <= time < to, oldest first
+static const char *cmdLog(const char *args) {
+    uint32_t from = 0;
+
+    logTo = UINT32_MAX;
+    if(*args != '\0') {
+        if(!parseStamp(&args, &from)) {
+            return "usage";
+        }
+        args = skipSpaces(args);
+        if(*args != '\0' && !parseStamp(&args, &logTo)) {
+            return "usage";
+        }
+        if(*skipSpaces(args) != '\0') {
+            return "usage";
+        }
+    }
+    EVLOG_Seek(&logCursor, from);
+    logCount = 0;
+    consoleMore = logMore;
+    return NULL;
+}
+
+#endif /* CONFIG_EVENT_LOG */
+
+#if CONFIG_INPUT_LOG
+
+static uint16_t inputLine;
+
+// Lines of the input log while one fits in the TX ring
+static uint8_t inputMore(void) {
+    char text[INPUTLOG_LINE_MAX];
+
+    while(consoleTxFree() >= CONSOLE_REPLY_MAX) {
+        if(!INPUTLOG_Line(inputLine, text, sizeof(text))) {
+            return 0;
+        }
+        consoleReply("%s", text);
+        inputLine++;
+    }
+    return 1;
+}
+
+// input                  the recorded input log (input_log.h)
+static const char *cmdInput(const char *args) {
+    (void)args;
+    inputLine = 0;
+    consoleMore = inputMore;
+    return NULL;
+}
+
+#endif /* CONFIG_INPUT_LOG */
+
+static uint16_t crashLine;
+
+// Lines of the stored dump while one fits in the TX ring
+static uint8_t crashMore(void) {
+    char text[CRASH_LINE_MAX];
+
+    while(consoleTxFree() >= CONSOLE_REPLY_MAX) {
+        if(!CRASH_Line(crashLine, text, sizeof(text))) {
+            return 0;
+        }
+        consoleReply("%s", text);
+        crashLine++;
+    }
+    return 1;
+}
+
+// crash [clear|test]     the dump of the last fault (crash.h)
+static const char *cmdCrash(const char *args) {
+    if(*args == '\0') {
+        if(CRASH_Get() == NULL) {
+            consoleReply("CRASH NONE");
+            return NULL;
+        }
+        crashLine = 0;
+        consoleMore = crashMore;
+        return NULL;
+    }
+
+    if(isWord(args, "clear")) {
+        CRASH_Clear();
+    } else if(isWord(args, "test")) {
+        // Same path as a failed HAL call: dump and reset, no reply
+        Error_Handler();
+    } else {
+        return "usage";
+    }
+    return NULL;
+}
+
+static const char *cmdClock(const char *args) {
+    static const char *const words[SYSCLK_PROFILE_COUNT] = { "low", "nominal", "over" };
+    const SysclkInfo_t *info;
+
+    if(*args != '\0') {
+        uint8_t i = 0;
+
+        while(i < SYSCLK_PROFILE_COUNT && !isWord(args, words[i])) {
+            i++;
+        }
+#if CONFIG_GOVERNOR
+        if(i == SYSCLK_PROFILE_COUNT && isWord(args, "auto")) {
+            GOV_Release();
+        } else if(i == SYSCLK_PROFILE_COUNT) {
+            return "usage";
+        } else if(GOV_Pin((SysclkProfile_t)i) != HAL_OK) {
+            return "clock";
+        }
+#else
+        if(i == SYSCLK_PROFILE_COUNT) {
+            return "usage";
+        }
+        // Replies queued so far go out at the old rate, the rest at the new
+        if(SYSCLK_Set((SysclkProfile_t)i) != HAL_OK) {
+            return "clock";
+        }
+#endif
+    }
+
+    info = SYSCLK_Info(SYSCLK_Get());
+    consoleReply("CLOCK %s %lu MHZ", info->name, (unsigned long)(SystemCoreClock / 1000000U));
+#if CONFIG_GOVERNOR
+    {
+        const GovStats_t *gov = GOV_GetStats();
+
+        consoleReply("GOV %s LOAD %u %% UP %lu DOWN %lu SWITCHING %lu US",
+                     gov->pinned ? "PINNED" : "AUTO", gov->loadPct, (unsigned long)gov->ups,
+                     (unsigned long)gov->downs, (unsigned long)gov->switchUs);
+    }
+#endif
+    for(uint8_t i = 0; i < SYSCLK_PROFILE_COUNT; i++) {
+        const SysclkStats_t *stats = SYSCLK_Stats((SysclkProfile_t)i);
+
+        info = SYSCLK_Info((SysclkProfile_t)i);
+        consoleReply("PROFILE %s %lu MHZ %u.%u MA SW %lu FAIL %lu LAST %lu MAX %lu US", info->name,
+                     (unsigned long)(info->hz / 1000000U), info->runMa10 / 10U, info->runMa10 % 10U,
+                     (unsigned long)stats->switches, (unsigned long)stats->failures,
+                     (unsigned long)stats->lastUs, (unsigned long)stats->maxUs);
+#if CONFIG_GOVERNOR
+        consoleReply("RESIDENCY %s %lu MS", info->name,
+                     (unsigned long)GOV_GetStats()->residencyMs[i]);
+#endif
+    }
+    return NULL;
+}
+
+#if CONFIG_HSITRIM
+
+// hsi                    HSI trim and the stopwatch error (hsitrim.h)
+static const char *cmdHsi(const char *args) {
+    const HsitrimStats_t *hsi = HSITRIM_GetStats();
+
+    (void)args;
+    consoleReply("HSI %s TRIM %u FACTORY %u", HSITRIM_StateName((HsitrimState_t)hsi->state),
+                 hsi->trim, hsi->factoryTrim);
+    consoleReply("HSI %ld PPM CORRECTION %ld PPM", (long)hsi->hsiPpm, (long)hsi->correctionPpm);
+    consoleReply("STOPWATCH BEFORE %ld AFTER %ld PPM", (long)hsi->factoryPpm,
+                 (long)hsi->residualPpm);
+    consoleReply("MEASURED %lu DISCARDED %lu", (unsigned long)hsi->measurements,
+                 (unsigned long)hsi->discarded);
+    return NULL;
+}
+
+#endif /* CONFIG_HSITRIM */
+
+static const char *cmdStats(const char *args) {
+    const ModeSwitchStats_t *modeStats = MODE_GetSwitchStats();
+    const Mode_t *mode = MODE_Active();
+
+    (void)args;
+    consoleReply("UPTIME %lu ms", (unsigned long)HAL_GetTick());
+    consoleReply("BOOT %s %lu ms", bootProfile.fast ? "FAST" : "COLD",
+                 (unsigned long)(bootProfile.us[BOOT_PHASE_FIRST_FRAME] / 1000U));
+    consoleReply("MODE %s SWITCHES %lu LAST %lu MAX %lu CYC", mode ? mode->name : "-",
+                 (unsigned long)modeStats->count, (unsigned long)modeStats->last,
+                 (unsigned long)modeStats->max);
+    consoleReply("CONSOLE RX %lu OVR %lu TX %lu DROP %lu CMD %lu",
+                 (unsigned long)consoleStats.rxBytes, (unsigned long)consoleStats.rxOverruns,
+                 (unsigned long)consoleStats.txBytes, (unsigned long)consoleStats.txDropped,
+                 (unsigned long)consoleStats.commands);
+#if CONFIG_POWER_FAIL
+    {
+        const PowerBackup_t *power = POWER_GetStats();
+
+        consoleReply("POWER PVD %lu SAVE %lu MAX %lu CYC", (unsigned long)power->saves,
+                     (unsigned long)power->lastCycles, (unsigned long)power->maxCycles);
+    }
+#endif
+#if CONFIG_MEMSTAT
+    {
+        MemStats_t mem;
+
+        MEMSTAT_Scan();
+        MEMSTAT_Get(&mem);
+        consoleReply("STACK %lu/%lu B FREE %lu", (unsigned long)mem.stackPeak,
+                     (unsigned long)mem.stackReserved, (unsigned long)mem.freeGap);
+        consoleReply("HEAP %lu/%lu B FAIL %lu LAST %lu", (unsigned long)mem.heapPeak,
+                     (unsigned long)mem.heapReserved, (unsigned long)mem.heapFailures,
+                     (unsigned long)mem.heapFailLast);
+    }
+#endif
+    return NULL;
+}
+
+static const ConsoleCommand_t consoleCommands[] = {
+    { "help",  "",                         cmdHelp },
+    { "date",  "[YYYY-MM-DD]",             cmdDate },
+    { "time",  "[hh:mm:ss[.mmm]]",         cmdTime },
+#if CONFIG_MODE_STOPWATCH
+    { "sw",    "[start|stop|reset|lap]",   cmdStopwatch },
+    { "laps",  "",                         cmdLaps },
+#endif
+#if CONFIG_KV_STORE
+    { "kv",    "[key hex|-]",              cmdKv },
+#endif
+#if CONFIG_EVENT_LOG
+    { "log",   "[from [to]]",              cmdLog },
+#endif
+#if CONFIG_INPUT_LOG
+    { "input", "",                         cmdInput },
+#endif
+    { "crash", "[clear|test]",             cmdCrash },
+#if CONFIG_GOVERNOR
+    { "clock", "[low|nominal|over|auto]",  cmdClock },
+#else
+    { "clock", "[low|nominal|over]",       cmdClock },
+#endif
+#if CONFIG_HSITRIM
+    { "hsi",   "",                         cmdHsi },
+#endif
+    { "stats", "",                         cmdStats },
+};
+
+#define CONSOLE_COMMAND_COUNT  (sizeof(consoleCommands) / sizeof(consoleCommands[0]))
+
+static const char *cmdHelp(const char *args) {
+    (void)args;
+    for(uint8_t i = 0; i < CONSOLE_COMMAND_COUNT; i++) {
+        if(consoleCommands[i].usage[0] != '\0') {
+            consoleReply("%s %s", consoleCommands[i].name, consoleCommands[i].usage);
+        } else {
+            consoleReply("%s", consoleCommands[i].name);
+        }
+    }
+    return NULL;
+}
+
+static void consoleExecute(void) {
+    const char *p = skipSpaces(line);
+    const char *error = "unknown";
+
+    if(*p == '\0') {
+        return;
+    }
+
+    for(uint8_t i = 0; i < CONSOLE_COMMAND_COUNT; i++) {
+        size_t length = strlen(consoleCommands[i].name);
+
+        if(strncmp(p, consoleCommands[i].name, length) == 0 &&
+           (p[length] == '\0' || p[length] == ' ' || p[length] == '\t')) {
+            error = consoleCommands[i].run(skipSpaces(p + length));
+            break;
+        }
+    }
+    consoleStats.commands++;
+    if(error != NULL) {
+        consoleMore = NULL;
+        consoleReply("ERR %s", error);
+    } else if(consoleMore == NULL) {
+        consoleReply("OK");
+    }
+}
+
+/* ================= BAUD RATE ================= */
+
+static void consoleSetBaud(void) {
+    // Oversampling by 16: BRR = f_PCLK1 / baud, rounded
+    USART2->BRR = (HAL_RCC_GetPCLK1Freq() + CONFIG_CONSOLE_BAUD / 2U) / CONFIG_CONSOLE_BAUD;
+}
+
+void CONSOLE_ClockChanging(void) {
+    uint32_t wait;
+
+    if(!consoleReady) {
+        return;
+    }
+    // Stream 6 keeps its place; the character in the shift register
+    // needs one character time once DR is empty (TC may be stale)
+    USART2->CR3 &= ~USART_CR3_DMAT;
+    while(!(USART2->SR & USART_SR_TXE)) {
+    }
+    wait = SystemCoreClock / (CONFIG_CONSOLE_BAUD / 10U) / 10U;
+    while(wait--) {
+        __NOP();
+    }
+}
+
+void CONSOLE_ClockChanged(void) {
+    if(!consoleReady) {
+        return;
+    }
+    consoleSetBaud();
+    USART2->CR3 |= USART_CR3_DMAT;
+}
+
+/* ================= PUBLIC API ================= */
+
+void CONSOLE_Init(void) {
+    memset(&consoleStats, 0, sizeof(consoleStats));
+    rxWritten = 0;
+    rxDmaPos = 0;
+    rxRead = 0;
+    lineLength = 0;
+    lineError = NULL;
+    consoleMore = NULL;
+    consoleChanged = 0;
+    txHead = txTail = txBusy = 0;
+
+    RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN | RCC_AHB1ENR_DMA1EN;
+    RCC->APB1ENR |= RCC_APB1ENR_USART2EN;
+    (void)RCC->APB1ENR;    // Clock enable takes effect before the first access
+
+    // PA2 / PA3: alternate function 7 (USART2_TX / USART2_RX), RX pulled up
+    GPIOA->MODER   = (GPIOA->MODER & ~(GPIO_MODER_MODER2 | GPIO_MODER_MODER3)) |
+                     GPIO_MODER_MODER2_1 | GPIO_MODER_MODER3_1;
+    GPIOA->OSPEEDR |= GPIO_OSPEEDER_OSPEEDR2;
+    GPIOA->PUPDR   = (GPIOA->PUPDR & ~GPIO_PUPDR_PUPD3) | GPIO_PUPDR_PUPD3_0;
+    GPIOA->AFR[0]  = (GPIOA->AFR[0] & ~(0xFFU << 8)) | (7U << 8) | (7U << 12);
+
+    // Streams must be off before they are programmed
+    USART2->CR1 = 0;
+    DMA1_Stream5->CR = 0;
+    DMA1_Stream6->CR = 0;
+    DMA1->HIFCR = CONSOLE_RX_FLAGS | CONSOLE_TX_FLAGS;
+
+    // RX: peripheral to memory, circular over rxRing
+    DMA1_Stream5->PAR  = (uintptr_t)&USART2->DR;
+    DMA1_Stream5->M0AR = (uintptr_t)rxRing;
+    DMA1_Stream5->NDTR = CONFIG_CONSOLE_RX_BYTES;
+    DMA1_Stream5->CR   = CONSOLE_DMA_CHANNEL | DMA_SxCR_MINC | DMA_SxCR_CIRC |
+                         DMA_SxCR_HTIE | DMA_SxCR_TCIE | DMA_SxCR_EN;
+
+    // TX: memory to peripheral, one chunk at a time (consoleTxKick())
+    DMA1_Stream6->PAR  = (uintptr_t)&USART2->DR;
+    DMA1_Stream6->CR   = CONSOLE_DMA_CHANNEL | DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_TCIE;
+
+    consoleSetBaud();
+    USART2->CR3 = USART_CR3_DMAR | USART_CR3_DMAT;
+    USART2->CR1 = USART_CR1_UE | USART_CR1_TE | USART_CR1_RE | USART_CR1_IDLEIE;
+
+    NVIC_SetPriority(USART2_IRQn, 5);
+    NVIC_SetPriority(DMA1_Stream5_IRQn, 5);
+    NVIC_SetPriority(DMA1_Stream6_IRQn, 5);
+    NVIC_EnableIRQ(USART2_IRQn);
+    NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+    NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+
+    consoleReady = 1;
+}
+
+uint8_t CONSOLE_Poll(void) {
+    uint32_t written = rxWritten;
+    uint32_t read;
+
+    if(!consoleReady) {
+        return 0;
+    }
+    if(consoleMore != NULL) {
+        if(consoleMore()) {
+            return 0;
+        }
+        consoleMore = NULL;
+        consoleReply("OK");
+    }
+
+    if(written - rxRead > CONFIG_CONSOLE_RX_BYTES) {
+        // The DMA went round the ring before the loop got here
+        consoleStats.rxOverruns++;
+        rxRead = written - CONFIG_CONSOLE_RX_BYTES;
+        lineError = "overrun";
+    }
+    read = rxRead;
+
+    while(rxRead != written && consoleMore == NULL) {
+        char c = (char)rxRing[rxRead % CONFIG_CONSOLE_RX_BYTES];
+        rxRead++;
+
+        if(c == '\r' || c == '\n') {
+            line[lineLength] = '\0';
+            if(lineError != NULL) {
+                consoleStats.commands++;
+                consoleReply("ERR %s", lineError);
+            } else if(lineLength > 0U) {
+                consoleExecute();
+            }
+            lineLength = 0;
+            lineError = NULL;
+        } else if(lineLength < CONFIG_CONSOLE_LINE) {
+            line[lineLength++] = c;
+        } else {
+            lineError = "too long";
+        }
+    }
+    consoleStats.rxBytes += rxRead - read;
+    if(consoleChanged) {
+        consoleChanged = 0;
+        return 1;
+    }
+    return 0;
+}
+
+#endif /* CONFIG_CONSOLE */
@@ -0,0 +1,322 @@
+/**
+ * @file    crash.c
+ * @brief   Fault vectors and the post-mortem dump (crash.h)
+ */
+
+#include "crash.h"
+#include "backup.h"
+#include "eventlog.h"
+#include "crc16.h"
+#include "fmt.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CRASH_DUMP  (&BACKUP_SRAM->crash)
+
+static const char *const crashCauseNames[CRASH_CAUSE_COUNT] = {
+    [CRASH_NONE]       = "NONE",
+    [CRASH_HARDFAULT]  = "HARDFAULT",
+    [CRASH_MEMMANAGE]  = "MEMMANAGE",
+    [CRASH_BUSFAULT]   = "BUSFAULT",
+    [CRASH_USAGEFAULT] = "USAGEFAULT",
+    [CRASH_ERROR]      = "ERROR",
+};
+
+/* ================= FAULT VECTORS ================= */
+
+#if defined(__arm__)
+
+// Bounds of the program and of the stack (STM32F446RETX_FLASH.ld)
+extern uint8_t _etext;
+extern uint8_t _estack;
+
+#define CRASH_RAM_START  0x20000000U
+
+// Hand the stacked frame (MSP or PSP, by EXC_RETURN bit 2), EXC_RETURN
+// and the cause to CRASH_Fault() without touching the stack
+#define CRASH_VECTOR(handler, cause)                    \
+    __attribute__((naked)) void handler(void) {         \
+        __asm volatile(                                 \
+            "tst   lr, #4       \n"                     \
+            "ite   eq           \n"                     \
+            "mrseq r0, msp      \n"                     \
+            "mrsne r0, psp      \n"                     \
+            "mov   r1, lr       \n"                     \
+            "movs  r2, %0       \n"                     \
+            "b     CRASH_Fault  \n"                     \
+            : : "i" (cause));                           \
+    }
+
+CRASH_VECTOR(HardFault_Handler,  CRASH_HARDFAULT)
+CRASH_VECTOR(MemManage_Handler,  CRASH_MEMMANAGE)
+CRASH_VECTOR(BusFault_Handler,   CRASH_BUSFAULT)
+CRASH_VECTOR(UsageFault_Handler, CRASH_USAGEFAULT)
+
+static uint8_t crashInRam(uint32_t address, uint32_t bytes) {
+    return address >= CRASH_RAM_START && address <= (uint32_t)&_estack - bytes;
+}
+
+// 'word' is a Thumb address in the program just behind a BL or BLX
+static uint8_t crashIsReturn(uint32_t word) {
+    uint32_t address = word & ~1U;
+    uint16_t last, first;
+
+    if((word & 1U) == 0U || address < FLASH_BASE + 4U || address > (uint32_t)&_etext) {
+        return 0;
+    }
+    last = *(const uint16_t *)(address - 2U);
+    first = *(const uint16_t *)(address - 4U);
+    return (last & 0xFF87U) == 0x4780U ||                               // BLX Rm
+           ((first & 0xF800U) == 0xF000U && (last & 0xD000U) == 0xD000U); // BL
+}
+
+// Return addresses on the stack above 'sp', innermost first
+static void crashBacktrace(CrashDump_t *dump, uint32_t sp) {
+    const uint32_t *word = (const uint32_t *)sp;
+
+    dump->depth = 0;
+    for(uint32_t i = 0; i < CRASH_SCAN_WORDS && crashInRam((uint32_t)word, 4U) &&
+                        dump->depth < CRASH_BACKTRACE; i++, word++) {
+        if(crashIsReturn(*word)) {
+            dump->backtrace[dump->depth++] = *word;
+        }
+    }
+}
+
+#endif /* __arm__ */
+
+/* ================= DUMP ================= */
+
+static uint16_t crashCrc(const CrashDump_t *dump) {
+    return CRC16_Update(CRC16_INIT, dump, offsetof(CrashDump_t, crc));
+}
+
+const CrashDump_t *CRASH_Get(void) {
+    const CrashDump_t *dump = CRASH_DUMP;
+
+    if(dump->magic != CRASH_MAGIC || dump->cause == CRASH_NONE ||
+       dump->cause >= CRASH_CAUSE_COUNT || dump->crc != crashCrc(dump)) {
+        return NULL;
+    }
+    return dump;
+}
+
+// Interrupts off, backup SRAM writable, and a blank dump that counts
+// on from the previous one
+static CrashDump_t *crashBegin(CrashCause_t cause) {
+    CrashDump_t *dump = CRASH_DUMP;
+    const CrashDump_t *previous;
+    uint16_t count;
+
+    __disable_irq();
+    BACKUP_Access();
+
+    previous = CRASH_Get();
+    count = (uint16_t)((previous != NULL ? previous->count : 0U) + 1U);
+    memset(dump, 0, offsetof(CrashDump_t, crc));
+    dump->count = count;
+    dump->cause = (uint8_t)cause;
+    return dump;
+}
+
+#if CONFIG_TRACE
+// Clock of record 'first' of the ring: the last TRACE_CLOCK (sysclk.h)
+// still in the ring before it, else the one tracing started at
+static uint32_t crashTraceHz(uint32_t first) {
+    uint32_t oldest = (traceBuffer.head > CONFIG_TRACE_RECORDS) ? traceBuffer.head - CONFIG_TRACE_RECORDS : 0U;
+
+    for(uint32_t i = first; i > oldest; i--) {
+        const TraceRecord_t *r = &traceBuffer.ring[(i - 1U) & (CONFIG_TRACE_RECORDS - 1U)];
+
+        if(r->id == TRACE_CLOCK && r->arg != 0U) {
+            return r->arg * 1000000U;
+        }
+    }
+    return traceBuffer.cpuHz;
+}
+#endif
+
+// Everything but the registers, which the caller has filled in
+static __attribute__((noreturn)) void crashStore(CrashDump_t *dump) {
+    dump->cfsr = SCB->CFSR;
+    dump->hfsr = SCB->HFSR;
+    dump->mmfar = SCB->MMFAR;
+    dump->bfar = SCB->BFAR;
+    dump->rtcTime = RTC->TR;
+    dump->rtcDate = RTC->DR;    // Reading TR locks DR until it is read
+
+    dump->traceCount = 0;
+    dump->cpuHz = SystemCoreClock;
+#if CONFIG_TRACE
+    if(traceBuffer.magic == TRACE_MAGIC) {
+        uint32_t head = traceBuffer.head;
+        uint32_t count = (head < CRASH_TRACE_RECORDS) ? head : CRASH_TRACE_RECORDS;
+
+        for(uint32_t i = 0; i < count; i++) {
+            dump->trace[i] = traceBuffer.ring[(head - count + i) & (CONFIG_TRACE_RECORDS - 1U)];
+        }
+        dump->traceCount = (uint8_t)count;
+        dump->cpuHz = crashTraceHz(head - count);
+    }
+#endif
+    dump->magic = CRASH_MAGIC;
+    dump->crc = crashCrc(dump);
+
+    NVIC_SystemReset();
+}
+
+void CRASH_Fault(const uint32_t *frame, uint32_t excReturn, CrashCause_t cause) {
+    CrashDump_t *dump = crashBegin(cause);
+
+    dump->excReturn = excReturn;
+    dump->sp = (uint32_t)(uintptr_t)frame;
+#if defined(__arm__)
+    if(crashInRam(dump->sp, 32U)) {
+        dump->r0 = frame[0];
+        dump->r1 = frame[1];
+        dump->r2 = frame[2];
+        dump->r3 = frame[3];
+        dump->r12 = frame[4];
+        dump->lr = frame[5];
+        dump->pc = frame[6];
+        dump->xpsr = frame[7];
+        // Caller's SP: past the basic or the extended (FPU) frame and
+        // the alignment word (xPSR bit 9)
+        dump->sp += ((excReturn & 0x10U) ? 32U : 104U) + ((dump->xpsr & 0x200U) ? 4U : 0U);
+        crashBacktrace(dump, dump->sp);
+    }
+#endif
+    crashStore(dump);
+}
+
+void CRASH_Error(uint32_t caller) {
+    CrashDump_t *dump = crashBegin(CRASH_ERROR);
+
+    dump->pc = caller;
+#if defined(__arm__)
+    dump->sp = __get_MSP();
+    crashBacktrace(dump, dump->sp);
+#endif
+    crashStore(dump);
+}
+
+void CRASH_Clear(void) {
+    CRASH_DUMP->magic = 0;
+}
+
+const char *CRASH_CauseName(CrashCause_t cause) {
+    return (cause < CRASH_CAUSE_COUNT) ? crashCauseNames[cause] : "?";
+}
+
+/* ================= REPORT ================= */
+
+// "YYYY-MM-DDThh:mm:ss" from the RTC registers
+static char *crashFormatRtc(char *out, uint32_t tr, uint32_t dr) {
+    out = FMT_Str(out, "20");
+    out = FMT_Bcd2(out, (uint8_t)(dr >> 16));
+    *out++ = '-';
+    out = FMT_Bcd2(out, (uint8_t)((dr >> 8) & 0x1FU));
+    *out++ = '-';
+    out = FMT_Bcd2(out, (uint8_t)(dr & 0x3FU));
+    *out++ = 'T';
+    out = FMT_BcdTime(out, tr & 0x3F7F7FU);
+    *out = '\0';
+    return out;
+}
+
+uint8_t CRASH_Line(uint16_t index, char *out, size_t size) {
+    const CrashDump_t *dump = CRASH_Get();
+    char when[20];
+
+    if(dump == NULL) {
+        return 0;
+    }
+
+    switch(index) {
+    case 0:
+        crashFormatRtc(when, dump->rtcTime, dump->rtcDate);
+        FMT_Format(out, size, "CRASH,%s,%u,%s", CRASH_CauseName((CrashCause_t)dump->cause),
+                   (unsigned)dump->count, when);
+        return 1;
+    case 1:
+        FMT_Format(out, size, "CRASH_R,%08lX,%08lX,%08lX,%08lX,%08lX",
+                   (unsigned long)dump->r0, (unsigned long)dump->r1, (unsigned long)dump->r2,
+                   (unsigned long)dump->r3, (unsigned long)dump->r12);
+        return 1;
+    case 2:
+        FMT_Format(out, size, "CRASH_PC,%08lX,%08lX,%08lX,%08lX,%08lX",
+                   (unsigned long)dump->pc, (unsigned long)dump->lr, (unsigned long)dump->xpsr,
+                   (unsigned long)dump->sp, (unsigned long)dump->excReturn);
+        return 1;
+    case 3:
+        FMT_Format(out, size, "CRASH_FSR,%08lX,%08lX,%08lX,%08lX",
+                   (unsigned long)dump->cfsr, (unsigned long)dump->hfsr,
+                   (unsigned long)dump->mmfar, (unsigned long)dump->bfar);
+        return 1;
+    default:
+        break;
+    }
+
+    index -= 4U;
+    if(index < dump->depth) {
+        FMT_Format(out, size, "CRASH_BT,%08lX", (unsigned long)dump->backtrace[index]);
+        return 1;
+    }
+    index -= dump->depth;
+
+    // Same records as TRACE_Dump(), so trace_decode reads them too
+    if(dump->traceCount > 0U) {
+        if(index == 0U) {
+            FMT_Format(out, size, "TRACE,%lu,%u,%u", (unsigned long)dump->cpuHz,
+                       (unsigned)dump->traceCount, (unsigned)dump->traceCount);
+            return 1;
+        }
+        if(index <= dump->traceCount) {
+            const TraceRecord_t *r = &dump->trace[index - 1U];
+
+            FMT_Format(out, size, "T,%lu,%u,%u", (unsigned long)r->cycles,
+                       (unsigned)r->id, (unsigned)r->arg);
+            return 1;
+        }
+        if(index == dump->traceCount + 1U) {
+            FMT_Format(out, size, "TRACE_END");
+            return 1;
+        }
+        index -= dump->traceCount + 2U;
+    }
+
+    if(index == 0U) {
+        FMT_Format(out, size, "CRASH_END");
+        return 1;
+    }
+    return 0;
+}
+
+void CRASH_Init(void) {
+    CrashDump_t *dump = (CrashDump_t *)CRASH_Get();
+    char line[CRASH_LINE_MAX];
+
+    // Precise causes instead of a HardFault for everything
+    SCB->SHCSR |= SCB_SHCSR_MEMFAULTENA_Msk | SCB_SHCSR_BUSFAULTENA_Msk |
+                  SCB_SHCSR_USGFAULTENA_Msk;
+
+    if(dump == NULL || dump->reported) {
+        return;
+    }
+
+    for(uint16_t i = 0; CRASH_Line(i, line, sizeof(line)); i++) {
+        printf("%s\n", line);
+    }
+    fflush(stdout);
+
+#if CONFIG_EVENT_LOG
+    {
+        uint32_t data[3] = { dump->cause, dump->pc, dump->cfsr };
+
+        EVLOG_Record(EVLOG_CRASH, data, 3);
+    }
+#endif
+
+    dump->reported = 1;
+    dump->crc = crashCrc(dump);
+}
@@ -0,0 +1,21 @@
+/**
+ * @file    crc16.c
+ * @brief   CRC-16/CCITT-FALSE, nibble table
+ */
+
+#include "crc16.h"
+
+static const uint16_t crcNibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+uint16_t CRC16_Update(uint16_t crc, const void *data, uint32_t length) {
+    const uint8_t *p = data;
+
+    for(uint32_t i = 0; i < length; i++) {
+        crc = (uint16_t)((crc << 4) ^ crcNibble[(crc >> 12) ^ (p[i] >> 4)]);
+        crc = (uint16_t)((crc << 4) ^ crcNibble[(crc >> 12) ^ (p[i] & 0x0FU)]);
+    }
+    return crc;
+}
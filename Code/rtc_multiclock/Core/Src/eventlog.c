@@ -0,0 +1,479 @@
+/**
+ * @file    eventlog.c
+ * @brief   Append-only event log in flash sectors 6 and 7
+ *
+ * See eventlog.h for the layout, the time index and the power-loss
+ * rules. Flash is read directly, words are programmed with the FLASH
+ * HAL (x32, VDD 2.7 .. 3.6 V), as in kvstore.c.
+ */
+
+#include "app_config.h"
+
+#if CONFIG_EVENT_LOG
+
+#include "eventlog.h"
+#include "calendar.h"
+#include "backup.h"
+#include "crc16.h"
+#include <stddef.h>
+#include <string.h>
+
+#define EVLOG_OFFSET         0x40000U       // Sector 6, from FLASH_BASE
+#define EVLOG_SECTOR_BLOCKS  (EVLOG_BLOCKS / 2U)
+#define EVLOG_MAGIC          0x31475645U    // "EVG1"
+#define EVLOG_ERASED         0xFFFFFFFFU
+#define EVLOG_TAIL_MAGIC     0x4C494154U    // "TAIL"
+
+#define EVLOG_PENDING        (1UL << 8)     // Cleared once the data is complete
+#define EVLOG_DELTA_SHIFT    9U
+
+#define EVLOG_RECORD_BYTES(words)  (4U + 4U * (uint32_t)(words))
+
+typedef struct {
+    uint32_t magic;
+    uint32_t number;      // Block number since the log was created
+    uint32_t start;       // Time of the first record
+    uint32_t check;       // ~(number ^ start)
+} EvlogBlock_t;
+
+#define EVLOG_HEADER_BYTES   ((uint32_t)sizeof(EvlogBlock_t))
+
+_Static_assert(EVLOG_BLOCKS * EVLOG_BLOCK_BYTES == 2U * 0x20000U, "sectors 6 and 7");
+_Static_assert(EVLOG_TYPE_COUNT < 0x3FU, "type 0x3F would make an erased record word");
+
+extern RTC_HandleTypeDef hrtc;
+
+static const char *const evlogNames[EVLOG_TYPE_COUNT] = {
+    [EVLOG_RESET]           = "RESET",
+    [EVLOG_TIME_SET]        = "TIME_SET",
+    [EVLOG_STOPWATCH_START] = "SW_START",
+    [EVLOG_STOPWATCH_STOP]  = "SW_STOP",
+    [EVLOG_ALARM]           = "ALARM",
+    [EVLOG_CRASH]           = "CRASH",
+    [EVLOG_POWER_FAIL]      = "POWER_FAIL",
+};
+
+// Start time of each block in the log by slot; a block with a torn
+// header takes the start of the next one, so the index stays sorted
+static uint32_t evlogStart[EVLOG_BLOCKS];
+static uint32_t evlogOldest;         // Block numbers
+static uint32_t evlogNewest;
+static uint8_t  evlogEmpty;          // No block written yet
+static uint32_t evlogWritePos;       // Next free offset in the newest block
+static uint32_t evlogLastTime;       // Stamp of the newest record
+static uint32_t evlogRecords;
+static uint8_t  evlogRecovered;
+
+// Record EVLOG_RecordAt() is writing, for EVLOG_PowerFail()
+static EvlogEvent_t     evlogWriting;
+static volatile uint8_t evlogInFlight;
+
+/* ================= FLASH ACCESS ================= */
+
+static uintptr_t evlogAddress(uint32_t slot, uint32_t offset) {
+    return FLASH_BASE + EVLOG_OFFSET + slot * EVLOG_BLOCK_BYTES + offset;
+}
+
+static uint32_t evlogWord(uint32_t slot, uint32_t offset) {
+    return *(const uint32_t *)evlogAddress(slot, offset);
+}
+
+static const EvlogBlock_t *evlogHeader(uint32_t slot) {
+    return (const EvlogBlock_t *)evlogAddress(slot, 0);
+}
+
+static HAL_StatusTypeDef evlogProgram(uint32_t slot, uint32_t offset, uint32_t word) {
+    return HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, evlogAddress(slot, offset), word);
+}
+
+static uint8_t evlogBlank(uint32_t slot, uint32_t offset, uint32_t end) {
+    for(; offset < end; offset += 4U) {
+        if(evlogWord(slot, offset) != EVLOG_ERASED) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static uint8_t evlogBlockValid(uint32_t slot) {
+    const EvlogBlock_t *header = evlogHeader(slot);
+
+    return header->magic == EVLOG_MAGIC && header->number % EVLOG_BLOCKS == slot &&
+           header->check == ~(header->number ^ header->start);
+}
+
+/* ================= RECORDS ================= */
+
+// Bytes taken by the complete record whose first word is 'word' at
+// 'offset' of a block, or 0 if it is pending or damaged
+static uint32_t evlogRecordBytes(uint32_t word, uint32_t offset) {
+    uint32_t type = word & 0x3FU;
+    uint32_t bytes = EVLOG_RECORD_BYTES((word >> 6) & 0x03U);
+
+    if((word & EVLOG_PENDING) || type == 0U || type >= EVLOG_TYPE_COUNT ||
+       offset + bytes > EVLOG_BLOCK_BYTES) {
+        return 0;
+    }
+    return bytes;
+}
+
+// First word with the pending bit, data, then the pending bit cleared
+static HAL_StatusTypeDef evlogWriteRecord(uint32_t slot, uint32_t offset, uint32_t word,
+                                          const uint32_t *data, uint8_t words) {
+    if(evlogProgram(slot, offset, word | EVLOG_PENDING) != HAL_OK) {
+        return HAL_ERROR;
+    }
+    for(uint8_t i = 0; i < words; i++) {
+        if(evlogProgram(slot, offset + 4U + 4U * i, data[i]) != HAL_OK) {
+            return HAL_ERROR;
+        }
+    }
+    return evlogProgram(slot, offset, word);
+}
+
+/* ================= BLOCKS ================= */
+
+static HAL_StatusTypeDef evlogEraseSector(uint32_t slot) {
+    FLASH_EraseInitTypeDef erase = {0};
+    uint32_t sectorError;
+
+    erase.TypeErase = FLASH_TYPEERASE_SECTORS;
+    erase.Sector = (slot < EVLOG_SECTOR_BLOCKS) ? FLASH_SECTOR_6 : FLASH_SECTOR_7;
+    erase.NbSectors = 1;
+    erase.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+    return HAL_FLASHEx_Erase(&erase, &sectorError);
+}
+
+// Start the block after the newest one at 'time'. Slots holding a torn
+// block are skipped; entering a sector erases it unless it is blank.
+static HAL_StatusTypeDef evlogOpen(uint32_t time) {
+    uint32_t number = evlogEmpty ? 0U : evlogNewest + 1U;
+    uint32_t slot;
+
+    for(;;) {
+        slot = number % EVLOG_BLOCKS;
+        if(slot % EVLOG_SECTOR_BLOCKS == 0U && !evlogBlank(slot, 0, EVLOG_SECTOR_BLOCKS * EVLOG_BLOCK_BYTES)) {
+            if(evlogEraseSector(slot) != HAL_OK) {
+                return HAL_ERROR;
+            }
+            // The blocks of the previous round in this sector are gone
+            if(!evlogEmpty && number >= EVLOG_BLOCKS &&
+               evlogOldest < number - EVLOG_BLOCKS + EVLOG_SECTOR_BLOCKS) {
+                evlogOldest = number - EVLOG_BLOCKS + EVLOG_SECTOR_BLOCKS;
+            }
+        }
+        evlogStart[slot] = time;
+        if(evlogBlank(slot, 0, EVLOG_BLOCK_BYTES)) {
+            break;
+        }
+        number++;    // Torn, written before the last erase of its sector
+    }
+
+    // Taken even if the header fails: the slot is no longer blank
+    if(evlogEmpty) {
+        evlogOldest = number;
+        evlogEmpty = 0;
+    }
+    evlogNewest = number;
+    evlogWritePos = EVLOG_BLOCK_BYTES;
+    if(evlogProgram(slot, offsetof(EvlogBlock_t, magic), EVLOG_MAGIC) != HAL_OK ||
+       evlogProgram(slot, offsetof(EvlogBlock_t, number), number) != HAL_OK ||
+       evlogProgram(slot, offsetof(EvlogBlock_t, start), time) != HAL_OK ||
+       evlogProgram(slot, offsetof(EvlogBlock_t, check), ~(number ^ time)) != HAL_OK) {
+        return HAL_ERROR;
+    }
+    evlogWritePos = EVLOG_HEADER_BYTES;
+    evlogLastTime = time;
+    return HAL_OK;
+}
+
+// Find the end of the newest block and the stamp of its last record
+static void evlogScanTail(void) {
+    uint32_t slot = evlogNewest % EVLOG_BLOCKS;
+    uint32_t offset = EVLOG_HEADER_BYTES;
+    uint32_t time = evlogHeader(slot)->start;
+
+    while(offset < EVLOG_BLOCK_BYTES) {
+        uint32_t word = evlogWord(slot, offset);
+        uint32_t bytes = evlogRecordBytes(word, offset);
+
+        if(bytes == 0U) {
+            break;
+        }
+        time += word >> EVLOG_DELTA_SHIFT;
+        offset += bytes;
+    }
+
+    // Anything programmed past the last good record is a write that was
+    // cut short; the next record starts a new block
+    evlogWritePos = offset;
+    evlogLastTime = time;
+    evlogRecovered = !evlogBlank(slot, offset, EVLOG_BLOCK_BYTES);
+    if(evlogRecovered) {
+        evlogWritePos = EVLOG_BLOCK_BYTES;
+    }
+}
+
+// Read the block headers into the index
+static void evlogIndex(void) {
+    uint8_t found = 0;
+
+    evlogEmpty = 1;
+    evlogOldest = evlogNewest = 0;
+    evlogWritePos = EVLOG_BLOCK_BYTES;
+    evlogLastTime = 0;
+    evlogRecords = 0;
+    evlogRecovered = 0;
+
+    for(uint32_t slot = 0; slot < EVLOG_BLOCKS; slot++) {
+        uint32_t number = evlogHeader(slot)->number;
+
+        if(!evlogBlockValid(slot)) {
+            continue;
+        }
+        if(!found || number < evlogOldest) {
+            evlogOldest = number;
+        }
+        if(!found || number > evlogNewest) {
+            evlogNewest = number;
+        }
+        found = 1;
+    }
+    if(!found) {
+        return;    // Created by the first record
+    }
+
+    // Newest to oldest, so a torn block takes the start of the next one
+    evlogEmpty = 0;
+    for(uint32_t number = evlogNewest + 1U; number-- > evlogOldest;) {
+        uint32_t slot = number % EVLOG_BLOCKS;
+
+        if(evlogBlockValid(slot) && evlogHeader(slot)->number == number) {
+            evlogStart[slot] = evlogHeader(slot)->start;
+        } else {
+            evlogStart[slot] = evlogStart[(number + 1U) % EVLOG_BLOCKS];
+        }
+    }
+    evlogScanTail();
+}
+
+/* ================= POWER FAILURE ================= */
+
+// Of the fields between the magic and the CRC
+static uint16_t evlogTailCrc(const EvlogTail_t *tail) {
+    return CRC16_Update(CRC16_INIT, &tail->count,
+                        offsetof(EvlogTail_t, crc) - offsetof(EvlogTail_t, count));
+}
+
+// 'event' is in the log already (written before the supply failed)
+static uint8_t evlogContains(const EvlogEvent_t *event) {
+    EvlogCursor_t cursor;
+    EvlogEvent_t found;
+
+    EVLOG_Seek(&cursor, event->time);
+    while(EVLOG_Next(&cursor, &found) && found.time == event->time) {
+        if(found.type == event->type && found.words == event->words &&
+           memcmp(found.data, event->data, 4U * found.words) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Append what EVLOG_PowerFail() staged and drop the stage
+static void evlogReplayTail(void) {
+    EvlogTail_t *tail = &BACKUP_SRAM->evlog;
+
+    if(tail->magic != EVLOG_TAIL_MAGIC) {
+        return;
+    }
+    if(tail->count <= 2U && tail->crc == evlogTailCrc(tail)) {
+        for(uint32_t i = 0; i < tail->count; i++) {
+            const EvlogEvent_t *event = &tail->event[i];
+
+            if(!evlogContains(event)) {
+                EVLOG_RecordAt(event->time, event->type, event->data, event->words);
+            }
+        }
+    }
+    tail->magic = 0;
+}
+
+// Each field is a plain store; the magic goes last
+void EVLOG_PowerFail(void) {
+    EvlogTail_t *tail = &BACKUP_SRAM->evlog;
+    EvlogEvent_t *event = &tail->event[0];
+    uint32_t now = EVLOG_Now();
+
+    tail->magic = 0;
+    if(evlogInFlight) {
+        *event++ = evlogWriting;
+    }
+    event->time = (now < evlogLastTime) ? evlogLastTime : now;
+    event->type = EVLOG_POWER_FAIL;
+    event->words = 0;
+    tail->count = (uint32_t)(event - tail->event) + 1U;
+    tail->crc = evlogTailCrc(tail);
+    tail->magic = EVLOG_TAIL_MAGIC;
+}
+
+/* ================= API ================= */
+
+void EVLOG_Init(void) {
+    evlogIndex();
+    evlogReplayTail();
+}
+
+uint32_t EVLOG_Now(void) {
+    RTC_TimeTypeDef time;
+    RTC_DateTypeDef date;
+    uint32_t ahead;
+
+    HAL_RTC_GetTime(&hrtc, &time, RTC_FORMAT_BIN);
+    HAL_RTC_GetDate(&hrtc, &date, RTC_FORMAT_BIN); // Unlocks the shadow registers
+    (void)CAL_SubSecondMs(time.SubSeconds, time.SecondFraction, &ahead);
+    return CAL_DaysSince2000(date.Year, date.Month, date.Date) * 86400UL +
+           (time.Hours * 60UL + time.Minutes) * 60UL + time.Seconds - ahead;
+}
+
+HAL_StatusTypeDef EVLOG_RecordAt(uint32_t time, EvlogType_t type,
+                                 const uint32_t *data, uint8_t words) {
+    HAL_StatusTypeDef status = HAL_OK;
+    uint32_t slot;
+
+    if(type == 0 || type >= EVLOG_TYPE_COUNT || words > EVLOG_MAX_WORDS) {
+        return HAL_ERROR;
+    }
+    if(time < evlogLastTime) {
+        time = evlogLastTime;    // Clock set back: keep the log in order
+    }
+
+    evlogWriting.time = time;
+    evlogWriting.type = type;
+    evlogWriting.words = words;
+    for(uint8_t i = 0; i < words; i++) {
+        evlogWriting.data[i] = data[i];
+    }
+    evlogInFlight = 1;
+
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR |
+                           FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR);
+    if(evlogEmpty || evlogWritePos + EVLOG_RECORD_BYTES(words) > EVLOG_BLOCK_BYTES ||
+       time - evlogLastTime > EVLOG_MAX_DELTA) {
+        status = evlogOpen(time);
+    }
+    if(status == HAL_OK) {
+        slot = evlogNewest % EVLOG_BLOCKS;
+        status = evlogWriteRecord(slot, evlogWritePos,
+                                  (uint32_t)type | ((uint32_t)words << 6) |
+                                  ((time - evlogLastTime) << EVLOG_DELTA_SHIFT),
+                                  data, words);
+        if(status == HAL_OK) {
+            evlogWritePos += EVLOG_RECORD_BYTES(words);
+            evlogLastTime = time;
+            evlogRecords++;
+        } else {
+            evlogWritePos = EVLOG_BLOCK_BYTES;    // Nothing goes after a torn record
+        }
+    }
+    HAL_FLASH_Lock();
+    evlogInFlight = 0;
+    return status;
+}
+
+HAL_StatusTypeDef EVLOG_Record(EvlogType_t type, const uint32_t *data, uint8_t words) {
+    return EVLOG_RecordAt(EVLOG_Now(), type, data, words);
+}
+
+HAL_StatusTypeDef EVLOG_TimeChanged(uint32_t before) {
+    uint32_t now = EVLOG_Now();
+
+    return EVLOG_RecordAt(before, EVLOG_TIME_SET, &now, 1);
+}
+
+// The start time is read with the first record: the block may not
+// have been written yet
+static void evlogEnter(EvlogCursor_t *cursor, uint32_t number) {
+    cursor->block = number;
+    cursor->offset = EVLOG_HEADER_BYTES;
+}
+
+// Events at or after 'from' can only be in the block before the first
+// one that starts at or after it (the previous block's last record
+// may share its start time), or in the newest one
+void EVLOG_Seek(EvlogCursor_t *cursor, uint32_t from) {
+    uint32_t low = evlogOldest;
+    uint32_t high = evlogNewest + 1U;
+
+    while(low < high) {
+        uint32_t middle = low + (high - low) / 2U;
+
+        if(evlogStart[middle % EVLOG_BLOCKS] >= from) {
+            high = middle;
+        } else {
+            low = middle + 1U;
+        }
+    }
+    if(low > evlogOldest) {
+        low--;
+    }
+    evlogEnter(cursor, low);
+    cursor->from = from;
+}
+
+uint8_t EVLOG_Next(EvlogCursor_t *cursor, EvlogEvent_t *event) {
+    while(!evlogEmpty) {
+        uint32_t slot = cursor->block % EVLOG_BLOCKS;
+        uint32_t word, bytes;
+
+        if(cursor->block < evlogOldest) {
+            evlogEnter(cursor, evlogOldest);    // Erased while reading
+            continue;
+        }
+        if(cursor->block > evlogNewest) {
+            return 0;
+        }
+        word = (cursor->offset < EVLOG_BLOCK_BYTES) ? evlogWord(slot, cursor->offset) : EVLOG_ERASED;
+        bytes = evlogRecordBytes(word, cursor->offset);
+        if(!evlogBlockValid(slot) || evlogHeader(slot)->number != cursor->block ||
+           word == EVLOG_ERASED || bytes == 0U) {
+            if(cursor->block == evlogNewest) {
+                return 0;    // Later records will continue from here
+            }
+            evlogEnter(cursor, cursor->block + 1U);
+            continue;
+        }
+
+        if(cursor->offset == EVLOG_HEADER_BYTES) {
+            cursor->time = evlogHeader(slot)->start;
+        }
+        cursor->time += word >> EVLOG_DELTA_SHIFT;
+        event->time = cursor->time;
+        event->type = (EvlogType_t)(word & 0x3FU);
+        event->words = (uint8_t)((word >> 6) & 0x03U);
+        for(uint8_t i = 0; i < event->words; i++) {
+            event->data[i] = evlogWord(slot, cursor->offset + 4U + 4U * i);
+        }
+        cursor->offset += bytes;
+        if(event->time >= cursor->from) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char *EVLOG_TypeName(EvlogType_t type) {
+    return (type > 0 && type < EVLOG_TYPE_COUNT) ? evlogNames[type] : "?";
+}
+
+void EVLOG_GetStats(EvlogStats_t *stats) {
+    stats->oldest = evlogOldest;
+    stats->newest = evlogNewest;
+    stats->records = evlogRecords;
+    stats->last = evlogLastTime;
+    stats->used = (uint16_t)(evlogEmpty ? 0U : evlogWritePos);
+    stats->recovered = evlogRecovered;
+}
+
+#endif /* CONFIG_EVENT_LOG */
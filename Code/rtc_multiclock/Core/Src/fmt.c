@@ -0,0 +1,310 @@
+/**
+ * @file    fmt.c
+ * @brief   Table-driven field writers and a small format-spec parser
+ */
+
+#include "fmt.h"
+#include <string.h>
+
+// SIMD kernel for FMT_BcdTime(); the host test also forces it on
+// with the intrinsics emulated by the simulated HAL
+#ifndef FMT_DSP
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#define FMT_DSP  1
+#else
+#define FMT_DSP  0
+#endif
+#endif
+
+#if FMT_DSP
+#include "main.h"   // CMSIS: __UADD8, __USUB8, __SEL, __UXTB16
+#endif
+
+#define FMT_ROW(tens) \
+    { tens, '0' }, { tens, '1' }, { tens, '2' }, { tens, '3' }, { tens, '4' }, \
+    { tens, '5' }, { tens, '6' }, { tens, '7' }, { tens, '8' }, { tens, '9' }
+
+const char fmtDigits2[100][2] = {
+    FMT_ROW('0'), FMT_ROW('1'), FMT_ROW('2'), FMT_ROW('3'), FMT_ROW('4'),
+    FMT_ROW('5'), FMT_ROW('6'), FMT_ROW('7'), FMT_ROW('8'), FMT_ROW('9'),
+};
+
+static const char hexLower[16] = "0123456789abcdef";
+static const char hexUpper[16] = "0123456789ABCDEF";
+
+/* ================== FIELD WRITERS ================== */
+
+char *FMT_Dec2(char *out, uint32_t value) {
+    const char *d = fmtDigits2[value % 100U];
+
+    out[0] = d[0];
+    out[1] = d[1];
+    return out + 2;
+}
+
+char *FMT_Dec3(char *out, uint32_t value) {
+    value %= 1000U;
+    out[0] = (char)('0' + value / 100U);
+    return FMT_Dec2(out + 1, value % 100U);
+}
+
+char *FMT_Dec4(char *out, uint32_t value) {
+    value %= 10000U;
+    out = FMT_Dec2(out, value / 100U);
+    return FMT_Dec2(out, value % 100U);
+}
+
+char *FMT_Bcd2(char *out, uint8_t bcd) {
+    out[0] = (char)('0' + (bcd >> 4));
+    out[1] = (char)('0' + (bcd & 0x0FU));
+    return out + 2;
+}
+
+/**
+ * @brief Six BCD digits to "HH:MM:SS" in two word stores
+ *
+ * tens and units hold one digit per byte (seconds in byte 0), e.g.
+ * 12:34:56 gives tens = 0x00010305 and units = 0x00020406. Both are
+ * made ASCII in parallel, then interleaved per byte:
+ *
+ *   pair02 = S1 S0 H1 H0     (bytes 0 and 2 of tens / units)
+ *   pair1  = M1 M0 0  0      (byte 1)
+ *
+ * and stored as H1 H0 ':' M1 | M0 ':' S1 S0 (little-endian words).
+ */
+char *FMT_BcdTime(char *out, uint32_t bcd) {
+    uint32_t tens, units, pair02, pair1, word;
+
+    bcd &= 0x003F7F7FU;                     // Drop the PM bit and reserved bits
+    tens = (bcd >> 4) & 0x000F0F0FU;
+    units = bcd & 0x000F0F0FU;
+
+#if FMT_DSP
+    {
+        uint32_t ascii;
+
+        // GE is set for every byte >= 10; __SEL picks '?' there
+        ascii = __UADD8(tens, 0x30303030U);
+        (void)__USUB8(tens, 0x0A0A0A0AU);
+        tens = __SEL(0x3F3F3F3FU, ascii);
+
+        ascii = __UADD8(units, 0x30303030U);
+        (void)__USUB8(units, 0x0A0A0A0AU);
+        units = __SEL(0x3F3F3F3FU, ascii);
+    }
+    pair02 = __UXTB16(tens) | (__UXTB16(units) << 8);
+    pair1 = __UXTB16(tens >> 8) | (__UXTB16(units >> 8) << 8);
+#else
+    {
+        // Bytes are at most 15, so 0x76 + byte carries into bit 7 exactly for 10..15
+        uint32_t badTens = (((tens + 0x76767676U) & 0x80808080U) >> 7) * 0xFFU;
+        uint32_t badUnits = (((units + 0x76767676U) & 0x80808080U) >> 7) * 0xFFU;
+
+        tens = ((tens + 0x30303030U) & ~badTens) | (0x3F3F3F3FU & badTens);
+        units = ((units + 0x30303030U) & ~badUnits) | (0x3F3F3F3FU & badUnits);
+    }
+    pair02 = (tens & 0x00FF00FFU) | ((units & 0x00FF00FFU) << 8);
+    pair1 = ((tens >> 8) & 0x00FF00FFU) | (((units >> 8) & 0x00FF00FFU) << 8);
+#endif
+
+    // memcpy of 4 bytes is a single (unaligned) store on the M4
+    word = (pair02 >> 16) | ((uint32_t)':' << 16) | (pair1 << 24);
+    memcpy(out, &word, 4);
+    word = ((pair1 >> 8) & 0xFFU) | ((uint32_t)':' << 8) | (pair02 << 16);
+    memcpy(out + 4, &word, 4);
+    return out + 8;
+}
+
+char *FMT_Uint(char *out, uint32_t value, uint8_t width, char pad) {
+    char digits[10];
+    char *p = digits + sizeof(digits);
+    uint8_t count;
+
+    // Two digits per step from the right
+    while(value >= 100U) {
+        uint32_t q = value / 100U;
+        const char *d = fmtDigits2[value - q * 100U];
+        *--p = d[1];
+        *--p = d[0];
+        value = q;
+    }
+    if(value >= 10U) {
+        *--p = fmtDigits2[value][1];
+        *--p = fmtDigits2[value][0];
+    } else {
+        *--p = (char)('0' + value);
+    }
+
+    count = (uint8_t)(digits + sizeof(digits) - p);
+    while(width > count) {
+        *out++ = pad;
+        width--;
+    }
+    while(p < digits + sizeof(digits)) {
+        *out++ = *p++;
+    }
+    return out;
+}
+
+char *FMT_Str(char *out, const char *s) {
+    while(*s != '\0') {
+        *out++ = *s++;
+    }
+    return out;
+}
+
+/* ================== FORMAT SPEC PARSER ================== */
+
+typedef struct {
+    char *p;
+    char *end;      // Last usable byte, kept for the NUL
+    size_t length;  // Characters produced, stored or not
+} FmtOut_t;
+
+static void put(FmtOut_t *o, char c) {
+    if(o->p < o->end) {
+        *o->p++ = c;
+    }
+    o->length++;
+}
+
+static void putPadded(FmtOut_t *o, const char *text, uint8_t length,
+                      uint8_t width, char pad, char sign) {
+    uint8_t total = (uint8_t)(length + (sign ? 1U : 0U));
+
+    // Like printf: the sign goes before zero padding, after spaces
+    if(sign && pad == '0') {
+        put(o, sign);
+    }
+    while(width > total) {
+        put(o, pad);
+        width--;
+    }
+    if(sign && pad != '0') {
+        put(o, sign);
+    }
+    for(uint8_t i = 0; i < length; i++) {
+        put(o, text[i]);
+    }
+}
+
+static uint8_t hexDigits(char *out, uint32_t value, const char *table) {
+    char digits[8];
+    uint8_t n = 0;
+
+    do {
+        digits[n++] = table[value & 0x0FU];
+        value >>= 4;
+    } while(value != 0U);
+
+    for(uint8_t i = 0; i < n; i++) {
+        out[i] = digits[n - 1U - i];
+    }
+    return n;
+}
+
+// %lu takes an unsigned long, which is wider than 32 bits on a PC
+static uint32_t argUnsigned(va_list *args, uint8_t isLong) {
+    return isLong ? (uint32_t)va_arg(*args, unsigned long) : va_arg(*args, unsigned int);
+}
+
+int FMT_VFormat(char *out, size_t size, const char *format, va_list argList) {
+    FmtOut_t o;
+    va_list args;
+
+    // A local copy so that argUnsigned() can take its address
+    va_copy(args, argList);
+    o.p = out;
+    o.end = (size != 0U) ? out + size - 1U : out;
+    o.length = 0;
+
+    while(*format != '\0') {
+        char text[11];
+        uint8_t length;
+        uint8_t width = 0;
+        char pad = ' ';
+        char sign = 0;
+        uint8_t isLong = 0;
+
+        if(*format != '%') {
+            put(&o, *format++);
+            continue;
+        }
+        format++;
+
+        if(*format == '0') {
+            pad = '0';
+            format++;
+        }
+        while(*format >= '0' && *format <= '9') {
+            width = (uint8_t)(width * 10U + (uint8_t)(*format++ - '0'));
+        }
+        if(*format == 'l') {
+            isLong = 1;
+            format++;
+        }
+
+        switch(*format) {
+        case 'd': {
+            int32_t v = isLong ? (int32_t)va_arg(args, long) : va_arg(args, int);
+            uint32_t magnitude = (uint32_t)v;
+            if(v < 0) {
+                sign = '-';
+                magnitude = 0U - magnitude;
+            }
+            length = (uint8_t)(FMT_Uint(text, magnitude, 0, ' ') - text);
+            putPadded(&o, text, length, width, pad, sign);
+            break;
+        }
+        case 'u':
+            length = (uint8_t)(FMT_Uint(text, argUnsigned(&args, isLong), 0, ' ') - text);
+            putPadded(&o, text, length, width, pad, 0);
+            break;
+        case 'x':
+        case 'X':
+            length = hexDigits(text, argUnsigned(&args, isLong), (*format == 'x') ? hexLower : hexUpper);
+            putPadded(&o, text, length, width, pad, 0);
+            break;
+        case 'c':
+            text[0] = (char)va_arg(args, int);
+            putPadded(&o, text, 1, width, ' ', 0);
+            break;
+        case 's': {
+            const char *s = va_arg(args, const char *);
+            uint8_t n = 0;
+            while(s[n] != '\0' && n < 0xFFU) {
+                n++;
+            }
+            putPadded(&o, s, n, width, ' ', 0);
+            break;
+        }
+        case '%':
+            put(&o, '%');
+            break;
+        case '\0':
+            // Lone '%' at the end
+            put(&o, '?');
+            continue;
+        default:
+            put(&o, '?');
+            break;
+        }
+        format++;
+    }
+
+    va_end(args);
+    if(size != 0U) {
+        *o.p = '\0';
+    }
+    return (int)o.length;
+}
+
+int FMT_Format(char *out, size_t size, const char *format, ...) {
+    va_list args;
+    int n;
+
+    va_start(args, format);
+    n = FMT_VFormat(out, size, format, args);
+    va_end(args);
+    return n;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file    fsm.c
+ * @brief   Table-driven finite state machine engine
+ *
+ * The engine itself holds no application knowledge. All states,
+ * events, guards and actions come from const tables supplied
+ * by the caller (see ui_fsm.h for the clock UI tables).
+ */
+
+#include "fsm.h"
+#include "trace.h"
+
+/* ================== LOCAL HELPERS ================== */
+
+// Run an optional hook
+static void FSM_Call(FsmAction_t hook) {
+    if(hook != NULL) {
+        hook();
+    }
+}
+
+/* ================== PUBLIC API ================== */
+
+void FSM_Init(Fsm_t *fsm, const FsmDef_t *def, FsmState_t initial) {
+    fsm->def = def;
+    fsm->state = initial;
+    FSM_Call(def->states[initial].enter);
+}
+
+// Handle exactly one event: lookup, guard, exit, action, enter
+void FSM_Dispatch(Fsm_t *fsm, FsmEvent_t event) {
+    const FsmDef_t *def = fsm->def;
+
+    if(event >= def->numEvents) {
+        return; // Unknown event
+    }
+
+    // Direct index into the flash table - no searching
+    const FsmTransition_t *t = &def->table[fsm->state * def->numEvents + event];
+
+    if(!t->used) {
+        return; // Event not handled in this state
+    }
+    if(t->guard != NULL && !t->guard()) {
+        return; // Guard rejected the transition
+    }
+
+    TRACE(TRACE_FSM_TRANSITION, ((uint16_t)fsm->state << 8) | t->next);
+
+    if(t->next != fsm->state) {
+        FSM_Call(def->states[fsm->state].exit);
+        FSM_Call(t->action);
+        fsm->state = t->next;
+        FSM_Call(def->states[fsm->state].enter);
+    } else {
+        // Internal transition: no exit / enter hooks
+        FSM_Call(t->action);
+    }
+}
+
+void FSM_Render(const Fsm_t *fsm) {
+    FSM_Call(fsm->def->states[fsm->state].render);
+}
@@ -0,0 +1,191 @@
+/**
+ * @file    governor.c
+ * @brief   Clock profile governor (governor.h)
+ */
+
+#include "app_config.h"
+
+#if CONFIG_GOVERNOR
+
+#include "governor.h"
+#include "parallel_lcd.h"
+#include "dwt.h"
+#include <string.h>
+
+static GovStats_t govStats;
+static SysclkProfile_t passProfile;   // Profile the pass started in
+static uint32_t sinceMs;              // Residency counted up to here
+static uint32_t lcdWaited;            // LCD_WaitedUs() at the last poll
+static uint32_t windowStartMs;
+static uint32_t windowCpuUs;          // Busy time that scales with the clock
+static uint32_t windowWaitUs;         // Busy time in fixed delays
+static uint32_t windowMaxCpuUs;       // Largest CPU part of one pass
+static uint8_t  holdWindows;          // Windows in a row a lower profile would do
+
+/* ================= PROJECTION ================= */
+
+// CPU time 'us' at the current profile, as it would be at 'profile'
+static uint32_t govScale(uint32_t us, SysclkProfile_t profile) {
+    return (uint32_t)((uint64_t)us * SystemCoreClock / SYSCLK_Info(profile)->hz);
+}
+
+// Lowest profile at which the window's CPU time stays at most
+// 'loadPct' of the time outside fixed delays, and the CPU part of its
+// longest pass within 'passUs'; else the top one
+static SysclkProfile_t govLowest(uint32_t windowUs, uint32_t loadPct, uint32_t passUs) {
+    uint32_t freeUs = (windowUs > windowWaitUs) ? windowUs - windowWaitUs : 0U;
+
+    for(uint8_t p = 0; p < SYSCLK_PROFILE_COUNT; p++) {
+        if((uint64_t)govScale(windowCpuUs, (SysclkProfile_t)p) * 100U <= (uint64_t)freeUs * loadPct &&
+           govScale(windowMaxCpuUs, (SysclkProfile_t)p) <= passUs) {
+            return (SysclkProfile_t)p;
+        }
+    }
+    return (SysclkProfile_t)(SYSCLK_PROFILE_COUNT - 1);
+}
+
+/* ================= SWITCH ================= */
+
+static void govCount(uint32_t now) {
+    govStats.residencyMs[SYSCLK_Get()] += now - sinceMs;
+    sinceMs = now;
+}
+
+static void govNewWindow(void) {
+    windowStartMs = HAL_GetTick();
+    windowCpuUs = 0;
+    windowWaitUs = 0;
+    windowMaxCpuUs = 0;
+}
+
+static HAL_StatusTypeDef govSwitch(SysclkProfile_t profile) {
+    SysclkProfile_t from = SYSCLK_Get();
+    HAL_StatusTypeDef status;
+
+    govCount(HAL_GetTick());
+    status = SYSCLK_Set(profile);
+    if(status == HAL_OK) {
+        govStats.switchUs += SYSCLK_Stats(profile)->lastUs;
+    }
+    if(SYSCLK_Get() > from) {
+        govStats.ups++;
+    } else if(SYSCLK_Get() < from) {
+        govStats.downs++;
+    }
+
+    // The window so far ran at the old clock
+    passProfile = SYSCLK_Get();
+    holdWindows = 0;
+    govNewWindow();
+    return status;
+}
+
+// End of a window: up at once, down after CONFIG_GOVERNOR_HOLD
+static void govDecide(uint32_t windowUs) {
+    SysclkProfile_t current = SYSCLK_Get();
+    SysclkProfile_t up = govLowest(windowUs, CONFIG_GOVERNOR_UP_PCT, CONFIG_GOVERNOR_PASS_US);
+    SysclkProfile_t down;
+
+    if(up > current) {
+        govSwitch(up);
+        return;
+    }
+    down = govLowest(windowUs, CONFIG_GOVERNOR_DOWN_PCT, CONFIG_GOVERNOR_PASS_US / 2U);
+    if(down >= current) {
+        holdWindows = 0;
+    } else if(++holdWindows >= CONFIG_GOVERNOR_HOLD) {
+        govSwitch(down);
+        return;
+    }
+    govNewWindow();
+}
+
+/* ================= PUBLIC API ================= */
+
+void GOV_Init(void) {
+    memset(&govStats, 0, sizeof(govStats));
+    passProfile = SYSCLK_Get();
+    sinceMs = HAL_GetTick();
+    lcdWaited = LCD_WaitedUs();
+    holdWindows = 0;
+    govNewWindow();
+    DWT_CycleCounterInit();
+}
+
+void GOV_Poll(uint32_t startCycles) {
+    uint32_t now = HAL_GetTick();
+    uint32_t waited = LCD_WaitedUs();
+    uint32_t passUs;
+    uint32_t waitUs;
+    uint32_t cpuUs;
+    uint32_t windowUs;
+    uint64_t loadPct;
+
+    // Nothing drives the LCD between here and the next pass
+    waitUs = waited - lcdWaited;
+    lcdWaited = waited;
+
+    // A pass that switched the clock itself (console) is not measured
+    if(SYSCLK_Get() != passProfile) {
+        passProfile = SYSCLK_Get();
+        holdWindows = 0;
+        govNewWindow();
+        return;
+    }
+
+    passUs = (DWT_Cycles() - startCycles) / (SystemCoreClock / 1000000U);
+    cpuUs = (passUs > waitUs) ? passUs - waitUs : 0U;
+    windowCpuUs += cpuUs;
+    windowWaitUs += waitUs;
+    if(cpuUs > windowMaxCpuUs) {
+        windowMaxCpuUs = cpuUs;
+    }
+
+    // A pass whose own work made the next sample late: up at once
+    if(!govStats.pinned && cpuUs > CONFIG_GOVERNOR_PASS_US) {
+        for(uint8_t p = (uint8_t)(passProfile + 1); p < SYSCLK_PROFILE_COUNT; p++) {
+            if(govScale(cpuUs, (SysclkProfile_t)p) <= CONFIG_GOVERNOR_PASS_US ||
+               p == SYSCLK_PROFILE_COUNT - 1) {
+                govSwitch((SysclkProfile_t)p);
+                return;
+            }
+        }
+    }
+
+    if(now - windowStartMs < CONFIG_GOVERNOR_WINDOW_MS) {
+        return;
+    }
+    windowUs = (now - windowStartMs) * 1000U;
+    loadPct = (windowUs > windowWaitUs) ? (uint64_t)windowCpuUs * 100U / (windowUs - windowWaitUs) : 100U;
+    govStats.loadPct = (uint8_t)((loadPct > 100U) ? 100U : loadPct);
+    govStats.windows++;
+    if(govStats.pinned) {
+        govNewWindow();
+    } else {
+        govDecide(windowUs);
+    }
+}
+
+HAL_StatusTypeDef GOV_Pin(SysclkProfile_t profile) {
+    if(profile >= SYSCLK_PROFILE_COUNT) {
+        return HAL_ERROR;
+    }
+    govStats.pinned = 1;
+    if(profile == SYSCLK_Get()) {
+        return HAL_OK;
+    }
+    return govSwitch(profile);
+}
+
+void GOV_Release(void) {
+    govStats.pinned = 0;
+    holdWindows = 0;
+    govNewWindow();
+}
+
+const GovStats_t *GOV_GetStats(void) {
+    govCount(HAL_GetTick());
+    return &govStats;
+}
+
+#endif /* CONFIG_GOVERNOR */
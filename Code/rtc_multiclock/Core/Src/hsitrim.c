@@ -0,0 +1,288 @@
+/**
+ * @file    hsitrim.c
+ * @brief   HSI calibration against the LSE (hsitrim.h)
+ */
+
+#include "app_config.h"
+
+#if CONFIG_HSITRIM
+
+#include "hsitrim.h"
+#include "sysclk.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define HSITRIM_LSE_HZ       32768U
+#define HSITRIM_EDGES        8U       // LSE periods per capture (IC4PSC)
+#define HSITRIM_CAPTURES     (CONFIG_HSITRIM_PERIODS / HSITRIM_EDGES)
+#define HSITRIM_MAX          31U      // HSITRIM is 5 bits
+
+// HSITRIM step, RM0390 "around 80 kHz": only a first guess, each step
+// taken is measured
+#define HSITRIM_STEP_PPM     5000
+
+static HsitrimStats_t hsitrimStats;
+
+// Filled by TIM5_IRQHandler() while CC4IE is set
+static volatile uint32_t captures;
+static volatile uint32_t firstCapture;
+static volatile uint32_t lastCapture;
+static volatile uint8_t  missed;
+
+static uint8_t  measuring;
+static uint32_t measureSwitches;      // Clock switches when it started
+static uint32_t waitStartMs;          // LSE on / last measurement
+static uint32_t waitMs;               // Until the next measurement
+
+// Trim and error before the last step, to notice the sign change
+static uint8_t  prevValid;
+static uint8_t  prevTrim;
+static int32_t  prevPpm;
+
+// HSITRIM_Ms() = msBase + (HAL_GetTick() - msBaseTick) * 1e6 / (1e6 + correction)
+static uint32_t msBaseTick;
+static uint32_t msBase;
+static uint32_t msRemainder;          // Carried part of the division
+
+static const char *const stateNames[] = {
+    [HSITRIM_LSE_WAIT] = "LSE_WAIT",
+    [HSITRIM_NO_LSE]   = "NO_LSE",
+    [HSITRIM_TRIMMING] = "TRIMMING",
+    [HSITRIM_SETTLED]  = "SETTLED",
+};
+
+/* ================= CAPTURE ================= */
+
+// Every 8th LSE edge while measuring. Not traced: 4096 a second would
+// fill the trace ring
+void TIM5_IRQHandler(void) {
+    uint32_t sr = TIM5->SR;
+    uint32_t capture = TIM5->CCR4;
+
+    // rc_w0: writing 1 leaves a flag alone
+    TIM5->SR = ~(uint32_t)(TIM_SR_CC4IF | TIM_SR_CC4OF);
+    if(!(sr & TIM_SR_CC4IF)) {
+        return;
+    }
+    if(sr & TIM_SR_CC4OF) {
+        missed = 1;
+    }
+    if(captures == 0U) {
+        firstCapture = capture;
+    }
+    lastCapture = capture;
+    if(++captures > HSITRIM_CAPTURES) {
+        TIM5->DIER = 0;
+    }
+}
+
+/* ================= MEASUREMENT ================= */
+
+// TIM5's clock: twice PCLK1 when APB1 is divided
+static uint32_t hsitrimTimerHz(void) {
+    uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+
+    return (pclk1 == HAL_RCC_GetHCLKFreq()) ? pclk1 : 2U * pclk1;
+}
+
+// A failed switch may have left the clock elsewhere too
+static uint32_t hsitrimSwitches(void) {
+    uint32_t switches = 0;
+
+    for(uint8_t p = 0; p < SYSCLK_PROFILE_COUNT; p++) {
+        const SysclkStats_t *stats = SYSCLK_Stats((SysclkProfile_t)p);
+
+        switches += stats->switches + stats->failures;
+    }
+    return switches;
+}
+
+static void hsitrimStart(void) {
+    captures = 0;
+    missed = 0;
+    measureSwitches = hsitrimSwitches();
+    measuring = 1;
+    TIM5->SR = ~(uint32_t)(TIM_SR_CC4IF | TIM_SR_CC4OF);
+    TIM5->DIER = TIM_DIER_CC4IE;
+}
+
+// HSI error in ppm from a completed measurement
+static int32_t hsitrimPpm(void) {
+    uint64_t nominal = (uint64_t)hsitrimTimerHz() * CONFIG_HSITRIM_PERIODS;
+    uint64_t counted = (uint64_t)(lastCapture - firstCapture) * HSITRIM_LSE_HZ;
+    int64_t ppm = ((int64_t)counted - (int64_t)nominal) * 1000000 / (int64_t)(nominal / 1000U);
+
+    // In 0.001 ppm so far, rounded
+    return (int32_t)((ppm + (ppm < 0 ? -500 : 500)) / 1000);
+}
+
+/* ================= CORRECTION ================= */
+
+static uint32_t hsitrimMsAt(uint32_t tick, uint32_t *remainder) {
+    uint64_t scaled = (uint64_t)(tick - msBaseTick) * 1000000U + msRemainder;
+    uint32_t divisor = (uint32_t)(1000000 + hsitrimStats.correctionPpm);
+
+    *remainder = (uint32_t)(scaled % divisor);
+    return msBase + (uint32_t)(scaled / divisor);
+}
+
+// From here on count with 'ppm' taken out
+static void hsitrimCorrect(int32_t ppm) {
+    uint32_t tick = HAL_GetTick();
+    uint32_t remainder;
+
+    msBase = hsitrimMsAt(tick, &remainder);
+    msBaseTick = tick;
+    msRemainder = remainder;
+    hsitrimStats.correctionPpm = ppm;
+}
+
+/* ================= TRIM ================= */
+
+static void hsitrimSetTrim(uint8_t trim) {
+    RCC->CR = (RCC->CR & ~RCC_CR_HSITRIM) | ((uint32_t)trim << RCC_CR_HSITRIM_Pos);
+    hsitrimStats.trim = trim;
+}
+
+// Newly settled: measure once more straight away, with the correction
+// in place, for the error after
+static void hsitrimSettle(int32_t ppm) {
+    prevValid = 0;
+    hsitrimCorrect(ppm);
+    waitMs = (hsitrimStats.state == HSITRIM_SETTLED) ? CONFIG_HSITRIM_INTERVAL_S * 1000U : 0U;
+    hsitrimStats.state = HSITRIM_SETTLED;
+}
+
+// Closed loop on one measurement at the current trim
+static void hsitrimEvaluate(int32_t ppm) {
+    int32_t steps;
+    int32_t next;
+
+    hsitrimStats.measurements++;
+    hsitrimStats.hsiPpm = ppm;
+    hsitrimStats.residualPpm = ppm - hsitrimStats.correctionPpm;
+    if(hsitrimStats.measurements == 1U) {
+        hsitrimStats.factoryPpm = ppm;
+    }
+
+    // The last step went past 16 MHz: keep the closer of the two
+    if(prevValid && (prevPpm < 0) != (ppm < 0)) {
+        if(abs(prevPpm) < abs(ppm)) {
+            hsitrimSetTrim(prevTrim);
+            ppm = prevPpm;
+        }
+        hsitrimSettle(ppm);
+        return;
+    }
+
+    steps = (ppm + (ppm < 0 ? -HSITRIM_STEP_PPM / 2 : HSITRIM_STEP_PPM / 2)) / HSITRIM_STEP_PPM;
+    next = (int32_t)hsitrimStats.trim - steps;
+    if(next < 0) {
+        next = 0;
+    } else if(next > (int32_t)HSITRIM_MAX) {
+        next = HSITRIM_MAX;
+    }
+    if(next == (int32_t)hsitrimStats.trim) {
+        hsitrimSettle(ppm);
+        return;
+    }
+
+    prevValid = 1;
+    prevTrim = hsitrimStats.trim;
+    prevPpm = ppm;
+    hsitrimSetTrim((uint8_t)next);
+    // Until it is measured: what the step should have taken off
+    hsitrimCorrect(ppm - (prevTrim - next) * HSITRIM_STEP_PPM);
+    hsitrimStats.state = HSITRIM_TRIMMING;
+    waitMs = 0;
+}
+
+/* ================= PUBLIC API ================= */
+
+void HSITRIM_Init(void) {
+    memset(&hsitrimStats, 0, sizeof(hsitrimStats));
+    hsitrimStats.factoryTrim = (uint8_t)((RCC->CR & RCC_CR_HSITRIM) >> RCC_CR_HSITRIM_Pos);
+    hsitrimStats.trim = hsitrimStats.factoryTrim;
+    hsitrimStats.state = HSITRIM_LSE_WAIT;
+    measuring = 0;
+    prevValid = 0;
+    msBaseTick = HAL_GetTick();
+    msBase = msBaseTick;
+    msRemainder = 0;
+
+    // LSEON is in the backup domain
+    HAL_PWR_EnableBkUpAccess();
+    RCC->BDCR |= RCC_BDCR_LSEON;
+    waitStartMs = HAL_GetTick();
+    waitMs = CONFIG_HSITRIM_LSE_MS;
+
+    // TIM5 free-running over 32 bits; IC4 on TI4 = LSE, every 8th edge
+    RCC->APB1ENR |= RCC_APB1ENR_TIM5EN;
+    (void)RCC->APB1ENR;    // Clock enable takes effect before the first access
+    TIM5->CR1 = 0;
+    TIM5->DIER = 0;
+    TIM5->PSC = 0;
+    TIM5->ARR = 0xFFFFFFFFU;
+    TIM5->OR = TIM_OR_TI4_RMP_1;
+    TIM5->CCMR2 = TIM_CCMR2_CC4S_0 | TIM_CCMR2_IC4PSC;
+    TIM5->CCER = TIM_CCER_CC4E;
+    TIM5->EGR = TIM_EGR_UG;
+    TIM5->CR1 = TIM_CR1_CEN;
+
+    NVIC_SetPriority(TIM5_IRQn, 5);
+    NVIC_EnableIRQ(TIM5_IRQn);
+}
+
+void HSITRIM_Poll(void) {
+    uint32_t now = HAL_GetTick();
+
+    if(hsitrimStats.state == HSITRIM_NO_LSE) {
+        return;
+    }
+    if(hsitrimStats.state == HSITRIM_LSE_WAIT) {
+        if(RCC->BDCR & RCC_BDCR_LSERDY) {
+            hsitrimStats.state = HSITRIM_TRIMMING;
+            hsitrimStart();
+        } else if(now - waitStartMs >= waitMs) {
+            hsitrimStats.state = HSITRIM_NO_LSE;
+            TIM5->CR1 = 0;
+        }
+        return;
+    }
+
+    if(!measuring) {
+        if(now - waitStartMs >= waitMs) {
+            hsitrimStart();
+        }
+        return;
+    }
+    if(captures <= HSITRIM_CAPTURES) {
+        return;
+    }
+
+    measuring = 0;
+    waitStartMs = now;
+    if(missed || hsitrimSwitches() != measureSwitches) {
+        // The count is at two clocks, or short of edges: again
+        hsitrimStats.discarded++;
+        waitMs = 0;
+        return;
+    }
+    hsitrimEvaluate(hsitrimPpm());
+}
+
+uint32_t HSITRIM_Ms(void) {
+    uint32_t remainder;
+
+    return hsitrimMsAt(HAL_GetTick(), &remainder);
+}
+
+const HsitrimStats_t *HSITRIM_GetStats(void) {
+    return &hsitrimStats;
+}
+
+const char *HSITRIM_StateName(HsitrimState_t state) {
+    return (state <= HSITRIM_SETTLED) ? stateNames[state] : "?";
+}
+
+#endif /* CONFIG_HSITRIM */
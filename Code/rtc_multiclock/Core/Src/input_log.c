@@ -0,0 +1,313 @@
+/**
+ * @file    input_log.c
+ * @brief   Delta-encoded input recorder and replayer (see input_log.h)
+ */
+
+#include "input_log.h"
+
+#if CONFIG_INPUT_LOG
+
+#include "calendar.h"
+#include "stopwatch.h"
+#include "fmt.h"
+#include <stdio.h>
+
+#define INPUTLOG_MORE       0x10U   // Varint continuation of the delta follows
+#define INPUTLOG_RECORD_MAX 8U      // 1 + 4 varint bytes (28-bit delta) + 3 DATE / RTC bytes
+#define INPUTLOG_NO_KIND    0xFFU   // payloadLength() of a kind not in the format
+
+extern RTC_HandleTypeDef hrtc;
+
+InputLog_t inputLog;
+
+// Survives a reset: the debugger, Renode or the host loads an image here
+__attribute__((section(".noinit"))) InputLog_t inputLogReplay;
+
+typedef struct {
+    uint8_t  kind;
+    uint32_t ms;
+    uint8_t  payload[3];  // Event of SW, y/m/d of DATE, h/m/s of the RTC kinds
+} InputRecord_t;
+
+static uint8_t replaying;
+static uint8_t replayApplied;
+static uint16_t replayPos;
+static uint32_t replayMs;
+static uint16_t dumpLength;     // inputLog.length at line 0 of the text form
+
+uint32_t INPUTLOG_Checksum(uint32_t hash, const uint8_t *data, uint32_t length) {
+    for(uint32_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619U;
+    }
+    return hash;
+}
+
+/* ================== RECORDING ================== */
+
+void INPUTLOG_Init(void) {
+    inputLog.length = 0;
+    inputLog.dropped = 0;
+    inputLog.lastMs = 0;
+    inputLog.checksum = INPUTLOG_FNV_BASIS;
+    inputLog.magic = INPUTLOG_MAGIC;
+
+    // RAM holds garbage after power-up, so only a checked image is played
+    if(inputLogReplay.magic == INPUTLOG_MAGIC &&
+       inputLogReplay.length <= CONFIG_INPUT_LOG_BYTES &&
+       INPUTLOG_Checksum(INPUTLOG_FNV_BASIS, inputLogReplay.data, inputLogReplay.length)
+           == inputLogReplay.checksum) {
+        replaying = (inputLogReplay.length > 0U);
+        replayPos = 0;
+        replayMs = 0;
+    }
+    inputLogReplay.magic = 0;
+}
+
+static void append(uint8_t kind, const uint8_t *payload, uint8_t payloadLength) {
+    uint8_t record[INPUTLOG_RECORD_MAX];
+    uint32_t now = HAL_GetTick();
+    uint32_t delta = now - inputLog.lastMs;
+    uint8_t n = 0;
+
+    if(replaying) {
+        return;
+    }
+
+    record[n] = (uint8_t)((kind << 5) | (delta & 0x0FU));
+    delta >>= 4;
+    if(delta != 0U) {
+        record[n++] |= INPUTLOG_MORE;
+        while(delta >= 0x80U) {
+            record[n++] = (uint8_t)(delta | 0x80U);
+            delta >>= 7;
+        }
+        record[n++] = (uint8_t)delta;
+    } else {
+        n++;
+    }
+    for(uint8_t i = 0; i < payloadLength; i++) {
+        record[n++] = payload[i];
+    }
+
+    // Whole records only, so a full log still decodes
+    if(inputLog.length + n > CONFIG_INPUT_LOG_BYTES) {
+        if(inputLog.dropped != 0xFFFFU) {
+            inputLog.dropped++;
+        }
+        return;
+    }
+
+    for(uint8_t i = 0; i < n; i++) {
+        inputLog.data[inputLog.length++] = record[i];
+    }
+    inputLog.checksum = INPUTLOG_Checksum(inputLog.checksum, record, n);
+    inputLog.lastMs = now;
+}
+
+void INPUTLOG_RecordEvent(UiEvent_t event) {
+    append((uint8_t)event, NULL, 0);
+}
+
+void INPUTLOG_RecordStopwatch(UiEvent_t event) {
+    uint8_t payload = (uint8_t)event;
+
+    append(INPUTLOG_KIND_SW, &payload, 1);
+}
+
+void INPUTLOG_RecordDate(const RTC_DateTypeDef *date) {
+    uint8_t ymd[3] = { date->Year, date->Month, date->Date };
+
+    append(INPUTLOG_KIND_DATE, ymd, sizeof(ymd));
+}
+
+void INPUTLOG_RecordRtc(const RTC_TimeTypeDef *time, uint8_t kind) {
+    uint8_t hms[3] = { time->Hours, time->Minutes, time->Seconds };
+
+    append(kind, hms, sizeof(hms));
+}
+
+/* ================== REPLAY ================== */
+
+static uint8_t payloadLength(uint8_t kind) {
+    if(kind < UI_EV_COUNT) {
+        return 0;
+    }
+    switch(kind) {
+    case INPUTLOG_KIND_SW:
+        return 1;
+    case INPUTLOG_KIND_DATE:
+    case INPUTLOG_KIND_RTC_UI:
+    case INPUTLOG_KIND_RTC:
+        return 3;
+    default:
+        return INPUTLOG_NO_KIND;
+    }
+}
+
+// Decodes the record at 'pos'; returns the position after it, 0 at the end
+static uint16_t decode(uint16_t pos, InputRecord_t *record) {
+    const uint8_t *data = inputLogReplay.data;
+    uint16_t length = inputLogReplay.length;
+    uint32_t delta;
+    uint8_t shift = 4;
+    uint8_t head;
+    uint8_t payload;
+
+    if(pos >= length) {
+        return 0;
+    }
+    head = data[pos++];
+    record->kind = head >> 5;
+    delta = head & 0x0FU;
+
+    if(head & INPUTLOG_MORE) {
+        uint8_t b;
+        do {
+            if(pos >= length || shift > 25U) {
+                return 0;
+            }
+            b = data[pos++];
+            delta |= (uint32_t)(b & 0x7FU) << shift;
+            shift += 7;
+        } while(b & 0x80U);
+    }
+    record->ms = replayMs + delta;
+
+    payload = payloadLength(record->kind);
+    if(payload == INPUTLOG_NO_KIND || pos + payload > length) {
+        return 0;
+    }
+    for(uint8_t i = 0; i < payload; i++) {
+        record->payload[i] = data[pos++];
+    }
+    return pos;
+}
+
+// What the console command did, from the state the replay is in now
+static void applyStopwatch(const InputRecord_t *record) {
+#if CONFIG_MODE_STOPWATCH
+    if(record->payload[0] == UI_EV_SELECT) {
+        (void)(STOPWATCH_Running() ? STOPWATCH_Stop() : STOPWATCH_Start());
+    } else if(record->payload[0] == UI_EV_INC) {
+        (void)(STOPWATCH_Running() ? STOPWATCH_Lap() : STOPWATCH_Reset());
+    }
+#else
+    (void)record;
+#endif
+}
+
+static void applyDate(const InputRecord_t *record) {
+    RTC_DateTypeDef date = {0};
+
+    date.Year = record->payload[0];
+    date.Month = record->payload[1];
+    date.Date = record->payload[2];
+    date.WeekDay = CAL_DayOfWeek(date.Year, date.Month, date.Date);
+    HAL_RTC_SetDate(&hrtc, &date, RTC_FORMAT_BIN);
+}
+
+static void applyRtc(const InputRecord_t *record) {
+    RTC_TimeTypeDef time = {0};
+
+    time.Hours = record->payload[0];
+    time.Minutes = record->payload[1];
+    time.Seconds = record->payload[2];
+    time.TimeFormat = RTC_HOURFORMAT_24;
+    time.DayLightSaving = RTC_DAYLIGHTSAVING_NONE;
+    time.StoreOperation = RTC_STOREOPERATION_RESET;
+    HAL_RTC_SetTime(&hrtc, &time, RTC_FORMAT_BIN);
+}
+
+uint8_t INPUTLOG_Replaying(void) {
+    return replaying;
+}
+
+uint8_t INPUTLOG_NextReplayed(UiEvent_t *event) {
+    uint32_t now = HAL_GetTick();
+    InputRecord_t record;
+
+    while(replaying) {
+        uint16_t next = decode(replayPos, &record);
+
+        // End of the image (or a corrupt tail): back to the buttons
+        if(next == 0U) {
+            replaying = 0;
+            break;
+        }
+        if((int32_t)(now - record.ms) < 0) {
+            return 0;
+        }
+        replayPos = next;
+        replayMs = record.ms;
+
+        if(record.kind < UI_EV_COUNT) {
+            *event = (UiEvent_t)record.kind;
+            return 1;
+        }
+        // A time saved from the UI is written again by the replayed events
+        if(record.kind == INPUTLOG_KIND_RTC_UI) {
+            continue;
+        }
+        if(record.kind == INPUTLOG_KIND_SW) {
+            applyStopwatch(&record);
+        } else if(record.kind == INPUTLOG_KIND_DATE) {
+            applyDate(&record);
+        } else {
+            applyRtc(&record);
+        }
+#if CONFIG_MODE_STOPWATCH
+        // As the console does after a date or time
+        if(record.kind != INPUTLOG_KIND_SW) {
+            STOPWATCH_ClockChanged();
+        }
+#endif
+        replayApplied = 1;
+    }
+    return 0;
+}
+
+uint8_t INPUTLOG_ReplayApplied(void) {
+    uint8_t applied = replayApplied;
+
+    replayApplied = 0;
+    return applied;
+}
+
+/* ================== EXPORT ================== */
+
+uint8_t INPUTLOG_Line(uint16_t index, char *out, size_t size) {
+    uint16_t rows;
+
+    if(index == 0U) {
+        dumpLength = inputLog.length;
+        FMT_Format(out, size, "INPUTLOG,%u,%u", (unsigned)dumpLength, (unsigned)inputLog.dropped);
+        return 1;
+    }
+
+    rows = (uint16_t)((dumpLength + INPUTLOG_DUMP_ROW - 1U) / INPUTLOG_DUMP_ROW);
+    if(index <= rows) {
+        uint32_t start = (uint32_t)(index - 1U) * INPUTLOG_DUMP_ROW;
+        size_t used = (size_t)FMT_Format(out, size, "I,");
+
+        for(uint32_t i = start; i < dumpLength && i < start + INPUTLOG_DUMP_ROW && used < size; i++) {
+            used += (size_t)FMT_Format(&out[used], size - used, "%02X", inputLog.data[i]);
+        }
+        return 1;
+    }
+    if(index == rows + 1U) {
+        FMT_Format(out, size, "INPUTLOG_END");
+        return 1;
+    }
+    return 0;
+}
+
+void INPUTLOG_Dump(void) {
+    char line[INPUTLOG_LINE_MAX];
+
+    for(uint16_t i = 0; INPUTLOG_Line(i, line, sizeof(line)); i++) {
+        printf("%s\n", line);
+    }
+    fflush(stdout);
+}
+
+#endif /* CONFIG_INPUT_LOG */
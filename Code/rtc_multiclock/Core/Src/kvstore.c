@@ -0,0 +1,334 @@
+/**
+ * @file    kvstore.c
+ * @brief   Log-structured key/value store in flash sectors 1 and 2
+ *
+ * See kvstore.h for the layout and the power-loss rules. Offsets are
+ * bytes from the start of a sector; flash is read directly, words are
+ * programmed with the FLASH HAL (x32, VDD 2.7 .. 3.6 V).
+ */
+
+#include "app_config.h"
+
+#if CONFIG_KV_STORE
+
+#include "kvstore.h"
+#include "crc16.h"
+#include <stddef.h>
+#include <string.h>
+
+#define KV_SECTOR_BYTES   0x4000U
+#define KV_MAGIC          0x3153564BU   // "KVS1"
+#define KV_ERASED         0xFFFFFFFFU
+
+#define KV_PENDING        (1UL << 15)   // Cleared once the value is complete
+
+#define KV_WORDS(length)         (((uint32_t)(length) + 3U) / 4U)
+#define KV_RECORD_BYTES(length)  (4U + 4U * KV_WORDS(length))
+
+typedef struct {
+    uint32_t magic;
+    uint32_t generation;
+    uint32_t check;       // ~generation
+    uint32_t active;      // KV_ERASED while records are copied in, then 0
+} KvHeader_t;
+
+#define KV_HEADER_BYTES   ((uint32_t)sizeof(KvHeader_t))
+
+_Static_assert(KV_HEADER_BYTES + KV_KEY_COUNT * KV_RECORD_BYTES(KV_MAX_VALUE) * 2U <= KV_SECTOR_BYTES,
+               "a compacted sector must leave room to append");
+_Static_assert(KV_KEY_COUNT < 0xFFU, "key 0xFF would make an erased header word");
+
+typedef struct {
+    uint32_t  sector;     // FLASH_SECTOR_x
+    uintptr_t offset;     // From FLASH_BASE
+} KvSector_t;
+
+static const KvSector_t kvSectors[2] = {
+    { FLASH_SECTOR_1, 0x04000U },
+    { FLASH_SECTOR_2, 0x08000U },
+};
+
+static const char *const kvNames[KV_KEY_COUNT] = {
+#define KV_KEY_NAME(name, text)  text,
+    KV_KEYS(KV_KEY_NAME)
+#undef KV_KEY_NAME
+};
+
+static uint8_t  kvActive;                // Index into kvSectors
+static uint32_t kvGeneration;
+static uint32_t kvWritePos;              // Next free offset of the active sector
+static uint16_t kvRecords;
+static uint8_t  kvRecovered;
+static uint16_t kvIndex[KV_KEY_COUNT];   // Offset of each key's latest record, 0 = none
+
+/* ================= FLASH ACCESS ================= */
+
+static const uint8_t *kvBase(uint8_t s) {
+    return (const uint8_t *)(FLASH_BASE + kvSectors[s].offset);
+}
+
+static uint32_t kvWord(uint8_t s, uint32_t offset) {
+    return *(const uint32_t *)(kvBase(s) + offset);
+}
+
+static HAL_StatusTypeDef kvProgram(uint8_t s, uint32_t offset, uint32_t word) {
+    return HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, FLASH_BASE + kvSectors[s].offset + offset, word);
+}
+
+static uint8_t kvBlankFrom(uint8_t s, uint32_t offset) {
+    for(; offset < KV_SECTOR_BYTES; offset += 4U) {
+        if(kvWord(s, offset) != KV_ERASED) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* ================= RECORDS ================= */
+
+static uint32_t kvRecordHeader(KvKey_t key, const uint8_t *value, uint8_t length) {
+    uint8_t tag[2] = { (uint8_t)key, length };
+    uint16_t crc = CRC16_Update(CRC16_INIT, tag, sizeof(tag));
+
+    crc = CRC16_Update(crc, value, length);
+    return (uint32_t)key | ((uint32_t)length << 8) | ((uint32_t)crc << 16);
+}
+
+// Length of the value stored at 'offset'
+static uint8_t kvRecordLength(uint8_t s, uint32_t offset) {
+    return (uint8_t)((kvWord(s, offset) >> 8) & 0x7FU);
+}
+
+// Bytes taken by a complete, intact record at 'offset', or 0
+static uint32_t kvCheckRecord(uint8_t s, uint32_t offset) {
+    uint32_t header = kvWord(s, offset);
+    uint8_t key = (uint8_t)header;
+    uint8_t length = (uint8_t)((header >> 8) & 0x7FU);
+
+    if((header & KV_PENDING) || key >= KV_KEY_COUNT || length > KV_MAX_VALUE ||
+       offset + KV_RECORD_BYTES(length) > KV_SECTOR_BYTES) {
+        return 0;
+    }
+    if(kvRecordHeader((KvKey_t)key, kvBase(s) + offset + 4U, length) != header) {
+        return 0;
+    }
+    return KV_RECORD_BYTES(length);
+}
+
+// Header with the pending bit, value, then the pending bit cleared: a
+// record cut short at any point keeps the bit (the CRC alone would let
+// one in 65536 torn values through)
+static HAL_StatusTypeDef kvWriteRecord(uint8_t s, uint32_t offset, KvKey_t key,
+                                       const uint8_t *value, uint8_t length) {
+    uint32_t header = kvRecordHeader(key, value, length);
+
+    if(kvProgram(s, offset, header | KV_PENDING) != HAL_OK) {
+        return HAL_ERROR;
+    }
+    for(uint32_t i = 0; i < length; i += 4U) {
+        uint32_t word = KV_ERASED;     // Padding stays erased
+
+        memcpy(&word, value + i, (length - i < 4U) ? length - i : 4U);
+        if(kvProgram(s, offset + 4U + i, word) != HAL_OK) {
+            return HAL_ERROR;
+        }
+    }
+    return kvProgram(s, offset, header);
+}
+
+/* ================= SECTORS ================= */
+
+static uint8_t kvSectorValid(uint8_t s) {
+    const KvHeader_t *header = (const KvHeader_t *)kvBase(s);
+
+    return header->magic == KV_MAGIC && header->check == ~header->generation &&
+           header->active == 0U;
+}
+
+// Erase 's' unless it is blank already and write a header without
+// the active mark
+static HAL_StatusTypeDef kvStartSector(uint8_t s, uint32_t generation) {
+    if(!kvBlankFrom(s, 0)) {
+        FLASH_EraseInitTypeDef erase = {0};
+        uint32_t sectorError;
+
+        erase.TypeErase = FLASH_TYPEERASE_SECTORS;
+        erase.Sector = kvSectors[s].sector;
+        erase.NbSectors = 1;
+        erase.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+        if(HAL_FLASHEx_Erase(&erase, &sectorError) != HAL_OK) {
+            return HAL_ERROR;
+        }
+    }
+    if(kvProgram(s, offsetof(KvHeader_t, magic), KV_MAGIC) != HAL_OK ||
+       kvProgram(s, offsetof(KvHeader_t, generation), generation) != HAL_OK ||
+       kvProgram(s, offsetof(KvHeader_t, check), ~generation) != HAL_OK) {
+        return HAL_ERROR;
+    }
+    return HAL_OK;
+}
+
+// Index the records of sector 's', which becomes the active one
+static void kvScan(uint8_t s) {
+    uint32_t offset = KV_HEADER_BYTES;
+
+    kvActive = s;
+    kvGeneration = ((const KvHeader_t *)kvBase(s))->generation;
+    kvRecords = 0;
+    memset(kvIndex, 0, sizeof(kvIndex));
+
+    while(offset < KV_SECTOR_BYTES && kvWord(s, offset) != KV_ERASED) {
+        uint32_t bytes = kvCheckRecord(s, offset);
+
+        if(bytes == 0U) {
+            break;
+        }
+        kvIndex[(uint8_t)kvWord(s, offset)] = (uint16_t)offset;
+        kvRecords++;
+        offset += bytes;
+    }
+
+    // Anything programmed past the last good record is a write that was
+    // cut short; nothing can be appended over it
+    kvWritePos = offset;
+    kvRecovered = !kvBlankFrom(s, offset);
+    if(kvRecovered) {
+        kvWritePos = KV_SECTOR_BYTES;
+    }
+}
+
+// Copy the latest values into the other sector, with 'key' set to
+// 'value' on the way, and make it the active one
+static HAL_StatusTypeDef kvCompact(KvKey_t key, const uint8_t *value, uint8_t length) {
+    uint8_t from = kvActive;
+    uint8_t to = from ^ 1U;
+    uint16_t index[KV_KEY_COUNT];
+    uint32_t offset = KV_HEADER_BYTES;
+    uint16_t records = 0;
+
+    if(kvStartSector(to, kvGeneration + 1U) != HAL_OK) {
+        return HAL_ERROR;
+    }
+    memset(index, 0, sizeof(index));
+    for(uint8_t k = 0; k < KV_KEY_COUNT; k++) {
+        const uint8_t *src = value;
+        uint8_t n = length;
+
+        if(k != key) {
+            if(kvIndex[k] == 0U) {
+                continue;
+            }
+            src = kvBase(from) + kvIndex[k] + 4U;
+            n = kvRecordLength(from, kvIndex[k]);
+        }
+        if(n == 0U) {
+            continue;    // Deleted
+        }
+        if(kvWriteRecord(to, offset, (KvKey_t)k, src, n) != HAL_OK) {
+            return HAL_ERROR;
+        }
+        index[k] = (uint16_t)offset;
+        offset += KV_RECORD_BYTES(n);
+        records++;
+    }
+    if(kvProgram(to, offsetof(KvHeader_t, active), 0) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    kvActive = to;
+    kvGeneration++;
+    memcpy(kvIndex, index, sizeof(kvIndex));
+    kvWritePos = offset;
+    kvRecords = records;
+    kvRecovered = 0;
+    return HAL_OK;
+}
+
+/* ================= API ================= */
+
+void KV_Init(void) {
+    uint8_t valid0 = kvSectorValid(0);
+    uint8_t valid1 = kvSectorValid(1);
+
+    if(valid0 && valid1) {
+        // A compaction whose source was not erased yet: the newer one wins
+        kvScan((((const KvHeader_t *)kvBase(1))->generation >
+                ((const KvHeader_t *)kvBase(0))->generation) ? 1U : 0U);
+    } else if(valid0 || valid1) {
+        kvScan(valid1 ? 1U : 0U);
+    } else {
+        // First start (or neither sector complete): an empty store
+        HAL_FLASH_Unlock();
+        __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR |
+                               FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR);
+        if(kvStartSector(0, 1U) == HAL_OK) {
+            kvProgram(0, offsetof(KvHeader_t, active), 0);
+        }
+        HAL_FLASH_Lock();
+        kvScan(0);
+    }
+}
+
+uint8_t KV_Get(KvKey_t key, void *value, uint8_t size) {
+    uint8_t length;
+
+    if(key >= KV_KEY_COUNT || kvIndex[key] == 0U) {
+        return 0;
+    }
+    length = kvRecordLength(kvActive, kvIndex[key]);
+    memcpy(value, kvBase(kvActive) + kvIndex[key] + 4U, (length < size) ? length : size);
+    return length;
+}
+
+HAL_StatusTypeDef KV_Set(KvKey_t key, const void *value, uint8_t length) {
+    HAL_StatusTypeDef status;
+
+    if(key >= KV_KEY_COUNT || length > KV_MAX_VALUE) {
+        return HAL_ERROR;
+    }
+    if(kvIndex[key] != 0U ? (kvRecordLength(kvActive, kvIndex[key]) == length &&
+                             memcmp(kvBase(kvActive) + kvIndex[key] + 4U, value, length) == 0)
+                          : length == 0U) {
+        return HAL_OK;    // Unchanged: no flash write
+    }
+
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR |
+                           FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR);
+    if(kvWritePos + KV_RECORD_BYTES(length) <= KV_SECTOR_BYTES) {
+        status = kvWriteRecord(kvActive, kvWritePos, key, value, length);
+        if(status == HAL_OK) {
+            kvIndex[key] = (uint16_t)kvWritePos;
+            kvRecords++;
+        }
+        // Even a failed record takes its space
+        kvWritePos += KV_RECORD_BYTES(length);
+    } else {
+        status = kvCompact(key, value, length);
+    }
+    HAL_FLASH_Lock();
+    return status;
+}
+
+KvKey_t KV_Find(const char *name) {
+    for(uint8_t k = 0; k < KV_KEY_COUNT; k++) {
+        if(strcmp(kvNames[k], name) == 0) {
+            return (KvKey_t)k;
+        }
+    }
+    return KV_KEY_COUNT;
+}
+
+const char *KV_Name(KvKey_t key) {
+    return (key < KV_KEY_COUNT) ? kvNames[key] : "?";
+}
+
+void KV_GetStats(KvStats_t *stats) {
+    stats->generation = kvGeneration;
+    stats->used = (uint16_t)((kvWritePos < KV_SECTOR_BYTES) ? kvWritePos : KV_SECTOR_BYTES);
+    stats->size = KV_SECTOR_BYTES;
+    stats->records = kvRecords;
+    stats->recovered = kvRecovered;
+}
+
+#endif /* CONFIG_KV_STORE */
@@ -39,6 +39,24 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "parallel_lcd.h"
+#include "mode.h"
+#include "bench.h"
+#include "trace.h"
+#include "memstat.h"
+#include "input_log.h"
+#include "anim_assets.h"
+#include "boot.h"
+#include "console.h"
+#include "telemetry.h"
+#include "kvstore.h"
+#include "eventlog.h"
+#include "backup.h"
+#include "crash.h"
+#include "power.h"
+#include "sysclk.h"
+#include "governor.h"
+#include "hsitrim.h"
+#include "dwt.h"
 #include "stdio.h"
 /* USER CODE END Includes */
 
@@ -49,7 +67,8 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
-
+// Button sampling period of the main loop (ms)
+#define BUTTON_POLL_MS  10
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -59,55 +78,14 @@
 
 /* Private variables ---------------------------------------------------------*/
 /* ================= GLOBAL APPLICATION VARIABLES =================
- * RTC structures store time and date maintained by the STM32 RTC
- * peripheral, allowing time persistence across resets.
- *
- * Stopwatch variables rely on system tick counting to provide
- * high-resolution timing independent of the RTC.
+ * The RTC handle is shared with the modes (mode_*.c), which keep
+ * their own state. The RTC maintains time across resets.
  * ================================================================= */
 
 RTC_HandleTypeDef hrtc;
 
 /* USER CODE BEGIN PV */
 
-// Current real-time clock values fetched from hardware RTC
-RTC_TimeTypeDef currentTime;
-RTC_DateTypeDef currentDate;
-
-// Stopwatch timing variables
-uint32_t stopwatchStartTime = 0; // Start timestamp in milliseconds
-uint32_t stopwatchElapsed = 0;   // Elapsed time in milliseconds
-uint8_t stopwatchRunning = 0;    // Stopwatch state flag
-/**
- * @brief Application display modes (Finite State Machine)
- *
- * MODE_CLOCK     : Normal time display using RTC
- * MODE_STOPWATCH : Stopwatch operation mode
- * MODE_SETTINGS  : User configuration for time setting
- */
-
-typedef enum {
-    MODE_CLOCK,
-    MODE_STOPWATCH,
-    MODE_SETTINGS
-} DisplayMode_t;
-/**
- * @brief Time setting sub-modes
- *
- * SET_HOURS   : Adjust hours field
- * SET_MINUTES : Adjust minutes field
- * SET_SAVE    : Commit time to RTC and exit settings
- */
-
-typedef enum {
-    SET_HOURS,
-    SET_MINUTES,
-    SET_SAVE
-} SettingMode_t;
-
-DisplayMode_t currentMode = MODE_CLOCK;
-SettingMode_t settingMode = SET_HOURS;
-uint8_t settingBlink = 0;
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -116,21 +94,17 @@ static void MX_GPIO_Init(void);
 static void MX_RTC_Init(void);
 
 /* ================= FUNCTION PROTOTYPES =================
- * Display functions handle LCD visualization for each mode.
- * Button handlers implement debounced user interaction.
+ * Mode views and behaviour live in mode_*.c (see mode.h).
+ * Button handler implements debounced user interaction.
  * ====================================================== */
 
 /* USER CODE BEGIN PFP */
-void displayClock(void);
-void displayStopwatch(void);
-void displaySettings(void);
-void handleStopwatch(void);
 void updateDisplay(void);
-void handleButtons(void);
-void handleModeButton(void);
-void handleStopwatchButtons(void);
-void handleSettingsButtons(void);
-void playRocketAnimation(void);  // ADD THIS LINE
+uint8_t handleButtons(void);
+static void finishSplash(void);
+#if CONFIG_KV_STORE
+static void applyRtcCalibration(void);
+#endif
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
@@ -154,7 +128,14 @@ int main(void)
 {
 
   /* USER CODE BEGIN 1 */
-
+  // Time since reset and the reset cause, before anything else runs
+  BOOT_Start();
+
+#if CONFIG_MEMSTAT
+  // Must run before anything else uses the stack deeply
+  MEMSTAT_PaintStack();
+  BOOT_Mark(BOOT_PHASE_STACK_PAINT);
+#endif
   /* USER CODE END 1 */
 
   /* MCU Configuration--------------------------------------------------------*/
@@ -164,7 +145,7 @@ int main(void)
   HAL_Init();
 
   /* USER CODE BEGIN Init */
-
+  BOOT_Mark(BOOT_PHASE_HAL);
   /* USER CODE END Init */
 
   /* Configure the system clock */
@@ -172,37 +153,122 @@ int main(void)
   SystemClock_Config();
 
   /* USER CODE BEGIN SysInit */
+  BOOT_Mark(BOOT_PHASE_CLOCK);
+
+  // SystemClock_Config() has set up the NOMINAL profile (sysclk.h)
+  SYSCLK_Init();
+
+#if CONFIG_HSITRIM
+  // LSE on, TIM5 capturing it; the trim follows from the main loop
+  HSITRIM_Init();
+#endif
 
+#if CONFIG_TRACE
+  // Timestamps are CPU cycles, so start once the PLL is running
+  TRACE_Init();
+#endif
   /* USER CODE END SysInit */
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
   /* USER CODE BEGIN 2 */
-  // Initialize LCD in 4-bit mode
-  // Display startup animation and system status
-
-  LCD_Init();
-
-    // Play the rocket launch splash screen
-
-    playRocketAnimation();
-    HAL_Delay(2000); // Hold the "SYSTEM ONLINE" message
+  BOOT_Mark(BOOT_PHASE_GPIO);
+
+#if CONFIG_CONSOLE
+    // Commands are received from here on and run once the main loop starts
+    CONSOLE_Init();
+#endif
+
+#if CONFIG_TELEMETRY
+    // Binary records on USART1 (telemetry.h); nothing waits for the line
+    TELEM_Init();
+#endif
+
+#if CONFIG_INPUT_LOG
+    // Timestamps are ms since reset; a loaded replay image starts here
+    INPUTLOG_Init();
+#endif
+
+    if(BOOT_CanFastBoot()) {
+        // Warm reset, RTC running, LCD configured: straight to the clock
+        LCD_Resume();
+    } else {
+        // Initialize LCD in 4-bit mode, then start the splash screen
+        // (Assets/rocket.anim); the rest of the start-up runs while it
+        // plays, ANIM_Poll() draws the due frames
+        LCD_Init();
+        BOOT_LcdReady();
+        ANIM_Start(&animRocket);
+    }
+    BOOT_Mark(BOOT_PHASE_LCD);
 
-    // Continue with your original startup message or go straight to the clock
-    LCD_Clear();
-  LCD_WriteStringXY(0, 0, "Multi-Purpose");
-  LCD_WriteStringXY(1, 0, "Clock Ready!");
-  HAL_Delay(2000);
-  LCD_Clear();
-    //start the RTC so time begins from 00:00:00 here
+    // Start the RTC; it keeps its time if it was set before this reset
     MX_RTC_Init();
+    BOOT_Mark(BOOT_PHASE_RTC);
+    ANIM_Poll();
+
+    // Everything up to entering the first mode runs under the splash,
+    // with ANIM_Poll() between the steps so that no frame is late
+
+    // Backup SRAM: the stopwatch resumes from it in MODE_InitAll()
+    BACKUP_Init();
+
+#if CONFIG_KV_STORE
+    // Settings from flash, before the modes that use them
+    KV_Init();
+    applyRtcCalibration();
+    ANIM_Poll();
+#endif
+#if CONFIG_EVENT_LOG
+    // Audit trail: index it, add what a supply failure staged in backup
+    // SRAM, and note this reset
+    EVLOG_Init();
+    EVLOG_Record(EVLOG_RESET, &bootProfile.resetFlags, 1);
+    ANIM_Poll();
+#endif
+
+    // Report a dump the last fault left in backup SRAM, and arm the
+    // fault vectors that write the next one
+    CRASH_Init();
+
+    // Initialize every registered mode
+    MODE_InitAll();
+    BOOT_Mark(BOOT_PHASE_MODES);
+    ANIM_Poll();
+
+    // Show the rest of the splash unless a button cuts it short
+    finishSplash();
+    BOOT_Mark(BOOT_PHASE_SPLASH);
+
+    // Enter the first mode (or the one to resume); it draws from here
+    MODE_Start();
+
+#if CONFIG_POWER_FAIL
+    // Supply failure warning; its save path calls the modes' save hooks
+    POWER_Init();
+#endif
+
+#if CONFIG_BENCHMARK
+    // Benchmark build: time the drivers once, then run normally
+    BENCH_Run();
+#endif
+
+#if CONFIG_GOVERNOR
+    // From here the main loop's load picks the clock profile
+    GOV_Init();
+#endif
   /* USER CODE END 2 */
 
   /* Infinite loop */
   /* USER CODE BEGIN WHILE */
   // ================= MAIN APPLICATION LOOP =================
   // Handles input, updates stopwatch, and refreshes display
+  //
+  // Buttons are sampled every BUTTON_POLL_MS so short presses
+  // are never missed; the display is redrawn when the active
+  // mode's deadline expires or right after an input event.
   // =========================================================
+  uint32_t nextRedraw = HAL_GetTick();
 
   while (1)
   {
@@ -224,16 +290,48 @@ int main(void)
 //	      }
 //
 //	      HAL_Delay(200);
-	  handleButtons();
+#if CONFIG_TELEMETRY || CONFIG_GOVERNOR
+	  	          uint32_t loopStart = DWT_Cycles();
+#endif
+	  uint8_t input = handleButtons();
+
+#if CONFIG_CONSOLE
+	  	          // Commands may change the time or the stopwatch: redraw
+	  	          input |= CONSOLE_Poll();
+#endif
+
+	  	          // Periodic work of the active mode (e.g. stopwatch timing)
+	  	          MODE_Tick();
+
+#if CONFIG_MEMSTAT
+	  	          MEMSTAT_Poll();
+#endif
+#if CONFIG_HSITRIM
+	  	          // HSI measurement and trim (hsitrim.h)
+	  	          HSITRIM_Poll();
+#endif
 
-	  	          // Handle stopwatch timing
-	  	          if(currentMode == MODE_STOPWATCH) {
-	  	              handleStopwatch();
+	  	          // Update display
+	  	          if(input || (int32_t)(HAL_GetTick() - nextRedraw) >= 0) {
+	  	              updateDisplay();
+	  	              nextRedraw = HAL_GetTick() + MODE_NextDeadline();
+	  	              BOOT_Mark(BOOT_PHASE_FIRST_FRAME);
+#if CONFIG_TELEMETRY
+	  	              if(input) {
+	  	                  TELEM_Input(loopStart);
+	  	              }
+#endif
 	  	          }
 
-	  	          // Update display
-	  	          updateDisplay();
-	  	          HAL_Delay(1000);
+#if CONFIG_TELEMETRY
+	  	          TELEM_Loop(loopStart);
+	  	          TELEM_Poll();
+#endif
+#if CONFIG_GOVERNOR
+	  	          // Busy time of this pass; may switch the clock profile
+	  	          GOV_Poll(loopStart);
+#endif
+	  	          HAL_Delay(BUTTON_POLL_MS);
   }
   /* USER CODE END 3 */
 }
@@ -321,7 +419,11 @@ static void MX_RTC_Init(void)
   }
 
   /* USER CODE BEGIN Check_RTC_BKUP */
-
+  // Set before this reset (and kept by VBAT): leave the time alone
+  if(HAL_RTCEx_BKUPRead(&hrtc, BOOT_RTC_BKP_REG) == BOOT_RTC_MAGIC)
+  {
+    return;
+  }
   /* USER CODE END Check_RTC_BKUP */
 
   /** Initialize RTC and set the Time and Date
@@ -345,7 +447,7 @@ static void MX_RTC_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN RTC_Init 2 */
-
+  HAL_RTCEx_BKUPWrite(&hrtc, BOOT_RTC_BKP_REG, BOOT_RTC_MAGIC);
   /* USER CODE END RTC_Init 2 */
 
 }
@@ -405,366 +507,155 @@ static void MX_GPIO_Init(void)
 }
 
 /* USER CODE BEGIN 4 */
-// Display clock mode
-//Fetches time from RTC and formats it for a 16x2 LCD.
-void displayClock(void) {
-    char buffer[17];
-    // Fetch current time and date from RTC hardware
-
-    HAL_RTC_GetTime(&hrtc, &currentTime, RTC_FORMAT_BIN);
-    HAL_RTC_GetDate(&hrtc, &currentDate, RTC_FORMAT_BIN);
-
-    // Changed to exactly 16 characters
-    snprintf(buffer, sizeof(buffer), "T:%02d:%02d:%02d ",
-             currentTime.Hours, currentTime.Minutes, currentTime.Seconds);
-    LCD_WriteStringXY(0, 0, buffer);
-
-    // Second line
-    LCD_WriteStringXY(1, 0, "MODE>SW>SET");
-}
-
-// Display stopwatch mode
+#if CONFIG_KV_STORE
 /**
- * @brief Displays stopwatch time and status
+ * @brief Smooth calibration of the RTC from the rtc_calib setting
  *
- * Stopwatch time is derived from system tick counter
- * for millisecond-level resolution.
+ * Signed ppm, int16 little-endian; positive makes the RTC faster.
+ * Over the 32 s window each CALM pulse masks 2^-20 of the RTCCLK
+ * cycles (0.954 ppm) and CALP inserts 512 of them, so -487 .. +488 ppm
+ * can be set. Without a setting, or out of that range, the RTC is
+ * left as it is; a change takes effect at the next boot.
  */
-
-void displayStopwatch(void) {
-    char buffer[17];
-    uint32_t hours, minutes, seconds;
-
-    // Convert milliseconds to time components
-    seconds = stopwatchElapsed / 1000;
-    minutes = seconds / 60;
-    hours = minutes / 60;
-
-    seconds %= 60;
-    minutes %= 60;
-
-    // Display stopwatch on first line
-    snprintf(buffer, sizeof(buffer), "SW: %02lu:%02lu:%02lu",
-             hours, minutes, seconds);
-    LCD_WriteStringXY(0, 0, buffer);
-
-    // Display status and controls on second line - FIXED
-    if(stopwatchRunning) {
-        snprintf(buffer, sizeof(buffer), "Reset Mode Stop");
-    } else {
-        snprintf(buffer, sizeof(buffer), "Reset Mode Start");
+static void applyRtcCalibration(void) {
+    uint8_t value[2];
+    int32_t ppm;
+    int32_t minus;
+    uint32_t plus = RTC_SMOOTHCALIB_PLUSPULSES_RESET;
+
+    if(KV_Get(KV_KEY_RTC_CALIBRATION, value, sizeof(value)) != sizeof(value)) {
+        return;
+    }
+    ppm = (int16_t)(value[0] | (value[1] << 8));
+    if(ppm < -487 || ppm > 488) {
+        return;
     }
-    LCD_WriteStringXY(1, 0, buffer);
+    // Pulses to mask, rounded: ppm * 2^20 / 10^6
+    minus = -(ppm * 1048576 + (ppm < 0 ? -500000 : 500000)) / 1000000;
+    if(minus < 0) {
+        plus = RTC_SMOOTHCALIB_PLUSPULSES_SET;
+        minus += 512;
+    }
+    HAL_RTCEx_SetSmoothCalib(&hrtc, RTC_SMOOTHCALIB_PERIOD_32SEC, plus, (uint32_t)minus);
 }
+#endif
 
 // Update display based on current mode
 void updateDisplay(void) {
     LCD_Clear();
 
-    switch(currentMode) {
-        case MODE_CLOCK:
-            displayClock();
-            break;
-        case MODE_STOPWATCH:
-            displayStopwatch();
-            break;
-        case MODE_SETTINGS:
-            displaySettings();
-            break;
-    }
+    // View of the active mode (see mode.h)
+    MODE_Render();
 }
 
-// Handle mode button (PB9)
 /**
- * @brief Handles mode switching using MODE button
+ * @brief Debounced press detection for one active-low button
  *
- * Cycles through CLOCK → STOPWATCH → SETTINGS modes.
- * Software debouncing is implemented using HAL_GetTick().
+ * Returns 1 at most once every 300 ms while the button is held.
  */
-
-void handleModeButton(void) {
-    static uint32_t lastPress = 0;
-    // Debounce logic to prevent multiple triggers
-
-    if(HAL_GPIO_ReadPin(mode_pin_GPIO_Port, mode_pin_Pin) == GPIO_PIN_RESET) {
-        if(HAL_GetTick() - lastPress > 300) {
-            if(currentMode == MODE_CLOCK) {
-                currentMode = MODE_STOPWATCH;
-            } else if(currentMode == MODE_STOPWATCH) {
-                currentMode = MODE_SETTINGS;
-                // Initialize settings with current time
-                HAL_RTC_GetTime(&hrtc, &currentTime, RTC_FORMAT_BIN);
-                settingMode = SET_HOURS;
-            } else {
-                currentMode = MODE_CLOCK;
-            }
-            LCD_Clear();
-            lastPress = HAL_GetTick();
+static uint8_t buttonPressed(GPIO_TypeDef *port, uint16_t pin, uint32_t *lastPress) {
+    if(HAL_GPIO_ReadPin(port, pin) == GPIO_PIN_RESET) {
+        if(HAL_GetTick() - *lastPress > 300) {
+            *lastPress = HAL_GetTick();
+            return 1;
         }
     }
+    return 0;
 }
 
-// Handle stopwatch control buttons
-void handleStopwatchButtons(void) {
-    static uint32_t lastStartStop = 0;
-    static uint32_t lastReset = 0;
-
-    if(HAL_GPIO_ReadPin(start_stop_pin_GPIO_Port, start_stop_pin_Pin) == GPIO_PIN_RESET) {
-        if(HAL_GetTick() - lastStartStop > 300) {
-            if(!stopwatchRunning) {
-                stopwatchStartTime = HAL_GetTick() - stopwatchElapsed;
-                stopwatchRunning = 1;
-            } else {
-                stopwatchRunning = 0;
-            }
-            lastStartStop = HAL_GetTick();
-        }
-    }
-
-    if(HAL_GPIO_ReadPin(reset_pin_GPIO_Port, reset_pin_Pin) == GPIO_PIN_RESET) {
-        if(HAL_GetTick() - lastReset > 300 && !stopwatchRunning) {
-            stopwatchElapsed = 0;
-            lastReset = HAL_GetTick();
-        }
+// Time of the last accepted press of each button (ms)
+static uint32_t lastMode;
+static uint32_t lastSelect;
+static uint32_t lastIncrement;
+
+// Next debounced press, or 0 if there is none
+static uint8_t nextPress(UiEvent_t *event) {
+    if(buttonPressed(MODE_BUTTON_PORT, MODE_BUTTON_PIN, &lastMode)) {
+        *event = UI_EV_MODE;
+    } else if(buttonPressed(START_STOP_PORT, START_STOP_PIN, &lastSelect)) {
+        *event = UI_EV_SELECT;
+    } else if(buttonPressed(RESET_PORT, RESET_PIN, &lastIncrement)) {
+        *event = UI_EV_INC;
+    } else {
+        return 0;
     }
+    return 1;
 }
+
 /**
- * @brief Handles user input in SETTINGS mode
+ * @brief Let the splash animation run to its end
  *
- * START/STOP button switches between hour/minute/save fields.
- * RESET button increments selected field or confirms save.
+ * Any button press ends it early. That press only skips the splash;
+ * it is recorded like any other event, so a replay skips on the same
+ * tick.
  */
-
-void handleSettingsButtons(void) {
-    static uint32_t lastSelectPress = 0;
-    static uint32_t lastIncrementPress = 0;
-
-    // SELECT button (START/STOP) - Change setting field
-    if(HAL_GPIO_ReadPin(start_stop_pin_GPIO_Port, start_stop_pin_Pin) == GPIO_PIN_RESET) {
-        if(HAL_GetTick() - lastSelectPress > 300) {
-            if(settingMode == SET_HOURS) {
-                settingMode = SET_MINUTES;
-            } else if(settingMode == SET_MINUTES) {
-                settingMode = SET_SAVE;
-            } else {
-                settingMode = SET_HOURS;
+static void finishSplash(void) {
+    UiEvent_t event;
+
+    while(ANIM_Poll()) {
+#if CONFIG_INPUT_LOG
+        if(INPUTLOG_Replaying()) {
+            if(INPUTLOG_NextReplayed(&event)) {
+                ANIM_Stop();
             }
-            lastSelectPress = HAL_GetTick();
+        } else if(nextPress(&event)) {
+            INPUTLOG_RecordEvent(event);
+            ANIM_Stop();
         }
-    }
-
-    // INCREMENT button (RESET) - Increase value or save
-    if(HAL_GPIO_ReadPin(reset_pin_GPIO_Port, reset_pin_Pin) == GPIO_PIN_RESET) {
-        if(HAL_GetTick() - lastIncrementPress > 300) {
-            if(settingMode == SET_HOURS) {
-                currentTime.Hours = (currentTime.Hours + 1) % 24;
-            } else if(settingMode == SET_MINUTES) {
-                currentTime.Minutes = (currentTime.Minutes + 1) % 60;
-            } else if(settingMode == SET_SAVE) {
-                // Save to RTC
-                currentTime.TimeFormat = RTC_HOURFORMAT_24;
-                currentTime.DayLightSaving = RTC_DAYLIGHTSAVING_NONE;
-                currentTime.StoreOperation = RTC_STOREOPERATION_RESET;
-                HAL_RTC_SetTime(&hrtc, &currentTime, RTC_FORMAT_BIN);
-
-                // Return to clock mode
-                currentMode = MODE_CLOCK;
-            }
-            lastIncrementPress = HAL_GetTick();
+#else
+        if(nextPress(&event)) {
+            ANIM_Stop();
         }
-    }
-}
-// Main button handler
-void handleButtons(void) {
-    handleModeButton();
-
-    if(currentMode == MODE_STOPWATCH) {
-        handleStopwatchButtons();
-    } else if(currentMode == MODE_SETTINGS) {
-        handleSettingsButtons();
+#endif
+        HAL_Delay(BUTTON_POLL_MS);
     }
 }
 
-// Handle stopwatch control buttons
-void handleStopwatch(void) {
-    if(stopwatchRunning) {
-        stopwatchElapsed = HAL_GetTick() - stopwatchStartTime;
-    }
+// Record a debounced event for replay, then hand it to the modes
+static void dispatchInput(UiEvent_t event) {
+#if CONFIG_INPUT_LOG
+    INPUTLOG_RecordEvent(event);
+#endif
+    MODE_Dispatch(event);
 }
-// Display settings mode
+
 /**
- * @brief Displays time-setting interface on LCD
+ * @brief Main button handler
  *
- * Selected field blinks at 500ms interval for user feedback.
- * Brackets indicate the currently editable field.
+ * Converts debounced button presses into UI events. MODE cycles
+ * through the registered modes; what the other events do is up
+ * to the active mode.
+ *
+ * @retval 1 if at least one event was dispatched
  */
-
-void displaySettings(void) {
-    char buffer[17];
-    // Software-controlled blink for selected field
-
-    // Blink every 500ms
-    static uint32_t lastBlink = 0;
-    static uint8_t blinkState = 1;
-    if (HAL_GetTick() - lastBlink > 500) {
-        blinkState = !blinkState;
-        lastBlink = HAL_GetTick();
-    }
-
-    // First line: Setting instruction
-    switch (settingMode) {
-        case SET_HOURS:
-            LCD_WriteStringXY(0, 0, "Set Hours:      "); // padded to clear line
-            break;
-        case SET_MINUTES:
-            LCD_WriteStringXY(0, 0, "Set Minutes:    ");
-            break;
-        case SET_SAVE:
-            LCD_WriteStringXY(0, 0, "Save Time?      ");
-            LCD_WriteStringXY(1, 0, "Press INC to save");
-            return; // fine — we only update static screen here
+uint8_t handleButtons(void) {
+    uint8_t input = 0;
+
+#if CONFIG_INPUT_LOG
+    // Replay: the recorded events on their original ticks, pins ignored
+    if(INPUTLOG_Replaying()) {
+        UiEvent_t event;
+        while(INPUTLOG_NextReplayed(&event)) {
+            MODE_Dispatch(event);
+            input = 1;
+        }
+        return input | INPUTLOG_ReplayApplied();
     }
+#endif
 
-    // Second line: Time display with stable brackets
-    if (settingMode == SET_HOURS) {
-        if (blinkState)
-            snprintf(buffer, sizeof(buffer), "[%02d]:%02d  ", currentTime.Hours, currentTime.Minutes);
-        else
-            snprintf(buffer, sizeof(buffer), " %02d :%02d  ", currentTime.Hours, currentTime.Minutes);
-    } else if (settingMode == SET_MINUTES) {
-        if (blinkState)
-            snprintf(buffer, sizeof(buffer), " %02d:[%02d] ", currentTime.Hours, currentTime.Minutes);
-        else
-            snprintf(buffer, sizeof(buffer), " %02d : %02d  ", currentTime.Hours, currentTime.Minutes);
+    if(buttonPressed(MODE_BUTTON_PORT, MODE_BUTTON_PIN, &lastMode)) {
+        dispatchInput(UI_EV_MODE);
+        input = 1;
     }
-
-    LCD_WriteStringXY(1, 0, buffer);
-}
-// 1. Define the pixel data for the rocket and flames (4 custom characters)
-/* ================= LCD CUSTOM CHARACTERS =================
- * Custom CGRAM characters used for startup animation.
- * Adds visual feedback and improves system aesthetics.
- * ========================================================= */
-
-// Character 0: The top of the rocket
-uint8_t rocket_top[8] = {
-    0b00100, //   *
-    0b01110, //  ***
-    0b01110, //  ***
-    0b01110, //  ***
-    0b01110, //  ***
-    0b01110, //  ***
-    0b01110, //  ***
-    0b00000
-};
-
-// Character 1: The bottom of the rocket with fins
-uint8_t rocket_bottom[8] = {
-    0b01110, //  ***
-    0b01110, //  ***
-    0b11111, // *****
-    0b11111, // *****
-    0b11111, // *****
-    0b10101, // * * *
-    0b10101, // * * *
-    0b00000
-};
-
-// Character 2: The first frame of the flame animation
-uint8_t flame_1[8] = {
-    0b00100, //   *
-    0b01110, //  ***
-    0b10101, // * * *
-    0b01110, //  ***
-    0b11111, // *****
-    0b01010, //  * *
-    0b10101, // * * *
-    0b00100
-};
-
-// Character 3: The second frame of the flame animation
-uint8_t flame_2[8] = {
-    0b01110, //  ***
-    0b11111, // *****
-    0b01110, //  ***
-    0b11111, // *****
-    0b10101, // * * *
-    0b11111, // *****
-    0b01110, //  ***
-    0b00100
-};
-
-
-// Make sure you have this function in parallel_lcd.c and its prototype in parallel_lcd.h
-/*
-void LCD_CreateChar(uint8_t location, uint8_t charmap[]) {
-    location &= 0x07; // We only have 8 locations 0-7
-    LCD_Command(0x40 | (location << 3)); // Set CGRAM Address
-    for (int i=0; i<8; i++) {
-        LCD_WriteChar(charmap[i]);
+    if(buttonPressed(START_STOP_PORT, START_STOP_PIN, &lastSelect)) {
+        dispatchInput(UI_EV_SELECT);
+        input = 1;
     }
-}
-*/
-
-/**
- * @brief Displays startup rocket animation on LCD
- *
- * Uses LCD CGRAM custom characters for visual effects.
- * Enhances user experience during system startup.
- */
-
-// 2. Create the animation function
-void playRocketAnimation(void) {
-    // Load the custom characters into the LCD's memory
-    LCD_CreateChar(0, rocket_top);
-    LCD_CreateChar(1, rocket_bottom);
-    LCD_CreateChar(2, flame_1);
-    LCD_CreateChar(3, flame_2);
-
-    LCD_Clear();
-
-    // -- Phase 1: Ignition --
-    // Place the rocket on the "ground" (bottom line)
-    LCD_SetCursor(1, 7); // Center on bottom line
-    LCD_WriteChar(1);    // Draw the rocket bottom
-
-    // Flicker the flames for a bit
-    for (int i = 0; i < 6; i++) {
-        LCD_SetCursor(1, 7);
-        LCD_WriteChar(2); // Draw flame 1
-        HAL_Delay(80);
-        LCD_SetCursor(1, 7);
-        LCD_WriteChar(3); // Draw flame 2
-        HAL_Delay(80);
+    if(buttonPressed(RESET_PORT, RESET_PIN, &lastIncrement)) {
+        dispatchInput(UI_EV_INC);
+        input = 1;
     }
-
-    // -- Phase 2: Launch --
-    // Frame 1: Full rocket with flames
-    LCD_Clear();
-    LCD_SetCursor(0, 7); // Top part of rocket on line 0
-    LCD_WriteChar(0);
-    LCD_SetCursor(1, 7); // Bottom part of rocket on line 1
-    LCD_WriteChar(1);
-    HAL_Delay(150);
-
-    // Frame 2: Rocket moves up
-    LCD_Clear();
-    LCD_SetCursor(0, 7); // Full rocket now on line 0
-    LCD_WriteChar(0);
-    LCD_SetCursor(1, 7); // Flames are now on line 1
-    LCD_WriteChar(2);
-    HAL_Delay(150);
-
-    // Frame 3: Rocket flies off screen
-    LCD_Clear();
-    LCD_SetCursor(0, 7); // Only flames remain on line 0
-    LCD_WriteChar(3);
-    HAL_Delay(150);
-
-    // -- Phase 3: Reveal Text --
-    LCD_Clear();
-    LCD_WriteStringXY(0, 2, "SYSTEM ONLINE");
-    LCD_WriteStringXY(1, 0, "----------------");
+    return input;
 }
 
 /* ... rest of your functions like displayClock, handleButtons, etc. ... */
@@ -778,10 +669,8 @@ void Error_Handler(void)
 {
   /* USER CODE BEGIN Error_Handler_Debug */
   /* User can add his own implementation to report the HAL error return state */
-  __disable_irq();
-  while (1)
-  {
-  }
+  // Dump to backup SRAM and reset instead of hanging (crash.h)
+  CRASH_Error((uint32_t)(uintptr_t)__builtin_return_address(0));
   /* USER CODE END Error_Handler_Debug */
 }
 #ifdef USE_FULL_ASSERT
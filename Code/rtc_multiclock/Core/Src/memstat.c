@@ -0,0 +1,75 @@
+/**
+ * @file    memstat.c
+ * @brief   Stack painting and high-water-mark scan
+ *
+ * RAM layout (see sysmem.c):
+ *
+ *   | .data | .bss | heap ->   painted   <- MSP stack |
+ *                  ^_end     ^break             _estack^
+ *
+ * The scan walks up from the highest heap break; the first word
+ * that no longer holds the paint is the deepest the stack has been.
+ */
+
+#include "memstat.h"
+
+#if CONFIG_MEMSTAT
+
+#include "main.h"
+
+// Words kept free below the stack pointer while painting
+#define MEMSTAT_PAINT_GUARD  8U
+
+extern uint8_t _end;
+extern uint8_t _estack;
+extern uint32_t _Min_Stack_Size;
+extern uint32_t _Min_Heap_Size;
+
+// From sysmem.c
+extern uint32_t sbrkPeakBytes;
+extern uint32_t sbrkFailCount;
+extern uint32_t sbrkFailLast;
+
+static uint32_t *stackLowest;     // Lowest stack word seen in use
+static uint32_t nextScanTick;
+
+void MEMSTAT_PaintStack(void) {
+    uint32_t *p = (uint32_t *)(((uint32_t)&_end + 3U) & ~3U);
+    uint32_t *top = (uint32_t *)__get_MSP() - MEMSTAT_PAINT_GUARD;
+
+    while(p < top) {
+        *p++ = MEMSTAT_PAINT;
+    }
+    stackLowest = top;
+}
+
+void MEMSTAT_Scan(void) {
+    uint32_t *p = (uint32_t *)(((uint32_t)&_end + sbrkPeakBytes + 3U) & ~3U);
+
+    // Only words below the previous mark can have changed
+    while(p < stackLowest && *p == MEMSTAT_PAINT) {
+        p++;
+    }
+    stackLowest = p;
+}
+
+void MEMSTAT_Poll(void) {
+    if((int32_t)(HAL_GetTick() - nextScanTick) >= 0) {
+        MEMSTAT_Scan();
+        nextScanTick = HAL_GetTick() + CONFIG_MEMSTAT_SCAN_MS;
+    }
+}
+
+void MEMSTAT_Get(MemStats_t *stats) {
+    uint32_t heapTop = (uint32_t)&_end + sbrkPeakBytes;
+
+    stats->stackReserved = (uint32_t)&_Min_Stack_Size;
+    stats->stackPeak = (uint32_t)&_estack - (uint32_t)stackLowest;
+    stats->heapReserved = (uint32_t)&_Min_Heap_Size;
+    stats->heapPeak = sbrkPeakBytes;
+    stats->heapFailures = sbrkFailCount;
+    stats->heapFailLast = sbrkFailLast;
+    stats->freeGap = ((uint32_t)stackLowest > heapTop) ? (uint32_t)stackLowest - heapTop : 0U;
+}
+
+#endif /* CONFIG_MEMSTAT */
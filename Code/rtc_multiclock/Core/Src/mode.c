@@ -0,0 +1,160 @@
+/**
+ * @file    mode.c
+ * @brief   Link-time mode registry and mode switching
+ *
+ * The registry is the 'mode_registry' linker section: an array of
+ * const Mode_t descriptors in flash, bounded by the symbols
+ * __start_mode_registry / __stop_mode_registry. Modes that are
+ * compiled out simply never appear in it.
+ */
+
+#include "mode.h"
+#include "dwt.h"
+#include "trace.h"
+
+/* ================== REGISTRY BOUNDS ==================
+ * Defined by the linker script on target; generated
+ * automatically by GNU ld for the host build.
+ * ===================================================== */
+
+extern const Mode_t __start_mode_registry[];
+extern const Mode_t __stop_mode_registry[];
+
+#define MODE_FIRST  (__start_mode_registry)
+#define MODE_END    (__stop_mode_registry)
+
+#define MODE_DEFAULT_DEADLINE_MS  1000
+
+static const Mode_t *activeMode = NULL;
+static ModeSwitchStats_t switchStats;
+
+/* ================== LOCAL HELPERS ================== */
+
+// 1 if 'a' comes before 'b' in the cycle: by 'order', then by place
+// in the registry, so modes that share an order are all reached
+static uint8_t MODE_Before(const Mode_t *a, const Mode_t *b) {
+    return a->order < b->order || (a->order == b->order && a < b);
+}
+
+// First mode of the cycle
+static const Mode_t *MODE_Lowest(void) {
+    const Mode_t *best = NULL;
+
+    for(const Mode_t *m = MODE_FIRST; m < MODE_END; m++) {
+        if(best == NULL || MODE_Before(m, best)) {
+            best = m;
+        }
+    }
+    return best;
+}
+
+// Next mode in the cycle after 'cur' (wraps to the lowest)
+static const Mode_t *MODE_Next(const Mode_t *cur) {
+    const Mode_t *best = NULL;
+
+    for(const Mode_t *m = MODE_FIRST; m < MODE_END; m++) {
+        if(MODE_Before(cur, m) && (best == NULL || MODE_Before(m, best))) {
+            best = m;
+        }
+    }
+    return (best != NULL) ? best : MODE_Lowest();
+}
+
+// Leave the active mode and enter 'next', timing the hand-over
+static void MODE_SwitchTo(const Mode_t *next) {
+    uint32_t start = DWT_Cycles();
+
+    if(activeMode != NULL && activeMode->exit != NULL) {
+        activeMode->exit();
+    }
+    activeMode = next;
+    TRACE(TRACE_MODE_SWITCH, (activeMode != NULL) ? activeMode->order : 0xFFFFU);
+    if(activeMode != NULL && activeMode->enter != NULL) {
+        activeMode->enter();
+    }
+
+    switchStats.last = DWT_Cycles() - start;
+    if(switchStats.last > switchStats.max) {
+        switchStats.max = switchStats.last;
+    }
+    switchStats.count++;
+}
+
+/* ================== PUBLIC API ================== */
+
+void MODE_InitAll(void) {
+    DWT_CycleCounterInit();
+
+    for(const Mode_t *m = MODE_FIRST; m < MODE_END; m++) {
+        if(m->init != NULL) {
+            m->init();
+        }
+    }
+    activeMode = NULL;
+}
+
+void MODE_Start(void) {
+    for(const Mode_t *m = MODE_FIRST; m < MODE_END; m++) {
+        if(m->resume != NULL && m->resume()) {
+            MODE_SwitchTo(m);
+            return;
+        }
+    }
+    MODE_SwitchTo(MODE_Lowest());
+}
+
+void MODE_SaveAll(void) {
+    for(const Mode_t *m = MODE_FIRST; m < MODE_END; m++) {
+        if(m->save != NULL) {
+            m->save();
+        }
+    }
+}
+
+void MODE_Dispatch(UiEvent_t event) {
+    if(activeMode == NULL) {
+        return;
+    }
+
+    TRACE(TRACE_UI_EVENT, event);
+    if(event == UI_EV_MODE) {
+        MODE_SwitchTo(MODE_Next(activeMode));
+    } else if(activeMode->on_event != NULL) {
+        activeMode->on_event(event);
+    }
+}
+
+void MODE_Home(void) {
+    MODE_SwitchTo(MODE_Lowest());
+}
+
+void MODE_Tick(void) {
+    if(activeMode != NULL && activeMode->tick != NULL) {
+        activeMode->tick();
+    }
+}
+
+void MODE_Render(void) {
+    if(activeMode != NULL && activeMode->render != NULL) {
+        activeMode->render();
+    }
+}
+
+uint32_t MODE_NextDeadline(void) {
+    if(activeMode != NULL && activeMode->deadline != NULL) {
+        return activeMode->deadline();
+    }
+    return MODE_DEFAULT_DEADLINE_MS;
+}
+
+const Mode_t *MODE_Active(void) {
+    return activeMode;
+}
+
+uint8_t MODE_Count(void) {
+    return (uint8_t)(MODE_END - MODE_FIRST);
+}
+
+const ModeSwitchStats_t *MODE_GetSwitchStats(void) {
+    return &switchStats;
+}
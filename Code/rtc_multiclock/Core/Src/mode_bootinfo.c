@@ -0,0 +1,76 @@
+/**
+ * @file    mode_bootinfo.c
+ * @brief   BOOTINFO debug view: the boot-time profile (boot.h)
+ *
+ *   COLD BOOT 5592ms     boot type, reset to first clock frame
+ *   SPLASH  5377.2ms     one phase and its duration
+ *
+ * Only built with CONFIG_MODE_BOOTINFO=1; sits at the end of the
+ * MODE cycle. INC steps through the phases, SELECT prints the
+ * profile on stdout (BOOT_Dump()).
+ */
+
+#include "app_config.h"
+
+#if CONFIG_MODE_BOOTINFO
+
+#include "mode.h"
+#include "boot.h"
+#include "parallel_lcd.h"
+#include "fmt.h"
+
+static BootPhase_t shownPhase;
+
+// Next phase after 'phase' that this boot went through
+static BootPhase_t nextMarked(BootPhase_t phase) {
+    for(uint8_t i = 1; i <= BOOT_PHASE_COUNT; i++) {
+        BootPhase_t p = (BootPhase_t)((phase + i) % BOOT_PHASE_COUNT);
+        if(bootProfile.marked & (1U << p)) {
+            return p;
+        }
+    }
+    return phase;
+}
+
+static void bootinfoEnter(void) {
+    LCD_Clear();
+    shownPhase = nextMarked(BOOT_PHASE_FIRST_FRAME);
+}
+
+static void bootinfoEvent(UiEvent_t event) {
+    if(event == UI_EV_INC) {
+        shownPhase = nextMarked(shownPhase);
+    } else if(event == UI_EV_SELECT) {
+        BOOT_Dump();
+    }
+}
+
+static void displayBootinfo(void) {
+    char buffer[17];
+    uint32_t us = BOOT_PhaseUs(shownPhase);
+
+    FMT_Format(buffer, sizeof(buffer), "%s%5lums",
+               bootProfile.fast ? "FAST BOOT" : "COLD BOOT",
+               (unsigned long)(bootProfile.us[BOOT_PHASE_FIRST_FRAME] / 1000U));
+    LCD_WriteStringXY(0, 0, buffer);
+
+    LCD_WriteStringXY(1, 0, (char *)BOOT_PhaseName(shownPhase));
+    FMT_Format(buffer, sizeof(buffer), "%4lu.%lums",
+               (unsigned long)(us / 1000U), (unsigned long)((us / 100U) % 10U));
+    LCD_WriteStringXY(1, 8, buffer);
+}
+
+static uint32_t bootinfoDeadline(void) {
+    return 1000;
+}
+
+MODE_REGISTER(modeBootinfo) = {
+    .name     = "BOOTINFO",
+    .enter    = bootinfoEnter,
+    .on_event = bootinfoEvent,
+    .render   = displayBootinfo,
+    .deadline = bootinfoDeadline,
+    .order    = 4,
+};
+
+#endif /* CONFIG_MODE_BOOTINFO */
@@ -0,0 +1,100 @@
+/**
+ * @file    mode_clock.c
+ * @brief   CLOCK mode: live RTC time display
+ */
+
+#include "app_config.h"
+
+#if CONFIG_MODE_CLOCK
+
+#include "mode.h"
+#include "parallel_lcd.h"
+#include "trace.h"
+#include "fmt.h"
+#include "kvstore.h"
+
+extern RTC_HandleTypeDef hrtc;
+
+// Current real-time clock values fetched from hardware RTC (BCD)
+RTC_TimeTypeDef currentTime;
+RTC_DateTypeDef currentDate;
+
+static void clockEnter(void) {
+    LCD_Clear();
+}
+
+// hour_format (kvstore.h): 1 for 12 hours with AM / PM, else 24 hours.
+// Looked up on each frame, so a change from the console shows at once.
+static uint8_t clockTwelveHours(void) {
+#if CONFIG_KV_STORE
+    uint8_t format;
+
+    return KV_Get(KV_KEY_HOUR_FORMAT, &format, sizeof(format)) == 1U && format == 12U;
+#else
+    return 0;
+#endif
+}
+
+// Display clock mode
+//Fetches time from RTC and formats it for a 16x2 LCD.
+static void displayClock(void) {
+    char buffer[17];
+    char *p = buffer;
+    uint8_t hours;
+    const char *suffix = "   ";
+    // Fetch current time and date from RTC hardware.
+    // The registers are BCD already, so the digits need no division.
+
+    TRACE(TRACE_RTC_READ_BEGIN, 0);
+    HAL_RTC_GetTime(&hrtc, &currentTime, RTC_FORMAT_BCD);
+    HAL_RTC_GetDate(&hrtc, &currentDate, RTC_FORMAT_BCD);
+    TRACE(TRACE_RTC_READ_END, 0);
+
+    // "T:hh:mm:ss AM", "T:hh:mm:ss   " (24 hours: the AM / PM cleared)
+    hours = currentTime.Hours;
+    if(clockTwelveHours()) {
+        uint8_t h = (uint8_t)((hours >> 4) * 10U + (hours & 0x0FU));
+
+        suffix = (h < 12U) ? " AM" : " PM";
+        h = (h % 12U == 0U) ? 12U : h % 12U;
+        hours = (uint8_t)(((h / 10U) << 4) | (h % 10U));
+    }
+    p = FMT_Str(p, "T:");
+    p = FMT_BcdTime(p, ((uint32_t)hours << 16) |
+                       ((uint32_t)currentTime.Minutes << 8) | currentTime.Seconds);
+    p = FMT_Str(p, suffix);
+    *p = '\0';
+    LCD_WriteStringXY(0, 0, buffer);
+
+    // Second line
+    LCD_WriteStringXY(1, 0, "MODE>SW>SET");
+}
+
+/**
+ * @brief Time until the RTC's next second boundary
+ *
+ * SSR counts down from SynchPrediv to 0 during each second, so the
+ * remaining part of the second is SSR / (SynchPrediv + 1). Redrawing
+ * just after each boundary means no second is ever skipped on screen.
+ */
+static uint32_t clockDeadline(void) {
+    RTC_TimeTypeDef now;
+    RTC_DateTypeDef today;
+
+    TRACE(TRACE_RTC_READ_BEGIN, 1);
+    HAL_RTC_GetTime(&hrtc, &now, RTC_FORMAT_BIN);
+    HAL_RTC_GetDate(&hrtc, &today, RTC_FORMAT_BIN); // Unlocks the shadow registers
+    TRACE(TRACE_RTC_READ_END, 1);
+
+    return (now.SubSeconds * 1000U) / (now.SecondFraction + 1U) + 1U;
+}
+
+MODE_REGISTER(modeClock) = {
+    .name     = "CLOCK",
+    .enter    = clockEnter,
+    .render   = displayClock,
+    .deadline = clockDeadline,
+    .order    = 0,
+};
+
+#endif /* CONFIG_MODE_CLOCK */
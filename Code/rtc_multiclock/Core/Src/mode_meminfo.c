@@ -0,0 +1,62 @@
+/**
+ * @file    mode_meminfo.c
+ * @brief   MEMINFO debug view: stack and heap high-water marks
+ *
+ *   STK  612/1024 B     peak stack use / _Min_Stack_Size ('!' = over)
+ *   HP   436/ 512 F 0   peak heap break / _Min_Heap_Size, refused _sbrk
+ *
+ * Only built with CONFIG_MODE_MEMINFO=1; sits after SETTINGS in the
+ * MODE cycle. INC forces a fresh scan.
+ */
+
+#include "app_config.h"
+
+#if CONFIG_MODE_MEMINFO
+
+#include "mode.h"
+#include "memstat.h"
+#include "parallel_lcd.h"
+#include "fmt.h"
+
+static void meminfoEnter(void) {
+    LCD_Clear();
+    MEMSTAT_Scan();
+}
+
+static void meminfoEvent(UiEvent_t event) {
+    if(event == UI_EV_INC) {
+        MEMSTAT_Scan();
+    }
+}
+
+static void displayMeminfo(void) {
+    char buffer[17];
+    MemStats_t stats;
+
+    MEMSTAT_Get(&stats);
+
+    FMT_Format(buffer, sizeof(buffer), "STK %4lu/%4lu %c ",
+             (unsigned long)stats.stackPeak, (unsigned long)stats.stackReserved,
+             (stats.stackPeak > stats.stackReserved) ? '!' : 'B');
+    LCD_WriteStringXY(0, 0, buffer);
+
+    FMT_Format(buffer, sizeof(buffer), "HP %4lu/%4lu F%2lu",
+             (unsigned long)stats.heapPeak, (unsigned long)stats.heapReserved,
+             (unsigned long)stats.heapFailures);
+    LCD_WriteStringXY(1, 0, buffer);
+}
+
+static uint32_t meminfoDeadline(void) {
+    return 500;
+}
+
+MODE_REGISTER(modeMeminfo) = {
+    .name     = "MEMINFO",
+    .enter    = meminfoEnter,
+    .on_event = meminfoEvent,
+    .render   = displayMeminfo,
+    .deadline = meminfoDeadline,
+    .order    = 3,
+};
+
+#endif /* CONFIG_MODE_MEMINFO */
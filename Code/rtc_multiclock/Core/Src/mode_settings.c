@@ -0,0 +1,256 @@
+/**
+ * @file    mode_settings.c
+ * @brief   SETTINGS mode: set hours and minutes with the push buttons
+ *
+ * START/STOP button switches between hour/minute/save fields.
+ * RESET button increments selected field or confirms save.
+ * Field selection follows the UI_SETTING_* table in ui_fsm.h.
+ *
+ * An edit that the supply failure (power.h) cut short is kept in the
+ * backup SRAM; the next boot starts in SETTINGS with it.
+ */
+
+#include "app_config.h"
+
+#if CONFIG_MODE_SETTINGS
+
+#include "mode.h"
+#include "input_log.h"
+#include "eventlog.h"
+#include "stopwatch.h"
+#include "parallel_lcd.h"
+#include "fmt.h"
+#include "backup.h"
+#include "crc16.h"
+#include <stddef.h>
+
+extern RTC_HandleTypeDef hrtc;
+
+// Time being edited (loaded from the RTC when the mode is entered)
+static RTC_TimeTypeDef editTime;
+static uint8_t settingBlink = 1;
+static Fsm_t settingFsm;
+static uint8_t settingsActive;
+
+#if CONFIG_POWER_FAIL
+// Edit restored from the backup SRAM, taken over by the next enter
+static SettingsBackup_t settingsResume;
+#endif
+
+static void displaySetHours(void);
+static void displaySetMinutes(void);
+static void displaySetSave(void);
+static void incrementHours(void);
+static void incrementMinutes(void);
+static void saveTime(void);
+
+/* ================= STATE TABLE =================
+ * Generated from UI_SETTING_* in ui_fsm.h.
+ * =============================================== */
+
+#define SET_CELL(state, event, guard, action, next) \
+    FSM_CELL(UI_EV_COUNT, state, event, guard, action, next)
+
+static const FsmStateDesc_t settingStates[SET_COUNT] = {
+    UI_SETTING_STATES(FSM_STATE_DESC)
+};
+
+static const FsmTransition_t settingTable[SET_COUNT * UI_EV_COUNT] = {
+    UI_SETTING_TRANSITIONS(SET_CELL)
+};
+
+static const FsmDef_t settingFsmDef = {
+    settingStates, settingTable, SET_COUNT, UI_EV_COUNT
+};
+
+/* ================= ACTIONS ================= */
+
+static void incrementHours(void) {
+    editTime.Hours = (editTime.Hours + 1) % 24;
+}
+
+static void incrementMinutes(void) {
+    editTime.Minutes = (editTime.Minutes + 1) % 60;
+}
+
+// Commit edited time to the RTC and return to the first mode
+static void saveTime(void) {
+#if CONFIG_EVENT_LOG
+    uint32_t before = EVLOG_Now();
+#endif
+
+    editTime.TimeFormat = RTC_HOURFORMAT_24;
+    editTime.DayLightSaving = RTC_DAYLIGHTSAVING_NONE;
+    editTime.StoreOperation = RTC_STOREOPERATION_RESET;
+    HAL_RTC_SetTime(&hrtc, &editTime, RTC_FORMAT_BIN);
+#if CONFIG_INPUT_LOG
+    INPUTLOG_RecordRtc(&editTime, INPUTLOG_KIND_RTC_UI);
+#endif
+#if CONFIG_EVENT_LOG
+    EVLOG_TimeChanged(before);
+#endif
+#if CONFIG_MODE_STOPWATCH
+    STOPWATCH_ClockChanged();
+#endif
+
+    MODE_Home();
+}
+
+/* ================= MODE CALLBACKS ================= */
+
+#if CONFIG_POWER_FAIL
+static uint16_t settingsBackupCrc(const SettingsBackup_t *copy) {
+    return CRC16_Update(CRC16_INIT, copy, offsetof(SettingsBackup_t, crc));
+}
+
+// Supply failing: keep an edit in progress
+static void settingsSave(void) {
+    SettingsBackup_t *copy = &BACKUP_SRAM->settings;
+
+    if(!settingsActive) {
+        return;
+    }
+    copy->magic = SETTINGS_BACKUP_MAGIC;
+    copy->hours = editTime.Hours;
+    copy->minutes = editTime.Minutes;
+    copy->state = settingFsm.state;
+    copy->reserved = 0;
+    copy->crc = settingsBackupCrc(copy);
+}
+
+static uint8_t settingsResumed(void) {
+    return settingsResume.magic == SETTINGS_BACKUP_MAGIC;
+}
+#endif
+
+// Take over an edit saved at a supply failure; the copy is used once
+static void settingsInit(void) {
+#if CONFIG_POWER_FAIL
+    SettingsBackup_t *copy = &BACKUP_SRAM->settings;
+
+    settingsResume.magic = 0;
+    if(copy->magic == SETTINGS_BACKUP_MAGIC && copy->crc == settingsBackupCrc(copy) &&
+       copy->hours < 24U && copy->minutes < 60U && copy->state < SET_COUNT) {
+        settingsResume = *copy;
+    }
+    copy->magic = 0;
+#endif
+    settingsActive = 0;
+}
+
+// Enter SETTINGS: start editing from the current RTC time, or go on
+// with the edit saved at a supply failure
+static void settingsEnter(void) {
+    FsmState_t state = UI_SETTING_INITIAL;
+
+    LCD_Clear();
+    HAL_RTC_GetTime(&hrtc, &editTime, RTC_FORMAT_BIN);
+#if CONFIG_POWER_FAIL
+    if(settingsResumed()) {
+        editTime.Hours = settingsResume.hours;
+        editTime.Minutes = settingsResume.minutes;
+        state = settingsResume.state;
+        settingsResume.magic = 0;
+    }
+#endif
+    FSM_Init(&settingFsm, &settingFsmDef, state);
+    settingsActive = 1;
+}
+
+static void settingsExit(void) {
+    settingsActive = 0;
+}
+
+static void settingsEvent(UiEvent_t event) {
+    FSM_Dispatch(&settingFsm, event);
+}
+
+// Redraw often enough for the 500 ms blink
+static uint32_t settingsDeadline(void) {
+    return 250;
+}
+
+// Display settings mode
+/**
+ * @brief Displays time-setting interface on LCD
+ *
+ * Selected field blinks at 500ms interval for user feedback.
+ * Brackets indicate the currently editable field.
+ */
+static void displaySettings(void) {
+    // Software-controlled blink for selected field
+
+    // Blink every 500ms
+    static uint32_t lastBlink = 0;
+    if (HAL_GetTick() - lastBlink > 500) {
+        settingBlink = !settingBlink;
+        lastBlink = HAL_GetTick();
+    }
+
+    // Sub-state view (see UI_SETTING_STATES)
+    FSM_Render(&settingFsm);
+}
+
+/**
+ * @brief Second line of the edit views: <pre>hh<mid>mm<post>
+ *
+ * Hours and minutes are kept in binary while editing (they are
+ * incremented), so the table-driven decimal writer is used here.
+ */
+static void writeEditTime(char buffer[17], const char *pre, const char *mid, const char *post) {
+    char *p = buffer;
+
+    p = FMT_Str(p, pre);
+    p = FMT_Dec2(p, editTime.Hours);
+    p = FMT_Str(p, mid);
+    p = FMT_Dec2(p, editTime.Minutes);
+    p = FMT_Str(p, post);
+    *p = '\0';
+}
+
+static void displaySetHours(void) {
+    char buffer[17];
+
+    LCD_WriteStringXY(0, 0, "Set Hours:      "); // padded to clear line
+
+    // Second line: Time display with stable brackets
+    if (settingBlink)
+        writeEditTime(buffer, "[", "]:", "  ");
+    else
+        writeEditTime(buffer, " ", " :", "  ");
+    LCD_WriteStringXY(1, 0, buffer);
+}
+
+static void displaySetMinutes(void) {
+    char buffer[17];
+
+    LCD_WriteStringXY(0, 0, "Set Minutes:    ");
+
+    if (settingBlink)
+        writeEditTime(buffer, " ", ":[", "] ");
+    else
+        writeEditTime(buffer, " ", " : ", "  ");
+    LCD_WriteStringXY(1, 0, buffer);
+}
+
+static void displaySetSave(void) {
+    LCD_WriteStringXY(0, 0, "Save Time?      ");
+    LCD_WriteStringXY(1, 0, "INC to save time"); // 16 columns
+}
+
+MODE_REGISTER(modeSettings) = {
+    .name     = "SETTINGS",
+    .init     = settingsInit,
+    .enter    = settingsEnter,
+    .exit     = settingsExit,
+    .on_event = settingsEvent,
+    .render   = displaySettings,
+    .deadline = settingsDeadline,
+#if CONFIG_POWER_FAIL
+    .save     = settingsSave,
+    .resume   = settingsResumed,
+#endif
+    .order    = 2,
+};
+
+#endif /* CONFIG_MODE_SETTINGS */
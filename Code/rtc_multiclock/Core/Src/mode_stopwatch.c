@@ -0,0 +1,393 @@
+/**
+ * @file    mode_stopwatch.c
+ * @brief   STOPWATCH mode: start / stop / reset / lap using the system tick
+ *          (HSITRIM_Ms(): corrected for the HSI error, hsitrim.h)
+ *
+ * Button handling follows the STOPPED <-> RUNNING table in ui_fsm.h;
+ * stopwatch.h drives the same table from the console. Every action
+ * mirrors the state into the backup SRAM, from where stopwatchInit()
+ * resumes it after a reset.
+ */
+
+#include "app_config.h"
+
+#if CONFIG_MODE_STOPWATCH
+
+#include "mode.h"
+#include "parallel_lcd.h"
+#include "fmt.h"
+#include "stopwatch.h"
+#include "eventlog.h"
+#include "backup.h"
+#include "calendar.h"
+#include "crc16.h"
+#include "hsitrim.h"
+#include <stddef.h>
+#include <string.h>
+
+extern RTC_HandleTypeDef hrtc;
+
+// Stopwatch timing variables
+uint32_t stopwatchStartTime = 0; // Start timestamp in milliseconds
+uint32_t stopwatchElapsed = 0;   // Elapsed time in milliseconds
+uint8_t stopwatchRunning = 0;    // Stopwatch state flag
+
+// Elapsed time at the most recent laps, lap n in [(n - 1) % size]
+static uint32_t lapMs[CONFIG_STOPWATCH_LAPS];
+static uint16_t lapCount;
+
+#if CONFIG_STOPWATCH_BACKUP
+// Running session: elapsed ms at RTC time anchorSeconds + anchorMs
+static uint32_t anchorSeconds;
+static uint32_t anchorElapsed;
+static uint16_t anchorMs;
+
+// Copy in the backup SRAM written last, and its sequence number
+static uint8_t  backupSlot;
+static uint32_t backupSequence;
+#endif
+
+static Fsm_t stopwatchFsm;
+
+static void displayStopwatch(void);
+static void stopwatchStart(void);
+static void stopwatchStop(void);
+static void stopwatchReset(void);
+static void stopwatchLap(void);
+
+// The stopwatch's time base in ms
+static uint32_t stopwatchNow(void) {
+#if CONFIG_HSITRIM
+    return HSITRIM_Ms();
+#else
+    return HAL_GetTick();
+#endif
+}
+
+/* ================= STATE TABLE =================
+ * Generated from UI_STOPWATCH_* in ui_fsm.h.
+ * =============================================== */
+
+#define SW_CELL(state, event, guard, action, next) \
+    FSM_CELL(UI_EV_COUNT, state, event, guard, action, next)
+
+static const FsmStateDesc_t stopwatchStates[SW_COUNT] = {
+    UI_STOPWATCH_STATES(FSM_STATE_DESC)
+};
+
+static const FsmTransition_t stopwatchTable[SW_COUNT * UI_EV_COUNT] = {
+    UI_STOPWATCH_TRANSITIONS(SW_CELL)
+};
+
+static const FsmDef_t stopwatchFsmDef = {
+    stopwatchStates, stopwatchTable, SW_COUNT, UI_EV_COUNT
+};
+
+/* ================= BACKUP ================= */
+
+#if CONFIG_STOPWATCH_BACKUP
+// RTC time in seconds since 2000-01-01, and the ms within the second
+static uint32_t stopwatchRtcNow(uint16_t *ms) {
+    RTC_TimeTypeDef time;
+    RTC_DateTypeDef date;
+    uint32_t ahead;
+
+    HAL_RTC_GetTime(&hrtc, &time, RTC_FORMAT_BIN);
+    HAL_RTC_GetDate(&hrtc, &date, RTC_FORMAT_BIN); // Unlocks the shadow registers
+    // Right after 'time hh:mm:ss.mmm' TR / DR read ahead
+    *ms = CAL_SubSecondMs(time.SubSeconds, time.SecondFraction, &ahead);
+    return CAL_DaysSince2000(date.Year, date.Month, date.Date) * 86400UL +
+           (time.Hours * 60UL + time.Minutes) * 60UL + time.Seconds - ahead;
+}
+
+static uint16_t stopwatchBackupCrc(const StopwatchBackup_t *copy) {
+    uint16_t crc = CRC16_Update(CRC16_INIT, copy, offsetof(StopwatchBackup_t, crc));
+
+    return CRC16_Update(crc, copy->lapMs, sizeof(copy->lapMs));
+}
+#endif
+
+// Tie the running session to the RTC time now
+static void stopwatchAnchor(void) {
+#if CONFIG_STOPWATCH_BACKUP
+    anchorSeconds = stopwatchRtcNow(&anchorMs);
+    anchorElapsed = stopwatchNow() - stopwatchStartTime;
+#endif
+}
+
+// Overwrite the older copy; the CRC goes last, so a reset during the
+// write leaves a copy that fails its check and the other one is used
+void STOPWATCH_Backup(void) {
+#if CONFIG_STOPWATCH_BACKUP
+    StopwatchBackup_t *copy;
+
+    backupSlot ^= 1U;
+    copy = &BACKUP_SRAM->stopwatch[backupSlot];
+    copy->sequence = ++backupSequence;
+    copy->anchorSeconds = anchorSeconds;
+    copy->anchorElapsed = stopwatchRunning ? anchorElapsed : stopwatchElapsed;
+    copy->anchorMs = anchorMs;
+    copy->lapCount = lapCount;
+    copy->running = stopwatchRunning;
+    copy->reserved = 0;
+    memcpy(copy->lapMs, lapMs, sizeof(lapMs));
+    copy->crc = stopwatchBackupCrc(copy);
+#endif
+}
+
+void STOPWATCH_ClockChanged(void) {
+    if(stopwatchRunning) {
+        stopwatchAnchor();
+        STOPWATCH_Backup();
+    }
+}
+
+#if CONFIG_STOPWATCH_BACKUP
+// Take over the newest valid copy; 1 if its session was running.
+// The RTC time since the anchor (none if the clock was set back in
+// the meantime) is added to the elapsed time.
+static uint8_t stopwatchRestore(void) {
+    const StopwatchBackup_t *newest = NULL;
+    uint32_t seconds;
+    uint16_t ms;
+    uint64_t outage;
+
+    for(uint8_t i = 0; i < 2U; i++) {
+        const StopwatchBackup_t *copy = &BACKUP_SRAM->stopwatch[i];
+
+        if(copy->crc != stopwatchBackupCrc(copy) ||
+           (newest != NULL && (int32_t)(copy->sequence - newest->sequence) <= 0)) {
+            continue;
+        }
+        newest = copy;
+        backupSlot = i;
+    }
+    if(newest == NULL) {
+        return 0;
+    }
+
+    backupSequence = newest->sequence;
+    lapCount = newest->lapCount;
+    memcpy(lapMs, newest->lapMs, sizeof(lapMs));
+    stopwatchElapsed = newest->anchorElapsed;
+    if(!newest->running) {
+        return 0;
+    }
+
+    anchorSeconds = newest->anchorSeconds;
+    anchorMs = newest->anchorMs;
+    anchorElapsed = newest->anchorElapsed;
+    seconds = stopwatchRtcNow(&ms);
+    outage = 0;
+    if(seconds * 1000ULL + ms > anchorSeconds * 1000ULL + anchorMs) {
+        outage = (seconds * 1000ULL + ms) - (anchorSeconds * 1000ULL + anchorMs);
+    }
+
+    // Wraps after 49 days, as SysTick arithmetic does while running
+    stopwatchElapsed = anchorElapsed + (uint32_t)outage;
+    stopwatchStartTime = stopwatchNow() - stopwatchElapsed;
+    stopwatchRunning = 1;
+#if CONFIG_EVENT_LOG
+    EVLOG_Record(EVLOG_STOPWATCH_START, &stopwatchElapsed, 1);
+#endif
+    return 1;
+}
+#endif
+
+/* ================= ACTIONS ================= */
+
+static void stopwatchStart(void) {
+    stopwatchStartTime = stopwatchNow() - stopwatchElapsed;
+    stopwatchRunning = 1;
+    stopwatchAnchor();
+    STOPWATCH_Backup();
+#if CONFIG_EVENT_LOG
+    EVLOG_Record(EVLOG_STOPWATCH_START, &stopwatchElapsed, 1);
+#endif
+}
+
+static void stopwatchStop(void) {
+#if CONFIG_EVENT_LOG
+    uint32_t session[2];
+#endif
+
+    // The mode's tick only runs while it is shown
+    stopwatchElapsed = stopwatchNow() - stopwatchStartTime;
+    stopwatchRunning = 0;
+    STOPWATCH_Backup();
+#if CONFIG_EVENT_LOG
+    session[0] = stopwatchElapsed;
+    session[1] = lapCount;
+    EVLOG_Record(EVLOG_STOPWATCH_STOP, session, 2);
+#endif
+}
+
+static void stopwatchReset(void) {
+    stopwatchElapsed = 0;
+    lapCount = 0;
+    STOPWATCH_Backup();
+}
+
+static void stopwatchLap(void) {
+    lapMs[lapCount % CONFIG_STOPWATCH_LAPS] = stopwatchNow() - stopwatchStartTime;
+    if(lapCount < UINT16_MAX) {
+        lapCount++;
+    }
+    // Re-anchor: a resume then counts only the outage with the RTC
+    stopwatchAnchor();
+    STOPWATCH_Backup();
+}
+
+/* ================= CONTROL (stopwatch.h) ================= */
+
+// Dispatch 'event' if the machine is in 'state'
+static uint8_t stopwatchDispatchIn(FsmState_t state, UiEvent_t event) {
+    if(stopwatchFsm.state != state) {
+        return 0;
+    }
+    FSM_Dispatch(&stopwatchFsm, event);
+    return 1;
+}
+
+uint8_t STOPWATCH_Start(void) {
+    return stopwatchDispatchIn(SW_STOPPED, UI_EV_SELECT);
+}
+
+uint8_t STOPWATCH_Stop(void) {
+    return stopwatchDispatchIn(SW_RUNNING, UI_EV_SELECT);
+}
+
+uint8_t STOPWATCH_Reset(void) {
+    return stopwatchDispatchIn(SW_STOPPED, UI_EV_INC);
+}
+
+uint8_t STOPWATCH_Lap(void) {
+    return stopwatchDispatchIn(SW_RUNNING, UI_EV_INC);
+}
+
+uint8_t STOPWATCH_Running(void) {
+    return stopwatchRunning;
+}
+
+uint32_t STOPWATCH_ElapsedMs(void) {
+    return stopwatchRunning ? stopwatchNow() - stopwatchStartTime : stopwatchElapsed;
+}
+
+uint16_t STOPWATCH_LapCount(void) {
+    return lapCount;
+}
+
+uint32_t STOPWATCH_LapMs(uint16_t number) {
+    if(number == 0U || number > lapCount ||
+       lapCount - number >= CONFIG_STOPWATCH_LAPS) {
+        return 0;
+    }
+    return lapMs[(number - 1U) % CONFIG_STOPWATCH_LAPS];
+}
+
+/* ================= MODE CALLBACKS ================= */
+
+static void stopwatchInit(void) {
+    stopwatchElapsed = 0;
+    stopwatchRunning = 0;
+    lapCount = 0;
+#if CONFIG_STOPWATCH_BACKUP
+    backupSlot = 0;
+    backupSequence = 0;
+
+    // A session cut short by a reset runs on
+    if(stopwatchRestore()) {
+        FSM_Init(&stopwatchFsm, &stopwatchFsmDef, SW_RUNNING);
+        return;
+    }
+#endif
+    FSM_Init(&stopwatchFsm, &stopwatchFsmDef, UI_STOPWATCH_INITIAL);
+}
+
+static void stopwatchEnter(void) {
+    LCD_Clear();
+}
+
+#if CONFIG_STOPWATCH_BACKUP
+// Supply failing: the copy is current, but a running session is
+// re-anchored so that the time since its last action is counted by
+// SysTick rather than by the RTC
+static void stopwatchSave(void) {
+    if(stopwatchRunning) {
+        stopwatchAnchor();
+        STOPWATCH_Backup();
+    }
+}
+#endif
+
+static void stopwatchEvent(UiEvent_t event) {
+    FSM_Dispatch(&stopwatchFsm, event);
+}
+
+static void stopwatchRender(void) {
+    FSM_Render(&stopwatchFsm);
+}
+
+// Update elapsed time while running
+static void handleStopwatch(void) {
+    if(stopwatchRunning) {
+        stopwatchElapsed = stopwatchNow() - stopwatchStartTime;
+    }
+}
+
+// Redraw when the displayed second changes
+static uint32_t stopwatchDeadline(void) {
+    if(stopwatchRunning) {
+        return 1000U - (stopwatchElapsed % 1000U);
+    }
+    return 1000U;
+}
+
+// Display stopwatch mode
+/**
+ * @brief Displays stopwatch time and status
+ *
+ * Stopwatch time is derived from system tick counter
+ * for millisecond-level resolution.
+ */
+static void displayStopwatch(void) {
+    char buffer[17];
+    uint32_t hours, minutes, seconds;
+
+    // Convert milliseconds to time components
+    seconds = stopwatchElapsed / 1000;
+    minutes = seconds / 60;
+    hours = minutes / 60;
+
+    seconds %= 60;
+    minutes %= 60;
+
+    // Display stopwatch on first line; hours widen past 99 (at most 1193).
+    // Through the parser so the fuzzer checks that the widest one fits
+    FMT_Format(buffer, sizeof(buffer), "SW: %02lu:%02lu:%02lu",
+               (unsigned long)hours, (unsigned long)minutes, (unsigned long)seconds);
+    LCD_WriteStringXY(0, 0, buffer);
+
+    // Display status and controls on second line - FIXED
+    if(stopwatchRunning) {
+        LCD_WriteStringXY(1, 0, "Lap   Mode Stop ");
+    } else {
+        LCD_WriteStringXY(1, 0, "Reset Mode Start");
+    }
+}
+
+MODE_REGISTER(modeStopwatch) = {
+    .name     = "STOPWATCH",
+    .init     = stopwatchInit,
+    .enter    = stopwatchEnter,
+    .on_event = stopwatchEvent,
+    .render   = stopwatchRender,
+    .tick     = handleStopwatch,
+    .deadline = stopwatchDeadline,
+#if CONFIG_STOPWATCH_BACKUP
+    .save     = stopwatchSave,
+#endif
+    .order    = 1,
+};
+
+#endif /* CONFIG_MODE_STOPWATCH */
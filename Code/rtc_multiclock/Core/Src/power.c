@@ -0,0 +1,87 @@
+/**
+ * @file    power.c
+ * @brief   PVD interrupt and the state-save path (power.h)
+ */
+
+#include "app_config.h"
+
+#if CONFIG_POWER_FAIL
+
+#include "power.h"
+#include "backup.h"
+#include "mode.h"
+#include "eventlog.h"
+#include "parallel_lcd.h"
+#include "trace.h"
+#include "dwt.h"
+
+#define POWER_STATS  (&BACKUP_SRAM->power)
+
+void POWER_Save(void) {
+    // A calendar write cut short would leave the RTC stopped in init
+    // mode on VBAT
+    if(RTC->ISR & RTC_ISR_INIT) {
+        RTC->ISR &= ~RTC_ISR_INIT;
+    }
+
+    MODE_SaveAll();
+#if CONFIG_EVENT_LOG
+    EVLOG_PowerFail();
+#endif
+    LCD_SafeState();
+}
+
+// VDD fell below the PVD level (PVDO set), or rose above it again
+void PVD_IRQHandler(void) {
+    PowerBackup_t *stats = POWER_STATS;
+    uint32_t start;
+
+    TRACE(TRACE_ISR_ENTER, PVD_IRQn);
+    __HAL_PWR_PVD_EXTI_CLEAR_FLAG();
+    if(!__HAL_PWR_GET_FLAG(PWR_FLAG_PVDO)) {
+        TRACE(TRACE_ISR_EXIT, PVD_IRQn);
+        return;    // A glitch that was over before it was handled
+    }
+
+    __disable_irq();
+    start = DWT_Cycles();
+    POWER_Save();
+    stats->lastCycles = DWT_Cycles() - start;
+    if(stats->lastCycles > stats->maxCycles) {
+        stats->maxCycles = stats->lastCycles;
+    }
+    stats->saves++;
+
+    // Nothing runs any more until the supply is gone or back
+    while(__HAL_PWR_GET_FLAG(PWR_FLAG_PVDO)) {
+    }
+    NVIC_SystemReset();
+}
+
+void POWER_Init(void) {
+    PWR_PVDTypeDef pvd;
+    PowerBackup_t *stats = POWER_STATS;
+
+    if(stats->magic != POWER_MAGIC) {
+        stats->saves = 0;
+        stats->lastCycles = 0;
+        stats->maxCycles = 0;
+        stats->magic = POWER_MAGIC;
+    }
+    DWT_CycleCounterInit();
+
+    // PVDO rises when VDD falls below the level and falls when it is back
+    pvd.PVDLevel = (uint32_t)CONFIG_PVD_LEVEL << PWR_CR_PLS_Pos;
+    pvd.Mode = PWR_PVD_MODE_IT_RISING_FALLING;
+    HAL_PWR_ConfigPVD(&pvd);
+    HAL_PWR_EnablePVD();
+
+    NVIC_SetPriority(PVD_IRQn, 0);
+    NVIC_EnableIRQ(PVD_IRQn);
+}
+
+const PowerBackup_t *POWER_GetStats(void) {
+    return POWER_STATS;
+}
+
+#endif /* CONFIG_POWER_FAIL */
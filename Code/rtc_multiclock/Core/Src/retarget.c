@@ -0,0 +1,79 @@
+/**
+ * @file    retarget.c
+ * @brief   stdout over USART2 (ST-LINK virtual COM port), polled
+ *
+ * syscalls.c routes _write() to __io_putchar(); this provides it.
+ * USART2 TX is PA2 (AF7) on the Nucleo-F446RE and reaches the PC
+ * through the ST-LINK VCP. There is no UART HAL module in this
+ * project, so the peripheral is set up at register level the first
+ * time a character is sent. Output is 115200 8N1 with CRLF line ends.
+ *
+ * With CONFIG_CONSOLE the console owns USART2 and stdout is queued
+ * behind its replies (CONSOLE_PutChar()).
+ */
+
+#include "main.h"
+#include "app_config.h"
+
+#if CONFIG_CONSOLE
+
+#include "console.h"
+
+int __io_putchar(int ch) {
+    return CONSOLE_PutChar(ch);
+}
+
+#else
+
+#define RETARGET_BAUD  115200U
+
+static uint8_t retargetReady = 0;
+static uint32_t retargetPclk;    // PCLK1 the baud rate was set for
+
+static void RETARGET_Init(void) {
+    RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN;
+    RCC->APB1ENR |= RCC_APB1ENR_USART2EN;
+    (void)RCC->APB1ENR;    // Clock enable takes effect before the first access
+
+    // PA2: alternate function 7 (USART2_TX), high speed
+    GPIOA->MODER   = (GPIOA->MODER & ~GPIO_MODER_MODER2) | GPIO_MODER_MODER2_1;
+    GPIOA->OSPEEDR |= GPIO_OSPEEDER_OSPEEDR2;
+    GPIOA->AFR[0]  = (GPIOA->AFR[0] & ~(0xFU << 8)) | (7U << 8);
+
+    // Oversampling by 16: BRR = f_PCLK1 / baud, rounded
+    retargetPclk = HAL_RCC_GetPCLK1Freq();
+    USART2->BRR = (retargetPclk + RETARGET_BAUD / 2U) / RETARGET_BAUD;
+    USART2->CR1 = USART_CR1_UE | USART_CR1_TE;
+
+    retargetReady = 1;
+}
+
+static void RETARGET_Send(uint8_t byte) {
+    while(!(USART2->SR & USART_SR_TXE)) {
+    }
+    USART2->DR = byte;
+}
+
+// The system clock has changed (sysclk.h) since the last character:
+// let that one finish, then set the baud rate for the new PCLK1
+static void RETARGET_Retime(void) {
+    while(!(USART2->SR & USART_SR_TC)) {
+    }
+    retargetPclk = HAL_RCC_GetPCLK1Freq();
+    USART2->BRR = (retargetPclk + RETARGET_BAUD / 2U) / RETARGET_BAUD;
+}
+
+int __io_putchar(int ch) {
+    if(!retargetReady) {
+        RETARGET_Init();
+    } else if(HAL_RCC_GetPCLK1Freq() != retargetPclk) {
+        RETARGET_Retime();
+    }
+    if(ch == '\n') {
+        RETARGET_Send('\r');
+    }
+    RETARGET_Send((uint8_t)ch);
+    return ch;
+}
+
+#endif /* CONFIG_CONSOLE */
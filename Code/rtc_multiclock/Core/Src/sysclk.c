@@ -0,0 +1,199 @@
+/**
+ * @file    sysclk.c
+ * @brief   System clock profiles and the switch between them (sysclk.h)
+ */
+
+#include "sysclk.h"
+#include "console.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "dwt.h"
+
+#define SYSCLK_HSI_MHZ  16U
+
+typedef struct {
+    uint32_t source;          // RCC_SYSCLKSOURCE_*
+    uint32_t scale;           // PWR_REGULATOR_VOLTAGE_SCALEx
+    uint8_t  overDrive;
+    uint32_t pllN;            // HSI / 16 * N / P; 0: PLL off
+    uint32_t pllP;
+    uint32_t apb1;            // RCC_HCLK_DIVx
+    uint32_t apb2;
+    uint32_t latency;         // FLASH_LATENCY_x, 2.7 to 3.6 V
+} SysclkConfig_t;
+
+static const SysclkConfig_t sysclkConfig[SYSCLK_PROFILE_COUNT] = {
+    [SYSCLK_LOW]       = { RCC_SYSCLKSOURCE_HSI,    PWR_REGULATOR_VOLTAGE_SCALE3, 0,
+                           0,   0,             RCC_HCLK_DIV1, RCC_HCLK_DIV1, FLASH_LATENCY_0 },
+    [SYSCLK_NOMINAL]   = { RCC_SYSCLKSOURCE_PLLCLK, PWR_REGULATOR_VOLTAGE_SCALE3, 0,
+                           336, RCC_PLLP_DIV4, RCC_HCLK_DIV2, RCC_HCLK_DIV1, FLASH_LATENCY_2 },
+    [SYSCLK_OVERDRIVE] = { RCC_SYSCLKSOURCE_PLLCLK, PWR_REGULATOR_VOLTAGE_SCALE1, 1,
+                           360, RCC_PLLP_DIV2, RCC_HCLK_DIV4, RCC_HCLK_DIV2, FLASH_LATENCY_5 },
+};
+
+// Run mode from flash, ART on, peripherals as this firmware uses them:
+// typical datasheet figures, to be replaced by readings at the IDD
+// jumper (JP6) of the board
+static const SysclkInfo_t sysclkInfo[SYSCLK_PROFILE_COUNT] = {
+    [SYSCLK_LOW]       = { "LOW",        16000000U,  50 },
+    [SYSCLK_NOMINAL]   = { "NOMINAL",    84000000U, 200 },
+    [SYSCLK_OVERDRIVE] = { "OVERDRIVE", 180000000U, 500 },
+};
+
+static SysclkProfile_t sysclkProfile;
+static SysclkStats_t sysclkStats[SYSCLK_PROFILE_COUNT];
+
+/* ================= UARTS ================= */
+
+// Nothing may leave a UART while its baud rate is wrong
+static void sysclkUartsHold(void) {
+#if CONFIG_CONSOLE
+    CONSOLE_ClockChanging();
+#endif
+#if CONFIG_TELEMETRY
+    TELEM_ClockChanging();
+#endif
+}
+
+static void sysclkUartsRelease(void) {
+#if CONFIG_CONSOLE
+    CONSOLE_ClockChanged();
+#endif
+#if CONFIG_TELEMETRY
+    TELEM_ClockChanged();
+#endif
+}
+
+/* ================= SWITCH ================= */
+
+// SYSCLK on HSI, PLL and over-drive off: the state every switch passes
+static HAL_StatusTypeDef sysclkToHsi(void) {
+    RCC_OscInitTypeDef osc = {0};
+    RCC_ClkInitTypeDef clk = {0};
+
+    clk.ClockType = RCC_CLOCKTYPE_HCLK | RCC_CLOCKTYPE_SYSCLK |
+                    RCC_CLOCKTYPE_PCLK1 | RCC_CLOCKTYPE_PCLK2;
+    clk.SYSCLKSource = RCC_SYSCLKSOURCE_HSI;
+    clk.AHBCLKDivider = RCC_SYSCLK_DIV1;
+    clk.APB1CLKDivider = RCC_HCLK_DIV1;
+    clk.APB2CLKDivider = RCC_HCLK_DIV1;
+    if(HAL_RCC_ClockConfig(&clk, FLASH_LATENCY_0) != HAL_OK) {
+        return HAL_ERROR;
+    }
+    if(sysclkConfig[sysclkProfile].overDrive && HAL_PWREx_DisableOverDrive() != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    osc.OscillatorType = RCC_OSCILLATORTYPE_NONE;
+    osc.PLL.PLLState = RCC_PLL_OFF;
+    return HAL_RCC_OscConfig(&osc);
+}
+
+// From HSI to 'config'
+static HAL_StatusTypeDef sysclkFromHsi(const SysclkConfig_t *config) {
+    RCC_OscInitTypeDef osc = {0};
+    RCC_ClkInitTypeDef clk = {0};
+
+    // Takes effect when the PLL starts
+    __HAL_PWR_VOLTAGESCALING_CONFIG(config->scale);
+
+    if(config->pllN != 0U) {
+        osc.OscillatorType = RCC_OSCILLATORTYPE_NONE;
+        osc.PLL.PLLState = RCC_PLL_ON;
+        osc.PLL.PLLSource = RCC_PLLSOURCE_HSI;
+        osc.PLL.PLLM = 16;
+        osc.PLL.PLLN = config->pllN;
+        osc.PLL.PLLP = config->pllP;
+        osc.PLL.PLLQ = 2;
+        osc.PLL.PLLR = 2;
+        if(HAL_RCC_OscConfig(&osc) != HAL_OK) {
+            return HAL_ERROR;
+        }
+    }
+    if(config->overDrive && HAL_PWREx_EnableOverDrive() != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    clk.ClockType = RCC_CLOCKTYPE_HCLK | RCC_CLOCKTYPE_SYSCLK |
+                    RCC_CLOCKTYPE_PCLK1 | RCC_CLOCKTYPE_PCLK2;
+    clk.SYSCLKSource = config->source;
+    clk.AHBCLKDivider = RCC_SYSCLK_DIV1;
+    clk.APB1CLKDivider = config->apb1;
+    clk.APB2CLKDivider = config->apb2;
+    return HAL_RCC_ClockConfig(&clk, config->latency);
+}
+
+HAL_StatusTypeDef SYSCLK_Set(SysclkProfile_t profile) {
+    SysclkStats_t *stats;
+    HAL_StatusTypeDef status;
+    uint32_t fromMhz = SystemCoreClock / 1000000U;
+    uint32_t start;
+    uint32_t onHsi;
+    uint32_t us;
+
+    if(profile >= SYSCLK_PROFILE_COUNT) {
+        return HAL_ERROR;
+    }
+    if(profile == sysclkProfile) {
+        return HAL_OK;
+    }
+
+    start = DWT_Cycles();
+    sysclkUartsHold();
+    status = sysclkToHsi();
+    onHsi = DWT_Cycles();
+    if(status == HAL_OK) {
+        sysclkProfile = SYSCLK_LOW;
+        if(profile != SYSCLK_LOW) {
+            status = sysclkFromHsi(&sysclkConfig[profile]);
+        }
+    }
+    if(status == HAL_OK) {
+        sysclkProfile = profile;
+    } else if(sysclkProfile == SYSCLK_LOW) {
+        // Half way: back to plain HSI, which needs nothing
+        sysclkFromHsi(&sysclkConfig[SYSCLK_LOW]);
+    }
+    sysclkUartsRelease();
+
+    // Up to HSI at the old clock, the rest at 16 MHz; the return from
+    // HAL_RCC_ClockConfig() at the new one is left out
+    us = (onHsi - start) / fromMhz + (DWT_Cycles() - onHsi) / SYSCLK_HSI_MHZ;
+    stats = &sysclkStats[profile];
+    if(status != HAL_OK) {
+        stats->failures++;
+    } else {
+        stats->switches++;
+        stats->lastUs = us;
+        if(us > stats->maxUs) {
+            stats->maxUs = us;
+        }
+    }
+    TRACE(TRACE_CLOCK, SystemCoreClock / 1000000U);
+    return status;
+}
+
+/* ================= PUBLIC API ================= */
+
+void SYSCLK_Init(void) {
+    sysclkProfile = SYSCLK_NOMINAL;
+    for(uint8_t i = 0; i < SYSCLK_PROFILE_COUNT; i++) {
+        sysclkStats[i].switches = 0;
+        sysclkStats[i].failures = 0;
+        sysclkStats[i].lastUs = 0;
+        sysclkStats[i].maxUs = 0;
+    }
+    DWT_CycleCounterInit();
+}
+
+SysclkProfile_t SYSCLK_Get(void) {
+    return sysclkProfile;
+}
+
+const SysclkInfo_t *SYSCLK_Info(SysclkProfile_t profile) {
+    return (profile < SYSCLK_PROFILE_COUNT) ? &sysclkInfo[profile] : NULL;
+}
+
+const SysclkStats_t *SYSCLK_Stats(SysclkProfile_t profile) {
+    return (profile < SYSCLK_PROFILE_COUNT) ? &sysclkStats[profile] : NULL;
+}
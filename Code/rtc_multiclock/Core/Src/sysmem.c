@@ -29,6 +29,13 @@
  */
 static uint8_t *__sbrk_heap_end = NULL;
 
+/**
+ * Heap statistics, read by memstat.c
+ */
+uint32_t sbrkPeakBytes = 0;   /* Highest break reached, bytes above '_end' */
+uint32_t sbrkFailCount = 0;   /* Requests refused with ENOMEM */
+uint32_t sbrkFailLast = 0;    /* Size of the last refused request */
+
 /**
  * @brief _sbrk() allocates memory to the newlib heap and is used by malloc
  *        and others from the C library
@@ -68,6 +75,8 @@ void *_sbrk(ptrdiff_t incr)
   /* Protect heap from growing into the reserved MSP stack */
   if (__sbrk_heap_end + incr > max_heap)
   {
+    sbrkFailCount++;
+    sbrkFailLast = (uint32_t)incr;
     errno = ENOMEM;
     return (void *)-1;
   }
@@ -75,5 +84,10 @@ void *_sbrk(ptrdiff_t incr)
   prev_heap_end = __sbrk_heap_end;
   __sbrk_heap_end += incr;
 
+  if ((uint32_t)(__sbrk_heap_end - &_end) > sbrkPeakBytes)
+  {
+    sbrkPeakBytes = (uint32_t)(__sbrk_heap_end - &_end);
+  }
+
   return (void *)prev_heap_end;
 }
@@ -0,0 +1,284 @@
+/**
+ * @file    telemetry.c
+ * @brief   COBS / CRC-16 framed telemetry on USART1 with double-buffered DMA
+ *
+ * USART1 TX is PA9 (AF7, Arduino D8 on the Nucleo); DMA2 stream 7,
+ * channel 4 feeds it. As for the console there is no UART or DMA HAL
+ * module, so both are set up at register level.
+ */
+
+#include "app_config.h"
+
+#if CONFIG_TELEMETRY
+
+#include "telemetry.h"
+#include "crc16.h"
+#include "dwt.h"
+#include "trace.h"
+#include <string.h>
+
+#define TELEM_DMA_CHANNEL  (4U << DMA_SxCR_CHSEL_Pos)   // USART1_TX on stream 7
+#define TELEM_DMA_FLAGS    (DMA_HIFCR_CFEIF7 | DMA_HIFCR_CDMEIF7 | DMA_HIFCR_CTEIF7 | \
+                            DMA_HIFCR_CHTIF7 | DMA_HIFCR_CTCIF7)
+
+// Code byte, header, payload, CRC, delimiter
+#define TELEM_FRAME_BYTES(length)  (1U + TELEM_HEADER_BYTES + (length) + TELEM_CRC_BYTES + 1U)
+
+extern RTC_HandleTypeDef hrtc;
+
+static uint8_t telemBuffer[2][CONFIG_TELEMETRY_BUF_BYTES];
+static volatile uint8_t  fill;          // Buffer that records go into
+static volatile uint16_t fillLength;
+static volatile uint8_t  dmaBusy;       // The other buffer is on the wire
+static volatile uint8_t  frameOpen;     // Between TELEM_Reserve() and TELEM_Commit()
+static uint16_t frameStart;             // Offset of the open frame's code byte
+static uint8_t  frameLength;            // Header + payload of the open frame
+static uint8_t  seq;
+
+static TelemStats_t telemStats;
+static uint32_t lastLoopStart;
+static uint32_t nextSecondMs;
+
+/* ================= DMA ================= */
+
+// Send the fill buffer if the line is free and no frame is half written.
+// Called with interrupts off or from the stream 7 interrupt.
+static void telemKick(void) {
+    if(dmaBusy || frameOpen || fillLength == 0U) {
+        return;
+    }
+    DMA2->HIFCR = TELEM_DMA_FLAGS;
+    DMA2_Stream7->M0AR = (uintptr_t)telemBuffer[fill];
+    DMA2_Stream7->NDTR = fillLength;
+    DMA2_Stream7->CR |= DMA_SxCR_EN;
+    dmaBusy = 1;
+    telemStats.bytes += fillLength;
+
+    fill ^= 1U;
+    fillLength = 0;
+}
+
+void DMA2_Stream7_IRQHandler(void) {
+    TRACE(TRACE_ISR_ENTER, DMA2_Stream7_IRQn);
+    if(DMA2->HISR & DMA_HISR_TCIF7) {
+        DMA2->HIFCR = DMA_HIFCR_CTCIF7;
+        dmaBusy = 0;
+        telemKick();
+    }
+    TRACE(TRACE_ISR_EXIT, DMA2_Stream7_IRQn);
+}
+
+/* ================= FRAMES ================= */
+
+void *TELEM_Reserve(TelemRecord_t type, uint8_t length) {
+    uint32_t start = DWT_Cycles();
+    uint32_t tick = HAL_GetTick();
+    uint32_t primask;
+    uint8_t *p;
+
+    if(length > TELEM_MAX_PAYLOAD) {
+        return NULL;
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if(fillLength + TELEM_FRAME_BYTES(length) > CONFIG_TELEMETRY_BUF_BYTES) {
+        // Hand the full buffer over if the line is free, else drop
+        telemKick();
+        if(fillLength + TELEM_FRAME_BYTES(length) > CONFIG_TELEMETRY_BUF_BYTES) {
+            __set_PRIMASK(primask);
+            telemStats.dropped++;
+            seq++;
+            telemStats.cycles += DWT_Cycles() - start;
+            return NULL;
+        }
+    }
+    frameOpen = 1;
+    frameStart = fillLength;
+    __set_PRIMASK(primask);
+
+    frameLength = (uint8_t)(TELEM_HEADER_BYTES + length);
+    p = &telemBuffer[fill][frameStart + 1U];
+    p[0] = (uint8_t)type;
+    p[1] = seq;
+    p[2] = (uint8_t)tick;
+    p[3] = (uint8_t)(tick >> 8);
+    p[4] = (uint8_t)(tick >> 16);
+    p[5] = (uint8_t)(tick >> 24);
+
+    telemStats.cycles += DWT_Cycles() - start;
+    return p + TELEM_HEADER_BYTES;
+}
+
+void TELEM_Commit(void) {
+    uint32_t start = DWT_Cycles();
+    uint8_t *p = &telemBuffer[fill][frameStart];
+    uint8_t n = frameLength;
+    uint8_t code = 0;
+    uint16_t crc;
+    uint32_t primask;
+
+    if(!frameOpen) {
+        return;
+    }
+    crc = CRC16_Update(CRC16_INIT, p + 1, n);
+    p[1U + n] = (uint8_t)crc;
+    p[2U + n] = (uint8_t)(crc >> 8);
+    n += TELEM_CRC_BYTES;
+
+    // COBS in place: each zero (and the leading code byte) becomes the
+    // distance to the next zero, or to the delimiter after the last one
+    for(uint8_t i = 1; i <= n; i++) {
+        if(p[i] == 0U) {
+            p[code] = (uint8_t)(i - code);
+            code = i;
+        }
+    }
+    p[code] = (uint8_t)(n + 1U - code);
+    p[n + 1U] = 0;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    fillLength = (uint16_t)(fillLength + n + 2U);
+    frameOpen = 0;
+    telemKick();
+    __set_PRIMASK(primask);
+
+    seq++;
+    telemStats.frames++;
+    telemStats.cycles += DWT_Cycles() - start;
+}
+
+/* ================= PRODUCERS ================= */
+
+void TELEM_Loop(uint32_t startCycles) {
+    uint32_t now = DWT_Cycles();
+    TelemLoop_t *rec = TELEM_Reserve(TELEM_REC_LOOP, sizeof(TelemLoop_t));
+
+    if(rec != NULL) {
+        rec->busyCycles = now - startCycles;
+        rec->periodCycles = lastLoopStart ? startCycles - lastLoopStart : 0U;
+        TELEM_Commit();
+    }
+    lastLoopStart = startCycles;
+}
+
+void TELEM_Input(uint32_t startCycles) {
+    uint32_t now = DWT_Cycles();
+    TelemInput_t *rec = TELEM_Reserve(TELEM_REC_INPUT, sizeof(TelemInput_t));
+
+    if(rec != NULL) {
+        rec->latencyCycles = now - startCycles;
+        TELEM_Commit();
+    }
+}
+
+void TELEM_Poll(void) {
+    RTC_TimeTypeDef time;
+    RTC_DateTypeDef date;
+    TelemTime_t *timeRec;
+    TelemStats_t *statsRec;
+
+    if((int32_t)(HAL_GetTick() - nextSecondMs) < 0) {
+        return;
+    }
+    nextSecondMs += 1000U;
+    if((int32_t)(HAL_GetTick() - nextSecondMs) >= 0) {
+        // Late by more than a second (start-up): no catch-up burst
+        nextSecondMs = HAL_GetTick() + 1000U;
+    }
+
+    // Read before the reservation: the tick in the header follows the RTC
+    HAL_RTC_GetTime(&hrtc, &time, RTC_FORMAT_BIN);
+    HAL_RTC_GetDate(&hrtc, &date, RTC_FORMAT_BIN); // Unlocks the shadow registers
+    timeRec = TELEM_Reserve(TELEM_REC_TIME, sizeof(TelemTime_t));
+    if(timeRec != NULL) {
+        timeRec->hours = time.Hours;
+        timeRec->minutes = time.Minutes;
+        timeRec->seconds = time.Seconds;
+        timeRec->subSeconds = (uint16_t)time.SubSeconds;
+        timeRec->secondFraction = (uint16_t)time.SecondFraction;
+        TELEM_Commit();
+    }
+
+    statsRec = TELEM_Reserve(TELEM_REC_STATS, sizeof(TelemStats_t));
+    if(statsRec != NULL) {
+        *statsRec = telemStats;
+        TELEM_Commit();
+    }
+}
+
+const TelemStats_t *TELEM_GetStats(void) {
+    return &telemStats;
+}
+
+/* ================= BAUD RATE ================= */
+
+static void telemSetBaud(void) {
+    // Oversampling by 16: BRR = f_PCLK2 / baud, rounded
+    USART1->BRR = (HAL_RCC_GetPCLK2Freq() + CONFIG_TELEMETRY_BAUD / 2U) / CONFIG_TELEMETRY_BAUD;
+}
+
+void TELEM_ClockChanging(void) {
+    uint32_t wait;
+
+    if(!(USART1->CR1 & USART_CR1_UE)) {
+        return;
+    }
+    // As CONSOLE_ClockChanging(): hold stream 7, one character time
+    USART1->CR3 &= ~USART_CR3_DMAT;
+    while(!(USART1->SR & USART_SR_TXE)) {
+    }
+    wait = SystemCoreClock / (CONFIG_TELEMETRY_BAUD / 10U) / 10U;
+    while(wait--) {
+        __NOP();
+    }
+}
+
+void TELEM_ClockChanged(void) {
+    if(!(USART1->CR1 & USART_CR1_UE)) {
+        return;
+    }
+    telemSetBaud();
+    USART1->CR3 |= USART_CR3_DMAT;
+}
+
+/* ================= INIT ================= */
+
+void TELEM_Init(void) {
+    fill = 0;
+    fillLength = 0;
+    dmaBusy = 0;
+    frameOpen = 0;
+    seq = 0;
+    memset(&telemStats, 0, sizeof(telemStats));
+    lastLoopStart = 0;
+    nextSecondMs = HAL_GetTick();
+    DWT_CycleCounterInit();
+
+    RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN | RCC_AHB1ENR_DMA2EN;
+    RCC->APB2ENR |= RCC_APB2ENR_USART1EN;
+    (void)RCC->APB2ENR;    // Clock enable takes effect before the first access
+
+    // PA9: alternate function 7 (USART1_TX), high speed
+    GPIOA->MODER   = (GPIOA->MODER & ~GPIO_MODER_MODER9) | GPIO_MODER_MODER9_1;
+    GPIOA->OSPEEDR |= GPIO_OSPEEDER_OSPEEDR9;
+    GPIOA->AFR[1]  = (GPIOA->AFR[1] & ~(0xFU << 4)) | (7U << 4);
+
+    USART1->CR1 = 0;
+    DMA2_Stream7->CR = 0;
+    DMA2->HIFCR = TELEM_DMA_FLAGS;
+
+    // Memory to peripheral, one buffer per transfer (telemKick())
+    DMA2_Stream7->PAR = (uintptr_t)&USART1->DR;
+    DMA2_Stream7->CR  = TELEM_DMA_CHANNEL | DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_TCIE;
+
+    telemSetBaud();
+    USART1->CR3 = USART_CR3_DMAT;
+    USART1->CR1 = USART_CR1_UE | USART_CR1_TE;
+
+    NVIC_SetPriority(DMA2_Stream7_IRQn, 5);
+    NVIC_EnableIRQ(DMA2_Stream7_IRQn);
+}
+
+#endif /* CONFIG_TELEMETRY */
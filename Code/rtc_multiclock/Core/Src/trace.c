@@ -0,0 +1,47 @@
+/**
+ * @file    trace.c
+ * @brief   Event trace ring storage and text dump
+ *
+ * Text dump format (one record per line, oldest first):
+ *
+ *   TRACE,<cpu_hz>,<head>,<size>
+ *   T,<cycles>,<id>,<arg>
+ *   ...
+ *   TRACE_END
+ */
+
+#include "trace.h"
+
+#if CONFIG_TRACE
+
+#include <stdio.h>
+
+TraceBuffer_t traceBuffer;
+
+void TRACE_Init(void) {
+    DWT_CycleCounterInit();
+
+    traceBuffer.head = 0;
+    traceBuffer.size = CONFIG_TRACE_RECORDS;
+    traceBuffer.cpuHz = SystemCoreClock;
+    traceBuffer.magic = TRACE_MAGIC;
+}
+
+void TRACE_Dump(void) {
+    // Snapshot the head so records added while printing are skipped
+    uint32_t head = traceBuffer.head;
+    uint32_t count = (head < CONFIG_TRACE_RECORDS) ? head : CONFIG_TRACE_RECORDS;
+
+    printf("TRACE,%lu,%lu,%lu\n", (unsigned long)traceBuffer.cpuHz,
+           (unsigned long)head, (unsigned long)CONFIG_TRACE_RECORDS);
+
+    for(uint32_t i = head - count; i != head; i++) {
+        const TraceRecord_t *r = &traceBuffer.ring[i & (CONFIG_TRACE_RECORDS - 1U)];
+        printf("T,%lu,%u,%u\n", (unsigned long)r->cycles, (unsigned)r->id, (unsigned)r->arg);
+    }
+
+    printf("TRACE_END\n");
+    fflush(stdout);
+}
+
+#endif /* CONFIG_TRACE */
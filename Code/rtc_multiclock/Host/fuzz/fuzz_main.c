@@ -0,0 +1,161 @@
+/**
+ * @file    fuzz_main.c
+ * @brief   Stand-in for libFuzzer's driver when the compiler has none (gcc)
+ *
+ * Accepts the same basic command line as a libFuzzer binary:
+ *
+ *   fuzz_ui [-runs=N] [-seed=S] [-max_len=N] [file|dir]...
+ *
+ * Files (and the files in directories) are run once each. Without
+ * any, -runs random inputs are generated; they are not coverage
+ * guided, but the invariants and sanitizers are the same. On a
+ * failure the offending input is written to crash-<seed>-<run>.
+ */
+
+#include "fuzz_ui.h"
+#include "sim.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+static uint8_t *currentInput;
+static size_t currentSize;
+static char crashName[64];
+
+static uint64_t rngState;
+
+static uint64_t xorshift64(void) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return rngState;
+}
+
+// abort() from the harness: keep the input that caused it
+static void saveCrash(void) {
+    FILE *f;
+
+    if(currentInput == NULL || crashName[0] == '\0') {
+        return;
+    }
+    f = fopen(crashName, "wb");
+    if(f != NULL) {
+        fwrite(currentInput, 1, currentSize, f);
+        fclose(f);
+        fprintf(stderr, "input written to %s\n", crashName);
+    }
+}
+
+static int runFile(const char *path) {
+    FILE *f = fopen(path, "rb");
+    long len;
+
+    if(f == NULL) {
+        perror(path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    currentInput = malloc(len > 0 ? (size_t)len : 1U);
+    currentSize = fread(currentInput, 1, (size_t)len, f);
+    fclose(f);
+
+    fprintf(stderr, "Running: %s\n", path);
+    crashName[0] = '\0';
+    LLVMFuzzerTestOneInput(currentInput, currentSize);
+    free(currentInput);
+    currentInput = NULL;
+    return 0;
+}
+
+static int runPath(const char *path) {
+    struct stat st;
+    DIR *dir;
+    struct dirent *entry;
+    char child[1024];
+
+    if(stat(path, &st) != 0) {
+        perror(path);
+        return -1;
+    }
+    if(!S_ISDIR(st.st_mode)) {
+        return runFile(path);
+    }
+
+    dir = opendir(path);
+    if(dir == NULL) {
+        perror(path);
+        return -1;
+    }
+    while((entry = readdir(dir)) != NULL) {
+        if(entry->d_name[0] == '.') {
+            continue;
+        }
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        if(runFile(child) != 0) {
+            closedir(dir);
+            return -1;
+        }
+    }
+    closedir(dir);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    unsigned long runs = 10000;
+    unsigned long seed = 1;
+    unsigned long maxLen = 256;
+    int files = 0;
+    struct timespec t0, t1;
+
+    atexit(saveCrash);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    for(int i = 1; i < argc; i++) {
+        if(sscanf(argv[i], "-runs=%lu", &runs) == 1 ||
+           sscanf(argv[i], "-seed=%lu", &seed) == 1 ||
+           sscanf(argv[i], "-max_len=%lu", &maxLen) == 1) {
+            continue;
+        }
+        if(argv[i][0] == '-') {
+            fprintf(stderr, "ignoring libFuzzer option %s\n", argv[i]);
+            continue;
+        }
+        if(runPath(argv[i]) != 0) {
+            return 1;
+        }
+        files++;
+    }
+
+    if(files == 0) {
+        rngState = seed ? seed : 1U;
+        currentInput = malloc(maxLen ? maxLen : 1U);
+        for(unsigned long r = 0; r < runs; r++) {
+            currentSize = (size_t)(xorshift64() % (maxLen + 1U));
+            for(size_t b = 0; b < currentSize; b++) {
+                currentInput[b] = (uint8_t)xorshift64();
+            }
+            snprintf(crashName, sizeof(crashName), "crash-%lu-%lu", seed, r);
+            LLVMFuzzerTestOneInput(currentInput, currentSize);
+        }
+        free(currentInput);
+        currentInput = NULL;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double wall = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+    double virt = (double)Sim_TimeNs() / 1e9;
+
+    fprintf(stderr, "Done: %s, %llu events, %.0f s virtual in %.2f s wall "
+                    "(%.2f M events/s, %.0f virtual s per wall s)\n",
+            files ? "corpus replayed" : "random inputs",
+            (unsigned long long)fuzzEventCount, virt, wall,
+            wall > 0.0 ? (double)fuzzEventCount / wall / 1e6 : 0.0,
+            wall > 0.0 ? virt / wall : 0.0);
+    return 0;
+}
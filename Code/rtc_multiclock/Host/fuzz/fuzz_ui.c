@@ -0,0 +1,259 @@
+/**
+ * @file    fuzz_ui.c
+ * @brief   libFuzzer target: random timed button sequences against the UI
+ *
+ * The input is a byte program. Each op drives the real handleButtons(),
+ * MODE_Tick() and updateDisplay() from main.c through the simulated
+ * GPIO, exactly as the main loop does, with virtual time in between:
+ *
+ *   op & 7   meaning                                  extra bytes
+ *   0..2     toggle button (0 mode, 1 select, 2 inc)  -
+ *   3        wait (n + 1) ms                          n
+ *   4        wait (n + 1) * 100 ms                    n
+ *   5        wait (n % 16 + 1) minutes                n
+ *   6        RTC correction to h:m:s                  h m s (taken modulo)
+ *   7        press and release button ((op >> 3) & 3) % 3,
+ *            held ((op >> 5) + 1) * 40 ms             -
+ *
+ * After every main-loop pass the invariants are checked and the
+ * harness aborts (libFuzzer saves the input) if one fails:
+ *  - the RTC holds a valid time and was never given an invalid one
+ *  - the stopwatch never shows more than the time that has passed
+ *  - nothing is written to the LCD beyond the 16 visible columns
+ *  - no FMT_Format() / FMT_VFormat() output is truncated (-Wl,--wrap)
+ * The firmware objects are built with ASan and UBSan.
+ */
+
+#include "fuzz_ui.h"
+#include "sim.h"
+#include "main.h"
+#include "fmt.h"
+#include "mode.h"
+#include "parallel_lcd.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Same as BUTTON_POLL_MS in main.c
+#define FUZZ_POLL_MS  10U
+
+// From main.c and mode_stopwatch.c
+extern RTC_HandleTypeDef hrtc;
+extern uint32_t stopwatchStartTime;
+extern uint32_t stopwatchElapsed;
+extern uint8_t stopwatchRunning;
+uint8_t handleButtons(void);
+void updateDisplay(void);
+
+typedef struct {
+    GPIO_TypeDef *port;
+    uint16_t pin;
+} FuzzButton_t;
+
+static const FuzzButton_t buttons[3] = {
+    { mode_pin_GPIO_Port,       mode_pin_Pin       },
+    { start_stop_pin_GPIO_Port, start_stop_pin_Pin },
+    { reset_pin_GPIO_Port,      reset_pin_Pin      },
+};
+
+static uint8_t held[3];
+static uint32_t nextRedraw;
+static uint32_t inputStartMs;
+
+uint64_t fuzzEventCount;
+
+/* ================== INVARIANTS ================== */
+
+static void fuzzFail(const char *format, ...) {
+    va_list args;
+
+    fprintf(stderr, "\n*** invariant violated at %.3f s: ", (double)Sim_TimeNs() / 1e9);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+    abort();
+}
+
+static void checkInvariants(void) {
+    RTC_TimeTypeDef time;
+    RTC_DateTypeDef date;
+
+    HAL_RTC_GetTime(&hrtc, &time, RTC_FORMAT_BIN);
+    HAL_RTC_GetDate(&hrtc, &date, RTC_FORMAT_BIN);
+    if(time.Hours > 23U || time.Minutes > 59U || time.Seconds > 59U) {
+        fuzzFail("RTC time %u:%u:%u", time.Hours, time.Minutes, time.Seconds);
+    }
+    if(Sim_RtcRejectedWrites() != 0U) {
+        fuzzFail("firmware wrote an out-of-range time or date to the RTC");
+    }
+
+    if(stopwatchElapsed > HAL_GetTick() - inputStartMs) {
+        fuzzFail("stopwatch shows %lu ms after %lu ms (negative start?)",
+                 (unsigned long)stopwatchElapsed, (unsigned long)(HAL_GetTick() - inputStartMs));
+    }
+
+    if(Sim_LcdHiddenWrites() != 0U) {
+        char row0[SIM_LCD_COLS + 1];
+        char row1[SIM_LCD_COLS + 1];
+        Sim_LcdRow(0, row0);
+        Sim_LcdRow(1, row1);
+        fuzzFail("text written past column 16 in mode %s: |%s|%s|",
+                 MODE_Active()->name, row0, row1);
+    }
+}
+
+// Every formatted string must fit the buffer it is written to
+int __real_FMT_VFormat(char *out, size_t size, const char *format, va_list args);
+
+int __wrap_FMT_VFormat(char *out, size_t size, const char *format, va_list args) {
+    int n = __real_FMT_VFormat(out, size, format, args);
+
+    if(n < 0 || (size_t)n >= size) {
+        fuzzFail("'%s' needs %d characters, buffer holds %zu", format, n + 1, size);
+    }
+    return n;
+}
+
+int __wrap_FMT_Format(char *out, size_t size, const char *format, ...) {
+    va_list args;
+    int n;
+
+    va_start(args, format);
+    n = __wrap_FMT_VFormat(out, size, format, args);
+    va_end(args);
+    return n;
+}
+
+/* ================== DRIVING THE APPLICATION ================== */
+
+// One pass of the loop in main()
+static void loopOnce(void) {
+    uint8_t input = handleButtons();
+
+    MODE_Tick();
+    if(input || (int32_t)(HAL_GetTick() - nextRedraw) >= 0) {
+        updateDisplay();
+        nextRedraw = HAL_GetTick() + MODE_NextDeadline();
+    }
+    HAL_Delay(FUZZ_POLL_MS);
+
+    fuzzEventCount++;
+    checkInvariants();
+}
+
+static void waitMs(uint32_t ms) {
+    uint32_t until = HAL_GetTick() + ms;
+
+    while((int32_t)(HAL_GetTick() - until) < 0) {
+        // With no button down the loop only spins until the next
+        // redraw, so jump there instead of polling every 10 ms
+        if(!held[0] && !held[1] && !held[2]) {
+            int32_t idle = (int32_t)(nextRedraw - HAL_GetTick()) - (int32_t)FUZZ_POLL_MS;
+            int32_t left = (int32_t)(until - HAL_GetTick());
+            if(idle > left) {
+                idle = left;
+            }
+            if(idle > 0) {
+                Sim_AdvanceMs((uint32_t)idle);
+            }
+        }
+        loopOnce();
+    }
+}
+
+static void setButton(uint8_t index, uint8_t down) {
+    held[index] = down;
+    Sim_SetInput(buttons[index].port, buttons[index].pin, down ? GPIO_PIN_RESET : GPIO_PIN_SET);
+    fuzzEventCount++;
+}
+
+// Same state for every input: fresh modes, idle buttons, fixed calendar
+static void fuzzStart(void) {
+    static uint8_t booted = 0;
+
+    if(!booted) {
+        Sim_Reset();
+        // Timing is not under test: at 1 MHz the LCD driver's
+        // microsecond busy-waits shrink to a few loop passes
+        SystemCoreClock = 1000000U;
+        hrtc.Instance = RTC;
+        hrtc.Init.HourFormat = RTC_HOURFORMAT_24;
+        hrtc.Init.AsynchPrediv = 127;
+        hrtc.Init.SynchPrediv = 255;
+        HAL_RTC_Init(&hrtc);
+        LCD_Init();
+        booted = 1;
+    }
+
+    for(uint8_t i = 0; i < 3; i++) {
+        setButton(i, 0);
+    }
+    // Longer than the 300 ms debounce, so old press times do not matter
+    Sim_AdvanceMs(1000);
+    Sim_SetCalendar(24, 6, 15, 12, 0, 0);
+
+    stopwatchStartTime = 0;
+    stopwatchElapsed = 0;
+    stopwatchRunning = 0;
+    // No session to resume from the previous input
+    memset(SimBkpSram, 0, SIM_BKPSRAM_BYTES);
+    MODE_InitAll();
+    MODE_Start();
+
+    inputStartMs = HAL_GetTick();
+    nextRedraw = inputStartMs;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    size_t i = 0;
+
+    fuzzStart();
+
+    while(i < size) {
+        uint8_t op = data[i++];
+        uint8_t n = (i < size) ? data[i] : 0;
+
+        switch(op & 7U) {
+        case 0:
+        case 1:
+        case 2:
+            setButton(op & 7U, !held[op & 7U]);
+            loopOnce();
+            break;
+        case 3:
+            i++;
+            waitMs(n + 1U);
+            break;
+        case 4:
+            i++;
+            waitMs((n + 1U) * 100U);
+            break;
+        case 5:
+            i++;
+            waitMs(((n % 16U) + 1U) * 60000U);
+            break;
+        case 6:
+            if(i + 3 > size) {
+                return 0;
+            }
+            Sim_SetCalendar(24, 6, 15, data[i] % 24U, data[i + 1] % 60U, data[i + 2] % 60U);
+            i += 3;
+            loopOnce();
+            break;
+        default: {
+            uint8_t b = (uint8_t)(((op >> 3) & 3U) % 3U);
+            setButton(b, 1);
+            waitMs(((op >> 5) + 1U) * 40U);
+            setButton(b, 0);
+            loopOnce();
+            break;
+        }
+        }
+    }
+
+    // Let the last input take effect
+    waitMs(2000);
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef FUZZ_UI_H
+#define FUZZ_UI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file    fuzz_ui.h
+ * @brief   Entry points shared by the libFuzzer target and the standalone driver
+ */
+
+// libFuzzer entry point: run one input program (see fuzz_ui.c)
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// Main-loop passes and button edges executed so far
+extern uint64_t fuzzEventCount;
+
+#endif
@@ -0,0 +1,592 @@
+/**
+ * @file    host_main.c
+ * @brief   Runs the unmodified firmware on the host against the simulated HAL
+ *
+ * Usage:
+ *   rtc_multiclock_host [-t seconds] [-d YY-MM-DD-hh:mm:ss] [-p button@ms[:holdMs]]... [-q] [-T file]
+ *                       [-R file] [-r file] [-F file] [-C file] [-w file] [-W file] [-b] [-u]
+ *                       [-L file] [-f file] [-V mV@ms]... [-H ppm]
+ *
+ *   -t  virtual run time in seconds (default 60)
+ *   -d  initial RTC calendar
+ *   -p  press a button at a virtual time in ms, optionally with a
+ *       hold time (default 150 ms): button@ms[:holdMs]
+ *       button is one of: mode, select, inc
+ *   -q  do not print LCD frames, only the summary
+ *   -T  write the trace ring (trace.h) to a file at the end of the run,
+ *       for Tools/trace_decode
+ *  -R  write the input log (input_log.h) to a file at the end of the run
+ *  -r  replay an input log: a binary image from -R or a RAM dump, or a
+ *      log containing the text of INPUTLOG_Dump() (e.g. a UART capture)
+ *  -F  write every LCD frame to a file: 4-byte ms timestamp, then the
+ *      16 + 16 raw DDRAM bytes of both rows
+ *  -C  compare the frames against a file written by -F; exit status 3
+ *      if any frame differs in a single byte
+ *  -w  at the end of the run, save what survives a reset without power
+ *      loss: RTC, backup registers, LCD and the firmware's .noinit flags
+ *  -W  start from a file written by -w as after an NRST reset (warm
+ *      boot) instead of from power-up
+ *  -b  print the boot profile (BOOT_Dump()) after the run
+ *  -u  connect USART2 (console.h) to a new pseudo-terminal, whose name
+ *      is printed first on stderr, and run in real time
+ *  -L  write the USART1 telemetry stream (telemetry.h) to a file, for
+ *      Tools/telem_decode.py
+ *  -f  flash image: loaded at the start if the file exists, written
+ *      back at the end, so settings (kvstore.h) persist across runs
+ *  -V  set the supply to mV at a virtual time in ms (3300 at the
+ *      start); below the PVD level the state is saved (power.h)
+ *  -H  HSI error of the part in ppm at the factory trim (default 0);
+ *      the firmware trims it against the LSE (hsitrim.h)
+ *
+ * Each time the visible LCD contents change the new frame is
+ * printed with its virtual timestamp.
+ *
+ * Regression test for a field report:
+ *   rtc_multiclock_host -r field.log -F expected.bin     (once)
+ *   rtc_multiclock_host -r field.log -C expected.bin     (every change)
+ *
+ * Boot time after a reset button press:
+ *   rtc_multiclock_host -q -t 10 -w board.bin
+ *   rtc_multiclock_host -q -t 1 -W board.bin -b
+ *
+ * Console session:
+ *   rtc_multiclock_host -q -t 600 -u       console on /dev/pts/7
+ *   picocom --echo /dev/pts/7              (any terminal program)
+ *
+ * Supply dip to 2.5 V for 5 ms, with the save and the reset after it:
+ *   rtc_multiclock_host -t 20 -p mode@6000 -p select@7000 -V 2500@12000 -V 3300@12005
+ *
+ * HSI 0.73 % fast, trimmed within the first 3 s ('hsi' on the console):
+ *   rtc_multiclock_host -q -t 600 -u -H 7300
+ *
+ * Telemetry capture:
+ *   rtc_multiclock_host -q -t 60 -L telem.bin
+ *   Tools/telem_decode.py telem.bin -o telem    (telem_time.csv, ...)
+ */
+
+#define _GNU_SOURCE     // posix_openpt(), ptsname(), cfmakeraw()
+
+#include "sim.h"
+#include "main.h"
+#include "trace.h"
+#include "input_log.h"
+#include "boot.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define BUTTON_HOLD_MS  150U
+
+static int quiet;
+static uint32_t frameCount;
+
+// -F / -C
+typedef struct {
+    uint32_t ms;
+    uint8_t rows[2 * SIM_LCD_COLS];
+} Frame_t;
+
+static FILE *frameOut;
+static Frame_t *expected;
+static uint32_t expectedCount;
+static uint32_t mismatchCount;
+static uint32_t firstMismatch;
+static int32_t maxSkewMs;
+
+/* ================== TRACE ================== */
+
+// Same bytes a RAM dump of traceBuffer on the board would give
+static int writeTrace(const char *path) {
+#if CONFIG_TRACE
+    FILE *f = fopen(path, "wb");
+
+    if(f == NULL || fwrite(&traceBuffer, sizeof(traceBuffer), 1, f) != 1) {
+        perror(path);
+        if(f != NULL) {
+            fclose(f);
+        }
+        return -1;
+    }
+    fclose(f);
+    return 0;
+#else
+    fprintf(stderr, "%s: built without CONFIG_TRACE\n", path);
+    return -1;
+#endif
+}
+
+/* ================== INPUT LOG ================== */
+
+static int writeInputLog(const char *path) {
+    FILE *f = fopen(path, "wb");
+
+    if(f == NULL || fwrite(&inputLog, sizeof(inputLog), 1, f) != 1) {
+        perror(path);
+        if(f != NULL) {
+            fclose(f);
+        }
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+// INPUTLOG_Dump() text; the last complete dump in the log wins
+static int parseInputLogText(char *text, InputLog_t *log) {
+    int inDump = 0;
+    int found = 0;
+    unsigned length, dropped;
+
+    for(char *line = strtok(text, "\r\n"); line != NULL; line = strtok(NULL, "\r\n")) {
+        if(sscanf(line, "INPUTLOG,%u,%u", &length, &dropped) == 2) {
+            log->length = 0;
+            log->dropped = (uint16_t)dropped;
+            inDump = 1;
+        } else if(inDump && strncmp(line, "INPUTLOG_END", 12) == 0) {
+            inDump = 0;
+            found = (log->length == length);
+        } else if(inDump && strncmp(line, "I,", 2) == 0) {
+            unsigned byte;
+            for(const char *p = line + 2; sscanf(p, "%2x", &byte) == 1; p += 2) {
+                if(log->length >= CONFIG_INPUT_LOG_BYTES) {
+                    return 0;
+                }
+                log->data[log->length++] = (uint8_t)byte;
+            }
+        }
+    }
+    return found;
+}
+
+// Loads the image where a debugger or Renode would: the .noinit buffer
+static int loadInputLog(const char *path) {
+    FILE *f = fopen(path, "rb");
+    static char text[1 << 16];
+    size_t len;
+
+    if(f == NULL) {
+        perror(path);
+        return -1;
+    }
+    len = fread(text, 1, sizeof(text) - 1, f);
+    fclose(f);
+    text[len] = '\0';
+
+    if(len >= sizeof(InputLog_t) && ((const InputLog_t *)(const void *)text)->magic == INPUTLOG_MAGIC) {
+        memcpy(&inputLogReplay, text, sizeof(inputLogReplay));
+    } else if(parseInputLogText(text, &inputLogReplay)) {
+        inputLogReplay.checksum = INPUTLOG_Checksum(INPUTLOG_FNV_BASIS, inputLogReplay.data,
+                                                    inputLogReplay.length);
+        inputLogReplay.magic = INPUTLOG_MAGIC;
+    } else {
+        fprintf(stderr, "%s: no input log found\n", path);
+        return -1;
+    }
+    if(inputLogReplay.dropped != 0U) {
+        fprintf(stderr, "%s: %u records were dropped while recording, replay is incomplete\n",
+                path, (unsigned)inputLogReplay.dropped);
+    }
+    return 0;
+}
+
+/* ================== WARM RESET ================== */
+
+#define RETAINED_MAGIC  0x52455432U   // "RET2"
+
+// -w / -W file: the sim's retained state plus the firmware's .noinit flag
+typedef struct {
+    uint32_t magic;
+    SimRetained_t sim;
+    uint32_t bootLcdMagic;
+} Retained_t;
+
+static int saveRetained(const char *path) {
+    Retained_t r;
+    FILE *f = fopen(path, "wb");
+
+    memset(&r, 0, sizeof(r));
+    r.magic = RETAINED_MAGIC;
+    Sim_SaveRetained(&r.sim);
+    r.bootLcdMagic = bootLcdMagic;
+    if(f == NULL || fwrite(&r, sizeof(r), 1, f) != 1) {
+        perror(path);
+        if(f != NULL) {
+            fclose(f);
+        }
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+static int warmReset(const char *path) {
+    Retained_t r;
+    FILE *f = fopen(path, "rb");
+
+    if(f == NULL) {
+        perror(path);
+        return -1;
+    }
+    if(fread(&r, sizeof(r), 1, f) != 1 || r.magic != RETAINED_MAGIC) {
+        fprintf(stderr, "%s: not a file written by -w\n", path);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    Sim_WarmReset(&r.sim);
+    bootLcdMagic = r.bootLcdMagic;
+    return 0;
+}
+
+/* ================== FLASH IMAGE (-f) ================== */
+
+static int loadFlash(const char *path) {
+    FILE *f = fopen(path, "rb");
+
+    if(f == NULL) {
+        return 0;    // First run: erased flash
+    }
+    if(fread(SimFlash, 1, SIM_FLASH_BYTES, f) != SIM_FLASH_BYTES) {
+        fprintf(stderr, "%s: not a flash image written by -f\n", path);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+static int saveFlash(const char *path) {
+    FILE *f = fopen(path, "wb");
+
+    if(f == NULL || fwrite(SimFlash, 1, SIM_FLASH_BYTES, f) != SIM_FLASH_BYTES) {
+        perror(path);
+        if(f != NULL) {
+            fclose(f);
+        }
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+/* ================== FRAME COMPARISON ================== */
+
+static int loadFrames(const char *path) {
+    FILE *f = fopen(path, "rb");
+    uint32_t capacity = 0;
+    Frame_t frame;
+
+    if(f == NULL) {
+        perror(path);
+        return -1;
+    }
+    while(fread(&frame, sizeof(frame), 1, f) == 1) {
+        if(expectedCount == capacity) {
+            capacity = capacity ? capacity * 2U : 1024U;
+            expected = realloc(expected, capacity * sizeof(Frame_t));
+        }
+        expected[expectedCount++] = frame;
+    }
+    fclose(f);
+    return 0;
+}
+
+static void checkFrame(const Frame_t *frame) {
+    uint32_t index = frameCount - 1U;
+    int32_t skew;
+
+    if(index >= expectedCount ||
+       memcmp(frame->rows, expected[index].rows, sizeof(frame->rows)) != 0) {
+        if(mismatchCount++ == 0U) {
+            firstMismatch = index;
+        }
+        return;
+    }
+    skew = (int32_t)(frame->ms - expected[index].ms);
+    if(skew < 0) {
+        skew = -skew;
+    }
+    if(skew > maxSkewMs) {
+        maxSkewMs = skew;
+    }
+}
+
+// 0 if the run produced exactly the expected frames
+static int reportComparison(void) {
+    if(frameCount != expectedCount && mismatchCount == 0U) {
+        firstMismatch = (frameCount < expectedCount) ? frameCount : expectedCount;
+        mismatchCount = 1;
+    }
+    if(mismatchCount == 0U) {
+        fprintf(stderr, "frames match: %u frames, timing within %d ms\n",
+                frameCount, (int)maxSkewMs);
+        return 0;
+    }
+    fprintf(stderr, "frames differ: %u of %u (expected %u), first at frame %u",
+            mismatchCount, frameCount, expectedCount, firstMismatch);
+    if(firstMismatch < expectedCount) {
+        const Frame_t *e = &expected[firstMismatch];
+        fprintf(stderr, ", expected at %u ms: |%.16s|%.16s|", e->ms,
+                (const char *)e->rows, (const char *)e->rows + SIM_LCD_COLS);
+    }
+    fprintf(stderr, "\n");
+    return -1;
+}
+
+/* ================== FRAME OUTPUT ================== */
+
+// Replace CGRAM codes 0..7 by '*' for terminal output
+static void printableRow(uint8_t row, char out[SIM_LCD_COLS + 1]) {
+    Sim_LcdRow(row, out);
+    for(int i = 0; i < SIM_LCD_COLS; i++) {
+        if((unsigned char)out[i] < 0x20U || (unsigned char)out[i] > 0x7EU) {
+            out[i] = '*';
+        }
+    }
+}
+
+static void onFrame(uint64_t timeNs) {
+    char row0[SIM_LCD_COLS + 1];
+    char row1[SIM_LCD_COLS + 1];
+
+    frameCount++;
+    if(frameOut != NULL || expected != NULL) {
+        Frame_t frame;
+
+        frame.ms = (uint32_t)(timeNs / 1000000ULL);
+        Sim_LcdRow(0, row0);
+        Sim_LcdRow(1, row1);
+        memcpy(frame.rows, row0, SIM_LCD_COLS);
+        memcpy(frame.rows + SIM_LCD_COLS, row1, SIM_LCD_COLS);
+        if(frameOut != NULL) {
+            fwrite(&frame, sizeof(frame), 1, frameOut);
+        }
+        if(expected != NULL) {
+            checkFrame(&frame);
+        }
+    }
+    if(quiet) {
+        return;
+    }
+    printableRow(0, row0);
+    printableRow(1, row1);
+    printf("[%10.3f s] |%s|%s|\n", (double)timeNs / 1e9, row0, row1);
+}
+
+/* ================== ARGUMENTS ================== */
+
+static int schedulePress(const char *arg) {
+    char name[16];
+    unsigned long atMs;
+    unsigned long holdMs = BUTTON_HOLD_MS;
+    GPIO_TypeDef *port;
+    uint16_t pin;
+
+    if(sscanf(arg, "%15[a-z]@%lu:%lu", name, &atMs, &holdMs) < 2) {
+        return -1;
+    }
+    if(strcmp(name, "mode") == 0) {
+        port = mode_pin_GPIO_Port;
+        pin = mode_pin_Pin;
+    } else if(strcmp(name, "select") == 0) {
+        port = start_stop_pin_GPIO_Port;
+        pin = start_stop_pin_Pin;
+    } else if(strcmp(name, "inc") == 0) {
+        port = reset_pin_GPIO_Port;
+        pin = reset_pin_Pin;
+    } else {
+        return -1;
+    }
+
+    // Buttons are active-low
+    Sim_ScheduleInput((uint32_t)atMs, port, pin, GPIO_PIN_RESET);
+    Sim_ScheduleInput((uint32_t)(atMs + holdMs), port, pin, GPIO_PIN_SET);
+    return 0;
+}
+
+static int scheduleSupply(const char *arg) {
+    unsigned long millivolts;
+    unsigned long atMs;
+
+    if(sscanf(arg, "%lu@%lu", &millivolts, &atMs) != 2 || millivolts > 3600U) {
+        return -1;
+    }
+    Sim_ScheduleSupply((uint32_t)atMs, (uint16_t)millivolts);
+    return 0;
+}
+
+/* ================== CONSOLE (-u) ================== */
+
+// The slave end is kept open so that the master never reads EOF
+// while no terminal is attached
+static int openConsolePty(void) {
+    struct termios raw;
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    int slave;
+
+    if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("posix_openpt");
+        return -1;
+    }
+    slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    if(slave < 0 || tcgetattr(slave, &raw) != 0) {
+        perror(ptsname(master));
+        return -1;
+    }
+    // Bytes pass unchanged, as on the wire
+    cfmakeraw(&raw);
+    tcsetattr(slave, TCSANOW, &raw);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    fprintf(stderr, "console on %s\n", ptsname(master));
+    Sim_UartAttach(USART2, master);
+    Sim_SetRealTime(1);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-t seconds] [-d YY-MM-DD-hh:mm:ss] [-p mode|select|inc@ms[:holdMs]]... [-q] [-T file]\n"
+                    "          [-R file] [-r file] [-F file] [-C file] [-w file] [-W file] [-b] [-u]\n"
+                    "          [-L file] [-f file] [-V mV@ms]... [-H ppm]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    uint32_t seconds = 60;
+    unsigned y = 0, mo = 1, d = 1, h = 0, mi = 0, s = 0;
+    int haveDate = 0;
+    const char *tracePath = NULL;
+    const char *inputLogPath = NULL;
+    const char *retainedPath = NULL;
+    const char *flashPath = NULL;
+    int bootDump = 0;
+    struct timespec t0, t1;
+
+    Sim_Reset();
+
+    // -W replaces the power-up state, so it comes before presses and dates
+    for(int i = 1; i + 1 < argc; i++) {
+        if(strcmp(argv[i], "-W") == 0 && warmReset(argv[i + 1]) != 0) {
+            return 2;
+        }
+    }
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            seconds = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            if(sscanf(argv[++i], "%u-%u-%u-%u:%u:%u", &y, &mo, &d, &h, &mi, &s) != 6) {
+                usage(argv[0]);
+                return 2;
+            }
+            haveDate = 1;
+        } else if(strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            if(schedulePress(argv[++i]) != 0) {
+                usage(argv[0]);
+                return 2;
+            }
+        } else if(strcmp(argv[i], "-V") == 0 && i + 1 < argc) {
+            if(scheduleSupply(argv[++i]) != 0) {
+                usage(argv[0]);
+                return 2;
+            }
+        } else if(strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+            Sim_SetHsiError((int32_t)strtol(argv[++i], NULL, 10));
+        } else if(strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if(strcmp(argv[i], "-R") == 0 && i + 1 < argc) {
+            inputLogPath = argv[++i];
+        } else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            if(loadInputLog(argv[++i]) != 0) {
+                return 2;
+            }
+        } else if(strcmp(argv[i], "-F") == 0 && i + 1 < argc) {
+            frameOut = fopen(argv[++i], "wb");
+            if(frameOut == NULL) {
+                perror(argv[i]);
+                return 2;
+            }
+        } else if(strcmp(argv[i], "-C") == 0 && i + 1 < argc) {
+            if(loadFrames(argv[++i]) != 0) {
+                return 2;
+            }
+        } else if(strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            retainedPath = argv[++i];
+        } else if(strcmp(argv[i], "-W") == 0 && i + 1 < argc) {
+            i++;    // Applied above
+        } else if(strcmp(argv[i], "-b") == 0) {
+            bootDump = 1;
+        } else if(strcmp(argv[i], "-u") == 0) {
+            if(openConsolePty() != 0) {
+                return 2;
+            }
+        } else if(strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            flashPath = argv[++i];
+            if(loadFlash(flashPath) != 0) {
+                return 2;
+            }
+        } else if(strcmp(argv[i], "-L") == 0 && i + 1 < argc) {
+            int fd = open(argv[++i], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+            if(fd < 0) {
+                perror(argv[i]);
+                return 2;
+            }
+            Sim_UartAttach(USART1, fd);
+        } else if(strcmp(argv[i], "-q") == 0) {
+            quiet = 1;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if(haveDate) {
+        Sim_SetCalendar((uint8_t)y, (uint8_t)mo, (uint8_t)d, (uint8_t)h, (uint8_t)mi, (uint8_t)s);
+    }
+    Sim_SetFrameCallback(onFrame);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    Sim_RunFirmware(seconds * 1000U);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double wall = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+    double virt = (double)Sim_TimeNs() / 1e9;
+
+    fprintf(stderr, "virtual %.3f s in %.3f s wall (x%.0f), %u frames, %u pin writes, "
+                    "%u LCD commands, %u LCD data bytes\n",
+            virt, wall, wall > 0.0 ? virt / wall : 0.0, frameCount,
+            Sim_PinWriteCount(), Sim_LcdCommandCount(), Sim_LcdDataCount());
+    if(bootProfile.marked & (1U << BOOT_PHASE_FIRST_FRAME)) {
+        fprintf(stderr, "%s boot, first mode frame at %lu.%03lu ms\n",
+                bootProfile.fast ? "fast" : "cold",
+                (unsigned long)(bootProfile.us[BOOT_PHASE_FIRST_FRAME] / 1000U),
+                (unsigned long)(bootProfile.us[BOOT_PHASE_FIRST_FRAME] % 1000U));
+    }
+    if(bootDump) {
+        BOOT_Dump();
+    }
+
+    if(frameOut != NULL) {
+        fclose(frameOut);
+    }
+    if(tracePath != NULL && writeTrace(tracePath) != 0) {
+        return 1;
+    }
+    if(inputLogPath != NULL && writeInputLog(inputLogPath) != 0) {
+        return 1;
+    }
+    if(retainedPath != NULL && saveRetained(retainedPath) != 0) {
+        return 1;
+    }
+    if(flashPath != NULL && saveFlash(flashPath) != 0) {
+        return 1;
+    }
+    if(expected != NULL && reportComparison() != 0) {
+        return 3;
+    }
+    return 0;
+}
@@ -0,0 +1,786 @@
+#ifndef STM32F4XX_HAL_H
+#define STM32F4XX_HAL_H
+
+/**
+ * @file    stm32f4xx_hal.h  (host simulation)
+ * @brief   Simulated subset of the STM32F4 HAL / CMSIS used by the firmware
+ *
+ * This header stands in for the real stm32f4xx_hal.h when the
+ * application is compiled for the host (see Host/CMakeLists.txt).
+ * Type names, field names and constant values follow the ST HAL
+ * so that main.c and the drivers compile unchanged.
+ *
+ * Behaviour is provided by Host/sim/sim_hal.c:
+ *  - GPIO : pin levels in simulated port registers, every write logged
+ *  - RTC  : calendar that advances with virtual time and can be set
+ *  - Tick : HAL_GetTick / HAL_Delay / __NOP driven by virtual time
+ *
+ * Test harnesses control the simulation through sim.h.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ================== COMMON HAL TYPES ================== */
+
+typedef enum {
+    HAL_OK       = 0x00U,
+    HAL_ERROR    = 0x01U,
+    HAL_BUSY     = 0x02U,
+    HAL_TIMEOUT  = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum {
+    RESET = 0U,
+    SET = !RESET
+} FlagStatus, ITStatus;
+
+typedef enum {
+    DISABLE = 0U,
+    ENABLE = !DISABLE
+} FunctionalState;
+
+#define __IO    volatile
+#define __I     volatile const
+#define __O     volatile
+
+#define HAL_MAX_DELAY      0xFFFFFFFFU
+#define UNUSED(X)          (void)(X)
+
+/* ================== CORE (CMSIS) ================== */
+
+extern uint32_t SystemCoreClock;
+
+typedef struct {
+    __IO uint32_t CTRL;
+    __IO uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    __IO uint32_t DHCSR;
+    __IO uint32_t DCRSR;
+    __IO uint32_t DCRDR;
+    __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+// System control block: only the fault configuration and status
+typedef struct {
+    __IO uint32_t SHCSR;
+    __IO uint32_t CFSR;
+    __IO uint32_t HFSR;
+    __IO uint32_t MMFAR;
+    __IO uint32_t BFAR;
+} SCB_Type;
+
+extern DWT_Type       SimDWT;
+extern CoreDebug_Type SimCoreDebug;
+extern SCB_Type       SimSCB;
+
+#define DWT        (&SimDWT)
+#define CoreDebug  (&SimCoreDebug)
+#define SCB        (&SimSCB)
+
+#define DWT_CTRL_CYCCNTENA_Msk           (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk       (1UL << 24)
+#define SCB_SHCSR_MEMFAULTENA_Msk        (1UL << 16)
+#define SCB_SHCSR_BUSFAULTENA_Msk        (1UL << 17)
+#define SCB_SHCSR_USGFAULTENA_Msk        (1UL << 18)
+
+// One iteration of a __NOP() busy-wait loop costs this many virtual cycles
+#define SIM_NOP_LOOP_CYCLES   10U
+
+/* Interrupts are taken when virtual time advances and PRIMASK is clear
+ * (see Host/sim/sim_uart.c). Only the lines the firmware uses exist. */
+typedef enum {
+    PVD_IRQn          = 1,
+    DMA1_Stream5_IRQn = 16,
+    DMA1_Stream6_IRQn = 17,
+    USART1_IRQn       = 37,
+    USART2_IRQn       = 38,
+    TIM5_IRQn         = 50,
+    DMA2_Stream7_IRQn = 70
+} IRQn_Type;
+
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority);
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+void NVIC_DisableIRQ(IRQn_Type IRQn);
+
+// Restarts firmware_main() inside Sim_RunFirmware(), as a software
+// reset would: the backup domain, the LCD and virtual time run on
+void NVIC_SystemReset(void) __attribute__((noreturn));
+
+void __NOP(void);
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+
+/* Cortex-M4 SIMD intrinsics (cmsis_gcc.h), bit-exact in C. The GE
+ * flags live in each translation unit, which is enough because
+ * __SEL() always follows the instruction that set them. */
+static uint32_t simApsrGe;
+
+static inline uint32_t __UADD8(uint32_t op1, uint32_t op2) {
+    uint32_t result = 0;
+    simApsrGe = 0;
+    for(int i = 0; i < 32; i += 8) {
+        uint32_t sum = ((op1 >> i) & 0xFFU) + ((op2 >> i) & 0xFFU);
+        result |= (sum & 0xFFU) << i;
+        simApsrGe |= (sum > 0xFFU) ? (1U << (i / 8)) : 0U;
+    }
+    return result;
+}
+
+static inline uint32_t __USUB8(uint32_t op1, uint32_t op2) {
+    uint32_t result = 0;
+    simApsrGe = 0;
+    for(int i = 0; i < 32; i += 8) {
+        uint32_t a = (op1 >> i) & 0xFFU;
+        uint32_t b = (op2 >> i) & 0xFFU;
+        result |= ((a - b) & 0xFFU) << i;
+        simApsrGe |= (a >= b) ? (1U << (i / 8)) : 0U;
+    }
+    return result;
+}
+
+static inline uint32_t __SEL(uint32_t op1, uint32_t op2) {
+    uint32_t result = 0;
+    for(int i = 0; i < 4; i++) {
+        result |= (((simApsrGe >> i) & 1U) ? op1 : op2) & (0xFFU << (i * 8));
+    }
+    return result;
+}
+
+static inline uint32_t __UXTB16(uint32_t op1) {
+    return op1 & 0x00FF00FFU;
+}
+
+/* ================== HAL CORE ================== */
+
+HAL_StatusTypeDef HAL_Init(void);
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+
+/* ================== RCC / PWR / FLASH ================== */
+
+#define RCC_OSCILLATORTYPE_NONE      0x00000000U
+#define RCC_OSCILLATORTYPE_HSE       0x00000001U
+#define RCC_OSCILLATORTYPE_HSI       0x00000002U
+#define RCC_OSCILLATORTYPE_LSE       0x00000004U
+#define RCC_OSCILLATORTYPE_LSI       0x00000008U
+
+#define RCC_HSE_OFF                  0x00000000U
+#define RCC_HSE_ON                   0x00010000U
+#define RCC_LSE_OFF                  0x00000000U
+#define RCC_LSE_ON                   0x00000001U
+#define RCC_HSI_OFF                  0x00000000U
+#define RCC_HSI_ON                   0x00000001U
+#define RCC_LSI_OFF                  0x00000000U
+#define RCC_LSI_ON                   0x00000001U
+
+#define RCC_HSICALIBRATION_DEFAULT   0x10U
+
+#define RCC_PLL_NONE                 0x00000000U
+#define RCC_PLL_OFF                  0x00000001U
+#define RCC_PLL_ON                   0x00000002U
+#define RCC_PLLSOURCE_HSI            0x00000000U
+#define RCC_PLLSOURCE_HSE            0x00400000U
+
+#define RCC_PLLP_DIV2                0x00000002U
+#define RCC_PLLP_DIV4                0x00000004U
+#define RCC_PLLP_DIV6                0x00000006U
+#define RCC_PLLP_DIV8                0x00000008U
+
+#define RCC_CLOCKTYPE_SYSCLK         0x00000001U
+#define RCC_CLOCKTYPE_HCLK           0x00000002U
+#define RCC_CLOCKTYPE_PCLK1          0x00000004U
+#define RCC_CLOCKTYPE_PCLK2          0x00000008U
+
+#define RCC_SYSCLKSOURCE_HSI         0x00000000U
+#define RCC_SYSCLKSOURCE_HSE         0x00000001U
+#define RCC_SYSCLKSOURCE_PLLCLK      0x00000002U
+
+#define RCC_SYSCLK_DIV1              0x00000000U
+#define RCC_HCLK_DIV1                0x00000000U
+#define RCC_HCLK_DIV2                0x00001000U
+#define RCC_HCLK_DIV4                0x00001400U
+
+#define FLASH_LATENCY_0              0x00000000U
+#define FLASH_LATENCY_1              0x00000001U
+#define FLASH_LATENCY_2              0x00000002U
+#define FLASH_LATENCY_3              0x00000003U
+#define FLASH_LATENCY_4              0x00000004U
+#define FLASH_LATENCY_5              0x00000005U
+
+#define PWR_REGULATOR_VOLTAGE_SCALE1 0x0000C000U
+#define PWR_REGULATOR_VOLTAGE_SCALE2 0x00008000U
+#define PWR_REGULATOR_VOLTAGE_SCALE3 0x00004000U
+
+typedef struct {
+    uint32_t PLLState;
+    uint32_t PLLSource;
+    uint32_t PLLM;
+    uint32_t PLLN;
+    uint32_t PLLP;
+    uint32_t PLLQ;
+    uint32_t PLLR;
+} RCC_PLLInitTypeDef;
+
+typedef struct {
+    uint32_t OscillatorType;
+    uint32_t HSEState;
+    uint32_t LSEState;
+    uint32_t HSIState;
+    uint32_t HSICalibrationValue;
+    uint32_t LSIState;
+    RCC_PLLInitTypeDef PLL;
+} RCC_OscInitTypeDef;
+
+typedef struct {
+    uint32_t ClockType;
+    uint32_t SYSCLKSource;
+    uint32_t AHBCLKDivider;
+    uint32_t APB1CLKDivider;
+    uint32_t APB2CLKDivider;
+} RCC_ClkInitTypeDef;
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct);
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency);
+uint32_t HAL_RCC_GetSysClockFreq(void);
+uint32_t HAL_RCC_GetHCLKFreq(void);
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+uint32_t HAL_RCC_GetPCLK2Freq(void);
+
+// Modelled: HSITRIM in RCC_CR (the HSI frequency, sim_hal.c), LSEON /
+// LSERDY in RCC_BDCR and the reset flags of RCC_CSR. The enables are
+// plain memory
+typedef struct {
+    __IO uint32_t CR;
+    __IO uint32_t AHB1ENR;
+    __IO uint32_t APB1ENR;
+    __IO uint32_t APB2ENR;
+    __IO uint32_t BDCR;
+    __IO uint32_t CSR;
+} RCC_TypeDef;
+
+extern RCC_TypeDef SimRCC;
+
+#define RCC   (&SimRCC)
+
+#define RCC_CR_HSION                 (1UL << 0)
+#define RCC_CR_HSIRDY                (1UL << 1)
+#define RCC_CR_HSITRIM_Pos           3U
+#define RCC_CR_HSITRIM               (0x1FUL << RCC_CR_HSITRIM_Pos)
+#define RCC_CR_HSICAL_Pos            8U
+#define RCC_CR_HSICAL                (0xFFUL << RCC_CR_HSICAL_Pos)
+
+#define RCC_BDCR_LSEON               (1UL << 0)
+#define RCC_BDCR_LSERDY              (1UL << 1)
+
+#define RCC_CSR_RMVF                 (1UL << 24)
+#define RCC_CSR_BORRSTF              (1UL << 25)
+#define RCC_CSR_PINRSTF              (1UL << 26)
+#define RCC_CSR_PORRSTF              (1UL << 27)
+#define RCC_CSR_SFTRSTF              (1UL << 28)
+#define RCC_CSR_IWDGRSTF             (1UL << 29)
+#define RCC_CSR_WWDGRSTF             (1UL << 30)
+#define RCC_CSR_LPWRRSTF             (1UL << 31)
+
+#define RCC_AHB1ENR_GPIOAEN          (1UL << 0)
+#define RCC_AHB1ENR_DMA1EN           (1UL << 21)
+#define RCC_AHB1ENR_DMA2EN           (1UL << 22)
+#define RCC_APB1ENR_TIM5EN           (1UL << 3)
+#define RCC_APB1ENR_USART2EN         (1UL << 17)
+#define RCC_APB2ENR_USART1EN         (1UL << 4)
+
+// Writing RMVF clears the flags on the MCU; the sim has no write hook
+#define __HAL_RCC_CLEAR_RESET_FLAGS()        do { RCC->CSR &= ~0xFF000000UL; } while(0)
+
+// Clock gates have no effect in the simulation
+#define __HAL_RCC_PWR_CLK_ENABLE()           do { } while(0)
+#define __HAL_RCC_GPIOA_CLK_ENABLE()         do { } while(0)
+#define __HAL_RCC_GPIOB_CLK_ENABLE()         do { } while(0)
+#define __HAL_RCC_GPIOC_CLK_ENABLE()         do { } while(0)
+#define __HAL_PWR_VOLTAGESCALING_CONFIG(x)   (PWR->CR = (PWR->CR & ~PWR_CR_VOS) | (x))
+#define __HAL_RCC_BKPSRAM_CLK_ENABLE()      do { } while(0)
+
+// The backup SRAM is an array (sim_hal.c): Sim_Reset() fills it with
+// noise, as a power-on without a battery leaves it; a warm reset keeps it
+#define SIM_BKPSRAM_BYTES            4096U
+
+extern uint8_t SimBkpSram[];
+
+#define BKPSRAM_BASE                 ((uintptr_t)SimBkpSram)
+
+// Backup domain write access (DBP) and the backup regulator: always on
+void HAL_PWR_EnableBkUpAccess(void);
+HAL_StatusTypeDef HAL_PWREx_EnableBkUpReg(void);
+
+// Over-drive (VOS scale 1 only): ODEN and ODSWEN, with the ready flags
+// at once; HAL_RCC_ClockConfig() checks the clocks against them
+HAL_StatusTypeDef HAL_PWREx_EnableOverDrive(void);
+HAL_StatusTypeDef HAL_PWREx_DisableOverDrive(void);
+
+/* PVD: PVDO follows the simulated supply (Sim_SetSupply()) against
+ * the PLS level while PVDE is set; its edges go through EXTI line 16
+ * to PVD_IRQn as configured. Only line 16 exists. */
+typedef struct {
+    __IO uint32_t CR;
+    __IO uint32_t CSR;
+} PWR_TypeDef;
+
+typedef struct {
+    __IO uint32_t IMR;
+    __IO uint32_t EMR;
+    __IO uint32_t RTSR;
+    __IO uint32_t FTSR;
+    __IO uint32_t SWIER;
+    __IO uint32_t PR;
+} EXTI_TypeDef;
+
+extern PWR_TypeDef  SimPWR;
+extern EXTI_TypeDef SimEXTI;
+
+#define PWR   (&SimPWR)
+#define EXTI  (&SimEXTI)
+
+#define PWR_CR_PVDE_Pos              4U
+#define PWR_CR_PVDE                  (1UL << PWR_CR_PVDE_Pos)
+#define PWR_CR_PLS_Pos               5U
+#define PWR_CR_PLS                   (7UL << PWR_CR_PLS_Pos)
+#define PWR_CR_ODEN                  (1UL << 16)
+#define PWR_CR_ODSWEN                (1UL << 17)
+#define PWR_CR_VOS                   (3UL << 14)
+#define PWR_CSR_PVDO                 (1UL << 2)
+#define PWR_CSR_ODRDY                (1UL << 16)
+#define PWR_CSR_ODSWRDY              (1UL << 17)
+#define PWR_FLAG_PVDO                PWR_CSR_PVDO
+#define PWR_EXTI_LINE_PVD            (1UL << 16)
+
+#define PWR_PVD_MODE_IT_RISING          0x00010001U
+#define PWR_PVD_MODE_IT_FALLING         0x00010002U
+#define PWR_PVD_MODE_IT_RISING_FALLING  0x00010003U
+
+typedef struct {
+    uint32_t PVDLevel;
+    uint32_t Mode;
+} PWR_PVDTypeDef;
+
+void HAL_PWR_ConfigPVD(PWR_PVDTypeDef *sConfigPVD);
+void HAL_PWR_EnablePVD(void);
+
+// A polled flag costs a few cycles, so a wait loop lets time run on
+uint32_t Sim_PwrReadCsr(void);
+
+#define __HAL_PWR_GET_FLAG(flag)          ((Sim_PwrReadCsr() & (flag)) == (flag))
+#define __HAL_PWR_PVD_EXTI_CLEAR_FLAG()   (EXTI->PR = PWR_EXTI_LINE_PVD)
+
+/* ================== FLASH ================== */
+
+// The 512 KB of flash are an array (sim_flash.c), erased at start-up;
+// firmware reaches its sectors through FLASH_BASE. Addresses are
+// uintptr_t here, uint32_t in the HAL: pointers are wider on the host.
+extern uint8_t SimFlash[];
+
+#define FLASH_BASE                   ((uintptr_t)SimFlash)
+
+#define FLASH_TYPEERASE_SECTORS      0x00000000U
+#define FLASH_TYPEPROGRAM_BYTE       0x00000000U
+#define FLASH_TYPEPROGRAM_HALFWORD   0x00000001U
+#define FLASH_TYPEPROGRAM_WORD       0x00000002U
+#define FLASH_TYPEPROGRAM_DOUBLEWORD 0x00000003U
+#define FLASH_VOLTAGE_RANGE_3        0x00000002U
+#define FLASH_BANK_1                 1U
+
+#define FLASH_SECTOR_0               0U
+#define FLASH_SECTOR_1               1U
+#define FLASH_SECTOR_2               2U
+#define FLASH_SECTOR_3               3U
+#define FLASH_SECTOR_4               4U
+#define FLASH_SECTOR_5               5U
+#define FLASH_SECTOR_6               6U
+#define FLASH_SECTOR_7               7U
+
+#define FLASH_FLAG_EOP               (1UL << 0)
+#define FLASH_FLAG_OPERR             (1UL << 1)
+#define FLASH_FLAG_WRPERR            (1UL << 4)
+#define FLASH_FLAG_PGAERR            (1UL << 5)
+#define FLASH_FLAG_PGPERR            (1UL << 6)
+#define FLASH_FLAG_PGSERR            (1UL << 7)
+
+// Errors are not modelled, there are no flags to clear
+#define __HAL_FLASH_CLEAR_FLAG(flags)        do { (void)(flags); } while(0)
+
+typedef struct {
+    uint32_t TypeErase;
+    uint32_t Banks;
+    uint32_t Sector;
+    uint32_t NbSectors;
+    uint32_t VoltageRange;
+} FLASH_EraseInitTypeDef;
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uintptr_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *SectorError);
+
+/* ================== GPIO ================== */
+
+typedef struct {
+    __IO uint32_t MODER;
+    __IO uint32_t OTYPER;
+    __IO uint32_t OSPEEDR;
+    __IO uint32_t PUPDR;
+    __IO uint32_t IDR;
+    __IO uint32_t ODR;
+    __IO uint32_t BSRR;
+    __IO uint32_t LCKR;
+    __IO uint32_t AFR[2];
+} GPIO_TypeDef;
+
+#define SIM_GPIO_PORTS  3
+
+extern GPIO_TypeDef SimGPIO[SIM_GPIO_PORTS];
+
+#define GPIOA   (&SimGPIO[0])
+#define GPIOB   (&SimGPIO[1])
+#define GPIOC   (&SimGPIO[2])
+
+typedef enum {
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef struct {
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+    uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+#define GPIO_PIN_0               ((uint16_t)0x0001)
+#define GPIO_PIN_1               ((uint16_t)0x0002)
+#define GPIO_PIN_2               ((uint16_t)0x0004)
+#define GPIO_PIN_3               ((uint16_t)0x0008)
+#define GPIO_PIN_4               ((uint16_t)0x0010)
+#define GPIO_PIN_5               ((uint16_t)0x0020)
+#define GPIO_PIN_6               ((uint16_t)0x0040)
+#define GPIO_PIN_7               ((uint16_t)0x0080)
+#define GPIO_PIN_8               ((uint16_t)0x0100)
+#define GPIO_PIN_9               ((uint16_t)0x0200)
+#define GPIO_PIN_10              ((uint16_t)0x0400)
+#define GPIO_PIN_11              ((uint16_t)0x0800)
+#define GPIO_PIN_12              ((uint16_t)0x1000)
+#define GPIO_PIN_13              ((uint16_t)0x2000)
+#define GPIO_PIN_14              ((uint16_t)0x4000)
+#define GPIO_PIN_15              ((uint16_t)0x8000)
+#define GPIO_PIN_All             ((uint16_t)0xFFFF)
+
+#define GPIO_MODE_INPUT          0x00000000U
+#define GPIO_MODE_OUTPUT_PP      0x00000001U
+#define GPIO_MODE_OUTPUT_OD      0x00000011U
+#define GPIO_MODE_AF_PP          0x00000002U
+
+#define GPIO_NOPULL              0x00000000U
+#define GPIO_PULLUP              0x00000001U
+#define GPIO_PULLDOWN            0x00000002U
+
+#define GPIO_SPEED_FREQ_LOW        0x00000000U
+#define GPIO_SPEED_FREQ_MEDIUM     0x00000001U
+#define GPIO_SPEED_FREQ_HIGH       0x00000002U
+#define GPIO_SPEED_FREQ_VERY_HIGH  0x00000003U
+
+// Register-level pin set-up (alternate functions) is stored but not modelled
+#define GPIO_MODER_MODER2            (0x3UL << 4)
+#define GPIO_MODER_MODER2_1          (0x2UL << 4)
+#define GPIO_MODER_MODER3            (0x3UL << 6)
+#define GPIO_MODER_MODER3_1          (0x2UL << 6)
+#define GPIO_MODER_MODER9            (0x3UL << 18)
+#define GPIO_MODER_MODER9_1          (0x2UL << 18)
+#define GPIO_OSPEEDER_OSPEEDR2       (0x3UL << 4)
+#define GPIO_OSPEEDER_OSPEEDR9       (0x3UL << 18)
+#define GPIO_PUPDR_PUPD3             (0x3UL << 6)
+#define GPIO_PUPDR_PUPD3_0           (0x1UL << 6)
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+
+/* ================== RTC ================== */
+
+typedef struct {
+    __IO uint32_t TR;
+    __IO uint32_t DR;
+    __IO uint32_t CR;
+    __IO uint32_t ISR;
+    __IO uint32_t PRER;
+    __IO uint32_t WUTR;
+    __IO uint32_t CALIBR;
+    __IO uint32_t ALRMAR;
+    __IO uint32_t ALRMBR;
+    __IO uint32_t WPR;
+    __IO uint32_t SSR;
+    __IO uint32_t SHIFTR;
+    __IO uint32_t TSTR;
+    __IO uint32_t TSDR;
+    __IO uint32_t TSSSR;
+    __IO uint32_t CALR;
+    __IO uint32_t TAFCR;
+    __IO uint32_t ALRMASSR;
+    __IO uint32_t ALRMBSSR;
+    uint32_t      RESERVED7;
+    __IO uint32_t BKP0R;
+    __IO uint32_t BKP1R;
+    __IO uint32_t BKP2R;
+    __IO uint32_t BKP3R;
+    __IO uint32_t BKP4R;
+    __IO uint32_t BKP5R;
+    __IO uint32_t BKP6R;
+    __IO uint32_t BKP7R;
+    __IO uint32_t BKP8R;
+    __IO uint32_t BKP9R;
+    __IO uint32_t BKP10R;
+    __IO uint32_t BKP11R;
+    __IO uint32_t BKP12R;
+    __IO uint32_t BKP13R;
+    __IO uint32_t BKP14R;
+    __IO uint32_t BKP15R;
+    __IO uint32_t BKP16R;
+    __IO uint32_t BKP17R;
+    __IO uint32_t BKP18R;
+    __IO uint32_t BKP19R;
+} RTC_TypeDef;
+
+extern RTC_TypeDef SimRTC;
+
+#define RTC   (&SimRTC)
+
+typedef struct {
+    uint32_t HourFormat;
+    uint32_t AsynchPrediv;
+    uint32_t SynchPrediv;
+    uint32_t OutPut;
+    uint32_t OutPutPolarity;
+    uint32_t OutPutType;
+} RTC_InitTypeDef;
+
+typedef struct {
+    RTC_TypeDef     *Instance;
+    RTC_InitTypeDef  Init;
+} RTC_HandleTypeDef;
+
+typedef struct {
+    uint8_t  Hours;
+    uint8_t  Minutes;
+    uint8_t  Seconds;
+    uint8_t  TimeFormat;
+    uint32_t SubSeconds;
+    uint32_t SecondFraction;
+    uint32_t DayLightSaving;
+    uint32_t StoreOperation;
+} RTC_TimeTypeDef;
+
+typedef struct {
+    uint8_t WeekDay;
+    uint8_t Month;
+    uint8_t Date;
+    uint8_t Year;
+} RTC_DateTypeDef;
+
+#define RTC_HOURFORMAT_24            0x00000000U
+#define RTC_HOURFORMAT_12            0x00000040U
+#define RTC_OUTPUT_DISABLE           0x00000000U
+#define RTC_OUTPUT_POLARITY_HIGH     0x00000000U
+#define RTC_OUTPUT_TYPE_OPENDRAIN    0x00000000U
+
+#define RTC_HOURFORMAT12_AM          ((uint8_t)0x00)
+#define RTC_HOURFORMAT12_PM          ((uint8_t)0x01)
+
+#define RTC_DAYLIGHTSAVING_NONE      0x00000000U
+#define RTC_STOREOPERATION_RESET     0x00000000U
+
+#define RTC_ISR_INIT                 (1UL << 7)
+
+#define RTC_FORMAT_BIN               0x00000000U
+#define RTC_FORMAT_BCD               0x00000001U
+
+#define RTC_MONTH_JANUARY            ((uint8_t)0x01)
+#define RTC_WEEKDAY_MONDAY           ((uint8_t)0x01)
+#define RTC_WEEKDAY_SUNDAY           ((uint8_t)0x07)
+
+#define RTC_BKP_DR0                  0x00000000U
+#define RTC_BKP_DR1                  0x00000001U
+#define RTC_BKP_DR19                 0x00000013U
+
+HAL_StatusTypeDef HAL_RTC_Init(RTC_HandleTypeDef *hrtc);
+HAL_StatusTypeDef HAL_RTC_SetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format);
+HAL_StatusTypeDef HAL_RTC_GetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format);
+HAL_StatusTypeDef HAL_RTC_SetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format);
+HAL_StatusTypeDef HAL_RTC_GetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format);
+void HAL_RTCEx_BKUPWrite(RTC_HandleTypeDef *hrtc, uint32_t BackupRegister, uint32_t Data);
+uint32_t HAL_RTCEx_BKUPRead(RTC_HandleTypeDef *hrtc, uint32_t BackupRegister);
+
+#define RTC_SHIFTADD1S_RESET         0x00000000U
+#define RTC_SHIFTADD1S_SET           0x80000000U
+
+HAL_StatusTypeDef HAL_RTCEx_SetSynchroShift(RTC_HandleTypeDef *hrtc, uint32_t ShiftAdd1S, uint32_t ShiftSubFS);
+
+#define RTC_SMOOTHCALIB_PERIOD_32SEC      0x00000000U
+#define RTC_SMOOTHCALIB_PLUSPULSES_RESET  0x00000000U
+#define RTC_SMOOTHCALIB_PLUSPULSES_SET    0x00008000U   // RTC_CALR_CALP
+
+// Stored in RTC->CALR; the simulated RTC's rate does not change
+HAL_StatusTypeDef HAL_RTCEx_SetSmoothCalib(RTC_HandleTypeDef *hrtc, uint32_t SmoothCalibPeriod,
+                                           uint32_t SmoothCalibPlusPulses,
+                                           uint32_t SmoothCalibMinusPulsesValue);
+
+/* ================== USART / DMA ==================
+ * USART2 with DMA1 stream 5 (RX) and stream 6 (TX), channel 4, and
+ * USART1 TX with DMA2 stream 7, channel 4, as on the F446.
+ * Sim_UartAttach() connects a line to a file
+ * descriptor (e.g. a pty). Memory addresses are uintptr_t here
+ * because host pointers are 64 bits wide; on the MCU the same
+ * source writes a 32-bit address.
+ */
+
+typedef struct {
+    __IO uint32_t SR;
+    __IO uint32_t DR;
+    __IO uint32_t BRR;
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t CR3;
+    __IO uint32_t GTPR;
+} USART_TypeDef;
+
+typedef struct {
+    __IO uint32_t  CR;
+    __IO uint32_t  NDTR;
+    __IO uintptr_t PAR;
+    __IO uintptr_t M0AR;
+    __IO uintptr_t M1AR;
+    __IO uint32_t  FCR;
+} DMA_Stream_TypeDef;
+
+typedef struct {
+    __IO uint32_t LISR;
+    __IO uint32_t HISR;
+    __IO uint32_t LIFCR;
+    __IO uint32_t HIFCR;
+} DMA_TypeDef;
+
+extern USART_TypeDef      SimUSART1;
+extern USART_TypeDef      SimUSART2;
+extern DMA_TypeDef        SimDMA1;
+extern DMA_TypeDef        SimDMA2;
+extern DMA_Stream_TypeDef SimDMA1Stream[8];
+extern DMA_Stream_TypeDef SimDMA2Stream[8];
+
+#define USART1        (&SimUSART1)
+#define USART2        (&SimUSART2)
+#define DMA1          (&SimDMA1)
+#define DMA2          (&SimDMA2)
+#define DMA1_Stream5  (&SimDMA1Stream[5])
+#define DMA1_Stream6  (&SimDMA1Stream[6])
+#define DMA2_Stream7  (&SimDMA2Stream[7])
+
+#define USART_SR_ORE                 (1UL << 3)
+#define USART_SR_IDLE                (1UL << 4)
+#define USART_SR_RXNE                (1UL << 5)
+#define USART_SR_TC                  (1UL << 6)
+#define USART_SR_TXE                 (1UL << 7)
+#define USART_CR1_RE                 (1UL << 2)
+#define USART_CR1_TE                 (1UL << 3)
+#define USART_CR1_IDLEIE             (1UL << 4)
+#define USART_CR1_UE                 (1UL << 13)
+#define USART_CR3_DMAR               (1UL << 6)
+#define USART_CR3_DMAT               (1UL << 7)
+
+#define DMA_SxCR_EN                  (1UL << 0)
+#define DMA_SxCR_HTIE                (1UL << 3)
+#define DMA_SxCR_TCIE                (1UL << 4)
+#define DMA_SxCR_DIR_0               (1UL << 6)
+#define DMA_SxCR_CIRC                (1UL << 8)
+#define DMA_SxCR_MINC                (1UL << 10)
+#define DMA_SxCR_CHSEL_Pos           25U
+
+#define DMA_HISR_HTIF5               (1UL << 10)
+#define DMA_HISR_TCIF5               (1UL << 11)
+#define DMA_HISR_TCIF6               (1UL << 21)
+#define DMA_HIFCR_CFEIF5             (1UL << 6)
+#define DMA_HIFCR_CDMEIF5            (1UL << 8)
+#define DMA_HIFCR_CTEIF5             (1UL << 9)
+#define DMA_HIFCR_CHTIF5             (1UL << 10)
+#define DMA_HIFCR_CTCIF5             (1UL << 11)
+#define DMA_HIFCR_CFEIF6             (1UL << 16)
+#define DMA_HIFCR_CDMEIF6            (1UL << 18)
+#define DMA_HIFCR_CTEIF6             (1UL << 19)
+#define DMA_HIFCR_CHTIF6             (1UL << 20)
+#define DMA_HIFCR_CTCIF6             (1UL << 21)
+#define DMA_HISR_TCIF7               (1UL << 27)
+#define DMA_HIFCR_CFEIF7             (1UL << 22)
+#define DMA_HIFCR_CDMEIF7            (1UL << 24)
+#define DMA_HIFCR_CTEIF7             (1UL << 25)
+#define DMA_HIFCR_CHTIF7             (1UL << 26)
+#define DMA_HIFCR_CTCIF7             (1UL << 27)
+
+/* ================== TIM5 ==================
+ * The counter runs from the APB1 timer clock (x2 when APB1 is
+ * divided), with PSC 0. Channel 4 captures on TI4, which TIM5_OR
+ * connects to the LSE: see sim_tim.c for what is modelled.
+ */
+
+typedef struct {
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t SMCR;
+    __IO uint32_t DIER;
+    __IO uint32_t SR;
+    __IO uint32_t EGR;
+    __IO uint32_t CCMR1;
+    __IO uint32_t CCMR2;
+    __IO uint32_t CCER;
+    __IO uint32_t CNT;
+    __IO uint32_t PSC;
+    __IO uint32_t ARR;
+    __IO uint32_t RCR;
+    __IO uint32_t CCR1;
+    __IO uint32_t CCR2;
+    __IO uint32_t CCR3;
+    __IO uint32_t CCR4;
+    __IO uint32_t BDTR;
+    __IO uint32_t DCR;
+    __IO uint32_t DMAR;
+    __IO uint32_t OR;
+} TIM_TypeDef;
+
+extern TIM_TypeDef SimTIM5;
+
+#define TIM5          (&SimTIM5)
+
+#define TIM_CR1_CEN                  (1UL << 0)
+#define TIM_DIER_CC4IE               (1UL << 4)
+#define TIM_SR_CC4IF                 (1UL << 4)
+#define TIM_SR_CC4OF                 (1UL << 12)
+#define TIM_EGR_UG                   (1UL << 0)
+#define TIM_CCMR2_CC4S_Pos           8U
+#define TIM_CCMR2_CC4S               (3UL << TIM_CCMR2_CC4S_Pos)
+#define TIM_CCMR2_CC4S_0             (1UL << TIM_CCMR2_CC4S_Pos)
+#define TIM_CCMR2_IC4PSC_Pos         10U
+#define TIM_CCMR2_IC4PSC             (3UL << TIM_CCMR2_IC4PSC_Pos)
+#define TIM_CCER_CC4E                (1UL << 12)
+#define TIM_OR_TI4_RMP_Pos           6U
+#define TIM_OR_TI4_RMP               (3UL << TIM_OR_TI4_RMP_Pos)
+#define TIM_OR_TI4_RMP_1             (2UL << TIM_OR_TI4_RMP_Pos)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STM32F4XX_HAL_H */
@@ -0,0 +1,207 @@
+#ifndef SIM_H
+#define SIM_H
+
+/**
+ * @file    sim.h
+ * @brief   Control interface of the host-side HAL simulation
+ *
+ * Harnesses (Host/host_main.c, fuzzers, replay tools) use this API
+ * to drive virtual time, inject button levels, set the RTC calendar
+ * and inspect what the firmware did to the pins and the LCD.
+ *
+ * Time model:
+ *  - A single virtual clock in nanoseconds drives HAL_GetTick(),
+ *    HAL_Delay(), the RTC calendar and DWT->CYCCNT (the HSI-clocked
+ *    ones at the HSI's pace, see Sim_SetHsiError()).
+ *  - HAL_Delay() and __NOP() advance virtual time instantly, so the
+ *    application runs as fast as the host CPU allows.
+ */
+
+#include <stdint.h>
+#include "stm32f4xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ================== LIFECYCLE ================== */
+
+// Reset all simulated peripherals and virtual time to zero
+void Sim_Reset(void);
+
+// HD44780 controller state (see sim_lcd.c)
+typedef struct {
+    uint8_t ddram[0x68];
+    uint8_t cgram[0x40];
+    uint8_t address;
+    uint8_t addressIsCgram;
+    uint8_t increment;
+    uint8_t fourBitMode;
+    uint8_t haveHighNibble;
+    uint8_t highNibble;
+} SimLcdState_t;
+
+// What a reset without power loss leaves alone: the backup domain
+// (RTC calendar, backup registers and backup SRAM) and the LCD, which
+// has its own supply. The firmware's .noinit RAM is up to the harness.
+typedef struct {
+    uint32_t rtcSeconds;
+    uint64_t rtcSubNs;
+    uint32_t rtcAhead;       // TR / DR ahead after a shift (sim_hal.c)
+    uint32_t bkp[20];
+    uint8_t  bkpSram[SIM_BKPSRAM_BYTES];
+    SimLcdState_t lcd;
+} SimRetained_t;
+
+// Sim_Reset() is a power-on reset (RCC_CSR: POR, BOR and pin reset)
+void Sim_SaveRetained(SimRetained_t *state);
+
+// Sim_Reset(), then restore 'state' as it was before an NRST reset
+void Sim_WarmReset(const SimRetained_t *state);
+
+/* ================== VIRTUAL TIME ================== */
+
+uint64_t Sim_TimeNs(void);
+uint64_t Sim_Cycles(void);
+
+// Advance virtual time (applies scheduled inputs on the way)
+void Sim_AdvanceNs(uint64_t ns);
+void Sim_AdvanceMs(uint32_t ms);
+void Sim_AdvanceCycles(uint64_t cycles);
+
+/* ================== GPIO ================== */
+
+typedef struct {
+    uint64_t timeNs;   // Virtual time of the write
+    uint8_t  port;     // 0 = GPIOA, 1 = GPIOB, 2 = GPIOC
+    uint16_t pins;     // Pin mask written
+    uint8_t  level;    // GPIO_PinState written
+} SimPinWrite_t;
+
+#define SIM_PIN_LOG_SIZE  4096U
+
+// Drive an input pin from outside (e.g. a button)
+void Sim_SetInput(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState level);
+
+// Change an input level at an absolute virtual time (ms)
+void Sim_ScheduleInput(uint32_t atMs, GPIO_TypeDef *port, uint16_t pin, GPIO_PinState level);
+
+// Pin write log: total writes so far and access to the last SIM_PIN_LOG_SIZE
+uint32_t Sim_PinWriteCount(void);
+const SimPinWrite_t *Sim_PinWrite(uint32_t index);
+
+/* ================== SUPPLY ================== */
+
+#define SIM_SUPPLY_MV  3300U    // VDD after Sim_Reset()
+
+// Set VDD. With the PVD on, crossing its level toggles PVDO and,
+// through EXTI line 16, pends PVD_IRQn. Nothing else depends on VDD:
+// there is no brown-out reset (a supply that stays off is
+// Sim_SaveRetained() and Sim_WarmReset()).
+void Sim_SetSupply(uint16_t millivolts);
+
+// Change VDD at an absolute virtual time (ms)
+void Sim_ScheduleSupply(uint32_t atMs, uint16_t millivolts);
+
+/* ================== RTC ================== */
+
+// Set the simulated calendar (binary values, year 0..99 = 2000..2099)
+void Sim_SetCalendar(uint8_t year, uint8_t month, uint8_t day,
+                     uint8_t hours, uint8_t minutes, uint8_t seconds);
+
+// Seconds since 2000-01-01 00:00:00 of the simulated calendar
+uint32_t Sim_CalendarSeconds(void);
+
+// HAL_RTC_SetTime / SetDate calls refused because a field was out of range
+uint32_t Sim_RtcRejectedWrites(void);
+
+/* ================== HSI ================== */
+
+// HSI error at the default trim (HSITRIM 16), in ppm; 0 after start-up
+// and kept by Sim_Reset(), as it belongs to the part. The CPU cycles,
+// SysTick and TIM5 run at the HSI's pace; virtual time, the RTC and
+// the LSE (32768 Hz, LSERDY 2 s after LSEON) do not. Each HSITRIM
+// step away from 16 adds about 0.47 %.
+void Sim_SetHsiError(int32_t ppm);
+
+/* ================== USART1 / USART2 ================== */
+
+// Connect a USART line (USART1 or USART2) to a non-blocking descriptor
+// (e.g. a pty master or a file): TX bytes are written to it, RX bytes
+// read from it. -1 disconnects; bytes sent then are lost.
+void Sim_UartAttach(USART_TypeDef *usart, int fd);
+
+// Keep virtual time from running ahead of the wall clock, so that
+// someone can type at the console
+void Sim_SetRealTime(int on);
+
+/* ================== FLASH ================== */
+
+// Programming only clears bits and an erase sets a whole sector to
+// 0xFF, as on the MCU; both fail while the flash is locked. Virtual
+// time follows the typical figures of the datasheet (x32): 16 us per
+// word, 250 / 550 / 1000 ms to erase a 16 / 64 / 128 KB sector.
+// The contents survive Sim_Reset() (they are non-volatile).
+
+#define SIM_FLASH_BYTES  (512U * 1024U)
+
+// Erase the whole flash, as from the factory
+void Sim_FlashWipe(void);
+
+// Power cut: the next 'operations' program / erase operations complete,
+// the one after is torn (a random subset of its bits changes) and
+// 'cut' is called, which should not return (e.g. longjmp back to the
+// harness). 0 disarms.
+void Sim_FlashCutAfter(uint32_t operations, void (*cut)(void));
+
+// Program and erase operations so far, and how many were erases
+uint32_t Sim_FlashOperations(void);
+uint32_t Sim_FlashErases(void);
+
+/* ================== HD44780 LCD MODEL ================== */
+
+#define SIM_LCD_ROWS  2
+#define SIM_LCD_COLS  16
+
+// Visible text of one row, NUL-terminated (custom chars are codes 0..7)
+void Sim_LcdRow(uint8_t row, char out[SIM_LCD_COLS + 1]);
+
+// Increments every time the visible contents change
+uint32_t Sim_LcdVersion(void);
+
+// Number of commands / data bytes decoded so far
+uint32_t Sim_LcdCommandCount(void);
+uint32_t Sim_LcdDataCount(void);
+
+// Characters written to DDRAM outside the 16 visible columns
+uint32_t Sim_LcdHiddenWrites(void);
+
+// Called from HAL_Delay() whenever the visible LCD contents changed
+typedef void (*SimFrameCallback_t)(uint64_t timeNs);
+void Sim_SetFrameCallback(SimFrameCallback_t cb);
+
+/* ================== RUNNING THE FIRMWARE ================== */
+
+// Firmware entry point (main.c is compiled with -Dmain=firmware_main)
+int firmware_main(void);
+
+// Run firmware_main() until virtual time reaches 'untilMs', then return
+void Sim_RunFirmware(uint32_t untilMs);
+
+// Internal: hooks between sim_hal.c and sim_lcd.c
+void Sim_LcdReset(void);
+void Sim_LcdPinsChanged(void);
+void Sim_LcdSaveState(SimLcdState_t *state);
+void Sim_LcdLoadState(const SimLcdState_t *state);
+void Sim_UartReset(void);
+void Sim_UartStep(uint64_t timeNs);
+void Sim_TimReset(void);
+void Sim_TimStep(uint64_t timeNs, uint64_t cycles);
+void Sim_NvicPend(IRQn_Type IRQn);
+void Sim_NvicDeliver(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_H */
@@ -0,0 +1,142 @@
+/**
+ * @file    sim_flash.c
+ * @brief   Embedded flash: word programming, sector erase and power cuts
+ *
+ * Only what the firmware's flash users need: HAL_FLASH_Program() of
+ * words and HAL_FLASHEx_Erase() of whole sectors, with the F446 sector
+ * map. Reads are plain memory reads of SimFlash through FLASH_BASE.
+ *
+ * A torn operation (Sim_FlashCutAfter()) leaves what a power cut in the
+ * middle of it could: a program clears only some of the bits it should
+ * and an erase sets only some of the bits it should.
+ */
+
+#include "sim.h"
+#include <string.h>
+
+uint8_t SimFlash[SIM_FLASH_BYTES];
+
+static const uint32_t sectorStart[9] = {
+    0x00000U, 0x04000U, 0x08000U, 0x0C000U, 0x10000U, 0x20000U, 0x40000U, 0x60000U, 0x80000U,
+};
+static const uint32_t sectorEraseMs[8] = { 250, 250, 250, 250, 550, 1000, 1000, 1000 };
+
+static int      unlocked;
+static uint32_t operations;
+static uint32_t erases;
+static uint32_t cutAfter;          // Operations left before the cut, 0 = disarmed
+static void   (*cutHandler)(void);
+static uint32_t noise = 0x2545F491U;
+
+void Sim_FlashWipe(void) {
+    memset(SimFlash, 0xFF, sizeof(SimFlash));
+    unlocked = 0;
+    operations = erases = 0;
+    cutAfter = 0;
+}
+
+// Erased at start-up; Sim_Reset() leaves the contents alone
+__attribute__((constructor)) static void Sim_FlashPowerOn(void) {
+    Sim_FlashWipe();
+}
+
+void Sim_FlashCutAfter(uint32_t count, void (*cut)(void)) {
+    cutAfter = (cut != NULL) ? count + 1U : 0U;
+    cutHandler = cut;
+    noise = 0x2545F491U ^ count;
+}
+
+uint32_t Sim_FlashOperations(void) {
+    return operations;
+}
+
+uint32_t Sim_FlashErases(void) {
+    return erases;
+}
+
+static uint32_t Sim_FlashNoise(void) {
+    noise ^= noise << 13;
+    noise ^= noise >> 17;
+    noise ^= noise << 5;
+    return noise;
+}
+
+// 1 when this operation is the one the power cut interrupts
+static int Sim_FlashTorn(void) {
+    operations++;
+    return cutAfter != 0U && --cutAfter == 0U;
+}
+
+static void Sim_FlashCut(void) {
+    void (*cut)(void) = cutHandler;
+
+    cutHandler = NULL;
+    unlocked = 0;
+    if(cut != NULL) {
+        cut();
+    }
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) {
+    unlocked = 1;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void) {
+    unlocked = 0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uintptr_t Address, uint64_t Data) {
+    uintptr_t offset = Address - FLASH_BASE;
+    uint32_t word;
+
+    if(!unlocked || TypeProgram != FLASH_TYPEPROGRAM_WORD || (offset & 3U) != 0U ||
+       Address < FLASH_BASE || offset >= SIM_FLASH_BYTES) {
+        return HAL_ERROR;
+    }
+    Sim_AdvanceNs(16000U);
+
+    memcpy(&word, &SimFlash[offset], sizeof(word));
+    if(Sim_FlashTorn()) {
+        // Only some of the bits to be cleared got there
+        word &= (uint32_t)Data | Sim_FlashNoise();
+        memcpy(&SimFlash[offset], &word, sizeof(word));
+        Sim_FlashCut();
+        return HAL_ERROR;
+    }
+    word &= (uint32_t)Data;
+    memcpy(&SimFlash[offset], &word, sizeof(word));
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *SectorError) {
+    *SectorError = 0xFFFFFFFFU;
+    if(!unlocked || pEraseInit->TypeErase != FLASH_TYPEERASE_SECTORS ||
+       pEraseInit->Sector + pEraseInit->NbSectors > 8U) {
+        return HAL_ERROR;
+    }
+
+    for(uint32_t s = pEraseInit->Sector; s < pEraseInit->Sector + pEraseInit->NbSectors; s++) {
+        uint8_t *p = &SimFlash[sectorStart[s]];
+        uint32_t length = sectorStart[s + 1] - sectorStart[s];
+
+        Sim_AdvanceMs(sectorEraseMs[s]);
+        erases++;
+        if(Sim_FlashTorn()) {
+            // Some of the bits set, in no particular order
+            for(uint32_t i = 0; i < length; i += 4U) {
+                uint32_t word;
+
+                memcpy(&word, &p[i], sizeof(word));
+                word |= Sim_FlashNoise() & Sim_FlashNoise();
+                memcpy(&p[i], &word, sizeof(word));
+            }
+            *SectorError = s;
+            Sim_FlashCut();
+            return HAL_ERROR;
+        }
+        memset(p, 0xFF, length);
+    }
+    return HAL_OK;
+}
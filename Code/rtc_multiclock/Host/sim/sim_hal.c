@@ -0,0 +1,1013 @@
+/**
+ * @file    sim_hal.c
+ * @brief   Host implementation of the simulated HAL (see stm32f4xx_hal.h)
+ *
+ * Everything is driven by one virtual clock. Blocking calls such as
+ * HAL_Delay() simply move that clock forward, which is why the whole
+ * application runs many thousands of times faster than real time.
+ *
+ * Virtual time is true time: the RTC and the LSE keep it. The CPU
+ * cycles and SysTick run from the HSI, which is off by the error set
+ * with Sim_SetHsiError() plus HSITRIM steps away from 16.
+ */
+
+#include "sim.h"
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* ================== SIMULATED REGISTERS ================== */
+
+uint32_t SystemCoreClock = 16000000U;   // HSI after reset
+
+DWT_Type       SimDWT;
+CoreDebug_Type SimCoreDebug;
+SCB_Type       SimSCB;
+GPIO_TypeDef   SimGPIO[SIM_GPIO_PORTS];
+RTC_TypeDef    SimRTC;
+RCC_TypeDef    SimRCC;
+PWR_TypeDef    SimPWR;
+EXTI_TypeDef   SimEXTI;
+
+uint8_t        SimBkpSram[SIM_BKPSRAM_BYTES];
+
+/* ================== VIRTUAL TIME ================== */
+
+// Cost of one HAL_GetTick() call, so that polling loops make progress
+#define SIM_GETTICK_CYCLES   20U
+
+static uint64_t timeNs;
+static uint64_t hsiNs;            // Virtual time at the HSI's pace (SysTick)
+static uint64_t hsiRemainder;
+static uint64_t cycles;
+static uint64_t cycleRemainder;   // ns -> cycles carry
+static uint64_t nsRemainder;      // cycles -> ns carry
+static uint32_t pendingCycles;    // __NOP() cycles not yet applied
+static uint32_t simPrimask;
+
+static uint32_t apb1Divider = 1;
+static uint32_t apb2Divider = 1;
+static RCC_PLLInitTypeDef pllConfig;
+static uint8_t  pllOn;
+static uint8_t  sysclkPll;        // SYSCLK runs from the PLL
+
+static int      realTime;
+static struct timespec realTimeStart;
+
+static int      running;
+static uint64_t runLimitNs;
+static jmp_buf  runJmp;
+
+#define SIM_RUN_LIMIT   1   // longjmp(runJmp): the run is over
+#define SIM_RUN_RESET   2   // NVIC_SystemReset()
+
+/* ================== GPIO STATE ================== */
+
+static uint16_t outputMask[SIM_GPIO_PORTS];  // Pins configured as outputs
+static uint16_t pullUpMask[SIM_GPIO_PORTS];  // Pins with pull-up enabled
+static uint16_t extDriven[SIM_GPIO_PORTS];   // Pins driven by Sim_SetInput
+static uint16_t extLevel[SIM_GPIO_PORTS];
+
+static SimPinWrite_t pinLog[SIM_PIN_LOG_SIZE];
+static uint32_t pinLogCount;
+
+#define SIM_MAX_SCHEDULED  256U
+#define SIM_SCHEDULED_SUPPLY  0xFFU   // 'port' of a supply change
+
+typedef struct {
+    uint64_t atNs;
+    uint8_t  port;
+    uint16_t pin;
+    uint8_t  level;
+    uint16_t millivolts;
+} SimScheduled_t;
+
+static SimScheduled_t scheduled[SIM_MAX_SCHEDULED];
+static uint32_t scheduledCount;
+static uint32_t scheduledNext;
+
+/* ================== HSI / LSE ================== */
+
+// HSITRIM step: RM0390 gives around 80 kHz (0.5 %); a little less
+// here, so a calibration cannot count on the figure
+#define SIM_HSI_TRIM_STEP_PPM   4700
+
+// LSE start-up, tSU(LSE) typical
+#define SIM_LSE_STARTUP_NS      2000000000ULL
+
+static int32_t  hsiFactoryPpm;    // HSI error at HSITRIM 16
+static uint64_t lseOnNs;          // LSEON seen set at this time
+static uint8_t  lseStarting;
+
+/* ================== SUPPLY ================== */
+
+// PVD thresholds by PLS (falling edge, datasheet typical values)
+static const uint16_t pvdLevelMv[8] = { 2000, 2100, 2300, 2500, 2600, 2700, 2800, 2900 };
+
+static uint16_t supplyMv = SIM_SUPPLY_MV;
+
+/* ================== RTC STATE ================== */
+
+static uint32_t rtcSeconds;      // Seconds since 2000-01-01 00:00:00
+static uint64_t rtcSubNs;        // Fraction of the current second
+// Seconds TR / DR read ahead of the calendar after a SUBFS shift, with
+// SSR above PREDIV_S by as many times PREDIV_S + 1 (RM0390, RTC_SSR)
+static uint32_t rtcAhead;
+static uint32_t rtcSynchPrediv = 255;
+static uint32_t rtcRejected;     // Out-of-range SetTime / SetDate calls
+
+static SimFrameCallback_t frameCallback;
+static uint32_t lastFrameVersion;
+
+/* ================== CALENDAR HELPERS ================== */
+
+static const uint8_t daysInMonth[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+static uint8_t Sim_IsLeap(uint32_t year) {
+    return (year % 4U) == 0U;    // Valid for 2000..2099
+}
+
+static uint8_t Sim_MonthDays(uint32_t year, uint32_t month) {
+    return (uint8_t)(daysInMonth[month - 1U] + ((month == 2U && Sim_IsLeap(year)) ? 1U : 0U));
+}
+
+static uint32_t Sim_DaysFromDate(uint32_t year, uint32_t month, uint32_t day) {
+    uint32_t days = 0;
+
+    for(uint32_t y = 0; y < year; y++) {
+        days += Sim_IsLeap(y) ? 366U : 365U;
+    }
+    for(uint32_t m = 1; m < month; m++) {
+        days += Sim_MonthDays(year, m);
+    }
+    return days + day - 1U;
+}
+
+static void Sim_DateFromDays(uint32_t days, uint8_t *year, uint8_t *month, uint8_t *day) {
+    uint32_t y = 0;
+    uint32_t m = 1;
+
+    while(days >= (Sim_IsLeap(y) ? 366U : 365U)) {
+        days -= Sim_IsLeap(y) ? 366U : 365U;
+        y++;
+    }
+    while(days >= Sim_MonthDays(y, m)) {
+        days -= Sim_MonthDays(y, m);
+        m++;
+    }
+    *year = (uint8_t)y;
+    *month = (uint8_t)m;
+    *day = (uint8_t)(days + 1U);
+}
+
+static uint8_t Sim_ToBcd(uint8_t v) {
+    return (uint8_t)(((v / 10U) << 4) | (v % 10U));
+}
+
+static uint8_t Sim_FromBcd(uint8_t v) {
+    return (uint8_t)((v >> 4) * 10U + (v & 0x0FU));
+}
+
+// Keep TR / DR / SSR in step with the calendar, like the real shadow registers
+static void Sim_RtcUpdateRegisters(void) {
+    uint32_t shown = rtcSeconds + rtcAhead;
+    uint32_t tod = shown % 86400U;
+    uint8_t y, mo, d;
+    uint8_t wd = (uint8_t)(((shown / 86400U) + 5U) % 7U + 1U);  // 2000-01-01 was a Saturday
+
+    Sim_DateFromDays(shown / 86400U, &y, &mo, &d);
+
+    SimRTC.TR = ((uint32_t)Sim_ToBcd((uint8_t)(tod / 3600U)) << 16) |
+                ((uint32_t)Sim_ToBcd((uint8_t)((tod / 60U) % 60U)) << 8) |
+                (uint32_t)Sim_ToBcd((uint8_t)(tod % 60U));
+    SimRTC.DR = ((uint32_t)Sim_ToBcd(y) << 16) | ((uint32_t)wd << 13) |
+                ((uint32_t)Sim_ToBcd(mo) << 8) | (uint32_t)Sim_ToBcd(d);
+    SimRTC.SSR = rtcSynchPrediv - (uint32_t)((rtcSubNs * (rtcSynchPrediv + 1U)) / 1000000000ULL) +
+                 rtcAhead * (rtcSynchPrediv + 1U);
+}
+
+/* ================== TIME CORE ================== */
+
+static void Sim_ApplyScheduled(void) {
+    while(scheduledNext < scheduledCount && scheduled[scheduledNext].atNs <= timeNs) {
+        const SimScheduled_t *s = &scheduled[scheduledNext++];
+
+        if(s->port == SIM_SCHEDULED_SUPPLY) {
+            Sim_SetSupply(s->millivolts);
+        } else {
+            Sim_SetInput(&SimGPIO[s->port], s->pin, (GPIO_PinState)s->level);
+        }
+    }
+}
+
+// New entry at 'atMs', after those at the same time; NULL when full
+static SimScheduled_t *Sim_ScheduleAt(uint32_t atMs) {
+    uint64_t at = (uint64_t)atMs * 1000000ULL;
+    uint32_t i;
+
+    if(scheduledCount >= SIM_MAX_SCHEDULED) {
+        return NULL;
+    }
+
+    // Keep the pending list sorted by time
+    for(i = scheduledCount; i > scheduledNext && scheduled[i - 1U].atNs > at; i--) {
+        scheduled[i] = scheduled[i - 1U];
+    }
+    memset(&scheduled[i], 0, sizeof(scheduled[i]));
+    scheduled[i].atNs = at;
+    scheduledCount++;
+    return &scheduled[i];
+}
+
+// Hold virtual time back to the wall clock (with 1 ms of slack)
+static void Sim_PaceRealTime(void) {
+    struct timespec now;
+    uint64_t wallNs;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    wallNs = (uint64_t)(now.tv_sec - realTimeStart.tv_sec) * 1000000000ULL +
+             (uint64_t)now.tv_nsec - (uint64_t)realTimeStart.tv_nsec;
+    if(timeNs > wallNs + 1000000ULL) {
+        struct timespec wait;
+        uint64_t ahead = timeNs - wallNs;
+
+        wait.tv_sec = (time_t)(ahead / 1000000000ULL);
+        wait.tv_nsec = (long)(ahead % 1000000000ULL);
+        nanosleep(&wait, NULL);
+    }
+}
+
+// HSI error now: the factory error and the trim
+static int32_t Sim_HsiPpm(void) {
+    int32_t trim = (int32_t)((SimRCC.CR & RCC_CR_HSITRIM) >> RCC_CR_HSITRIM_Pos);
+
+    return hsiFactoryPpm + (trim - (int32_t)RCC_HSICALIBRATION_DEFAULT) * SIM_HSI_TRIM_STEP_PPM;
+}
+
+// What SYSCLK runs at for a nominal SystemCoreClock
+static uint64_t Sim_CoreHz(void) {
+    return (uint64_t)SystemCoreClock * (uint64_t)(1000000 + Sim_HsiPpm()) / 1000000U;
+}
+
+// LSERDY once the crystal has been on for its start-up time
+static void Sim_LseStep(void) {
+    if(!(SimRCC.BDCR & RCC_BDCR_LSEON)) {
+        SimRCC.BDCR &= ~RCC_BDCR_LSERDY;
+        lseStarting = 0;
+    } else if(!(SimRCC.BDCR & RCC_BDCR_LSERDY)) {
+        if(!lseStarting) {
+            lseStarting = 1;
+            lseOnNs = timeNs;
+        } else if(timeNs - lseOnNs >= SIM_LSE_STARTUP_NS) {
+            SimRCC.BDCR |= RCC_BDCR_LSERDY;
+        }
+    }
+}
+
+static void Sim_Step(uint64_t ns, uint64_t cyc) {
+    timeNs += ns;
+    cycles += cyc;
+
+    hsiRemainder += ns * (uint64_t)(1000000 + Sim_HsiPpm());
+    hsiNs += hsiRemainder / 1000000U;
+    hsiRemainder %= 1000000U;
+    Sim_LseStep();
+
+    if(SimDWT.CTRL & DWT_CTRL_CYCCNTENA_Msk) {
+        SimDWT.CYCCNT += (uint32_t)cyc;
+    }
+
+    rtcSubNs += ns;
+    if(rtcSubNs >= 1000000000ULL) {
+        uint32_t seconds = (uint32_t)(rtcSubNs / 1000000000ULL);
+
+        // SSR runs down to PREDIV_S first; TR / DR stand still meanwhile
+        rtcAhead -= (seconds < rtcAhead) ? seconds : rtcAhead;
+        rtcSeconds += seconds;
+        rtcSubNs %= 1000000000ULL;
+    }
+
+    Sim_ApplyScheduled();
+    Sim_TimStep(timeNs, cycles);
+    Sim_UartStep(timeNs);
+
+    if(realTime) {
+        Sim_PaceRealTime();
+    }
+
+    if(running && timeNs >= runLimitNs) {
+        running = 0;
+        longjmp(runJmp, SIM_RUN_LIMIT);
+    }
+}
+
+// A step is cut at each scheduled input on the way, so that the
+// handler of an interrupt it raises runs at its time (a supply dip
+// shorter than a HAL_Delay() must not go unseen)
+static void Sim_Advance(uint64_t ns, uint64_t cyc) {
+    while(scheduledNext < scheduledCount && scheduled[scheduledNext].atNs > timeNs &&
+          scheduled[scheduledNext].atNs < timeNs + ns) {
+        uint64_t partNs = scheduled[scheduledNext].atNs - timeNs;
+        uint64_t partCyc = cyc * partNs / ns;
+
+        Sim_Step(partNs, partCyc);
+        ns -= partNs;
+        cyc -= partCyc;
+    }
+    Sim_Step(ns, cyc);
+}
+
+// Apply cycles accumulated by __NOP() busy loops
+static void Sim_Flush(void) {
+    if(pendingCycles != 0U) {
+        uint32_t cyc = pendingCycles;
+        pendingCycles = 0;
+        Sim_AdvanceCycles(cyc);
+    }
+}
+
+uint64_t Sim_TimeNs(void) {
+    Sim_Flush();
+    return timeNs;
+}
+
+uint64_t Sim_Cycles(void) {
+    Sim_Flush();
+    return cycles;
+}
+
+void Sim_AdvanceNs(uint64_t ns) {
+    uint64_t hz;
+    uint64_t cyc;
+
+    Sim_Flush();
+    hz = Sim_CoreHz();
+    cycleRemainder += (ns % 1000000000ULL) * hz;
+    cyc = (ns / 1000000000ULL) * hz + cycleRemainder / 1000000000ULL;
+    cycleRemainder %= 1000000000ULL;
+    Sim_Advance(ns, cyc);
+}
+
+void Sim_SetRealTime(int on) {
+    struct timespec now;
+
+    // Wall time that corresponds to virtual time zero
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    now.tv_sec -= (time_t)(timeNs / 1000000000ULL);
+    now.tv_nsec -= (long)(timeNs % 1000000000ULL);
+    if(now.tv_nsec < 0) {
+        now.tv_nsec += 1000000000L;
+        now.tv_sec--;
+    }
+    realTimeStart = now;
+    realTime = on;
+}
+
+void Sim_AdvanceMs(uint32_t ms) {
+    Sim_AdvanceNs((uint64_t)ms * 1000000ULL);
+}
+
+void Sim_AdvanceCycles(uint64_t cyc) {
+    if(pendingCycles != 0U) {
+        cyc += pendingCycles;
+        pendingCycles = 0;
+    }
+    uint64_t hz = Sim_CoreHz();
+    nsRemainder += cyc * 1000000000ULL;
+    uint64_t ns = nsRemainder / hz;
+    nsRemainder %= hz;
+    Sim_Advance(ns, cyc);
+}
+
+/* ================== LIFECYCLE ================== */
+
+// Clock tree after any reset: HSI at its default trim, PLL off
+// (PWR_CR: scale 1)
+static void Sim_ClockReset(void) {
+    SystemCoreClock = 16000000U;
+    SimRCC.CR = RCC_CR_HSION | RCC_CR_HSIRDY | (RCC_HSICALIBRATION_DEFAULT << RCC_CR_HSITRIM_Pos);
+    apb1Divider = 1;
+    apb2Divider = 1;
+    memset(&pllConfig, 0, sizeof(pllConfig));
+    pllOn = 0;
+    sysclkPll = 0;
+}
+
+// Power-on contents of the backup SRAM: random, but the same every run
+static void Sim_BkpSramNoise(void) {
+    uint32_t x = 0x2545F491U;
+
+    for(uint32_t i = 0; i < SIM_BKPSRAM_BYTES; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        SimBkpSram[i] = (uint8_t)x;
+    }
+}
+
+void Sim_Reset(void) {
+    timeNs = cycles = cycleRemainder = nsRemainder = 0;
+    hsiNs = hsiRemainder = 0;
+    pendingCycles = 0;
+    running = 0;
+    Sim_ClockReset();
+    simPrimask = 0;
+
+    memset(&SimDWT, 0, sizeof(SimDWT));
+    memset(&SimCoreDebug, 0, sizeof(SimCoreDebug));
+    memset(&SimSCB, 0, sizeof(SimSCB));
+    memset(SimGPIO, 0, sizeof(SimGPIO));
+    memset(&SimRTC, 0, sizeof(SimRTC));
+    memset(&SimPWR, 0, sizeof(SimPWR));
+    SimPWR.CR = PWR_REGULATOR_VOLTAGE_SCALE1;
+    memset(&SimEXTI, 0, sizeof(SimEXTI));
+    supplyMv = SIM_SUPPLY_MV;
+    Sim_BkpSramNoise();
+    SimRCC.CSR = RCC_CSR_PORRSTF | RCC_CSR_PINRSTF | RCC_CSR_BORRSTF;
+    SimRCC.BDCR = 0;
+    lseStarting = 0;
+    memset(outputMask, 0, sizeof(outputMask));
+    memset(pullUpMask, 0, sizeof(pullUpMask));
+    memset(extDriven, 0, sizeof(extDriven));
+    memset(extLevel, 0, sizeof(extLevel));
+
+    pinLogCount = 0;
+    scheduledCount = scheduledNext = 0;
+    rtcSeconds = 0;
+    rtcSubNs = 0;
+    rtcAhead = 0;
+    rtcRejected = 0;
+    Sim_RtcUpdateRegisters();
+    frameCallback = NULL;
+    lastFrameVersion = 0;
+
+    Sim_LcdReset();
+    Sim_TimReset();
+    Sim_UartReset();
+}
+
+void Sim_SaveRetained(SimRetained_t *state) {
+    state->rtcSeconds = rtcSeconds;
+    state->rtcSubNs = rtcSubNs;
+    state->rtcAhead = rtcAhead;
+    memcpy(state->bkp, (const void *)&SimRTC.BKP0R, sizeof(state->bkp));
+    memcpy(state->bkpSram, SimBkpSram, sizeof(state->bkpSram));
+    Sim_LcdSaveState(&state->lcd);
+}
+
+void Sim_WarmReset(const SimRetained_t *state) {
+    Sim_Reset();
+    SimRCC.CSR = RCC_CSR_PINRSTF;
+
+    rtcSeconds = state->rtcSeconds;
+    rtcSubNs = state->rtcSubNs;
+    rtcAhead = state->rtcAhead;
+    memcpy((void *)&SimRTC.BKP0R, state->bkp, sizeof(state->bkp));
+    memcpy(SimBkpSram, state->bkpSram, sizeof(state->bkpSram));
+    Sim_RtcUpdateRegisters();
+    Sim_LcdLoadState(&state->lcd);
+}
+
+// What NVIC_SystemReset() puts back: the core, the clocks and the
+// peripherals. Time, the backup domain, the LCD, the supply, the
+// scheduled inputs and the pin log run on.
+static void Sim_SoftReset(void) {
+    Sim_Flush();
+    Sim_ClockReset();
+    simPrimask = 0;
+
+    memset(&SimDWT, 0, sizeof(SimDWT));
+    memset(&SimCoreDebug, 0, sizeof(SimCoreDebug));
+    memset(&SimSCB, 0, sizeof(SimSCB));
+    memset(SimGPIO, 0, sizeof(SimGPIO));
+    memset(outputMask, 0, sizeof(outputMask));
+    memset(pullUpMask, 0, sizeof(pullUpMask));
+    memset(&SimPWR, 0, sizeof(SimPWR));
+    SimPWR.CR = PWR_REGULATOR_VOLTAGE_SCALE1;
+    memset(&SimEXTI, 0, sizeof(SimEXTI));
+    Sim_RtcUpdateRegisters();
+    SimRCC.CSR = RCC_CSR_SFTRSTF | RCC_CSR_PINRSTF;
+
+    Sim_TimReset();
+    Sim_UartReset();
+}
+
+void Sim_RunFirmware(uint32_t untilMs) {
+    runLimitNs = (uint64_t)untilMs * 1000000ULL;
+    if(timeNs >= runLimitNs) {
+        return;
+    }
+    running = 1;
+    if(setjmp(runJmp) != SIM_RUN_LIMIT) {
+        // First entry, and again after each NVIC_SystemReset()
+        firmware_main();
+    }
+    running = 0;
+}
+
+void NVIC_SystemReset(void) {
+    if(!running) {
+        fprintf(stderr, "sim: NVIC_SystemReset() outside Sim_RunFirmware()\n");
+        abort();
+    }
+    Sim_SoftReset();
+    longjmp(runJmp, SIM_RUN_RESET);
+}
+
+void Sim_SetFrameCallback(SimFrameCallback_t cb) {
+    frameCallback = cb;
+}
+
+/* ================== CORE / HAL CORE ================== */
+
+// Hot path of every busy-wait: only accumulate, applied on next observation
+void __NOP(void) {
+    pendingCycles += SIM_NOP_LOOP_CYCLES;
+}
+
+// Interrupts are taken between HAL calls (sim_uart.c) while PRIMASK is clear
+void __disable_irq(void) {
+    simPrimask = 1;
+}
+
+void __enable_irq(void) {
+    simPrimask = 0;
+}
+
+uint32_t __get_PRIMASK(void) {
+    return simPrimask;
+}
+
+void __set_PRIMASK(uint32_t priMask) {
+    simPrimask = priMask;
+}
+
+HAL_StatusTypeDef HAL_Init(void) {
+    return HAL_OK;
+}
+
+uint32_t HAL_GetTick(void) {
+    Sim_AdvanceCycles(SIM_GETTICK_CYCLES);   // also flushes pending cycles
+    return (uint32_t)(hsiNs / 1000000ULL);
+}
+
+// Virtual time in which the HSI counts 'ns', rounded up
+static uint64_t Sim_TrueNs(uint64_t ns) {
+    uint64_t rate = (uint64_t)(1000000 + Sim_HsiPpm());
+
+    return (ns * 1000000ULL + rate - 1U) / rate;
+}
+
+void HAL_Delay(uint32_t Delay) {
+    uint32_t tickstart = HAL_GetTick();
+    uint32_t wait = Delay;
+
+    // Same +1 as the real HAL: guarantees at least 'Delay' full ticks
+    if(wait < HAL_MAX_DELAY) {
+        wait++;
+    }
+
+    // A delay is where a frame becomes visible to the user
+    if(frameCallback != NULL && Sim_LcdVersion() != lastFrameVersion) {
+        lastFrameVersion = Sim_LcdVersion();
+        frameCallback(timeNs);
+    }
+
+    // The real loop polls the tick, so it ends just after a tick
+    // boundary; callers stay in phase with SysTick
+    Sim_AdvanceNs(Sim_TrueNs(((uint64_t)tickstart + wait) * 1000000ULL - hsiNs));
+}
+
+/* ================== RCC ================== */
+
+// PLL lock and over-drive ready, datasheet maxima (tLOCK, tOD_swen)
+#define SIM_PLL_LOCK_NS      100000U
+#define SIM_OVERDRIVE_NS     50000U
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct) {
+    const RCC_PLLInitTypeDef *pll = &RCC_OscInitStruct->PLL;
+
+    // As the HAL: HSI on, with the trim given (the LSE is in RCC_BDCR)
+    if(RCC_OscInitStruct->OscillatorType & RCC_OSCILLATORTYPE_HSI) {
+        Sim_Flush();
+        SimRCC.CR = (SimRCC.CR & ~RCC_CR_HSITRIM) |
+                    ((RCC_OscInitStruct->HSICalibrationValue << RCC_CR_HSITRIM_Pos) & RCC_CR_HSITRIM);
+    }
+    if(pll->PLLState == RCC_PLL_NONE) {
+        return HAL_OK;
+    }
+    // As the HAL: the PLL that clocks the CPU cannot be touched
+    if(sysclkPll) {
+        return (pll->PLLState == RCC_PLL_ON && pll->PLLM == pllConfig.PLLM &&
+                pll->PLLN == pllConfig.PLLN && pll->PLLP == pllConfig.PLLP) ? HAL_OK : HAL_ERROR;
+    }
+    if(pll->PLLState == RCC_PLL_OFF) {
+        pllOn = 0;
+        return HAL_OK;
+    }
+    pllConfig = *pll;
+    pllOn = 1;
+    Sim_AdvanceNs(SIM_PLL_LOCK_NS);
+    return HAL_OK;
+}
+
+uint32_t HAL_RCC_GetSysClockFreq(void) {
+    return SystemCoreClock;
+}
+
+uint32_t HAL_RCC_GetHCLKFreq(void) {
+    return SystemCoreClock;
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void) {
+    return SystemCoreClock / apb1Divider;
+}
+
+uint32_t HAL_RCC_GetPCLK2Freq(void) {
+    return SystemCoreClock / apb2Divider;
+}
+
+// HCLK limit of the regulator setting (STM32F446 datasheet)
+static uint32_t Sim_MaxHclk(void) {
+    switch(SimPWR.CR & PWR_CR_VOS) {
+        case PWR_REGULATOR_VOLTAGE_SCALE3: return 120000000U;
+        case PWR_REGULATOR_VOLTAGE_SCALE2: return (SimPWR.CR & PWR_CR_ODSWEN) ? 168000000U : 144000000U;
+        default:                           return (SimPWR.CR & PWR_CR_ODSWEN) ? 180000000U : 168000000U;
+    }
+}
+
+// A clock tree the MCU would not survive: stop the run
+static void Sim_ClockFault(const char *what, uint32_t hz) {
+    fprintf(stderr, "sim: %s at %lu Hz\n", what, (unsigned long)hz);
+    abort();
+}
+
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency) {
+    uint32_t hz = 16000000U;
+
+    if(RCC_ClkInitStruct->SYSCLKSource == RCC_SYSCLKSOURCE_PLLCLK) {
+        if(!pllOn || pllConfig.PLLM == 0U || pllConfig.PLLP == 0U) {
+            return HAL_ERROR;
+        }
+        // HSI (16 MHz) / M * N / P
+        hz = (uint32_t)((16000000ULL / pllConfig.PLLM) * pllConfig.PLLN / pllConfig.PLLP);
+    }
+
+    // Cycles so far ran at the old clock
+    Sim_Flush();
+    switch(RCC_ClkInitStruct->APB1CLKDivider) {
+        case RCC_HCLK_DIV2: apb1Divider = 2; break;
+        case RCC_HCLK_DIV4: apb1Divider = 4; break;
+        default:            apb1Divider = 1; break;
+    }
+    switch(RCC_ClkInitStruct->APB2CLKDivider) {
+        case RCC_HCLK_DIV2: apb2Divider = 2; break;
+        case RCC_HCLK_DIV4: apb2Divider = 4; break;
+        default:            apb2Divider = 1; break;
+    }
+    SystemCoreClock = hz;
+    sysclkPll = (RCC_ClkInitStruct->SYSCLKSource == RCC_SYSCLKSOURCE_PLLCLK);
+
+    // 2.7 to 3.6 V: one wait state per 30 MHz; APB1 45 MHz, APB2 90 MHz
+    if(hz > Sim_MaxHclk()) {
+        Sim_ClockFault("HCLK above the voltage scale limit", hz);
+    }
+    if(FLatency < (hz - 1U) / 30000000U) {
+        Sim_ClockFault("too few flash wait states", hz);
+    }
+    if(hz / apb1Divider > 45000000U || hz / apb2Divider > 90000000U) {
+        Sim_ClockFault("APB clock above its limit", hz);
+    }
+    return HAL_OK;
+}
+
+void HAL_PWR_EnableBkUpAccess(void) {
+}
+
+void Sim_SetHsiError(int32_t ppm) {
+    Sim_Flush();
+    hsiFactoryPpm = ppm;
+}
+
+HAL_StatusTypeDef HAL_PWREx_EnableBkUpReg(void) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PWREx_EnableOverDrive(void) {
+    if((SimPWR.CR & PWR_CR_VOS) != PWR_REGULATOR_VOLTAGE_SCALE1) {
+        return HAL_ERROR;
+    }
+    SimPWR.CR |= PWR_CR_ODEN | PWR_CR_ODSWEN;
+    SimPWR.CSR |= PWR_CSR_ODRDY | PWR_CSR_ODSWRDY;
+    Sim_AdvanceNs(SIM_OVERDRIVE_NS);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PWREx_DisableOverDrive(void) {
+    if(SystemCoreClock > 168000000U) {
+        return HAL_ERROR;
+    }
+    SimPWR.CR &= ~(PWR_CR_ODEN | PWR_CR_ODSWEN);
+    SimPWR.CSR &= ~(PWR_CSR_ODRDY | PWR_CSR_ODSWRDY);
+    return HAL_OK;
+}
+
+// PVDO from the supply and the PVD set-up; an edge the EXTI line is
+// configured for sets its pending bit and pends PVD_IRQn
+static void Sim_PvdUpdate(void) {
+    uint32_t before = SimPWR.CSR & PWR_CSR_PVDO;
+    uint32_t level = pvdLevelMv[(SimPWR.CR & PWR_CR_PLS) >> PWR_CR_PLS_Pos];
+    uint32_t after = ((SimPWR.CR & PWR_CR_PVDE) && supplyMv < level) ? PWR_CSR_PVDO : 0U;
+    uint32_t edges;
+
+    if(after == before) {
+        return;
+    }
+    SimPWR.CSR = (SimPWR.CSR & ~PWR_CSR_PVDO) | after;
+    edges = after ? SimEXTI.RTSR : SimEXTI.FTSR;
+    if(edges & SimEXTI.IMR & PWR_EXTI_LINE_PVD) {
+        SimEXTI.PR |= PWR_EXTI_LINE_PVD;
+        Sim_NvicPend(PVD_IRQn);
+    }
+}
+
+void HAL_PWR_ConfigPVD(PWR_PVDTypeDef *sConfigPVD) {
+    SimPWR.CR = (SimPWR.CR & ~PWR_CR_PLS) | (sConfigPVD->PVDLevel & PWR_CR_PLS);
+    SimEXTI.IMR &= ~PWR_EXTI_LINE_PVD;
+    SimEXTI.RTSR &= ~PWR_EXTI_LINE_PVD;
+    SimEXTI.FTSR &= ~PWR_EXTI_LINE_PVD;
+    if(sConfigPVD->Mode & 0x00010000U) {
+        SimEXTI.IMR |= PWR_EXTI_LINE_PVD;
+    }
+    if(sConfigPVD->Mode & 0x1U) {
+        SimEXTI.RTSR |= PWR_EXTI_LINE_PVD;
+    }
+    if(sConfigPVD->Mode & 0x2U) {
+        SimEXTI.FTSR |= PWR_EXTI_LINE_PVD;
+    }
+    Sim_PvdUpdate();
+}
+
+void HAL_PWR_EnablePVD(void) {
+    SimPWR.CR |= PWR_CR_PVDE;
+    Sim_PvdUpdate();
+}
+
+uint32_t Sim_PwrReadCsr(void) {
+    Sim_AdvanceCycles(SIM_GETTICK_CYCLES);   // also flushes pending cycles
+    return SimPWR.CSR;
+}
+
+void Sim_SetSupply(uint16_t millivolts) {
+    supplyMv = millivolts;
+    Sim_PvdUpdate();
+}
+
+void Sim_ScheduleSupply(uint32_t atMs, uint16_t millivolts) {
+    SimScheduled_t *s = Sim_ScheduleAt(atMs);
+
+    if(s != NULL) {
+        s->port = SIM_SCHEDULED_SUPPLY;
+        s->millivolts = millivolts;
+    }
+}
+
+/* ================== GPIO ================== */
+
+static uint8_t Sim_PortIndex(const GPIO_TypeDef *port) {
+    return (uint8_t)(port - SimGPIO);
+}
+
+// IDR = output latch for outputs, external level / pull for inputs
+static void Sim_UpdateIdr(uint8_t p) {
+    uint16_t inputs = (uint16_t)((extLevel[p] & extDriven[p]) | (pullUpMask[p] & ~extDriven[p]));
+    SimGPIO[p].IDR = (SimGPIO[p].ODR & outputMask[p]) | (inputs & (uint16_t)~outputMask[p]);
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init) {
+    uint8_t p = Sim_PortIndex(GPIOx);
+    uint16_t pins = (uint16_t)GPIO_Init->Pin;
+
+    if(GPIO_Init->Mode == GPIO_MODE_OUTPUT_PP || GPIO_Init->Mode == GPIO_MODE_OUTPUT_OD) {
+        outputMask[p] |= pins;
+    } else {
+        outputMask[p] &= (uint16_t)~pins;
+    }
+    if(GPIO_Init->Pull == GPIO_PULLUP) {
+        pullUpMask[p] |= pins;
+    } else {
+        pullUpMask[p] &= (uint16_t)~pins;
+    }
+    Sim_UpdateIdr(p);
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+    return (GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+    uint8_t p = Sim_PortIndex(GPIOx);
+    SimPinWrite_t *rec = &pinLog[pinLogCount % SIM_PIN_LOG_SIZE];
+
+    if(PinState != GPIO_PIN_RESET) {
+        GPIOx->ODR |= GPIO_Pin;
+    } else {
+        GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+    }
+    Sim_UpdateIdr(p);
+
+    rec->timeNs = Sim_TimeNs();
+    rec->port = p;
+    rec->pins = GPIO_Pin;
+    rec->level = (uint8_t)PinState;
+    pinLogCount++;
+
+    Sim_LcdPinsChanged();
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+    HAL_GPIO_WritePin(GPIOx, GPIO_Pin, (GPIOx->ODR & GPIO_Pin) ? GPIO_PIN_RESET : GPIO_PIN_SET);
+}
+
+void Sim_SetInput(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState level) {
+    uint8_t p = Sim_PortIndex(port);
+
+    extDriven[p] |= pin;
+    if(level != GPIO_PIN_RESET) {
+        extLevel[p] |= pin;
+    } else {
+        extLevel[p] &= (uint16_t)~pin;
+    }
+    Sim_UpdateIdr(p);
+}
+
+void Sim_ScheduleInput(uint32_t atMs, GPIO_TypeDef *port, uint16_t pin, GPIO_PinState level) {
+    SimScheduled_t *s = Sim_ScheduleAt(atMs);
+
+    if(s != NULL) {
+        s->port = Sim_PortIndex(port);
+        s->pin = pin;
+        s->level = (uint8_t)level;
+    }
+}
+
+uint32_t Sim_PinWriteCount(void) {
+    return pinLogCount;
+}
+
+const SimPinWrite_t *Sim_PinWrite(uint32_t index) {
+    if(index >= pinLogCount || pinLogCount - index > SIM_PIN_LOG_SIZE) {
+        return NULL;   // Never written or already overwritten
+    }
+    return &pinLog[index % SIM_PIN_LOG_SIZE];
+}
+
+/* ================== RTC ================== */
+
+void Sim_SetCalendar(uint8_t year, uint8_t month, uint8_t day,
+                     uint8_t hours, uint8_t minutes, uint8_t seconds) {
+    rtcSeconds = Sim_DaysFromDate(year, month, day) * 86400U +
+                 (uint32_t)hours * 3600U + (uint32_t)minutes * 60U + seconds;
+    rtcSubNs = 0;
+    rtcAhead = 0;
+    Sim_RtcUpdateRegisters();
+}
+
+uint32_t Sim_CalendarSeconds(void) {
+    return rtcSeconds;
+}
+
+uint32_t Sim_RtcRejectedWrites(void) {
+    return rtcRejected;
+}
+
+HAL_StatusTypeDef HAL_RTC_Init(RTC_HandleTypeDef *hrtc) {
+    rtcSynchPrediv = hrtc->Init.SynchPrediv;
+    SimRTC.PRER = (hrtc->Init.AsynchPrediv << 16) | hrtc->Init.SynchPrediv;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_SetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format) {
+    uint8_t h = sTime->Hours, m = sTime->Minutes, s = sTime->Seconds;
+    (void)hrtc;
+
+    if(Format == RTC_FORMAT_BCD) {
+        h = Sim_FromBcd(h);
+        m = Sim_FromBcd(m);
+        s = Sim_FromBcd(s);
+    }
+    if(h > 23U || m > 59U || s > 59U) {
+        rtcRejected++;
+        return HAL_ERROR;
+    }
+
+    // Writing the time restarts the prescalers, like the real RTC
+    rtcSeconds = ((rtcSeconds + rtcAhead) / 86400U) * 86400U + (uint32_t)h * 3600U + (uint32_t)m * 60U + s;
+    rtcSubNs = 0;
+    rtcAhead = 0;
+    Sim_RtcUpdateRegisters();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_GetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format) {
+    uint32_t tod = (rtcSeconds + rtcAhead) % 86400U;
+    (void)hrtc;
+
+    Sim_RtcUpdateRegisters();
+
+    sTime->Hours = (uint8_t)(tod / 3600U);
+    sTime->Minutes = (uint8_t)((tod / 60U) % 60U);
+    sTime->Seconds = (uint8_t)(tod % 60U);
+    sTime->TimeFormat = 0;
+    sTime->SubSeconds = SimRTC.SSR;
+    sTime->SecondFraction = rtcSynchPrediv;
+
+    if(Format == RTC_FORMAT_BCD) {
+        sTime->Hours = Sim_ToBcd(sTime->Hours);
+        sTime->Minutes = Sim_ToBcd(sTime->Minutes);
+        sTime->Seconds = Sim_ToBcd(sTime->Seconds);
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_SetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format) {
+    uint8_t y = sDate->Year, mo = sDate->Month, d = sDate->Date;
+    (void)hrtc;
+
+    if(Format == RTC_FORMAT_BCD) {
+        y = Sim_FromBcd(y);
+        mo = Sim_FromBcd(mo);
+        d = Sim_FromBcd(d);
+    }
+    if(y > 99U || mo < 1U || mo > 12U || d < 1U || d > Sim_MonthDays(y, mo)) {
+        rtcRejected++;
+        return HAL_ERROR;
+    }
+
+    rtcSeconds = Sim_DaysFromDate(y, mo, d) * 86400U + (rtcSeconds + rtcAhead) % 86400U - rtcAhead;
+    Sim_RtcUpdateRegisters();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_GetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format) {
+    uint32_t days = (rtcSeconds + rtcAhead) / 86400U;
+    (void)hrtc;
+
+    Sim_DateFromDays(days, &sDate->Year, &sDate->Month, &sDate->Date);
+    sDate->WeekDay = (uint8_t)((days + 5U) % 7U + 1U);
+
+    if(Format == RTC_FORMAT_BCD) {
+        sDate->Year = Sim_ToBcd(sDate->Year);
+        sDate->Month = Sim_ToBcd(sDate->Month);
+        sDate->Date = Sim_ToBcd(sDate->Date);
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTCEx_SetSynchroShift(RTC_HandleTypeDef *hrtc, uint32_t ShiftAdd1S, uint32_t ShiftSubFS) {
+    uint64_t delayNs = (uint64_t)ShiftSubFS * 1000000000ULL / (rtcSynchPrediv + 1U);
+    (void)hrtc;
+
+    if(ShiftSubFS > 0x7FFFU) {
+        return HAL_ERROR;
+    }
+    // ADD1S advances by a second, SUBFS delays by SUBFS / (PREDIV_S + 1).
+    // The real RTC adds SUBFS to SSR without a borrow from the seconds:
+    // for each second the calendar goes back, TR / DR read one ahead
+    // and SSR one PREDIV_S + 1 above PREDIV_S until SSR has run down
+    if(ShiftAdd1S == RTC_SHIFTADD1S_SET) {
+        rtcSeconds++;
+    }
+    while(rtcSubNs < delayNs) {
+        rtcSeconds--;
+        rtcAhead++;
+        rtcSubNs += 1000000000ULL;
+    }
+    rtcSubNs -= delayNs;
+    Sim_RtcUpdateRegisters();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTCEx_SetSmoothCalib(RTC_HandleTypeDef *hrtc, uint32_t SmoothCalibPeriod,
+                                           uint32_t SmoothCalibPlusPulses,
+                                           uint32_t SmoothCalibMinusPulsesValue) {
+    (void)hrtc;
+
+    if(SmoothCalibMinusPulsesValue > 0x1FFU) {
+        return HAL_ERROR;
+    }
+    SimRTC.CALR = SmoothCalibPeriod | SmoothCalibPlusPulses | SmoothCalibMinusPulsesValue;
+    return HAL_OK;
+}
+
+void HAL_RTCEx_BKUPWrite(RTC_HandleTypeDef *hrtc, uint32_t BackupRegister, uint32_t Data) {
+    (void)hrtc;
+    (&SimRTC.BKP0R)[BackupRegister] = Data;
+}
+
+uint32_t HAL_RTCEx_BKUPRead(RTC_HandleTypeDef *hrtc, uint32_t BackupRegister) {
+    (void)hrtc;
+    return (&SimRTC.BKP0R)[BackupRegister];
+}
@@ -0,0 +1,214 @@
+/**
+ * @file    sim_lcd.c
+ * @brief   HD44780 model attached to the LCD pins defined in main.h
+ *
+ * The model watches every GPIO write and latches RS / D4..D7 on the
+ * falling edge of EN, exactly like the real controller. It starts in
+ * 8-bit mode (each EN pulse is a whole instruction with D0..D3 = 0)
+ * until a function-set selects 4-bit mode, after which nibbles are
+ * paired high-then-low.
+ */
+
+#include "sim.h"
+#include "main.h"
+#include <string.h>
+
+#define SIM_DDRAM_SIZE   0x68U
+#define SIM_CGRAM_SIZE   0x40U
+
+static uint8_t ddram[SIM_DDRAM_SIZE];
+static uint8_t cgram[SIM_CGRAM_SIZE];
+
+_Static_assert(sizeof(ddram) == sizeof(((SimLcdState_t *)0)->ddram), "SimLcdState_t.ddram");
+_Static_assert(sizeof(cgram) == sizeof(((SimLcdState_t *)0)->cgram), "SimLcdState_t.cgram");
+static uint8_t address;
+static uint8_t addressIsCgram;
+static uint8_t increment;
+static uint8_t fourBitMode;
+static uint8_t haveHighNibble;
+static uint8_t highNibble;
+static uint8_t lastEn;
+static uint32_t version;
+static uint32_t commandCount;
+static uint32_t dataCount;
+static uint32_t hiddenWrites;
+
+/* ================== PIN ACCESS ================== */
+
+static uint8_t Sim_LcdPin(GPIO_TypeDef *port, uint16_t pin) {
+    return (port->ODR & pin) ? 1U : 0U;
+}
+
+static uint8_t Sim_LcdNibble(void) {
+    return (uint8_t)(Sim_LcdPin(LCD_D4_GPIO_Port, LCD_D4_Pin) |
+                     (Sim_LcdPin(LCD_D5_GPIO_Port, LCD_D5_Pin) << 1) |
+                     (Sim_LcdPin(LCD_D6_GPIO_Port, LCD_D6_Pin) << 2) |
+                     (Sim_LcdPin(LCD_D7_GPIO_Port, LCD_D7_Pin) << 3));
+}
+
+static uint8_t Sim_LcdVisible(uint8_t addr) {
+    return (addr < SIM_LCD_COLS) || (addr >= 0x40U && addr < 0x40U + SIM_LCD_COLS);
+}
+
+/* ================== CONTROLLER ================== */
+
+static void Sim_LcdCommand(uint8_t cmd) {
+    commandCount++;
+
+    if(cmd & 0x80U) {                       // Set DDRAM address
+        address = cmd & 0x7FU;
+        addressIsCgram = 0;
+    } else if(cmd & 0x40U) {                // Set CGRAM address
+        address = cmd & 0x3FU;
+        addressIsCgram = 1;
+    } else if(cmd & 0x20U) {                // Function set
+        fourBitMode = (cmd & 0x10U) ? 0U : 1U;
+    } else if(cmd & 0x04U && !(cmd & 0x18U)) { // Entry mode set
+        increment = (cmd & 0x02U) ? 1U : 0U;
+    } else if(cmd == 0x01U) {               // Clear display
+        memset(ddram, ' ', sizeof(ddram));
+        address = 0;
+        addressIsCgram = 0;
+        increment = 1;
+        version++;
+    } else if((cmd & 0xFEU) == 0x02U) {     // Return home
+        address = 0;
+        addressIsCgram = 0;
+    }
+    // Display control and shift commands do not change the contents
+}
+
+static void Sim_LcdData(uint8_t data) {
+    dataCount++;
+
+    if(addressIsCgram) {
+        cgram[address & 0x3FU] = data;
+        address = (uint8_t)((address + 1U) & 0x3FU);
+        return;
+    }
+
+    if(!Sim_LcdVisible(address)) {
+        hiddenWrites++;
+    }
+    if(address < SIM_DDRAM_SIZE && ddram[address] != data) {
+        ddram[address] = data;
+        if(Sim_LcdVisible(address)) {
+            version++;
+        }
+    }
+
+    // Line 1 runs 0x00..0x27, line 2 0x40..0x67
+    if(increment) {
+        address++;
+        if(address == 0x28U) {
+            address = 0x40U;
+        } else if(address >= 0x68U) {
+            address = 0x00U;
+        }
+    } else {
+        address = (address == 0x00U) ? 0x67U : (uint8_t)(address - 1U);
+    }
+}
+
+/* ================== SIMULATION HOOKS ================== */
+
+void Sim_LcdReset(void) {
+    memset(ddram, ' ', sizeof(ddram));
+    memset(cgram, 0, sizeof(cgram));
+    address = 0;
+    addressIsCgram = 0;
+    increment = 1;
+    fourBitMode = 0;
+    haveHighNibble = 0;
+    lastEn = 0;
+    version = 0;
+    commandCount = 0;
+    dataCount = 0;
+    hiddenWrites = 0;
+}
+
+void Sim_LcdSaveState(SimLcdState_t *state) {
+    memcpy(state->ddram, ddram, sizeof(state->ddram));
+    memcpy(state->cgram, cgram, sizeof(state->cgram));
+    state->address = address;
+    state->addressIsCgram = addressIsCgram;
+    state->increment = increment;
+    state->fourBitMode = fourBitMode;
+    state->haveHighNibble = haveHighNibble;
+    state->highNibble = highNibble;
+}
+
+void Sim_LcdLoadState(const SimLcdState_t *state) {
+    memcpy(ddram, state->ddram, sizeof(ddram));
+    memcpy(cgram, state->cgram, sizeof(cgram));
+    address = state->address;
+    addressIsCgram = state->addressIsCgram;
+    increment = state->increment;
+    fourBitMode = state->fourBitMode;
+    haveHighNibble = state->haveHighNibble;
+    highNibble = state->highNibble;
+}
+
+void Sim_LcdPinsChanged(void) {
+    uint8_t en = Sim_LcdPin(LCD_EN_GPIO_Port, LCD_EN_Pin);
+    uint8_t rs;
+    uint8_t nibble;
+
+    if(!(lastEn && !en)) {
+        lastEn = en;
+        return;                 // Only the falling edge latches
+    }
+    lastEn = en;
+
+    rs = Sim_LcdPin(LCD_RS_GPIO_Port, LCD_RS_Pin);
+    nibble = Sim_LcdNibble();
+
+    if(!fourBitMode) {
+        // 8-bit interface: D0..D3 are not connected (read as 0)
+        uint8_t value = (uint8_t)(nibble << 4);
+        if(rs) {
+            Sim_LcdData(value);
+        } else {
+            Sim_LcdCommand(value);
+        }
+        return;
+    }
+
+    if(!haveHighNibble) {
+        highNibble = nibble;
+        haveHighNibble = 1;
+        return;
+    }
+
+    haveHighNibble = 0;
+    if(rs) {
+        Sim_LcdData((uint8_t)((highNibble << 4) | nibble));
+    } else {
+        Sim_LcdCommand((uint8_t)((highNibble << 4) | nibble));
+    }
+}
+
+/* ================== INSPECTION ================== */
+
+void Sim_LcdRow(uint8_t row, char out[SIM_LCD_COLS + 1]) {
+    uint8_t base = (row == 0U) ? 0x00U : 0x40U;
+
+    memcpy(out, &ddram[base], SIM_LCD_COLS);
+    out[SIM_LCD_COLS] = '\0';
+}
+
+uint32_t Sim_LcdVersion(void) {
+    return version;
+}
+
+uint32_t Sim_LcdCommandCount(void) {
+    return commandCount;
+}
+
+uint32_t Sim_LcdDataCount(void) {
+    return dataCount;
+}
+
+uint32_t Sim_LcdHiddenWrites(void) {
+    return hiddenWrites;
+}
@@ -0,0 +1,40 @@
+#ifndef SIM_TEST_H
+#define SIM_TEST_H
+
+#include "sim.h"
+#include "main.h"
+#include <stdio.h>
+
+/**
+ * @file    sim_test.h
+ * @brief   Checks and button presses for the tests that run the whole
+ *          firmware on the simulated board (power_fail_test.c,
+ *          hsi_trim_test.c)
+ *
+ * One test per executable: each includes this once and reports
+ * 'failures' at the end.
+ */
+
+#define SIM_PRESS_MS   150U     // Held down, well past the debounce
+#define SIM_START_MS   7000U    // STOPWATCH started, after the splash (5.6 s)
+
+static unsigned failures;
+
+// Counts and reports a failed condition, then goes on
+#define CHECK(cond, ...)                              \
+    do {                                              \
+        if(!(cond)) {                                 \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__);                      \
+            printf("\n");                             \
+            failures++;                               \
+        }                                             \
+    } while(0)
+
+// A press of SIM_PRESS_MS at 'atMs'; buttons are active-low
+static inline void Sim_Press(uint32_t atMs, GPIO_TypeDef *port, uint16_t pin) {
+    Sim_ScheduleInput(atMs, port, pin, GPIO_PIN_RESET);
+    Sim_ScheduleInput(atMs + SIM_PRESS_MS, port, pin, GPIO_PIN_SET);
+}
+
+#endif
@@ -0,0 +1,113 @@
+/**
+ * @file    sim_tim.c
+ * @brief   TIM5 with channel 4 capturing the LSE
+ *
+ * What a calibration of the HSI against the LSE needs of TIM5:
+ *  - CNT counts at the APB1 timer clock: HCLK cycles, halved when
+ *    APB1 is divided by 4 or more (the timers get twice PCLK1), so it
+ *    runs at the HSI's pace like everything clocked from it. PSC and
+ *    ARR are taken to be 0 and 0xFFFFFFFF; there is no update event.
+ *  - With TIM5_OR remapping TI4 to the LSE, CC4 an input on TI4
+ *    (CC4S = 01), CC4E set and LSERDY, every 1 / 2 / 4 / 8 rising
+ *    edges of the LSE (IC4PSC) latch CNT into CCR4 and set CC4IF, and
+ *    CC4OF if CC4IF was still set. The LSE runs at exactly 32768 Hz of
+ *    virtual time.
+ *  - CC4IE pends TIM5_IRQn. The handler runs at the capture, also
+ *    within a long step, while PRIMASK is clear.
+ * SR keeps only CC4IF and CC4OF: the firmware clears flags by writing
+ * zeros (rc_w0), which sets the other bits in plain memory.
+ */
+
+#include "sim.h"
+#include <string.h>
+
+#define SIM_LSE_HZ   32768U
+
+TIM_TypeDef SimTIM5;
+
+static uint64_t lastNs;           // Virtual time of the last step
+static uint64_t lastCycles;
+static uint64_t cycleCarry;       // HCLK cycles not yet counted (APB1 / 4)
+static uint64_t nextEdge;         // Index of the next LSE rising edge
+static uint32_t edgesSeen;        // Edges into the IC4 prescaler
+static int inStep;
+
+// Virtual time of LSE edge 'edge'
+static uint64_t Sim_EdgeNs(uint64_t edge) {
+    return (edge / SIM_LSE_HZ) * 1000000000ULL + (edge % SIM_LSE_HZ) * 1000000000ULL / SIM_LSE_HZ;
+}
+
+// First LSE edge after 'ns'
+static uint64_t Sim_EdgeAfter(uint64_t ns) {
+    return (ns / 1000000000ULL) * SIM_LSE_HZ + (ns % 1000000000ULL) * SIM_LSE_HZ / 1000000000ULL + 1U;
+}
+
+static int Sim_Capturing(void) {
+    return (SimTIM5.OR & TIM_OR_TI4_RMP) == TIM_OR_TI4_RMP_1 &&
+           (SimTIM5.CCMR2 & TIM_CCMR2_CC4S) == TIM_CCMR2_CC4S_0 &&
+           (SimTIM5.CCER & TIM_CCER_CC4E) && (SimRCC.BDCR & RCC_BDCR_LSERDY);
+}
+
+void Sim_TimReset(void) {
+    memset(&SimTIM5, 0, sizeof(SimTIM5));
+    lastNs = Sim_TimeNs();
+    lastCycles = Sim_Cycles();
+    cycleCarry = 0;
+    nextEdge = Sim_EdgeAfter(lastNs);
+    edgesSeen = 0;
+}
+
+void Sim_TimStep(uint64_t timeNs, uint64_t cycles) {
+    uint32_t divider;
+    uint64_t counts;
+
+    // A handler may call the HAL, which advances time again
+    if(inStep) {
+        return;
+    }
+    inStep = 1;
+    SimTIM5.SR &= TIM_SR_CC4IF | TIM_SR_CC4OF;
+
+    if(!(SimTIM5.CR1 & TIM_CR1_CEN)) {
+        counts = 0;
+        cycleCarry = 0;
+    } else {
+        divider = HAL_RCC_GetHCLKFreq() / HAL_RCC_GetPCLK1Freq();
+        cycleCarry += (cycles - lastCycles) * (divider == 1U ? 1U : 2U);
+        counts = cycleCarry / divider;
+        cycleCarry %= divider;
+    }
+
+    if(!Sim_Capturing()) {
+        // The prescaler starts over when the channel comes back
+        nextEdge = Sim_EdgeAfter(timeNs);
+        edgesSeen = 0;
+    } else {
+        uint32_t prescaler = 1U << ((SimTIM5.CCMR2 & TIM_CCMR2_IC4PSC) >> TIM_CCMR2_IC4PSC_Pos);
+
+        for(uint64_t at = Sim_EdgeNs(nextEdge); at <= timeNs; at = Sim_EdgeNs(++nextEdge)) {
+            if(++edgesSeen < prescaler) {
+                continue;
+            }
+            edgesSeen = 0;
+
+            // CNT at the edge, the count being even over the step
+            SimTIM5.CCR4 = SimTIM5.CNT +
+                           (uint32_t)(timeNs > lastNs ? counts * (at - lastNs) / (timeNs - lastNs) : 0U);
+            if(SimTIM5.SR & TIM_SR_CC4IF) {
+                SimTIM5.SR |= TIM_SR_CC4OF;
+            }
+            SimTIM5.SR |= TIM_SR_CC4IF;
+            if(SimTIM5.DIER & TIM_DIER_CC4IE) {
+                Sim_NvicPend(TIM5_IRQn);
+                Sim_NvicDeliver();
+                SimTIM5.SR &= TIM_SR_CC4IF | TIM_SR_CC4OF;
+            }
+        }
+    }
+
+    SimTIM5.CNT += (uint32_t)counts;
+    lastNs = timeNs;
+    lastCycles = cycles;
+    inStep = 0;
+}
@@ -0,0 +1,341 @@
+/**
+ * @file    sim_uart.c
+ * @brief   USART1 / USART2 with their DMA streams, and the NVIC
+ *
+ * Enough of the peripherals for a DMA-driven console (USART2, DMA1
+ * streams 5 RX and 6 TX) and a DMA-driven transmit-only line (USART1,
+ * DMA2 stream 7):
+ *  - TX: while the stream is enabled, one byte per character time
+ *    (10 bits at the BRR baud rate) goes from M0AR to the attached
+ *    descriptor. After the last one EN clears and TCIF is set.
+ *  - RX: bytes read from the descriptor are stored by the stream at
+ *    M0AR + (NDTR at enable - NDTR); NDTR reloads in circular mode.
+ *    HTIF / TCIF are set at the half and the end of the buffer.
+ *    IDLE is set once a full character time of idle line follows
+ *    the last byte.
+ *  - Flags: IDLE is cleared once the USART handler has run (the
+ *    SR-then-DR read on the MCU), HIFCR / LIFCR writes clear flags
+ *    after each handler and at the next step. All streams used sit
+ *    in the HISR half.
+ *
+ * The NVIC also takes PVD_IRQn, pended by the supply model in
+ * sim_hal.c, and TIM5_IRQn (sim_tim.c).
+ *
+ * Handlers run from Sim_Advance() when their line is enabled in the
+ * NVIC and PRIMASK is clear, i.e. between two HAL calls of the
+ * firmware, as an interrupt would between two instructions. A long
+ * HAL_Delay() is one step, but RX handlers still run after every
+ * byte so the DMA never gets further ahead of them than on the MCU.
+ */
+
+#include "sim.h"
+#include <string.h>
+#include <unistd.h>
+
+USART_TypeDef      SimUSART1;
+USART_TypeDef      SimUSART2;
+DMA_TypeDef        SimDMA1;
+DMA_TypeDef        SimDMA2;
+DMA_Stream_TypeDef SimDMA1Stream[8];
+DMA_Stream_TypeDef SimDMA2Stream[8];
+
+// Defaults for builds without a console, telemetry, PVD or HSI
+// calibration; the firmware's handlers win
+__attribute__((weak)) void PVD_IRQHandler(void) {
+}
+
+__attribute__((weak)) void USART1_IRQHandler(void) {
+}
+
+__attribute__((weak)) void USART2_IRQHandler(void) {
+}
+
+__attribute__((weak)) void DMA1_Stream5_IRQHandler(void) {
+}
+
+__attribute__((weak)) void DMA1_Stream6_IRQHandler(void) {
+}
+
+__attribute__((weak)) void DMA2_Stream7_IRQHandler(void) {
+}
+
+__attribute__((weak)) void TIM5_IRQHandler(void) {
+}
+
+typedef struct {
+    USART_TypeDef      *usart;
+    uint32_t          (*pclk)(void);
+    DMA_TypeDef        *dma;
+    DMA_Stream_TypeDef *tx;
+    DMA_Stream_TypeDef *rx;         // NULL: transmit only
+    IRQn_Type           usartIrq;
+    IRQn_Type           txIrq;
+    IRQn_Type           rxIrq;
+    uint32_t            txTcif;     // HISR flags
+    uint32_t            rxHtif;
+    uint32_t            rxTcif;
+
+    int      fd;
+    uint32_t txLength;              // NDTR when the TX stream was enabled, 0 = idle
+    uint64_t txNextNs;
+    uint32_t rxLength;              // NDTR when the RX stream was enabled, 0 = idle
+    uint64_t rxNextNs;
+    uint64_t rxLastNs;
+    uint8_t  rxSinceIdle;           // Bytes received since the last IDLE
+} SimLine_t;
+
+static SimLine_t simLines[] = {
+    { &SimUSART2, HAL_RCC_GetPCLK1Freq, &SimDMA1, &SimDMA1Stream[6], &SimDMA1Stream[5],
+      USART2_IRQn, DMA1_Stream6_IRQn, DMA1_Stream5_IRQn,
+      DMA_HISR_TCIF6, DMA_HISR_HTIF5, DMA_HISR_TCIF5, -1, 0, 0, 0, 0, 0, 0 },
+    { &SimUSART1, HAL_RCC_GetPCLK2Freq, &SimDMA2, &SimDMA2Stream[7], NULL,
+      USART1_IRQn, DMA2_Stream7_IRQn, DMA2_Stream7_IRQn,
+      DMA_HISR_TCIF7, 0, 0, -1, 0, 0, 0, 0, 0, 0 },
+};
+
+#define SIM_LINE_COUNT  (sizeof(simLines) / sizeof(simLines[0]))
+
+static uint32_t nvicEnabled[3];     // Bit per IRQn
+static uint32_t nvicPending[3];
+static int inStep;
+
+/* ================== NVIC ================== */
+
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority) {
+    (void)IRQn;
+    (void)priority;
+}
+
+void NVIC_EnableIRQ(IRQn_Type IRQn) {
+    nvicEnabled[IRQn / 32] |= 1UL << (IRQn % 32);
+}
+
+void NVIC_DisableIRQ(IRQn_Type IRQn) {
+    nvicEnabled[IRQn / 32] &= ~(1UL << (IRQn % 32));
+}
+
+void Sim_NvicPend(IRQn_Type IRQn) {
+    nvicPending[IRQn / 32] |= 1UL << (IRQn % 32);
+}
+
+// 1 (and no longer pending) if IRQn is pending and enabled
+static int Sim_Take(IRQn_Type IRQn) {
+    uint32_t bit = 1UL << (IRQn % 32);
+
+    if(!(nvicPending[IRQn / 32] & nvicEnabled[IRQn / 32] & bit)) {
+        return 0;
+    }
+    nvicPending[IRQn / 32] &= ~bit;
+    return 1;
+}
+
+// HIFCR / LIFCR writes since the last call clear their flags
+static void Sim_ClearFlags(void) {
+    SimDMA1.LISR &= ~SimDMA1.LIFCR;
+    SimDMA1.HISR &= ~SimDMA1.HIFCR;
+    SimDMA1.LIFCR = SimDMA1.HIFCR = 0;
+    SimDMA2.LISR &= ~SimDMA2.LIFCR;
+    SimDMA2.HISR &= ~SimDMA2.HIFCR;
+    SimDMA2.LIFCR = SimDMA2.HIFCR = 0;
+}
+
+void Sim_NvicDeliver(void) {
+    if(__get_PRIMASK() != 0U) {
+        return;
+    }
+    // Priority 0 (power.h), the others 5
+    if(Sim_Take(PVD_IRQn)) {
+        PVD_IRQHandler();
+    }
+    if(Sim_Take(DMA1_Stream5_IRQn)) {
+        DMA1_Stream5_IRQHandler();
+    }
+    if(Sim_Take(DMA1_Stream6_IRQn)) {
+        DMA1_Stream6_IRQHandler();
+    }
+    if(Sim_Take(DMA2_Stream7_IRQn)) {
+        DMA2_Stream7_IRQHandler();
+    }
+    if(Sim_Take(TIM5_IRQn)) {
+        TIM5_IRQHandler();
+    }
+    if(Sim_Take(USART1_IRQn)) {
+        USART1_IRQHandler();
+        SimUSART1.SR &= ~USART_SR_IDLE;
+    }
+    if(Sim_Take(USART2_IRQn)) {
+        USART2_IRQHandler();
+        SimUSART2.SR &= ~USART_SR_IDLE;
+    }
+    Sim_ClearFlags();
+}
+
+/* ================== LINES ================== */
+
+void Sim_UartAttach(USART_TypeDef *usart, int fd) {
+    for(uint32_t i = 0; i < SIM_LINE_COUNT; i++) {
+        if(simLines[i].usart == usart) {
+            simLines[i].fd = fd;
+        }
+    }
+}
+
+void Sim_UartReset(void) {
+    memset(&SimUSART1, 0, sizeof(SimUSART1));
+    memset(&SimUSART2, 0, sizeof(SimUSART2));
+    memset(&SimDMA1, 0, sizeof(SimDMA1));
+    memset(&SimDMA2, 0, sizeof(SimDMA2));
+    memset(SimDMA1Stream, 0, sizeof(SimDMA1Stream));
+    memset(SimDMA2Stream, 0, sizeof(SimDMA2Stream));
+    SimUSART1.SR = USART_SR_TXE | USART_SR_TC;
+    SimUSART2.SR = USART_SR_TXE | USART_SR_TC;
+    memset(nvicEnabled, 0, sizeof(nvicEnabled));
+    memset(nvicPending, 0, sizeof(nvicPending));
+    inStep = 0;
+
+    // The descriptors stay attached
+    for(uint32_t i = 0; i < SIM_LINE_COUNT; i++) {
+        SimLine_t *line = &simLines[i];
+        line->txLength = line->rxLength = 0;
+        line->txNextNs = line->rxNextNs = line->rxLastNs = 0;
+        line->rxSinceIdle = 0;
+    }
+}
+
+static int Sim_TxEnabled(const SimLine_t *line) {
+    return (line->tx->CR & DMA_SxCR_EN) && (line->usart->CR3 & USART_CR3_DMAT) &&
+           (line->usart->CR1 & USART_CR1_TE);
+}
+
+static void Sim_UartTx(SimLine_t *line, uint64_t now, uint64_t charNs) {
+    DMA_Stream_TypeDef *tx = line->tx;
+
+    if(!(tx->CR & DMA_SxCR_EN)) {
+        line->txLength = 0;
+        return;
+    }
+    if(!Sim_TxEnabled(line)) {
+        // DMAT or TE off: the stream keeps its place, and the line
+        // goes on from here once requests come again
+        if(line->txLength != 0U && line->txNextNs < now) {
+            line->txNextNs = now;
+        }
+        return;
+    }
+    if(line->txLength == 0U) {
+        line->txLength = tx->NDTR;
+        line->txNextNs = now;
+    }
+    for(;;) {
+        while(tx->NDTR > 0U && now >= line->txNextNs) {
+            uint8_t byte = *(const uint8_t *)(tx->M0AR + (line->txLength - tx->NDTR));
+
+            if(line->fd >= 0 && write(line->fd, &byte, 1) != 1) {
+                // Nobody reading and the buffer is full: the byte is lost on the wire
+            }
+            tx->NDTR--;
+            line->txNextNs += charNs;
+        }
+        if(tx->NDTR != 0U) {
+            return;
+        }
+        tx->CR &= ~DMA_SxCR_EN;
+        line->txLength = 0;
+        line->dma->HISR |= line->txTcif;
+        if(tx->CR & DMA_SxCR_TCIE) {
+            Sim_NvicPend(line->txIrq);
+        }
+
+        // A handler that starts the next transfer keeps the line busy
+        // from the end of this one, even within a long step
+        Sim_NvicDeliver();
+        if(!Sim_TxEnabled(line)) {
+            return;
+        }
+        line->txLength = tx->NDTR;
+    }
+}
+
+static void Sim_UartRx(SimLine_t *line, uint64_t now, uint64_t charNs) {
+    DMA_Stream_TypeDef *rx = line->rx;
+    uint8_t byte;
+
+    if(rx == NULL || !(rx->CR & DMA_SxCR_EN) || !(line->usart->CR3 & USART_CR3_DMAR) ||
+       !(line->usart->CR1 & USART_CR1_RE)) {
+        line->rxLength = 0;
+        return;
+    }
+    if(line->rxLength == 0U) {
+        line->rxLength = rx->NDTR;
+        line->rxNextNs = now;
+    }
+
+    // The descriptor is polled once per character time at most
+    while(now >= line->rxNextNs) {
+        if(line->fd < 0 || read(line->fd, &byte, 1) != 1) {
+            line->rxNextNs = now + charNs;
+            break;
+        }
+        *(uint8_t *)(rx->M0AR + (line->rxLength - rx->NDTR)) = byte;
+        if(--rx->NDTR == line->rxLength / 2U) {
+            line->dma->HISR |= line->rxHtif;
+            if(rx->CR & DMA_SxCR_HTIE) {
+                Sim_NvicPend(line->rxIrq);
+            }
+        }
+        if(rx->NDTR == 0U) {
+            line->dma->HISR |= line->rxTcif;
+            if(rx->CR & DMA_SxCR_TCIE) {
+                Sim_NvicPend(line->rxIrq);
+            }
+            if(rx->CR & DMA_SxCR_CIRC) {
+                rx->NDTR = line->rxLength;
+            } else {
+                rx->CR &= ~DMA_SxCR_EN;
+                line->rxLength = 0;
+                break;
+            }
+        }
+        line->rxLastNs = line->rxNextNs;
+        line->rxNextNs += charNs;
+        line->rxSinceIdle = 1;
+        // Taken between bytes, as the handlers would on the MCU
+        Sim_NvicDeliver();
+    }
+
+    if(line->rxSinceIdle && now - line->rxLastNs >= 2U * charNs) {
+        line->rxSinceIdle = 0;
+        line->usart->SR |= USART_SR_IDLE;
+        if(line->usart->CR1 & USART_CR1_IDLEIE) {
+            Sim_NvicPend(line->usartIrq);
+        }
+    }
+}
+
+void Sim_UartStep(uint64_t now) {
+    // Handlers call the HAL, which advances time again
+    if(inStep) {
+        return;
+    }
+    inStep = 1;
+    Sim_ClearFlags();
+
+    for(uint32_t i = 0; i < SIM_LINE_COUNT; i++) {
+        SimLine_t *line = &simLines[i];
+        uint32_t baud;
+        uint64_t charNs;
+
+        if(!(line->usart->CR1 & USART_CR1_UE) || line->usart->BRR == 0U) {
+            continue;
+        }
+        // Oversampling by 16: BRR = f_PCLK / baud
+        baud = line->pclk() / line->usart->BRR;
+        charNs = 10ULL * 1000000000ULL / (baud ? baud : 1U);
+
+        Sim_UartTx(line, now, charNs);
+        Sim_UartRx(line, now, charNs);
+    }
+    Sim_NvicDeliver();
+
+    inStep = 0;
+}
@@ -0,0 +1,282 @@
+#!/usr/bin/env python3
+"""USART2 console (console.h) against a pseudo-terminal.
+
+Starts the host build with -u, which runs in real time and connects
+USART2 to a new pty, and talks to the console as a terminal would:
+
+    console_pty_test.py build-host/rtc_multiclock_host
+"""
+
+import os
+import re
+import select
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+REPLY_TIMEOUT_S = 3.0
+REBOOT_S = 0.3
+
+CRASH_DECODE = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                            "..", "..", "Tools", "crash_decode.py")
+
+
+class Console:
+    def __init__(self, path):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        self.pending = b""
+
+    def send(self, text):
+        os.write(self.fd, text.encode())
+
+    def reply(self):
+        """Lines up to and including the next OK / ERR line."""
+        deadline = time.monotonic() + REPLY_TIMEOUT_S
+        lines = []
+        while True:
+            while b"\r\n" in self.pending:
+                line, self.pending = self.pending.split(b"\r\n", 1)
+                lines.append(line.decode())
+                if line == b"OK" or line.startswith(b"ERR"):
+                    return lines
+            left = deadline - time.monotonic()
+            if left <= 0:
+                raise AssertionError("no reply, got %r" % lines)
+            ready, _, _ = select.select([self.fd], [], [], left)
+            if ready:
+                self.pending += os.read(self.fd, 1024)
+
+    def command(self, text):
+        self.send(text + "\r")
+        return self.reply()
+
+
+def expect(condition, what, got):
+    if not condition:
+        raise AssertionError("%s: got %r" % (what, got))
+
+
+def session(con):
+    # Answered once the splash has been cut short and the main loop runs
+    r = con.command("help")
+    expect(r[-1] == "OK" and "time [hh:mm:ss[.mmm]]" in r, "help", r)
+
+    r = con.command("time 12:34:56.250")
+    expect(r == ["OK"], "set time", r)
+    r = con.command("time")
+    m = re.fullmatch(r"TIME 12:34:(\d\d)\.(\d\d\d)", r[0])
+    expect(m and r[-1] == "OK", "read time", r)
+    ms = int(m.group(1)) * 1000 + int(m.group(2))
+    expect(56250 <= ms < 57500, "time since set", r)
+
+    # Read in the same burst: the shift leaves SSR above PREDIV_S and TR
+    # a second ahead until the next second
+    con.send("time 12:34:56.250\rtime\r")
+    expect(con.reply() == ["OK"], "set time with ms", None)
+    r = con.reply()
+    m = re.fullmatch(r"TIME 12:34:56\.(\d\d\d)", r[0])
+    expect(m and 250 <= int(m.group(1)) < 500 and r[-1] == "OK", "time right after set", r)
+
+    expect(con.command("date 2024-02-29") == ["OK"], "set date", None)
+    r = con.command("date")
+    expect(r == ["DATE 2024-02-29 THU", "OK"], "read date", r)
+    r = con.command("date 2023-02-29")
+    expect(r == ["ERR range"], "invalid date", r)
+    r = con.command("time 24:00:00")
+    expect(r == ["ERR range"], "invalid time", r)
+    r = con.command("frobnicate")
+    expect(r == ["ERR unknown"], "unknown command", r)
+
+    r = con.command("sw start")
+    expect(re.fullmatch(r"SW RUNNING 00:00:00\.\d{3} LAPS 0", r[0]), "sw start", r)
+    r = con.command("sw reset")
+    expect(r == ["ERR running"], "reset while running", r)
+    for n in (1, 2):
+        r = con.command("sw lap")
+        expect(r[0].endswith("LAPS %d" % n), "sw lap", r)
+    r = con.command("laps")
+    expect(len(r) == 3 and r[0].startswith("LAP 1 ") and r[1].startswith("LAP 2 "), "laps", r)
+    expect(con.command("sw stop")[0].startswith("SW STOPPED"), "sw stop", None)
+    r = con.command("sw reset")
+    expect(r == ["SW STOPPED 00:00:00.000 LAPS 0", "OK"], "sw reset", r)
+
+    # Event log: this boot, the corrections and the session above
+    r = con.command("log")
+    expect(r[-1] == "OK" and r[-2] == "LOG %d EVENTS" % (len(r) - 2), "log", r)
+    expect(any(re.fullmatch(r"EV \S+ \S+ RESET( [A-Z]+)+", l) for l in r), "log reset", r)
+    expect(any(re.fullmatch(r"EV \S+ \S+ TIME_SET 2024-02-29 12:34:5\d", l) for l in r),
+           "log time set", r)
+    r = con.command("log 2024-02-29 2024-03-01T00:00")
+    expect(len(r) == 4 and r[2:] == ["LOG 2 EVENTS", "OK"], "log range", r)
+    expect(re.fullmatch(r"EV 2024-02-29 12:34:5\d SW_START 00:00:00\.000", r[0]) and
+           re.fullmatch(r"EV 2024-02-29 12:34:5\d SW_STOP 00:00:0\d\.\d{3} LAPS 2", r[1]),
+           "log range events", r)
+    r = con.command("log 2024-03-01")
+    expect(r == ["LOG 0 EVENTS", "OK"], "log empty range", r)
+    r = con.command("log 2024-02-30")
+    expect(r == ["ERR usage"], "log invalid date", r)
+
+    # Several commands in one burst, framed by a single idle line
+    con.send("sw\rsw\nsw\r\n")
+    for _ in range(3):
+        r = con.reply()
+        expect(r[0].startswith("SW STOPPED"), "burst", r)
+
+    # Longer than the line and than half the DMA ring
+    r = con.command("x" * 200)
+    expect(r == ["ERR too long"], "long line", r)
+
+    r = con.command("stats")
+    m = [l for l in r if l.startswith("CONSOLE ")]
+    expect(m and " OVR 0 " in m[0] and " DROP 0 " in m[0] and r[-1] == "OK", "stats", r)
+
+    # Clock profiles (sysclk.h): the console keeps its baud rate. The
+    # governor (governor.h) takes the loop down to LOW once the console
+    # has been quiet for a few windows.
+    for _ in range(5):
+        time.sleep(1.5)
+        r = con.command("clock")
+        if r[0] == "CLOCK LOW 16 MHZ":
+            break
+    expect(r[0] == "CLOCK LOW 16 MHZ" and r[1].startswith("GOV AUTO ") and len(r) == 9 and
+           r[-1] == "OK", "clock", r)
+    for word, name, mhz in (("over", "OVERDRIVE", 180), ("nominal", "NOMINAL", 84),
+                            ("low", "LOW", 16)):
+        r = con.command("clock " + word)
+        expect(r[0] == "CLOCK %s %d MHZ" % (name, mhz) and r[1].startswith("GOV PINNED "),
+               "clock " + word, r)
+        expect(any(re.fullmatch(r"PROFILE %s %d MHZ \d+\.\d MA SW [1-9]\d* FAIL 0 LAST \d+ MAX \d+ US" %
+                                (name, mhz), l) for l in r), "clock %s switch" % word, r)
+        expect(con.command("date") == ["DATE 2024-02-29 THU", "OK"], "date at %d MHz" % mhz, None)
+    expect(con.command("clock turbo") == ["ERR usage"], "clock usage", None)
+    r = con.command("clock auto")
+    expect(r[1].startswith("GOV AUTO "), "clock auto", r)
+    res = [re.fullmatch(r"RESIDENCY \w+ (\d+) MS", l) for l in r]
+    expect(sum(int(m.group(1)) for m in res if m) > 0, "residency", r)
+
+    # HSI trim (hsitrim.h): the host runs a part 7300 ppm fast, two
+    # steps of HSITRIM take it to -2100 ppm and the rest is corrected.
+    # The switches above void a measurement; the next one comes at once.
+    for _ in range(5):
+        r = con.command("hsi")
+        if re.fullmatch(r"STOPWATCH BEFORE \d+ AFTER -?\d PPM", r[2]):
+            break
+        time.sleep(0.5)
+    expect(r[0] == "HSI SETTLED TRIM 14 FACTORY 16" and
+           re.fullmatch(r"HSI -2\d{3} PPM CORRECTION -2\d{3} PPM", r[1]) and
+           re.fullmatch(r"STOPWATCH BEFORE 7\d{3} AFTER -?\d PPM", r[2]) and
+           re.fullmatch(r"MEASURED [1-9]\d* DISCARDED \d+", r[3]) and r[-1] == "OK", "hsi", r)
+
+    # Error_Handler() stores a dump in backup SRAM and resets; the next
+    # boot logs it and 'crash' shows it
+    expect(con.command("crash") == ["CRASH NONE", "OK"], "no crash", None)
+    con.send("crash test\r")
+    time.sleep(REBOOT_S)
+    r = con.command("crash")
+    expect(re.fullmatch(r"CRASH,ERROR,1,2024-02-29T12:3\d:\d\d", r[0]) and
+           r[1].startswith("CRASH_R,") and r[-2:] == ["CRASH_END", "OK"], "crash dump", r)
+    decoded = subprocess.run([sys.executable, CRASH_DECODE, "-"], input="\n".join(r),
+                             capture_output=True, text=True)
+    expect(decoded.returncode == 0 and decoded.stdout.startswith("ERROR, dump 1, at 2024-02-29T"),
+           "crash_decode", decoded.stdout + decoded.stderr)
+    r = con.command("log 2024-02-29")
+    expect(any(re.fullmatch(r"EV \S+ \S+ CRASH ERROR PC [0-9A-F]{8}", l) for l in r), "log crash", r)
+    expect(con.command("crash clear") == ["OK"], "crash clear", None)
+    expect(con.command("crash") == ["CRASH NONE", "OK"], "crash cleared", None)
+
+
+def start(args, stdout=None):
+    proc = subprocess.Popen(args, stdout=stdout, stderr=subprocess.PIPE, text=True)
+    first = proc.stderr.readline()
+    if not first.startswith("console on "):
+        proc.kill()
+        raise AssertionError("unexpected start: %r" % first)
+    return proc, Console(first.split()[-1])
+
+
+def replay(host, directory):
+    """Console changes go into the input log and replay frame for frame;
+    the console refuses them while a log is replayed."""
+    log = os.path.join(directory, "console.bin")
+    frames = os.path.join(directory, "console.frames")
+    capture = os.path.join(directory, "console.txt")
+    proc, con = start([host, "-u", "-q", "-t", "4", "-p", "select@600", "-p", "mode@700",
+                       "-R", log, "-F", frames])
+    expect(con.command("date 2024-02-29") == ["OK"], "recorded date", None)
+    expect(con.command("time 12:00:00") == ["OK"], "recorded time", None)
+    expect(con.command("sw start")[-1] == "OK", "recorded sw start", None)
+    time.sleep(0.3)
+    expect(con.command("sw lap")[-1] == "OK", "recorded sw lap", None)
+    time.sleep(0.3)
+    expect(con.command("sw stop")[-1] == "OK", "recorded sw stop", None)
+    # The same log as text, as a field unit exports it
+    r = con.command("input")
+    expect(r[0].startswith("INPUTLOG,") and r[-2:] == ["INPUTLOG_END", "OK"], "input", r)
+    with open(capture, "w") as f:
+        f.write("\r\n".join(r) + "\r\n")
+    expect(proc.wait() == 0, "recording run", proc.returncode)
+
+    for source in (log, capture):
+        r = subprocess.run([host, "-q", "-t", "4", "-r", source, "-C", frames],
+                           capture_output=True, text=True)
+        expect(r.returncode == 0, "replayed frames of " + source, r.stdout + r.stderr)
+
+    proc, con = start([host, "-u", "-q", "-t", "1", "-r", log])
+    for command in ("sw start", "date 2024-01-01", "time 00:00:00"):
+        r = con.command(command)
+        expect(r == ["ERR replay"], command + " while replaying", r)
+    proc.wait()
+
+
+def hour_format(host):
+    """The CLOCK view follows the hour_format setting (kvstore.h)."""
+    proc, con = start([host, "-u", "-t", "4", "-p", "select@600"], stdout=subprocess.PIPE)
+    expect(con.command("time 13:00:00") == ["OK"], "time for 12 hours", None)
+    r = con.command("kv hour_format 0C")
+    expect(r == ["KV hour_format 0C", "OK"], "kv hour_format", r)
+    time.sleep(1.5)
+    expect(con.command("kv hour_format -") == ["OK"], "kv hour_format delete", None)
+    frames, _ = proc.communicate()
+    expect(re.search(r"\|T:01:00:0\d PM   \|", frames), "12-hour frame", frames[-400:])
+    expect(re.search(r"\|T:13:00:0\d      \|", frames), "24-hour frame", frames[-400:])
+
+
+def main():
+    host = sys.argv[1]
+    proc = subprocess.Popen([host, "-u", "-q", "-t", "10", "-p", "select@600",
+                             "-H", "7300"],
+                            stderr=subprocess.PIPE, text=True)
+    first = proc.stderr.readline()
+    if not first.startswith("console on "):
+        print("unexpected start: %r" % first)
+        proc.kill()
+        return 1
+    log = []
+    threading.Thread(target=lambda: log.extend(proc.stderr), daemon=True).start()
+
+    try:
+        session(Console(first.split()[-1]))
+    except AssertionError as e:
+        print("FAIL: %s" % e)
+        proc.kill()
+        return 1
+
+    if proc.wait() != 0:
+        print("host exited with %d: %s" % (proc.returncode, "".join(log)))
+        return 1
+
+    try:
+        with tempfile.TemporaryDirectory() as directory:
+            replay(host, directory)
+        hour_format(host)
+    except AssertionError as e:
+        print("FAIL: %s" % e)
+        return 1
+    print("console OK")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
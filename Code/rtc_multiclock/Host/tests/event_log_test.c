@@ -0,0 +1,307 @@
+/**
+ * @file    event_log_test.c
+ * @brief   eventlog.c on the simulated flash: time queries, wrap-around
+ *          and a power cut during writes
+ *
+ * A fixed pseudo-random workload of events (gaps from 0 s to past
+ * EVLOG_MAX_DELTA, some stamps going backwards, 0..3 data words) runs
+ * against a model of the log, long enough to go round the two sectors
+ * twice:
+ *
+ *  1. without interruption, rebooting (EVLOG_Init()) now and then;
+ *     the whole log and random time ranges [from, to) must read back
+ *     as the model's events still held (those of blocks from 'oldest'
+ *     on), in order
+ *  2. every op that opens a block and every 23rd other op again, once
+ *     per flash operation it takes with the power cut during that
+ *     operation (Cut_Op(), flash_cut.h): after the next boot the recent
+ *     events must all be there, and the cut one at most once. The log
+ *     must then take further events and survive another reboot.
+ */
+
+#include "eventlog.h"
+#include "calendar.h"
+#include "flash_cut.h"
+#include <stdio.h>
+#include <string.h>
+
+#define WORKLOAD_OPS    60000U
+#define AFTER_CUT_OPS   4U       // Events checked after each recovery
+#define TAIL_EVENTS     40U      // Checked after a cut
+
+// Flash sectors 6 and 7 (STM32F446RETX_FLASH.ld)
+#define LOG_FLASH_OFFSET 0x40000U
+#define LOG_FLASH_BYTES  0x40000U
+
+typedef struct {
+    uint32_t    time;
+    EvlogType_t type;
+    uint8_t     words;
+    uint32_t    data[EVLOG_MAX_WORDS];
+    uint32_t    block;      // Block it was written to (model entries only)
+} Entry_t;
+
+static Entry_t ops[WORKLOAD_OPS];
+static Entry_t model[WORKLOAD_OPS];
+static uint32_t modelCount;
+static const Entry_t *expected[WORKLOAD_OPS + AFTER_CUT_OPS + 1U];
+
+static void makeWorkload(void) {
+    uint32_t time = 26U * 365U * 86400U;
+
+    Cut_Seed(2718281U);
+    for(uint32_t i = 0; i < WORKLOAD_OPS; i++) {
+        Entry_t *op = &ops[i];
+
+        switch(Cut_Random() % 200U) {
+        case 0:  time += EVLOG_MAX_DELTA + Cut_Random() % 1000U; break;   // New block
+        case 1:
+        case 2:  time -= Cut_Random() % 100U; break;                      // Clock set back
+        case 3:
+        case 4:
+        case 5:  break;                                                    // Same second
+        default: time += 1U + Cut_Random() % 600U; break;
+        }
+        op->time = time;
+        op->type = (EvlogType_t)(1U + Cut_Random() % (EVLOG_TYPE_COUNT - 1U));
+        op->words = (uint8_t)(Cut_Random() % (EVLOG_MAX_WORDS + 1U));
+        for(uint8_t w = 0; w < op->words; w++) {
+            op->data[w] = Cut_Random();
+        }
+    }
+}
+
+// Only eventlog.c and calendar.cpp are linked, not main.c
+RTC_HandleTypeDef hrtc;
+
+static uint32_t lastTime(void) {
+    return (modelCount > 0U) ? model[modelCount - 1U].time : 0U;
+}
+
+static uint8_t same(const EvlogEvent_t *event, const Entry_t *entry) {
+    return event->time == entry->time && event->type == entry->type &&
+           event->words == entry->words &&
+           memcmp(event->data, entry->data, entry->words * sizeof(uint32_t)) == 0;
+}
+
+// Append 'op' as the log would stamp it after an event at 'last'
+static void append(const Entry_t *op, uint32_t last, Entry_t *into) {
+    EvlogStats_t stats;
+
+    if(EVLOG_RecordAt(op->time, op->type, op->data, op->words) != HAL_OK) {
+        Cut_Fail("EVLOG_RecordAt failed", 0, (uint32_t)(op - ops), "time %lu", (unsigned long)op->time);
+    }
+    EVLOG_GetStats(&stats);
+    *into = *op;
+    into->time = (op->time < last) ? last : op->time;
+    into->block = stats.newest;
+}
+
+// Read [from, to) and compare it with the 'count' entries of 'expected'
+static void compare(const char *what, uint32_t cut, uint32_t opIndex,
+                    uint32_t from, uint32_t to, uint32_t count) {
+    EvlogCursor_t cursor;
+    EvlogEvent_t event;
+    uint32_t n = 0;
+
+    EVLOG_Seek(&cursor, from);
+    while(EVLOG_Next(&cursor, &event) && event.time < to) {
+        if(n >= count || !same(&event, expected[n])) {
+            Cut_Fail(what, cut, opIndex, "event %lu", (unsigned long)n);
+            return;
+        }
+        n++;
+    }
+    if(n != count) {
+        Cut_Fail(what, cut, opIndex, "event %lu", (unsigned long)n);
+    }
+}
+
+// The model's events in [from, to) that the log still holds
+static uint32_t expectRange(uint32_t from, uint32_t to) {
+    EvlogStats_t stats;
+    uint32_t count = 0;
+
+    EVLOG_GetStats(&stats);
+    for(uint32_t i = 0; i < modelCount; i++) {
+        if(model[i].block >= stats.oldest && model[i].time >= from && model[i].time < to) {
+            expected[count++] = &model[i];
+        }
+    }
+    return count;
+}
+
+static void checkRange(const char *what, uint32_t cut, uint32_t opIndex, uint32_t from, uint32_t to) {
+    compare(what, cut, opIndex, from, to, expectRange(from, to));
+}
+
+/* ================= CALENDAR ================= */
+
+static void checkCalendar(void) {
+    for(uint32_t days = 0; days <= 36524U; days++) {
+        uint8_t year, month, day;
+
+        CAL_FromDays((uint16_t)days, &year, &month, &day);
+        if(CAL_DaysSince2000(year, month, day) != days) {
+            Cut_Fail("calendar round trip", 0, 0, "day %lu", (unsigned long)days);
+        }
+    }
+}
+
+/* ================= RUN 1: NO CUTS ================= */
+
+static void runClean(void) {
+    EvlogStats_t stats;
+
+    Sim_FlashWipe();
+    modelCount = 0;
+    EVLOG_Init();
+
+    for(uint32_t i = 0; i < WORKLOAD_OPS; i++) {
+        append(&ops[i], lastTime(), &model[modelCount]);
+        modelCount++;
+        if(i % 1000U == 999U) {
+            EVLOG_Init();
+            checkRange("whole log", 0, i, 0, UINT32_MAX);
+            for(uint8_t q = 0; q < 20U; q++) {
+                uint32_t a = model[Cut_Random() % modelCount].time + Cut_Random() % 3U - 1U;
+                uint32_t b = a + Cut_Random() % 200000U;
+
+                checkRange("time range", 0, i, a, b);
+            }
+        }
+    }
+    EVLOG_GetStats(&stats);
+    printf("clean run: %lu flash operations, %lu erases, blocks %lu..%lu\n",
+           (unsigned long)Sim_FlashOperations(), (unsigned long)Sim_FlashErases(),
+           (unsigned long)stats.oldest, (unsigned long)stats.newest);
+    if(stats.newest < 3U * EVLOG_BLOCKS) {
+        printf("workload too short: %lu blocks\n", (unsigned long)stats.newest);
+        cutFailures++;
+    }
+}
+
+/* ================= RUN 2: POWER CUTS ================= */
+
+static Entry_t extra[AFTER_CUT_OPS + 1U];
+
+// The last TAIL_EVENTS of the model, then 'extras' entries of 'extra'
+static void checkTail(const char *what, uint32_t cut, uint32_t opIndex, uint32_t extras) {
+    uint32_t first = (modelCount > TAIL_EVENTS) ? modelCount - TAIL_EVENTS : 0U;
+    uint32_t from = model[first].time;
+    uint32_t count = 0;
+
+    for(uint32_t i = first; i > 0U && model[i - 1U].time == from; i--) {
+        first = i - 1U;    // Same second: Seek() starts at the first of them
+    }
+    for(uint32_t i = first; i < modelCount; i++) {
+        expected[count++] = &model[i];
+    }
+    for(uint32_t i = 0; i < extras; i++) {
+        expected[count++] = &extra[i];
+    }
+    compare(what, cut, opIndex, from, UINT32_MAX, count);
+}
+
+// Events the log returns from 'from' on
+static uint32_t countFrom(uint32_t from) {
+    EvlogCursor_t cursor;
+    EvlogEvent_t event;
+    uint32_t n = 0;
+
+    EVLOG_Seek(&cursor, from);
+    while(EVLOG_Next(&cursor, &event)) {
+        n++;
+    }
+    return n;
+}
+
+static void applyOp(uint32_t opIndex) {
+    append(&ops[opIndex], lastTime(), &model[modelCount]);
+    modelCount++;
+}
+
+static void cutOp(uint32_t opIndex) {
+    EVLOG_RecordAt(ops[opIndex].time, ops[opIndex].type, ops[opIndex].data, ops[opIndex].words);
+}
+
+// Power back after a cut of op 'opIndex': the cut event is either
+// complete or absent. model[modelCount] is the op's entry.
+static void checkCut(uint32_t cut, uint32_t opIndex) {
+    EvlogStats_t stats;
+    uint32_t first;
+    uint32_t extras = 0;
+
+    EVLOG_Init();
+    first = (modelCount > TAIL_EVENTS) ? modelCount - TAIL_EVENTS : 0U;
+    while(first > 0U && model[first - 1U].time == model[first].time) {
+        first--;
+    }
+    if(countFrom(model[first].time) == modelCount - first + 1U) {
+        extra[extras++] = model[modelCount];
+    }
+    checkTail("after cut", cut, opIndex, extras);
+
+    // Still writable: the next events go into a new block. A block
+    // opened for the cut event keeps its start time as the floor.
+    EVLOG_GetStats(&stats);
+    if(stats.last < lastTime() || stats.last > model[modelCount].time) {
+        Cut_Fail("floor after cut", cut, opIndex, "floor %lu", (unsigned long)stats.last);
+    }
+    for(uint32_t i = opIndex + 1U; i < WORKLOAD_OPS && i <= opIndex + AFTER_CUT_OPS; i++) {
+        uint32_t last = (extras > 0U) ? extra[extras - 1U].time : stats.last;
+
+        append(&ops[i], last, &extra[extras++]);
+    }
+    EVLOG_Init();
+    checkTail("after recovery", cut, opIndex, extras);
+}
+
+static const CutStore_t evlogCut = {
+    .flashOffset = LOG_FLASH_OFFSET,
+    .flashBytes  = LOG_FLASH_BYTES,
+    .model       = &modelCount,     // model[] only grows: the count is the state
+    .modelBytes  = sizeof(modelCount),
+    .boot        = EVLOG_Init,
+    .apply       = applyOp,
+    .cutOp       = cutOp,
+    .check       = checkCut,
+};
+
+static uint32_t runCuts(void) {
+    uint32_t cuts = 0;
+
+    Sim_FlashWipe();
+    modelCount = 0;
+    Cut_Init(&evlogCut);
+    EVLOG_Init();
+
+    for(uint32_t i = 0; i < WORKLOAD_OPS; i++) {
+        EvlogStats_t stats;
+        uint32_t last = lastTime();
+        uint32_t time = (ops[i].time < last) ? last : ops[i].time;
+        uint8_t opens;
+
+        EVLOG_GetStats(&stats);
+        opens = stats.used + 4U + 4U * ops[i].words > EVLOG_BLOCK_BYTES ||
+                time - last > EVLOG_MAX_DELTA;
+        if(opens || i % 23U == 0U) {
+            cuts += Cut_Op(&evlogCut, i);
+        } else {
+            applyOp(i);
+        }
+    }
+    return cuts;
+}
+
+int main(void) {
+    uint32_t cuts;
+
+    Sim_Reset();
+    checkCalendar();
+    makeWorkload();
+    runClean();
+    cuts = runCuts();
+    printf("%lu power cuts: %u failures\n", (unsigned long)cuts, cutFailures);
+    return cutFailures ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file    flash_cut.c
+ * @brief   Power-cut harness for the flash store tests (see flash_cut.h)
+ */
+
+#include "flash_cut.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CUT_FAILURES_SHOWN  10U
+
+typedef struct {
+    uint8_t *flash;
+    uint8_t *model;
+} Snapshot_t;
+
+unsigned cutFailures;
+
+static uint32_t rng;
+static Snapshot_t before, after;
+static jmp_buf cutJmp;
+
+// Only the store under test is linked, not main.c
+int firmware_main(void) {
+    return 0;
+}
+
+void Cut_Seed(uint32_t seed) {
+    rng = seed;
+}
+
+uint32_t Cut_Random(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+void Cut_Fail(const char *what, uint32_t cut, uint32_t op, const char *detail, ...) {
+    va_list args;
+
+    if(cutFailures++ >= CUT_FAILURES_SHOWN) {
+        return;
+    }
+    printf("%s: cut %lu, op %lu, ", what, (unsigned long)cut, (unsigned long)op);
+    va_start(args, detail);
+    vprintf(detail, args);
+    va_end(args);
+    printf("\n");
+}
+
+/* ================= SNAPSHOTS ================= */
+
+static void allocate(Snapshot_t *snapshot, const CutStore_t *store) {
+    snapshot->flash = realloc(snapshot->flash, store->flashBytes);
+    snapshot->model = realloc(snapshot->model, store->modelBytes);
+    if(snapshot->flash == NULL || snapshot->model == NULL) {
+        printf("no memory for the snapshots\n");
+        exit(1);
+    }
+}
+
+void Cut_Init(const CutStore_t *store) {
+    allocate(&before, store);
+    allocate(&after, store);
+}
+
+static void save(Snapshot_t *snapshot, const CutStore_t *store) {
+    memcpy(snapshot->flash, &SimFlash[store->flashOffset], store->flashBytes);
+    memcpy(snapshot->model, store->model, store->modelBytes);
+}
+
+static void restore(const Snapshot_t *snapshot, const CutStore_t *store) {
+    memcpy(&SimFlash[store->flashOffset], snapshot->flash, store->flashBytes);
+    memcpy(store->model, snapshot->model, store->modelBytes);
+}
+
+/* ================= CUTS ================= */
+
+static void powerCut(void) {
+    longjmp(cutJmp, 1);
+}
+
+static void run(const CutStore_t *store, uint32_t op, void (*action)(uint32_t)) {
+    if(op == CUT_BOOT) {
+        store->boot();
+    } else {
+        action(op);
+    }
+}
+
+// Boot on 'before', then cut operation 'cut' of 'op' and let the test
+// check what the next boot finds
+static void cutDuring(const CutStore_t *store, uint32_t cut, uint32_t op) {
+    restore(&before, store);
+    if(op != CUT_BOOT) {
+        store->boot();
+    }
+    Sim_FlashCutAfter(cut, powerCut);
+    if(setjmp(cutJmp) == 0) {
+        run(store, op, store->cutOp);
+        Cut_Fail("no cut", cut, op, "finished");
+        Sim_FlashCutAfter(0, NULL);
+        return;
+    }
+    store->check(cut, op);
+}
+
+uint32_t Cut_Op(const CutStore_t *store, uint32_t op) {
+    uint32_t operations;
+
+    save(&before, store);
+    operations = Sim_FlashOperations();
+    run(store, op, store->apply);
+    operations = Sim_FlashOperations() - operations;
+    save(&after, store);
+
+    for(uint32_t cut = 0; cut < operations; cut++) {
+        cutDuring(store, cut, op);
+    }
+    restore(&after, store);
+    store->boot();
+    return operations;
+}
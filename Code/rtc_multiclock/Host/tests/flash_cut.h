@@ -0,0 +1,58 @@
+#ifndef FLASH_CUT_H
+#define FLASH_CUT_H
+
+#include "sim.h"
+
+/**
+ * @file    flash_cut.h
+ * @brief   Power cuts at every flash operation of a store, for the
+ *          flash store tests (kv_store_test.c, event_log_test.c)
+ *
+ * A test describes its store in a CutStore_t: the region of SimFlash
+ * it lives in, the test's model of its contents (saved and restored
+ * with the flash) and how to boot it, run one op of the workload and
+ * check it after a cut. Cut_Op() then runs an op once without a cut
+ * and once per flash operation it took with the power cut during that
+ * operation (Sim_FlashCutAfter()), each from the contents before it.
+ * What a test checks and how its workload looks is up to the test.
+ */
+
+// Op index of the boot itself: Cut_Op() cuts store->boot()
+#define CUT_BOOT  0xFFFFFFFFU
+
+typedef struct {
+    uint32_t flashOffset;     // Region of SimFlash the store lives in
+    uint32_t flashBytes;
+    void    *model;           // The test's model, saved and restored with the flash
+    uint32_t modelBytes;
+    void   (*boot)(void);     // Power-up of the store, e.g. KV_Init()
+    // Op 'op' on the store and on the model
+    void   (*apply)(uint32_t op);
+    // Op 'op' on the store alone; the power is cut during it
+    void   (*cutOp)(uint32_t op);
+    // Power back after 'cut' completed operations of op 'op' (model as
+    // before the op): boot and compare with the model
+    void   (*check)(uint32_t cut, uint32_t op);
+} CutStore_t;
+
+// Failures so far; Cut_Fail() prints the first few
+extern unsigned cutFailures;
+
+// xorshift32 for the workloads: the same sequence from the same seed
+void     Cut_Seed(uint32_t seed);
+uint32_t Cut_Random(void);
+
+// "<what>: cut <cut>, op <op>, <detail>", counted in cutFailures
+void Cut_Fail(const char *what, uint32_t cut, uint32_t op, const char *detail, ...)
+    __attribute__((format(printf, 4, 5)));
+
+// Snapshot buffers for 'store'; call once before Cut_Op()
+void Cut_Init(const CutStore_t *store);
+
+// Op 'op' (or CUT_BOOT) without a cut, then once per flash operation
+// it takes with the power cut during that operation, each from a boot
+// on the contents before it. Leaves the store as after the uncut run,
+// booted; returns the cuts made.
+uint32_t Cut_Op(const CutStore_t *store, uint32_t op);
+
+#endif
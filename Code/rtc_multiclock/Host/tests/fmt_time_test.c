@@ -0,0 +1,74 @@
+/**
+ * @file    fmt_time_test.c
+ * @brief   FMT_BcdTime() against the reference formatters for every time of day
+ *
+ * Built twice by CMake: with the portable kernel (FMT_DSP=0) and with
+ * the SIMD kernel (FMT_DSP=1) running on the intrinsics emulated in
+ * Host/sim/include/stm32f4xx_hal.h. For all 86,400 times the output
+ * must equal both snprintf("%02u:%02u:%02u") of the binary time and
+ * FMT_Bcd2() field by field. Nibbles above 9, the PM bit and the
+ * reserved RTC_TR bits are checked as well.
+ */
+
+#include "fmt.h"
+#include <stdio.h>
+#include <string.h>
+
+static unsigned failures;
+
+static uint8_t toBcd(unsigned value) {
+    return (uint8_t)(((value / 10U) << 4) | (value % 10U));
+}
+
+static void expectTime(uint32_t bcd, const char *expected) {
+    char out[12];
+
+    // Guard bytes: exactly 8 characters may be written
+    memset(out, '#', sizeof(out));
+    FMT_BcdTime(out + 2, bcd);
+
+    if(memcmp(out + 2, expected, 8) != 0 || out[0] != '#' || out[1] != '#' || out[10] != '#') {
+        if(failures++ < 10U) {
+            printf("0x%06lX: got '%.8s', expected '%s'\n", (unsigned long)bcd, out + 2, expected);
+        }
+    }
+}
+
+int main(void) {
+    unsigned checked = 0;
+
+    for(unsigned h = 0; h < 24U; h++) {
+        for(unsigned m = 0; m < 60U; m++) {
+            for(unsigned s = 0; s < 60U; s++) {
+                uint32_t bcd = ((uint32_t)toBcd(h) << 16) | ((uint32_t)toBcd(m) << 8) | toBcd(s);
+                char viaSnprintf[9];
+                char viaFields[9];
+                char *p = viaFields;
+
+                snprintf(viaSnprintf, sizeof(viaSnprintf), "%02u:%02u:%02u", h, m, s);
+                p = FMT_Bcd2(p, toBcd(h));
+                *p++ = ':';
+                p = FMT_Bcd2(p, toBcd(m));
+                *p++ = ':';
+                p = FMT_Bcd2(p, toBcd(s));
+                *p = '\0';
+
+                if(strcmp(viaSnprintf, viaFields) != 0) {
+                    printf("reference formatters disagree: %s / %s\n", viaSnprintf, viaFields);
+                    failures++;
+                }
+                expectTime(bcd, viaSnprintf);
+                // PM flag (bit 22) and reserved bits are not part of the time
+                expectTime(bcd | 0xFF408080U, viaSnprintf);
+                checked++;
+            }
+        }
+    }
+
+    // A corrupt register shows up as '?' instead of a wrong digit
+    expectTime(0x001A5F3BU, "1?:5?:3?");
+    expectTime(0x00000C0FU, "00:0?:0?");
+
+    printf("%u times of day checked, %u failures\n", checked, failures);
+    return failures ? 1 : 0;
+}
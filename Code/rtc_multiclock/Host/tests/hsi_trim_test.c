@@ -0,0 +1,103 @@
+/**
+ * @file    hsi_trim_test.c
+ * @brief   HSI trimmed against the LSE (hsitrim.h) on a simulated part
+ *          whose HSI is off by a given error
+ *
+ * For each error the firmware runs with the stopwatch going from about
+ * SIM_START_MS. Once the LSE is up the calibrator must measure the error
+ * at the factory trim, step HSITRIM to the trim closest to 16 MHz and
+ * settle there. Over the rest of the run the stopwatch, corrected by
+ * HSITRIM_Ms(), must keep to the virtual time within MAX_PPM: frames
+ * give pairs of stopwatch and virtual time taken at the same instant.
+ */
+
+#include "sim_test.h"
+#include "main.h"
+#include "hsitrim.h"
+#include "stopwatch.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SAMPLE_MS      12000U   // First pair taken from here on
+#define END_MS         130000U
+#define SIM_STEP_PPM   4700     // SIM_HSI_TRIM_STEP_PPM in sim_hal.c
+#define MAX_PPM        20       // Corrected stopwatch against virtual time
+
+// First and last stopwatch / virtual time pair
+static uint32_t firstElapsed;
+static uint32_t lastElapsed;
+static uint64_t firstNs;
+static uint64_t lastNs;
+
+// Each run presses a second later than the one before: the firmware's
+// statics (the debounce time of each button) carry over on the host
+static uint32_t runOffsetMs;
+
+static void onFrame(uint64_t timeNs) {
+    if(!STOPWATCH_Running() || timeNs < (uint64_t)SAMPLE_MS * 1000000ULL) {
+        return;
+    }
+    if(firstNs == 0U) {
+        firstNs = timeNs;
+        firstElapsed = STOPWATCH_ElapsedMs();
+    }
+    lastNs = timeNs;
+    lastElapsed = STOPWATCH_ElapsedMs();
+}
+
+static void runError(int32_t errorPpm) {
+    const HsitrimStats_t *stats;
+    int32_t modelPpm;
+    int64_t trueMs;
+    int64_t driftMs;
+
+    Sim_SetHsiError(errorPpm);
+    Sim_Reset();
+    Sim_FlashWipe();
+    firstNs = 0;
+    Sim_SetFrameCallback(onFrame);
+    Sim_Press(SIM_START_MS - 1000U + runOffsetMs, mode_pin_GPIO_Port, mode_pin_Pin);
+    Sim_Press(SIM_START_MS + runOffsetMs, start_stop_pin_GPIO_Port, start_stop_pin_Pin);
+    runOffsetMs += 1000U;
+    Sim_RunFirmware(END_MS);
+    Sim_SetFrameCallback(NULL);
+
+    stats = HSITRIM_GetStats();
+    modelPpm = errorPpm + ((int32_t)stats->trim - (int32_t)RCC_HSICALIBRATION_DEFAULT) * SIM_STEP_PPM;
+    CHECK(stats->state == HSITRIM_SETTLED, "%ld ppm: %s", (long)errorPpm,
+          HSITRIM_StateName((HsitrimState_t)stats->state));
+    // Once on settling, once CONFIG_HSITRIM_INTERVAL_S later
+    CHECK(stats->measurements >= 2U, "%ld ppm: %lu measurements", (long)errorPpm,
+          (unsigned long)stats->measurements);
+    CHECK(stats->factoryTrim == RCC_HSICALIBRATION_DEFAULT && abs(stats->factoryPpm - errorPpm) <= 2,
+          "%ld ppm: before %ld ppm at trim %u", (long)errorPpm, (long)stats->factoryPpm,
+          stats->factoryTrim);
+    CHECK(stats->trim == (RCC->CR & RCC_CR_HSITRIM) >> RCC_CR_HSITRIM_Pos, "%ld ppm: trim %u not in RCC_CR",
+          (long)errorPpm, stats->trim);
+    CHECK(abs(modelPpm) <= SIM_STEP_PPM / 2 && abs(stats->hsiPpm - modelPpm) <= 2,
+          "%ld ppm: trim %u measured %ld ppm, HSI at %ld ppm", (long)errorPpm, stats->trim,
+          (long)stats->hsiPpm, (long)modelPpm);
+    CHECK(abs(stats->correctionPpm - modelPpm) <= 2 && abs(stats->residualPpm) <= 2,
+          "%ld ppm: correction %ld ppm, after %ld ppm", (long)errorPpm,
+          (long)stats->correctionPpm, (long)stats->residualPpm);
+
+    // 1 ms of HAL_GetTick() resolution at either end
+    trueMs = (int64_t)((lastNs - firstNs) / 1000000ULL);
+    driftMs = (int64_t)(lastElapsed - firstElapsed) - trueMs;
+    CHECK(firstNs != 0U && trueMs > 100000, "%ld ppm: stopwatch sampled over %lld ms", (long)errorPpm,
+          (long long)trueMs);
+    CHECK(llabs(driftMs) <= 2 + trueMs * MAX_PPM / 1000000, "%ld ppm: stopwatch %lld ms off over %lld ms",
+          (long)errorPpm, (long long)driftMs, (long long)trueMs);
+    printf("%+6ld ppm: trim %u -> %u, HSI %+ld ppm, stopwatch %+lld ms over %lld ms\n",
+           (long)errorPpm, stats->factoryTrim, stats->trim, (long)stats->hsiPpm,
+           (long long)driftMs, (long long)trueMs);
+}
+
+int main(void) {
+    runError(7300);
+    runError(-5000);
+    runError(2000);    // Under half a step: correction only
+    runError(0);
+    printf("hsi trim: %u failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,196 @@
+/**
+ * @file    kv_store_test.c
+ * @brief   kvstore.c on the simulated flash, with a power cut at every operation
+ *
+ * A fixed pseudo-random workload of sets and deletes, long enough for
+ * several compactions, runs against a model of the expected contents:
+ *
+ *  1. without interruption, rebooting (KV_Init()) now and then; every
+ *     value must read back as written, and writing a stored value
+ *     again must not touch the flash
+ *  2. every op again from a reboot on the flash contents run 1 left
+ *     before it, then once per flash operation it takes with the power
+ *     cut during that operation (Cut_Op(), flash_cut.h): after the next
+ *     boot every key must hold its last written value, except the key
+ *     being written, which may hold the old or the new one. The store
+ *     must then take further writes and survive another reboot.
+ */
+
+#include "kvstore.h"
+#include "flash_cut.h"
+#include <stdio.h>
+#include <string.h>
+
+#define WORKLOAD_OPS    4000U
+#define AFTER_CUT_OPS   8U      // Writes checked after each recovery
+
+// Flash sectors 1 and 2 (STM32F446RETX_FLASH.ld)
+#define KV_FLASH_OFFSET 0x4000U
+#define KV_FLASH_BYTES  0x8000U
+
+typedef struct {
+    KvKey_t key;
+    uint8_t length;
+    uint8_t value[KV_MAX_VALUE];
+} Op_t;
+
+typedef struct {
+    uint8_t length[KV_KEY_COUNT];
+    uint8_t value[KV_KEY_COUNT][KV_MAX_VALUE];
+} Model_t;
+
+static Op_t ops[WORKLOAD_OPS];
+static Model_t model;
+
+static void makeWorkload(void) {
+    Cut_Seed(12345U);
+    for(uint32_t i = 0; i < WORKLOAD_OPS; i++) {
+        Op_t *op = &ops[i];
+
+        op->key = (KvKey_t)(Cut_Random() % KV_KEY_COUNT);
+        // Short settings, full-size values and a few deletes
+        switch(Cut_Random() % 8U) {
+        case 0:  op->length = 0; break;
+        case 1:
+        case 2:
+        case 3:  op->length = KV_MAX_VALUE; break;
+        default: op->length = (uint8_t)(1U + Cut_Random() % 8U); break;
+        }
+        for(uint8_t b = 0; b < op->length; b++) {
+            op->value[b] = (uint8_t)Cut_Random();
+        }
+    }
+}
+
+static uint8_t holds(KvKey_t key, const uint8_t *value, uint8_t length) {
+    uint8_t stored[KV_MAX_VALUE];
+
+    return KV_Get(key, stored, sizeof(stored)) == length && memcmp(stored, value, length) == 0;
+}
+
+static void apply(const Op_t *op) {
+    model.length[op->key] = op->length;
+    memcpy(model.value[op->key], op->value, op->length);
+}
+
+// Every key as in the model; 'maybe' may hold either value instead
+static void checkModel(const char *what, uint32_t cut, uint32_t opIndex, const Op_t *maybe) {
+    for(uint8_t k = 0; k < KV_KEY_COUNT; k++) {
+        if(holds((KvKey_t)k, model.value[k], model.length[k])) {
+            continue;
+        }
+        if(maybe != NULL && maybe->key == k && holds((KvKey_t)k, maybe->value, maybe->length)) {
+            apply(maybe);    // The cut write made it
+            continue;
+        }
+        Cut_Fail(what, cut, opIndex, "key %s", KV_Name((KvKey_t)k));
+    }
+}
+
+static void set(const Op_t *op, uint32_t cut, uint32_t opIndex) {
+    if(KV_Set(op->key, op->value, op->length) != HAL_OK) {
+        Cut_Fail("KV_Set failed", cut, opIndex, "key %s", KV_Name(op->key));
+    }
+    apply(op);
+}
+
+/* ================= RUN 1: NO CUTS ================= */
+
+static uint32_t runClean(void) {
+    KvStats_t stats;
+    uint32_t operations;
+
+    Sim_FlashWipe();
+    memset(&model, 0, sizeof(model));
+    KV_Init();
+
+    for(uint32_t i = 0; i < WORKLOAD_OPS; i++) {
+        set(&ops[i], 0, i);
+        if(!holds(ops[i].key, ops[i].value, ops[i].length)) {
+            Cut_Fail("read back", 0, i, "key %s", KV_Name(ops[i].key));
+        }
+        if(i % 97U == 0U) {
+            KV_Init();
+            checkModel("after reboot", 0, i, NULL);
+        }
+    }
+    operations = Sim_FlashOperations();
+
+    // Same value again: no flash operation
+    KV_Set(ops[0].key, model.value[ops[0].key], model.length[ops[0].key]);
+    if(Sim_FlashOperations() != operations) {
+        Cut_Fail("unchanged value was written", 0, 0, "key %s", KV_Name(ops[0].key));
+    }
+
+    KV_GetStats(&stats);
+    printf("clean run: %lu flash operations, %lu erases, generation %lu, %u/%u bytes used\n",
+           (unsigned long)operations, (unsigned long)Sim_FlashErases(),
+           (unsigned long)stats.generation, stats.used, stats.size);
+    if(stats.generation < 4U) {
+        printf("workload too short: only %lu compactions\n", (unsigned long)(stats.generation - 1U));
+        cutFailures++;
+    }
+    return operations;
+}
+
+/* ================= RUN 2: A CUT AT EVERY OPERATION ================= */
+
+static void applyOp(uint32_t opIndex) {
+    set(&ops[opIndex], 0, opIndex);
+}
+
+static void cutOp(uint32_t opIndex) {
+    KV_Set(ops[opIndex].key, ops[opIndex].value, ops[opIndex].length);
+}
+
+// Power back: the cut write may or may not have made it
+static void checkCut(uint32_t cut, uint32_t opIndex) {
+    uint32_t next = (opIndex == CUT_BOOT) ? 0U : opIndex + 1U;
+
+    KV_Init();
+    checkModel("after cut", cut, opIndex, (opIndex == CUT_BOOT) ? NULL : &ops[opIndex]);
+
+    // Still writable: recovery may have to compact first
+    for(uint32_t i = next; i < WORKLOAD_OPS && i < next + AFTER_CUT_OPS; i++) {
+        set(&ops[i], cut, i);
+    }
+    KV_Init();
+    checkModel("after recovery", cut, opIndex, NULL);
+}
+
+static const CutStore_t kvCut = {
+    .flashOffset = KV_FLASH_OFFSET,
+    .flashBytes  = KV_FLASH_BYTES,
+    .model       = &model,
+    .modelBytes  = sizeof(model),
+    .boot        = KV_Init,
+    .apply       = applyOp,
+    .cutOp       = cutOp,
+    .check       = checkCut,
+};
+
+// KV_Init() on an empty store, then every op of the workload, each
+// from a reboot on the flash contents the clean run left before it
+static uint32_t runCuts(void) {
+    uint32_t cuts;
+
+    Sim_FlashWipe();
+    memset(&model, 0, sizeof(model));
+    Cut_Init(&kvCut);
+    cuts = Cut_Op(&kvCut, CUT_BOOT);
+    for(uint32_t i = 0; i < WORKLOAD_OPS; i++) {
+        cuts += Cut_Op(&kvCut, i);
+    }
+    return cuts;
+}
+
+int main(void) {
+    uint32_t cuts;
+
+    Sim_Reset();
+    makeWorkload();
+    runClean();
+    cuts = runCuts();
+    printf("%lu power cuts: %u failures\n", (unsigned long)cuts, cutFailures);
+    return cutFailures ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+/**
+ * @file    power_fail_test.c
+ * @brief   Supply failure on the simulated board: the PVD save path
+ *          (power.h) and what the next boot makes of it
+ *
+ * The firmware runs with the stopwatch going (one lap taken) and an
+ * hour edit pending in SETTINGS, then the supply dips below the PVD
+ * level:
+ *
+ *  1. VDD comes back 5 ms later: the handler has saved the state and
+ *     resets the MCU. The save took at most POWER_SAVE_BUDGET_US, the
+ *     stopwatch runs on without losing time, SETTINGS is back with the
+ *     pending edit, and the log holds POWER_FAIL before the RESET.
+ *  2. VDD stays low: the handler waits until the supply is gone. The
+ *     next power-up (backup domain on VBAT, flash and LCD kept by the
+ *     harness) restores the same state; a cold power-up with a blank
+ *     backup SRAM starts from scratch.
+ */
+
+#include "sim_test.h"
+#include "main.h"
+#include "power.h"
+#include "backup.h"
+#include "mode.h"
+#include "stopwatch.h"
+#include "eventlog.h"
+#include <stdio.h>
+#include <string.h>
+
+#define DIP_MS         14000U   // Supply below the PVD level
+#define END_MS         20000U
+#define OUTAGE_S       30U
+#define RESUME_MS      6000U    // Run after the power-up
+
+// STOPWATCH, start, lap; SETTINGS, hours +1 twice, on to the minutes
+static void scheduleSession(void) {
+    Sim_Press(6000, mode_pin_GPIO_Port, mode_pin_Pin);
+    Sim_Press(SIM_START_MS, start_stop_pin_GPIO_Port, start_stop_pin_Pin);
+    Sim_Press(9000, reset_pin_GPIO_Port, reset_pin_Pin);
+    Sim_Press(10000, mode_pin_GPIO_Port, mode_pin_Pin);
+    Sim_Press(11000, reset_pin_GPIO_Port, reset_pin_Pin);
+    Sim_Press(11500, reset_pin_GPIO_Port, reset_pin_Pin);
+    Sim_Press(12000, start_stop_pin_GPIO_Port, start_stop_pin_Pin);
+}
+
+// The last 'count' events in the log, oldest first; the number read
+static uint32_t lastEvents(EvlogEvent_t *events, uint32_t count) {
+    EvlogCursor_t cursor;
+    EvlogEvent_t event;
+    uint32_t seen = 0;
+
+    memset(events, 0, count * sizeof(events[0]));
+    EVLOG_Seek(&cursor, 0);
+    while(EVLOG_Next(&cursor, &event)) {
+        memmove(events, events + 1, (count - 1U) * sizeof(events[0]));
+        events[count - 1U] = event;
+        seen++;
+    }
+    return seen;
+}
+
+// The end of the log: the stopwatch started, the supply failed, the
+// MCU came back up and resumed the stopwatch
+static void checkLog(const char *run, uint32_t resetFlag) {
+    EvlogEvent_t events[4];
+
+    lastEvents(events, 4);
+    CHECK(events[0].type == EVLOG_STOPWATCH_START && events[1].type == EVLOG_POWER_FAIL &&
+          events[2].type == EVLOG_RESET && events[3].type == EVLOG_STOPWATCH_START,
+          "%s: log ends %s %s %s %s", run, EVLOG_TypeName(events[0].type),
+          EVLOG_TypeName(events[1].type), EVLOG_TypeName(events[2].type),
+          EVLOG_TypeName(events[3].type));
+    CHECK(events[2].data[0] & resetFlag, "%s: reset flags %08lX", run,
+          (unsigned long)events[2].data[0]);
+    CHECK(events[1].time >= events[0].time && events[2].time >= events[1].time,
+          "%s: stamps out of order", run);
+}
+
+// Save statistics, stopwatch and SETTINGS after the boot that followed
+// the supply failure; 'want' is the stopwatch time expected
+static void checkRestored(const char *run, uint32_t want) {
+    const PowerBackup_t *stats = POWER_GetStats();
+    uint32_t budget = POWER_SAVE_BUDGET_US * (SystemCoreClock / 1000000U);
+    uint32_t elapsed = STOPWATCH_ElapsedMs();
+    char row[SIM_LCD_COLS + 1];
+
+    CHECK(stats->saves == 1U, "%s: %lu saves", run, (unsigned long)stats->saves);
+    CHECK(stats->maxCycles > 0U && stats->maxCycles <= budget,
+          "%s: save took %lu cycles, budget %lu", run,
+          (unsigned long)stats->maxCycles, (unsigned long)budget);
+
+    CHECK(STOPWATCH_Running(), "%s: stopwatch stopped", run);
+    CHECK(STOPWATCH_LapCount() == 1U, "%s: %u laps", run, STOPWATCH_LapCount());
+    // One RTC second of resolution on the way through the reset, and
+    // the last redraw
+    CHECK(elapsed + 1500U >= want && elapsed <= want + 1500U,
+          "%s: stopwatch at %lu ms, want %lu", run, (unsigned long)elapsed, (unsigned long)want);
+
+    CHECK(MODE_Active() != NULL && strcmp(MODE_Active()->name, "SETTINGS") == 0,
+          "%s: in %s", run, MODE_Active() ? MODE_Active()->name : "-");
+    Sim_LcdRow(0, row);
+    CHECK(strncmp(row, "Set Minutes:", 12) == 0, "%s: LCD '%s'", run, row);
+    Sim_LcdRow(1, row);
+    CHECK(strstr(row, "02") != NULL, "%s: LCD '%s', want hour 02", run, row);
+}
+
+// 1. A dip of 5 ms: save, wait, reset once VDD is back
+static void runDip(void) {
+    Sim_Reset();
+    Sim_FlashWipe();
+    scheduleSession();
+    Sim_ScheduleSupply(DIP_MS, 2500);
+    Sim_ScheduleSupply(DIP_MS + 5U, SIM_SUPPLY_MV);
+    Sim_RunFirmware(END_MS);
+
+    checkRestored("dip", END_MS - SIM_START_MS);
+    checkLog("dip", RCC_CSR_SFTRSTF);
+}
+
+// 2. The supply fails for good, and comes back after OUTAGE_S
+static void runOutage(void) {
+    static SimRetained_t retained;
+
+    Sim_Reset();
+    Sim_FlashWipe();
+    scheduleSession();
+    Sim_ScheduleSupply(DIP_MS, 2500);
+    Sim_RunFirmware(DIP_MS + 20U);
+    CHECK(POWER_GetStats()->saves == 1U, "outage: %lu saves",
+          (unsigned long)POWER_GetStats()->saves);
+
+    // Power-up 30 s later; the RTC ran on VBAT, so the stopwatch counts
+    // them (and the 20 ms of the wait)
+    Sim_SaveRetained(&retained);
+    retained.rtcSeconds += OUTAGE_S;
+    Sim_WarmReset(&retained);
+    Sim_RunFirmware(RESUME_MS);
+
+    checkRestored("outage", (DIP_MS - SIM_START_MS) + OUTAGE_S * 1000U + RESUME_MS);
+    checkLog("outage", RCC_CSR_PINRSTF);
+
+    // Cold power-up: nothing staged any more, and the backup SRAM is noise
+    Sim_Reset();
+    Sim_RunFirmware(8000);
+    CHECK(POWER_GetStats()->saves == 0U, "cold: %lu saves", (unsigned long)POWER_GetStats()->saves);
+    CHECK(!STOPWATCH_Running(), "cold: stopwatch running");
+    CHECK(MODE_Active() != NULL && strcmp(MODE_Active()->name, "SETTINGS") != 0,
+          "cold: in SETTINGS");
+}
+
+int main(void) {
+    runDip();
+    runOutage();
+    printf("power fail: %u failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,335 @@
+#!/usr/bin/env python3
+"""
+Pack LCD animations into const C data for anim.c.
+
+    anim_pack.py -o Core/Src/anim_assets.c -H Core/Inc/anim_assets.h Assets/*.anim
+
+Source format (one animation per file, '#' starts a comment):
+
+    anim rocket                     name -> 'animRocket' in C
+    glyph ^ rocket_top              5x8 glyph drawn by the alias '^',
+    ..#..                           followed by 8 rows ('#' = on)
+    ...
+    glyph * flame_1 flame_1.png     or read from a 5x8 PNG next to the
+                                    source (dark or opaque pixels = on)
+    repeat 6                        frames up to 'end' are repeated
+    frame 80                        shown for 80 ms
+    |                |              the two LCD lines between '|';
+    |       *        |              glyph aliases, otherwise ASCII text
+    end
+
+Output format, decoded by anim.c:
+
+  glyphs    8 rows per glyph, run-length coded: one byte per run,
+            (run - 1) << 5 | row, runs may span glyphs.
+  timeline  per frame: duration in ms (uint16, little-endian), then
+            runs covering the 32 cells: 'n, value' repeats a value
+            n times, '0x80 | n, n values' copies them. A value below 8
+            is a glyph index, anything else is a character.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+import zlib
+
+LCD_ROWS = 2
+LCD_COLS = 16
+CGRAM_SLOTS = 8
+GLYPH_ROWS = 8
+GLYPH_COLS = 5
+
+
+class PackError(Exception):
+    pass
+
+
+# ---------------------------------------------------------------------------
+# PNG (non-interlaced, any colour type) to a list of rows of on/off pixels
+# ---------------------------------------------------------------------------
+
+def _paeth(a, b, c):
+    p = a + b - c
+    pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+    if pa <= pb and pa <= pc:
+        return a
+    return b if pb <= pc else c
+
+
+def read_png(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"\x89PNG\r\n\x1a\n":
+        raise PackError("%s: not a PNG file" % path)
+
+    pos, idat, palette, trns = 8, b"", None, None
+    while pos < len(data):
+        length, kind = struct.unpack(">I4s", data[pos:pos + 8])
+        chunk = data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if kind == b"IHDR":
+            width, height, depth, ctype, _, _, interlace = struct.unpack(">IIBBBBB", chunk)
+        elif kind == b"PLTE":
+            palette = [tuple(chunk[i:i + 3]) for i in range(0, len(chunk), 3)]
+        elif kind == b"tRNS":
+            trns = chunk
+        elif kind == b"IDAT":
+            idat += chunk
+    if interlace:
+        raise PackError("%s: interlaced PNGs are not supported" % path)
+
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[ctype]
+    bpp = max(1, channels * depth // 8)
+    stride = (width * channels * depth + 7) // 8
+    raw = zlib.decompress(idat)
+
+    rows, prev = [], bytearray(stride)
+    for y in range(height):
+        line = raw[y * (stride + 1):(y + 1) * (stride + 1)]
+        ftype, cur = line[0], bytearray(line[1:])
+        for i in range(stride):
+            a = cur[i - bpp] if i >= bpp else 0
+            b = prev[i]
+            c = prev[i - bpp] if i >= bpp else 0
+            cur[i] = (cur[i] + (0, a, b, (a + b) // 2, _paeth(a, b, c))[ftype]) & 0xFF
+        prev = cur
+
+        if depth < 8:
+            samples = [(cur[(x * depth) // 8] >> (8 - depth - (x * depth) % 8)) & ((1 << depth) - 1)
+                       for x in range(width)]
+        else:
+            step = depth // 8
+            samples = [cur[i] for i in range(0, stride, step)]
+
+        pixels = []
+        for x in range(width):
+            if ctype == 3:
+                index = samples[x]
+                r, g, bl = palette[index]
+                alpha = trns[index] if trns and index < len(trns) else 255
+            else:
+                px = samples[x * channels:(x + 1) * channels]
+                scale = 255 // ((1 << depth) - 1)
+                px = [v * scale for v in px] if depth < 8 else px
+                r, g, bl = (px[0], px[0], px[0]) if ctype in (0, 4) else px[:3]
+                alpha = px[-1] if ctype in (4, 6) else 255
+            luma = (299 * r + 587 * g + 114 * bl) // 1000
+            pixels.append(alpha >= 128 and luma < 128)
+        rows.append(pixels)
+    return rows
+
+
+# ---------------------------------------------------------------------------
+# Source parser
+# ---------------------------------------------------------------------------
+
+class Anim:
+    def __init__(self, path):
+        self.path = path
+        self.name = None
+        self.glyphs = []        # (name, [8 row bytes])
+        self.aliases = {}       # char -> glyph index
+        self.frames = []        # (ms, 32 cell values)
+
+
+def parse(path):
+    anim = Anim(path)
+    lines = []
+    with open(path) as f:
+        for number, text in enumerate(f, 1):
+            text = text.rstrip("\n")
+            if text.lstrip().startswith("#") and not re.fullmatch(r"[.#]{%d}" % GLYPH_COLS, text.strip()):
+                continue
+            if text.strip():
+                lines.append((number, text))
+
+    def fail(number, message):
+        raise PackError("%s:%d: %s" % (path, number, message))
+
+    repeat_from, repeat_count = None, 0
+    i = 0
+    while i < len(lines):
+        number, text = lines[i]
+        words = text.split()
+        i += 1
+
+        if words[0] == "anim" and len(words) == 2:
+            anim.name = words[1]
+        elif words[0] == "glyph" and len(words) in (3, 4):
+            alias = words[1]
+            if len(alias) != 1 or alias in anim.aliases:
+                fail(number, "glyph alias must be one unused character")
+            if len(words) == 4:
+                pixels = read_png(os.path.join(os.path.dirname(path), words[3]))
+            else:
+                pixels = []
+                for _ in range(GLYPH_ROWS):
+                    if i >= len(lines):
+                        fail(number, "glyph needs %d rows" % GLYPH_ROWS)
+                    row = lines[i][1].strip()
+                    if not re.fullmatch(r"[.#]{%d}" % GLYPH_COLS, row):
+                        fail(lines[i][0], "glyph row must be %d of '.' and '#'" % GLYPH_COLS)
+                    pixels.append([c == "#" for c in row])
+                    i += 1
+            if len(pixels) != GLYPH_ROWS or any(len(r) != GLYPH_COLS for r in pixels):
+                fail(number, "glyph must be %dx%d pixels" % (GLYPH_COLS, GLYPH_ROWS))
+            rows = [sum(1 << (GLYPH_COLS - 1 - x) for x, on in enumerate(r) if on) for r in pixels]
+            anim.aliases[alias] = len(anim.glyphs)
+            anim.glyphs.append((words[2], rows))
+        elif words[0] == "repeat" and len(words) == 2:
+            if repeat_from is not None:
+                fail(number, "repeat blocks cannot be nested")
+            repeat_from, repeat_count = len(anim.frames), int(words[1])
+        elif words[0] == "end" and len(words) == 1:
+            if repeat_from is None:
+                fail(number, "'end' without 'repeat'")
+            block = anim.frames[repeat_from:]
+            anim.frames.extend(block * (repeat_count - 1))
+            repeat_from = None
+        elif words[0] == "frame" and len(words) == 2:
+            cells = []
+            for _ in range(LCD_ROWS):
+                if i >= len(lines):
+                    fail(number, "frame needs %d lines" % LCD_ROWS)
+                row_number, row = lines[i]
+                i += 1
+                row = row.strip()
+                if len(row) != LCD_COLS + 2 or row[0] != "|" or row[-1] != "|":
+                    fail(row_number, "frame line must be |%d characters|" % LCD_COLS)
+                for c in row[1:-1]:
+                    if c in anim.aliases:
+                        cells.append(anim.aliases[c])
+                    elif 0x20 <= ord(c) < 0x7F:
+                        cells.append(ord(c))
+                    else:
+                        fail(row_number, "character %r cannot be shown" % c)
+            anim.frames.append((int(words[1]), cells))
+        else:
+            fail(number, "unknown line: %s" % text.strip())
+
+    if repeat_from is not None:
+        raise PackError("%s: 'repeat' without 'end'" % path)
+    if not anim.name or not re.fullmatch(r"[a-z][a-z0-9_]*", anim.name):
+        raise PackError("%s: missing or invalid 'anim <name>'" % path)
+    if not anim.frames:
+        raise PackError("%s: no frames" % path)
+    # The player loads every glyph before the first frame
+    if len(anim.glyphs) > CGRAM_SLOTS:
+        raise PackError("%s: %d glyphs, the LCD has %d" % (path, len(anim.glyphs), CGRAM_SLOTS))
+    return anim
+
+
+# ---------------------------------------------------------------------------
+# Encoder
+# ---------------------------------------------------------------------------
+
+def encode_glyphs(glyphs):
+    rows = [r for _, g in glyphs for r in g]
+    out, i = [], 0
+    while i < len(rows):
+        run = 1
+        while i + run < len(rows) and run < 8 and rows[i + run] == rows[i]:
+            run += 1
+        out.append(((run - 1) << 5) | rows[i])
+        i += run
+    return out
+
+
+def encode_timeline(frames):
+    out = []
+    for ms, cells in frames:
+        if not 0 <= ms <= 0xFFFF:
+            raise PackError("frame duration %d ms does not fit in 16 bits" % ms)
+        out += [ms & 0xFF, ms >> 8]
+        literal, i = [], 0
+        while i < len(cells):
+            run = 1
+            while i + run < len(cells) and cells[i + run] == cells[i]:
+                run += 1
+            if run >= 3 or (run == 2 and not literal):
+                if literal:
+                    out += [0x80 | len(literal)] + literal
+                    literal = []
+                out += [run, cells[i]]
+                i += run
+            else:
+                literal.append(cells[i])
+                i += 1
+        if literal:
+            out += [0x80 | len(literal)] + literal
+    return out
+
+
+def c_name(name):
+    return "anim" + "".join(part.capitalize() for part in name.split("_"))
+
+
+def c_bytes(values):
+    lines = []
+    for i in range(0, len(values), 12):
+        lines.append("    " + ", ".join("0x%02X" % v for v in values[i:i + 12]) + ",")
+    return "\n".join(lines)
+
+
+def generate(anims, sources, header_name):
+    banner = "/* Generated by Tools/anim_pack.py from %s; do not edit. */\n" % ", ".join(sources)
+
+    c = [banner, '#include "%s"\n' % header_name]
+    h = [banner,
+         "#ifndef ANIM_ASSETS_H", "#define ANIM_ASSETS_H", "",
+         '#include "anim.h"', ""]
+
+    for anim in anims:
+        var = c_name(anim.name)
+        glyphs = encode_glyphs(anim.glyphs)
+        timeline = encode_timeline(anim.frames)
+        c.append("/* ================== %s ==================\n"
+                 " * %d glyphs (%s): %d -> %d bytes\n"
+                 " * %d frames: %d -> %d bytes\n"
+                 " * ========================================= */\n"
+                 % (anim.name.upper(), len(anim.glyphs), ", ".join(n for n, _ in anim.glyphs),
+                    len(anim.glyphs) * GLYPH_ROWS, len(glyphs),
+                    len(anim.frames), len(anim.frames) * (2 + LCD_ROWS * LCD_COLS), len(timeline)))
+        c.append("static const uint8_t %sGlyphs[] = {\n%s\n};\n" % (var, c_bytes(glyphs)))
+        c.append("static const uint8_t %sTimeline[] = {\n%s\n};\n" % (var, c_bytes(timeline)))
+        c.append("const Anim_t %s = {\n"
+                 '    .name = "%s",\n'
+                 "    .glyphs = %sGlyphs,\n"
+                 "    .timeline = %sTimeline,\n"
+                 "    .glyphCount = %d,\n"
+                 "    .frameCount = %d,\n"
+                 "};\n" % (var, anim.name, var, var, len(anim.glyphs), len(anim.frames)))
+        h.append("extern const Anim_t %s;" % var)
+
+    h += ["", "#endif", ""]
+    return "\n".join(c), "\n".join(h)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("sources", nargs="+", help=".anim files")
+    ap.add_argument("-o", "--output", required=True, help="generated .c file")
+    ap.add_argument("-H", "--header", required=True, help="generated .h file")
+    args = ap.parse_args()
+
+    try:
+        anims = [parse(path) for path in args.sources]
+    except (PackError, OSError, ValueError) as e:
+        sys.exit(str(e))
+    names = [a.name for a in anims]
+    if len(set(names)) != len(names):
+        sys.exit("duplicate animation names: %s" % ", ".join(names))
+
+    sources = [os.path.basename(p) for p in args.sources]
+    c_text, h_text = generate(anims, sources, os.path.basename(args.header))
+    with open(args.output, "w") as f:
+        f.write(c_text)
+    with open(args.header, "w") as f:
+        f.write(h_text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
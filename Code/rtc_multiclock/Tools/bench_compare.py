@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+"""
+Compare two benchmark logs produced by a CONFIG_BENCHMARK=1 build.
+
+    bench_compare.py base.log new.log [--threshold 5]
+
+Logs may contain any other output (UART capture, Renode analyzer
+dump, host run); only BENCH records are read:
+
+    BENCH,<target>,<cpu_hz>,<name>,<iterations>,<min>,<mean>,<max>
+
+'min' cycles are compared, since they exclude interrupt jitter. The
+host build prints n/a for cases it cannot time; they are listed but
+not compared.
+Exits with 1 when a case got slower than the threshold (percent).
+"""
+
+import argparse
+import sys
+
+
+def read_log(path):
+    records = {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            fields = line.strip().split(",")
+            if len(fields) != 8 or fields[0] != "BENCH":
+                continue
+            _, target, hz, name, n, cmin, cmean, cmax = fields
+            if cmin == "n/a":
+                records[name] = None
+                continue
+            records[name] = {
+                "target": target, "hz": int(hz), "n": int(n),
+                "min": int(cmin), "mean": int(cmean), "max": int(cmax),
+            }
+    return records
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("base")
+    ap.add_argument("new")
+    ap.add_argument("--threshold", type=float, default=5.0,
+                    help="regression limit in percent (default 5)")
+    args = ap.parse_args()
+
+    base = read_log(args.base)
+    new = read_log(args.new)
+    if not base or not new:
+        sys.exit("no BENCH records in %s" % (args.base if not base else args.new))
+
+    regressions = 0
+    print("%-24s %12s %12s %9s %10s" % ("case", "base min", "new min", "delta", "new us"))
+    for name in sorted(set(base) | set(new)):
+        b = base.get(name)
+        n = new.get(name)
+        if b is None or n is None:
+            def text(log, r):
+                return r["min"] if r else ("n/a" if name in log else "-")
+            print("%-24s %12s %12s" % (name, text(base, b), text(new, n)))
+            continue
+        if b["min"]:
+            delta = 100.0 * (n["min"] - b["min"]) / b["min"]
+            mark = ""
+            if delta > args.threshold:
+                mark = "  SLOWER"
+                regressions += 1
+            delta_text = "%+8.1f%%%s" % (delta, mark)
+        else:
+            delta_text = "%9s" % "n/a"
+        us = 1e6 * n["min"] / n["hz"] if n["hz"] else 0.0
+        print("%-24s %12d %12d %s %10.2f" % (name, b["min"], n["min"], delta_text, us))
+
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+"""
+Decode a crash dump (crash.h) and map its addresses to source lines.
+
+    crash_decode.py capture.txt [-e build/rtc_multiclock.elf] [--addr2line arm-none-eabi-addr2line]
+
+The capture is console or stdout text that holds a dump: the lines
+CRASH_Init() prints at the boot after a fault, or the reply to the
+'crash' console command. Other lines are skipped; the last complete
+dump (CRASH ... CRASH_END) is decoded.
+
+Prints the cause, the RTC time, the fault status bits by name, the
+fault address when the core marked it valid, the registers, and PC,
+LR and the backtrace as function and file:line from the ELF of the
+build that crashed (addr2line from the GNU Arm toolchain). Without an
+ELF the addresses stay plain. The trace events before the crash
+follow, named from Core/Inc/trace_events.h, with their time before
+the last one.
+"""
+
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+TRACE_EVENTS_H = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                              "..", "Core", "Inc", "trace_events.h")
+
+# CFSR: MMFSR (bits 0-7), BFSR (8-15), UFSR (16-31)
+CFSR_BITS = {
+    0: "IACCVIOL: instruction fetch from a no-execute region",
+    1: "DACCVIOL: data access violation",
+    3: "MUNSTKERR: MemManage fault on exception return unstacking",
+    4: "MSTKERR: MemManage fault on exception entry stacking",
+    5: "MLSPERR: MemManage fault during FPU lazy state save",
+    7: "MMARVALID: MMFAR holds the address",
+    8: "IBUSERR: bus fault on instruction fetch",
+    9: "PRECISERR: precise data bus error",
+    10: "IMPRECISERR: imprecise data bus error (PC is later)",
+    11: "UNSTKERR: bus fault on exception return unstacking",
+    12: "STKERR: bus fault on exception entry stacking",
+    13: "LSPERR: bus fault during FPU lazy state save",
+    15: "BFARVALID: BFAR holds the address",
+    16: "UNDEFINSTR: undefined instruction",
+    17: "INVSTATE: invalid state (Thumb bit clear)",
+    18: "INVPC: invalid EXC_RETURN on exception return",
+    19: "NOCP: coprocessor access (FPU not enabled)",
+    24: "UNALIGNED: unaligned access",
+    25: "DIVBYZERO: divide by zero",
+}
+
+HFSR_BITS = {
+    1: "VECTTBL: bus fault on vector table read",
+    30: "FORCED: escalated from a configurable fault",
+    31: "DEBUGEVT: debug event",
+}
+
+
+def parse(lines):
+    """Fields of the last complete dump, or None."""
+    dump = None
+    found = None
+    in_trace = False
+    for line in lines:
+        line = line.strip()
+        fields = line.split(",")
+        tag = fields[0]
+        if tag == "CRASH" and len(fields) == 4:
+            dump = {"cause": fields[1], "count": int(fields[2]), "when": fields[3],
+                    "bt": [], "trace": [], "cpu_hz": 0}
+            in_trace = False
+        elif dump is None:
+            continue
+        elif tag == "CRASH_R" and len(fields) == 6:
+            dump.update(zip(["r0", "r1", "r2", "r3", "r12"], (int(f, 16) for f in fields[1:])))
+        elif tag == "CRASH_PC" and len(fields) == 6:
+            dump.update(zip(["pc", "lr", "xpsr", "sp", "exc_return"],
+                            (int(f, 16) for f in fields[1:])))
+        elif tag == "CRASH_FSR" and len(fields) == 5:
+            dump.update(zip(["cfsr", "hfsr", "mmfar", "bfar"], (int(f, 16) for f in fields[1:])))
+        elif tag == "CRASH_BT" and len(fields) == 2:
+            dump["bt"].append(int(fields[1], 16))
+        elif tag == "TRACE" and len(fields) == 4:
+            dump["cpu_hz"] = int(fields[1])
+            in_trace = True
+        elif tag == "T" and len(fields) == 4 and in_trace:
+            dump["trace"].append(tuple(int(f) for f in fields[1:]))
+        elif tag == "TRACE_END":
+            in_trace = False
+        elif tag == "CRASH_END":
+            if "pc" in dump and "cfsr" in dump:
+                found = dump
+            dump = None
+    return found
+
+
+def trace_names():
+    """Event names by ID, as the TRACE_EVENTS() list numbers them."""
+    try:
+        with open(TRACE_EVENTS_H) as f:
+            text = f.read()
+    except OSError:
+        return {}
+    names = re.findall(r'E\((TRACE_\w+),\s*"(\w+)",\s*\'(\w)\'', text)
+    return {i: "%s %s" % (name, phase) for i, (_, name, phase) in enumerate(names)}
+
+
+class Symbols:
+    def __init__(self, elf, addr2line):
+        self.elf = elf
+        self.addr2line = addr2line
+
+    def lookup(self, address, is_return):
+        """'function at file:line' for a PC, or for the call behind a return address."""
+        if self.elf is None:
+            return ""
+        # A return address points behind the BL; ask for the BL itself
+        target = ((address & ~1) - 1) if is_return else (address & ~1)
+        try:
+            out = subprocess.run([self.addr2line, "-e", self.elf, "-f", "-i", "-C", "-p",
+                                  "0x%08x" % target],
+                                 capture_output=True, text=True, check=True).stdout
+        except (OSError, subprocess.CalledProcessError) as e:
+            return "(addr2line: %s)" % e
+        return " | ".join(l.strip() for l in out.splitlines() if l.strip())
+
+
+def bit_names(value, table):
+    return [text for bit, text in sorted(table.items()) if value & (1 << bit)]
+
+
+def report(dump, symbols):
+    print("%s, dump %d, at %s" % (dump["cause"], dump["count"], dump["when"]))
+
+    for text in bit_names(dump["cfsr"], CFSR_BITS) + bit_names(dump["hfsr"], HFSR_BITS):
+        print("  %s" % text)
+    if dump["cfsr"] & (1 << 7):
+        print("  fault address 0x%08X (MMFAR)" % dump["mmfar"])
+    if dump["cfsr"] & (1 << 15):
+        print("  fault address 0x%08X (BFAR)" % dump["bfar"])
+
+    print()
+    print("r0  %08X  r1  %08X  r2  %08X  r3 %08X" % (dump["r0"], dump["r1"], dump["r2"], dump["r3"]))
+    print("r12 %08X  sp  %08X  psr %08X  exc_return %08X" %
+          (dump["r12"], dump["sp"], dump["xpsr"], dump["exc_return"]))
+    print()
+    # Error_Handler() stores its return address as the PC, and no LR
+    print(("pc  %08X  %s" % (dump["pc"], symbols.lookup(dump["pc"], dump["cause"] == "ERROR"))).rstrip())
+    if dump["cause"] != "ERROR":
+        print(("lr  %08X  %s" % (dump["lr"], symbols.lookup(dump["lr"], True))).rstrip())
+    for i, address in enumerate(dump["bt"]):
+        print(("#%-2d %08X  %s" % (i, address, symbols.lookup(address, True))).rstrip())
+
+    if dump["trace"]:
+        names = trace_names()
+        clock = next((i for i, name in names.items() if name.startswith("clock ")), None)
+        hz = dump["cpu_hz"] or 1
+        times = [0.0]
+        # Cycles count at the new clock after a clock record (sysclk.h)
+        for (before, event, arg), (cycles, _, _) in zip(dump["trace"], dump["trace"][1:]):
+            if event == clock and arg:
+                hz = arg * 1000000
+            times.append(times[-1] + ((cycles - before) & 0xFFFFFFFF) * 1e6 / hz)
+        print()
+        print("last %d trace events (us before the last one):" % len(dump["trace"]))
+        for (cycles, event, arg), us in zip(dump["trace"], times):
+            print("  %11.1f  %-16s %u" % (us - times[-1], names.get(event, "event %d" % event), arg))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("capture", help="text with the dump ('-' for stdin)")
+    ap.add_argument("-e", "--elf", help="ELF of the build that crashed")
+    ap.add_argument("--addr2line", default="arm-none-eabi-addr2line")
+    args = ap.parse_args()
+
+    if args.capture == "-":
+        lines = sys.stdin.read().splitlines()
+    else:
+        with open(args.capture, errors="replace") as f:
+            lines = f.read().splitlines()
+    dump = parse(lines)
+    if dump is None:
+        sys.exit("no complete crash dump in %s" % args.capture)
+
+    if args.elf is not None and shutil.which(args.addr2line) is None:
+        sys.exit("%s not found (--addr2line)" % args.addr2line)
+    report(dump, Symbols(args.elf, args.addr2line))
+
+
+if __name__ == "__main__":
+    main()
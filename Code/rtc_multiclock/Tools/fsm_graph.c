@@ -0,0 +1,131 @@
+/**
+ * @file    fsm_graph.c
+ * @brief   Host tool: export the UI state machines and check reachability
+ *
+ * Builds the same X-macro rows as the mode files (ui_fsm.h) into
+ * name-only tables, then:
+ *  - prints both machines as a Graphviz DOT graph on stdout
+ *  - checks that every state is reachable from the initial state
+ *  - checks that every state can leave (no dead-end states)
+ *
+ * Build and run on the host (no HAL needed):
+ *   cc -I../Core/Inc fsm_graph.c -o fsm_graph
+ *   ./fsm_graph > ui_fsm.dot && dot -Tsvg ui_fsm.dot -o ui_fsm.svg
+ *
+ * Exit status is non-zero if any check fails; ctest runs it on the
+ * UI tables (Host/CMakeLists.txt).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "ui_fsm.h"
+
+/* ================== NAME-ONLY TABLES ================== */
+
+typedef struct {
+    int state;
+    int event;
+    const char *guard;
+    const char *action;
+    int next;
+} Edge_t;
+
+#define NAME_OF(id, ...)          #id,
+#define EVENT_NAME(id)            #id,
+#define EDGE(s, e, g, a, n)       { s, e, #g, #a, n },
+
+static const char *eventNames[UI_EV_COUNT] = { UI_EVENTS(EVENT_NAME) };
+
+static const char *stopwatchNames[SW_COUNT] = { UI_STOPWATCH_STATES(NAME_OF) };
+static const Edge_t stopwatchEdges[] = { UI_STOPWATCH_TRANSITIONS(EDGE) };
+
+static const char *settingNames[SET_COUNT] = { UI_SETTING_STATES(NAME_OF) };
+static const Edge_t settingEdges[] = { UI_SETTING_TRANSITIONS(EDGE) };
+
+#define COUNT_OF(a)  (sizeof(a) / sizeof((a)[0]))
+
+/* ================== EXPORT ================== */
+
+static void printMachine(const char *name, const char *const *states, int numStates,
+                         const Edge_t *edges, int numEdges, int initial) {
+    printf("  subgraph cluster_%s {\n", name);
+    printf("    label=\"%s\";\n", name);
+    for(int i = 0; i < numStates; i++) {
+        printf("    %s [shape=%s];\n", states[i], i == initial ? "doublecircle" : "circle");
+    }
+    for(int i = 0; i < numEdges; i++) {
+        const Edge_t *e = &edges[i];
+        printf("    %s -> %s [label=\"%s", states[e->state], states[e->next], eventNames[e->event]);
+        if(strcmp(e->guard, "NULL") != 0) {
+            printf(" [%s]", e->guard);
+        }
+        if(strcmp(e->action, "NULL") != 0) {
+            printf(" / %s", e->action);
+        }
+        printf("\"];\n");
+    }
+    printf("  }\n");
+}
+
+/* ================== CHECKS ================== */
+
+static int checkMachine(const char *name, const char *const *states, int numStates,
+                        const Edge_t *edges, int numEdges, int initial) {
+    unsigned char reached[256] = {0};
+    unsigned char leaves[256] = {0};
+    int errors = 0;
+    int changed = 1;
+
+    // Fixed-point BFS over the edge list
+    reached[initial] = 1;
+    while(changed) {
+        changed = 0;
+        for(int i = 0; i < numEdges; i++) {
+            if(reached[edges[i].state] && !reached[edges[i].next]) {
+                reached[edges[i].next] = 1;
+                changed = 1;
+            }
+        }
+    }
+
+    for(int i = 0; i < numEdges; i++) {
+        if(edges[i].next != edges[i].state) {
+            leaves[edges[i].state] = 1;
+        }
+    }
+
+    for(int s = 0; s < numStates; s++) {
+        if(!reached[s]) {
+            fprintf(stderr, "%s: state %s is unreachable\n", name, states[s]);
+            errors++;
+        }
+        if(!leaves[s]) {
+            fprintf(stderr, "%s: state %s has no way out\n", name, states[s]);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+int main(void) {
+    int errors = 0;
+
+    printf("digraph ui_fsm {\n");
+    printMachine("stopwatch", stopwatchNames, SW_COUNT,
+                 stopwatchEdges, (int)COUNT_OF(stopwatchEdges), UI_STOPWATCH_INITIAL);
+    printMachine("setting", settingNames, SET_COUNT,
+                 settingEdges, (int)COUNT_OF(settingEdges), UI_SETTING_INITIAL);
+    printf("}\n");
+
+    errors += checkMachine("stopwatch", stopwatchNames, SW_COUNT,
+                           stopwatchEdges, (int)COUNT_OF(stopwatchEdges), UI_STOPWATCH_INITIAL);
+    errors += checkMachine("setting", settingNames, SET_COUNT,
+                           settingEdges, (int)COUNT_OF(settingEdges), UI_SETTING_INITIAL);
+
+    if(errors) {
+        fprintf(stderr, "%d problem(s) found\n", errors);
+        return 1;
+    }
+    fprintf(stderr, "all states reachable\n");
+    return 0;
+}
@@ -0,0 +1,220 @@
+//
+// HD44780 16x2 character LCD on a 4-bit parallel bus, for Renode.
+//
+// Same decoder as Host/sim/sim_lcd.c: RS and D4..D7 are latched on the
+// falling edge of EN. The controller starts in 8-bit mode (each EN pulse
+// is a whole instruction with D0..D3 = 0) until a function set selects
+// 4-bit mode, after which nibbles are paired high-then-low.
+//
+// GPIO inputs: 0 = RS, 1 = EN, 2 = D4, 3 = D5, 4 = D6, 5 = D7
+//
+// Monitor API:
+//   GetLine <row>      current text of row 0 or 1
+//   GetHistory <row>   every distinct content of the row as "<ms>|<text>"
+//                      lines, stamped with the virtual time of the change
+//   ClearHistory
+//
+using System;
+using System.Collections.Generic;
+using System.Text;
+using Antmicro.Renode.Core;
+using Antmicro.Renode.Logging;
+
+namespace Antmicro.Renode.Peripherals.Miscellaneous
+{
+    public class HD44780 : IGPIOReceiver
+    {
+        public HD44780(IMachine machine)
+        {
+            this.machine = machine;
+            history = new List<string>[] { new List<string>(), new List<string>() };
+            Reset();
+        }
+
+        public void Reset()
+        {
+            for(var i = 0; i < ddram.Length; i++)
+            {
+                ddram[i] = (byte)' ';
+            }
+            Array.Clear(cgram, 0, cgram.Length);
+            Array.Clear(pins, 0, pins.Length);
+            address = 0;
+            addressIsCgram = false;
+            increment = true;
+            fourBitMode = false;
+            haveHighNibble = false;
+            ClearHistory();
+        }
+
+        public void OnGPIO(int number, bool value)
+        {
+            if(number < 0 || number >= pins.Length)
+            {
+                this.Log(LogLevel.Warning, "Unknown input {0}", number);
+                return;
+            }
+
+            var fallingEnable = number == EnableInput && pins[EnableInput] && !value;
+            pins[number] = value;
+            if(!fallingEnable)
+            {
+                return;
+            }
+
+            var nibble = (byte)((pins[2] ? 1 : 0) | (pins[3] ? 2 : 0) | (pins[4] ? 4 : 0) | (pins[5] ? 8 : 0));
+            if(!fourBitMode)
+            {
+                Write(pins[RegisterSelectInput], (byte)(nibble << 4));
+                return;
+            }
+            if(!haveHighNibble)
+            {
+                highNibble = nibble;
+                haveHighNibble = true;
+                return;
+            }
+            haveHighNibble = false;
+            Write(pins[RegisterSelectInput], (byte)((highNibble << 4) | nibble));
+        }
+
+        public string GetLine(int row)
+        {
+            var text = new StringBuilder(Columns);
+            var baseAddress = row == 0 ? 0x00 : 0x40;
+            for(var i = 0; i < Columns; i++)
+            {
+                var c = ddram[baseAddress + i];
+                // CGRAM characters (the rocket animation) shown as '*'
+                text.Append(c < 0x20 || c > 0x7E ? '*' : (char)c);
+            }
+            return text.ToString();
+        }
+
+        public string GetHistory(int row)
+        {
+            return string.Join("\n", history[row == 0 ? 0 : 1]);
+        }
+
+        public void ClearHistory()
+        {
+            history[0].Clear();
+            history[1].Clear();
+            lastLine = new string[] { GetLine(0), GetLine(1) };
+        }
+
+        private void Write(bool isData, byte value)
+        {
+            if(isData)
+            {
+                Data(value);
+            }
+            else
+            {
+                Command(value);
+            }
+            Record(0);
+            Record(1);
+        }
+
+        private void Command(byte cmd)
+        {
+            if((cmd & 0x80) != 0)                               // Set DDRAM address
+            {
+                address = cmd & 0x7F;
+                addressIsCgram = false;
+            }
+            else if((cmd & 0x40) != 0)                          // Set CGRAM address
+            {
+                address = cmd & 0x3F;
+                addressIsCgram = true;
+            }
+            else if((cmd & 0x20) != 0)                          // Function set
+            {
+                fourBitMode = (cmd & 0x10) == 0;
+            }
+            else if((cmd & 0x04) != 0 && (cmd & 0x18) == 0)     // Entry mode set
+            {
+                increment = (cmd & 0x02) != 0;
+            }
+            else if(cmd == 0x01)                                // Clear display
+            {
+                for(var i = 0; i < ddram.Length; i++)
+                {
+                    ddram[i] = (byte)' ';
+                }
+                address = 0;
+                addressIsCgram = false;
+                increment = true;
+            }
+            else if((cmd & 0xFE) == 0x02)                       // Return home
+            {
+                address = 0;
+                addressIsCgram = false;
+            }
+            // Display control and shift commands do not change the contents
+        }
+
+        private void Data(byte data)
+        {
+            if(addressIsCgram)
+            {
+                cgram[address & 0x3F] = data;
+                address = (address + 1) & 0x3F;
+                return;
+            }
+
+            if(address < ddram.Length)
+            {
+                ddram[address] = data;
+            }
+
+            // Line 1 runs 0x00..0x27, line 2 0x40..0x67
+            if(increment)
+            {
+                address++;
+                if(address == 0x28)
+                {
+                    address = 0x40;
+                }
+                else if(address >= 0x68)
+                {
+                    address = 0x00;
+                }
+            }
+            else
+            {
+                address = address == 0x00 ? 0x67 : address - 1;
+            }
+        }
+
+        private void Record(int row)
+        {
+            var line = GetLine(row);
+            if(line == lastLine[row])
+            {
+                return;
+            }
+            lastLine[row] = line;
+            var ms = machine.LocalTimeSource.ElapsedVirtualTime.TotalMilliseconds;
+            history[row].Add(string.Format("{0:F3}|{1}", ms, line));
+        }
+
+        private readonly IMachine machine;
+        private readonly byte[] ddram = new byte[0x68];
+        private readonly byte[] cgram = new byte[0x40];
+        private readonly bool[] pins = new bool[6];
+        private readonly List<string>[] history;
+        private string[] lastLine;
+        private int address;
+        private bool addressIsCgram;
+        private bool increment;
+        private bool fourBitMode;
+        private bool haveHighNibble;
+        private byte highNibble;
+
+        private const int Columns = 16;
+        private const int RegisterSelectInput = 0;
+        private const int EnableInput = 1;
+    }
+}
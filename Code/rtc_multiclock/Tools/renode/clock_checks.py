@@ -0,0 +1,80 @@
+"""
+Robot Framework keywords for checking the LCD history recorded by
+HD44780.cs. Can also be imported from pytest.
+
+A history is the text returned by ``lcd GetHistory <row>``: one
+``<virtual ms>|<16 characters>`` line per change of the row.
+"""
+
+import re
+
+TIME_RE = re.compile(r"T:(\d\d):(\d\d):(\d\d)")
+
+
+def _monitor_text(output):
+    # The monitor echoes strings with surrounding whitespace / quotes
+    return output.strip().strip('"')
+
+
+def parse_history(history):
+    """Returns [(ms, text)] from a GetHistory dump."""
+    frames = []
+    for line in _monitor_text(history).splitlines():
+        ms, sep, text = line.partition("|")
+        if sep:
+            frames.append((float(ms), text))
+    return frames
+
+
+def clock_seconds(history):
+    """Returns [(ms, seconds since midnight)] for every new clock value."""
+    values = []
+    for ms, text in parse_history(history):
+        m = TIME_RE.search(text)
+        if not m:
+            continue        # blank row after LCD_Clear or a partial redraw
+        t = int(m.group(1)) * 3600 + int(m.group(2)) * 60 + int(m.group(3))
+        if not values or values[-1][1] != t:
+            values.append((ms, t))
+    return values
+
+
+def seconds_should_never_skip(history, min_steps=3600, max_jitter_ms=50):
+    """Every displayed second is exactly one more than the previous one,
+    and it appears 1000 ms (+- max_jitter_ms) after it."""
+    values = clock_seconds(history)
+    min_steps = int(min_steps)
+    max_jitter_ms = float(max_jitter_ms)
+
+    if len(values) < min_steps + 1:
+        raise AssertionError("only %d clock updates, expected at least %d"
+                             % (len(values), min_steps + 1))
+    for (ms0, t0), (ms1, t1) in zip(values, values[1:]):
+        if (t1 - t0) % 86400 != 1:
+            raise AssertionError("clock jumped from %d to %d at %.3f ms" % (t0, t1, ms1))
+        if abs((ms1 - ms0) - 1000.0) > max_jitter_ms:
+            raise AssertionError("second %d shown %.3f ms after the previous one"
+                                 % (t1, ms1 - ms0))
+
+
+def first_clock_frame_should_be_before(history, max_ms):
+    """The boot animation finishes and the clock is shown within max_ms."""
+    values = clock_seconds(history)
+    if not values:
+        raise AssertionError("clock never shown")
+    if values[0][0] > float(max_ms):
+        raise AssertionError("first clock frame at %.3f ms, limit %s ms" % (values[0][0], max_ms))
+    return values[0][0]
+
+
+def lcd_line_should_start_with(line, prefix):
+    text = _monitor_text(line)
+    if not text.startswith(prefix):
+        raise AssertionError("LCD shows '%s', expected '%s...'" % (text, prefix))
+
+
+def monitor_value_should_be(output, expected):
+    """A number printed by the monitor (e.g. ``sysbus ReadWord``) equals expected."""
+    value = int(_monitor_text(output), 0)
+    if value != int(expected):
+        raise AssertionError("read %d, expected %s" % (value, expected))
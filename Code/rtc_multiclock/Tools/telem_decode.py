@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+"""
+Decode a telemetry capture (telemetry.h) into CSV or Parquet tables.
+
+    telem_decode.py capture.bin [-o prefix] [--format csv|parquet] [--hz 84000000]
+
+The capture is the raw USART1 byte stream, from a USB-serial adapter on
+PA9 or from the host build (rtc_multiclock_host -L capture.bin). Frames
+end in 0x00; each one is COBS-decoded and its CRC-16/CCITT-FALSE
+checked. Frames with a bad CRC are counted and skipped, and decoding
+picks up again at the next delimiter.
+
+One table per record type is written: <prefix>_time, _loop, _input and
+_stats (.csv or .parquet; Parquet needs pyarrow). A summary follows on
+stdout: frames lost (seq gaps), RTC drift against the tick in ppm, line
+use and the CPU share of the telemetry code.
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+HEADER = struct.Struct("<BBI")     # type, seq, tick
+
+RECORDS = {
+    1: ("time", struct.Struct("<BBBHH"),
+        ["hours", "minutes", "seconds", "sub_seconds", "second_fraction"]),
+    2: ("loop", struct.Struct("<II"), ["busy_cycles", "period_cycles"]),
+    3: ("input", struct.Struct("<I"), ["latency_cycles"]),
+    4: ("stats", struct.Struct("<IIII"), ["frames", "bytes", "dropped", "cycles"]),
+}
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(frame):
+    out = bytearray()
+    i = 0
+    while i < len(frame):
+        code = frame[i]
+        if code == 0 or i + code > len(frame) + 1:
+            return None
+        out += frame[i + 1:i + code]
+        i += code
+        if i < len(frame):
+            out.append(0)
+    return bytes(out)
+
+
+def decode(data):
+    """Rows per record name, plus counters."""
+    tables = {name: [] for name, _, _ in RECORDS.values()}
+    counts = {"frames": 0, "crc_errors": 0, "unknown": 0, "lost": 0}
+    last_seq = None
+
+    for chunk in data.split(b"\x00")[:-1]:
+        raw = cobs_decode(chunk) if chunk else None
+        if raw is None or len(raw) < HEADER.size + 2 or \
+                crc16(raw[:-2]) != struct.unpack_from("<H", raw, len(raw) - 2)[0]:
+            counts["crc_errors"] += 1
+            continue
+        rtype, seq, tick = HEADER.unpack_from(raw)
+        payload = raw[HEADER.size:-2]
+        counts["frames"] += 1
+        if last_seq is not None:
+            counts["lost"] += (seq - last_seq - 1) & 0xFF
+        last_seq = seq
+
+        rec = RECORDS.get(rtype)
+        if rec is None or len(payload) != rec[1].size:
+            counts["unknown"] += 1
+            continue
+        tables[rec[0]].append([tick, seq] + list(rec[1].unpack(payload)))
+    return tables, counts
+
+
+def write_tables(tables, prefix, fmt):
+    for name, _, fields in RECORDS.values():
+        columns = ["tick_ms", "seq"] + fields
+        rows = tables[name]
+        if fmt == "parquet":
+            try:
+                import pyarrow
+                import pyarrow.parquet
+            except ImportError:
+                sys.exit("--format parquet needs pyarrow")
+            table = pyarrow.table({c: [r[i] for r in rows] for i, c in enumerate(columns)})
+            pyarrow.parquet.write_table(table, "%s_%s.parquet" % (prefix, name))
+        else:
+            with open("%s_%s.csv" % (prefix, name), "w", newline="") as f:
+                w = csv.writer(f)
+                w.writerow(columns)
+                w.writerows(rows)
+
+
+def rtc_seconds(row):
+    _, _, h, m, s, ss, prediv = row
+    return h * 3600 + m * 60 + s + (prediv - ss) / (prediv + 1.0)
+
+
+def summary(tables, counts, hz, baud):
+    print("frames %d, lost %d, crc errors %d, unknown %d" %
+          (counts["frames"], counts["lost"], counts["crc_errors"], counts["unknown"]))
+
+    time = tables["time"]
+    if len(time) >= 2:
+        span = (time[-1][0] - time[0][0]) / 1000.0
+        rtc = rtc_seconds(time[-1]) - rtc_seconds(time[0])
+        if rtc < 0:
+            rtc += 86400    # Midnight
+        if span > 0:
+            print("rtc drift %+.1f ppm over %.0f s" % ((rtc - span) / span * 1e6, span))
+
+    stats = tables["stats"]
+    if len(stats) >= 2:
+        first, last = stats[0], stats[-1]
+        span = (last[0] - first[0]) / 1000.0
+        if span > 0:
+            delta = [(last[i] - first[i]) & 0xFFFFFFFF for i in range(2, 6)]
+            print("device: %d frames, %d dropped, line %.2f%% of %d baud, cpu %.3f%% at %d Hz" %
+                  (delta[0], delta[2], 100.0 * delta[1] * 10 / (baud * span), baud,
+                   100.0 * delta[3] / (hz * span), hz))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("capture")
+    ap.add_argument("-o", "--prefix", default="telem", help="output file prefix (default telem)")
+    ap.add_argument("--format", choices=["csv", "parquet"], default="csv")
+    ap.add_argument("--hz", type=int, default=84000000, help="CPU clock for the cycle counts")
+    ap.add_argument("--baud", type=int, default=921600)
+    args = ap.parse_args()
+
+    with open(args.capture, "rb") as f:
+        data = f.read()
+    tables, counts = decode(data)
+    if counts["frames"] == 0:
+        sys.exit("no telemetry frames in %s" % args.capture)
+    write_tables(tables, args.prefix, args.format)
+    summary(tables, counts, args.hz, args.baud)
+
+
+if __name__ == "__main__":
+    main()
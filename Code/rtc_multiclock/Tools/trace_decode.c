@@ -0,0 +1,202 @@
+/**
+ * @file    trace_decode.c
+ * @brief   Host tool: convert a trace ring into a Chrome / Perfetto JSON timeline
+ *
+ * Input is either
+ *  - a binary image of 'traceBuffer' (RAM dump, or 'rtc_multiclock_host -T'),
+ *    recognised by the TRACE_MAGIC header, or
+ *  - a text log containing the output of TRACE_Dump() (e.g. a UART
+ *    capture); other lines in the log are ignored.
+ *
+ * The JSON goes to stdout and opens in chrome://tracing or
+ * https://ui.perfetto.dev. Thread mode and interrupts are shown as
+ * two tracks. Event names come from trace_events.h. Cycles count at
+ * the clock of the header until a "clock" record (sysclk.h) gives the
+ * next one.
+ *
+ * Build and run on the host (no HAL needed):
+ *   cc -I../Core/Inc trace_decode.c -o trace_decode
+ *   ./trace_decode trace.bin > trace.json
+ *
+ * Exit status is non-zero if the input holds no trace.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace_events.h"
+
+typedef struct {
+    const char *name;
+    char phase;
+    int track;
+} EventInfo_t;
+
+#define TRACE_AS_INFO(id, name, phase, track)  [id] = { name, phase, track },
+
+static const EventInfo_t eventInfo[TRACE_EVENT_COUNT] = {
+    TRACE_EVENTS(TRACE_AS_INFO)
+};
+
+typedef struct {
+    uint32_t cycles;
+    uint16_t id;
+    uint16_t arg;
+} Record_t;
+
+static Record_t *records;
+static uint32_t recordCount;
+static uint32_t cpuHz;
+
+/* ================== INPUT ================== */
+
+static uint32_t le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+// TraceBuffer_t image: 16-byte header, then 'size' records of 8 bytes
+static int readImage(const uint8_t *data, size_t len) {
+    if(len < 16 || le32(data) != TRACE_MAGIC) {
+        return 0;
+    }
+
+    uint32_t head = le32(data + 4);
+    uint32_t size = le32(data + 8);
+    cpuHz = le32(data + 12);
+
+    if(size == 0 || (size & (size - 1)) != 0 || len < 16 + (size_t)size * 8) {
+        fprintf(stderr, "trace image truncated or corrupt\n");
+        return -1;
+    }
+
+    recordCount = (head < size) ? head : size;
+    records = calloc(recordCount ? recordCount : 1, sizeof(Record_t));
+    for(uint32_t i = 0; i < recordCount; i++) {
+        const uint8_t *r = data + 16 + (size_t)((head - recordCount + i) & (size - 1)) * 8;
+        records[i].cycles = le32(r);
+        records[i].id = le16(r + 4);
+        records[i].arg = le16(r + 6);
+    }
+    return 1;
+}
+
+// TRACE_Dump() output; the last complete dump in the log wins
+static int readText(char *text) {
+    uint32_t capacity = 0;
+    int inDump = 0;
+    int found = 0;
+
+    for(char *line = strtok(text, "\r\n"); line != NULL; line = strtok(NULL, "\r\n")) {
+        unsigned long a, b, c;
+
+        if(sscanf(line, "TRACE,%lu,%lu,%lu", &a, &b, &c) == 3) {
+            cpuHz = (uint32_t)a;
+            recordCount = 0;
+            inDump = 1;
+        } else if(inDump && strncmp(line, "TRACE_END", 9) == 0) {
+            inDump = 0;
+            found = 1;
+        } else if(inDump && sscanf(line, "T,%lu,%lu,%lu", &a, &b, &c) == 3) {
+            if(recordCount == capacity) {
+                capacity = capacity ? capacity * 2 : 1024;
+                records = realloc(records, capacity * sizeof(Record_t));
+            }
+            records[recordCount].cycles = (uint32_t)a;
+            records[recordCount].id = (uint16_t)b;
+            records[recordCount].arg = (uint16_t)c;
+            recordCount++;
+        }
+    }
+    return found;
+}
+
+/* ================== OUTPUT ================== */
+
+// Returns the covered time span in microseconds
+static double writeJson(void) {
+    double usPerCycle = 1e6 / (double)(cpuHz ? cpuHz : 1);
+    double time = 0.0;
+
+    printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    printf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"thread\"}},\n");
+    printf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"interrupts\"}}");
+
+    for(uint32_t i = 0; i < recordCount; i++) {
+        const Record_t *r = &records[i];
+
+        // CYCCNT wraps every 2^32 cycles; records are far closer than that
+        if(i > 0) {
+            time += (double)(uint32_t)(r->cycles - records[i - 1].cycles) * usPerCycle;
+        }
+
+        if(r->id >= TRACE_EVENT_COUNT) {
+            printf(",\n{\"name\":\"unknown_%u\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+                   "\"pid\":1,\"tid\":0,\"args\":{\"arg\":%u}}",
+                   (unsigned)r->id, time, (unsigned)r->arg);
+            continue;
+        }
+
+        const EventInfo_t *e = &eventInfo[r->id];
+        printf(",\n{\"name\":\"%s\",\"ph\":\"%c\",%s\"ts\":%.3f,\"pid\":1,\"tid\":%d,"
+               "\"args\":{\"arg\":%u}}",
+               e->name, e->phase, (e->phase == 'i') ? "\"s\":\"t\"," : "",
+               time, e->track, (unsigned)r->arg);
+
+        // The cycles from here on count at the new clock
+        if(r->id == TRACE_CLOCK && r->arg != 0) {
+            usPerCycle = 1.0 / (double)r->arg;
+        }
+    }
+
+    printf("\n]}\n");
+    return time;
+}
+
+int main(int argc, char **argv) {
+    FILE *f;
+    uint8_t *data;
+    size_t len = 0;
+    size_t capacity = 1 << 16;
+    int ok;
+
+    if(argc != 2) {
+        fprintf(stderr, "usage: %s trace.bin|uart.log > trace.json\n", argv[0]);
+        return 2;
+    }
+    f = fopen(argv[1], "rb");
+    if(f == NULL) {
+        perror(argv[1]);
+        return 2;
+    }
+
+    data = malloc(capacity + 1);
+    for(size_t n; (n = fread(data + len, 1, capacity - len, f)) > 0; ) {
+        len += n;
+        if(len == capacity) {
+            capacity *= 2;
+            data = realloc(data, capacity + 1);
+        }
+    }
+    fclose(f);
+    data[len] = '\0';
+
+    ok = readImage(data, len);
+    if(ok == 0) {
+        ok = readText((char *)data);
+    }
+    if(ok <= 0) {
+        fprintf(stderr, "%s: no trace found\n", argv[1]);
+        return 1;
+    }
+
+    double span = writeJson();
+    fprintf(stderr, "%u records, %.3f ms, starting at %u Hz\n", recordCount, span / 1e3, cpuHz);
+    free(records);
+    free(data);
+    return 0;
+}